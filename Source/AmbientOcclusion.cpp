@@ -0,0 +1,137 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "AmbientOcclusion.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+
+namespace Raymarch {
+    // The normal, right and up directions of each face, matching the voxel shader.
+    struct FaceBasis {
+        int Normal[3];
+        int Right[3];
+        int Up[3];
+    };
+    constexpr static const FaceBasis Faces[6] = {
+        {{+1,  0,  0}, {0, 1, 0}, {0, 0, 1}},
+        {{-1,  0,  0}, {0, 1, 0}, {0, 0, 1}},
+        {{ 0, +1,  0}, {1, 0, 0}, {0, 0, 1}},
+        {{ 0, -1,  0}, {1, 0, 0}, {0, 0, 1}},
+        {{ 0,  0, +1}, {1, 0, 0}, {0, 1, 0}},
+        {{ 0,  0, -1}, {1, 0, 0}, {0, 1, 0}}
+    };
+
+    // The up and right steps of each bit of a face mask.
+    constexpr static const int NeighbourSteps[8][2] = {
+        {+1,  0}, {-1,  0}, { 0, +1}, { 0, -1},
+        {+1, +1}, {+1, -1}, {-1, +1}, {-1, -1}
+    };
+
+    // Constructor for an empty occlusion volume.
+    AmbientOcclusion::AmbientOcclusion(void)
+        : Size{{0, 0, 0}} {
+    }
+
+    // Get the size.
+    const std::array<std::size_t, 3>& AmbientOcclusion::GetSize(void) const {
+        return this->Size;
+    }
+
+    // Get the occlusion data.
+    const std::uint32_t* AmbientOcclusion::data(void) const {
+        return this->Masks.data();
+    }
+
+    // Bake every voxel in parallel slabs along Z.
+    void AmbientOcclusion::Rebuild(const Volume& Scene) {
+        RAYMARCH_TRACE_SCOPE("AmbientOcclusion::Rebuild");
+
+        this->Size = Scene.GetSize();
+        this->Masks.assign(this->Size[0] * this->Size[1] * this->Size[2] * 2, 0);
+        JobSystem::GetGlobal().ParallelFor(0, this->Size[2], 1, [this, &Scene](std::size_t FirstZ, std::size_t LastZ) -> void {
+            Region Slab = Scene.GetRegion();
+            Slab.Minimum[2] = static_cast<int>(FirstZ);
+            Slab.Maximum[2] = static_cast<int>(LastZ);
+            this->Bake(Scene, Slab);
+        });
+    }
+
+    // Bake the voxels within one voxel of a change, the furthest neighbour of a face is one voxel away along every axis.
+    Region AmbientOcclusion::Update(const Volume& Scene, const Region& Changed) {
+        const Region Affected = Changed.Expand(1).Intersection(Scene.GetRegion());
+        if (!Affected.IsEmpty()) {
+            RAYMARCH_TRACE_SCOPE("AmbientOcclusion::Update");
+            this->Bake(Scene, Affected);
+        }
+        return Affected;
+    }
+
+    // Copy a region of occlusion words row by row.
+    void AmbientOcclusion::Copy(const AmbientOcclusion& Source, const Region& Target) {
+        if (this->Size != Source.Size) {
+            *this = Source;
+            return;
+        }
+        const Region Clipped = Target.Intersection(Region({{0, 0, 0}}, {{static_cast<int>(this->Size[0]), static_cast<int>(this->Size[1]), static_cast<int>(this->Size[2])}}));
+        for (int IndexZ = Clipped.Minimum[2]; IndexZ < Clipped.Maximum[2]; ++IndexZ) {
+            for (int IndexY = Clipped.Minimum[1]; IndexY < Clipped.Maximum[1]; ++IndexY) {
+                const std::size_t First = (static_cast<std::size_t>(Clipped.Minimum[0]) + this->Size[0] * (static_cast<std::size_t>(IndexY) + this->Size[1] * static_cast<std::size_t>(IndexZ))) * 2;
+                const std::size_t Count = static_cast<std::size_t>(Clipped.Maximum[0] - Clipped.Minimum[0]) * 2;
+                std::copy(Source.Masks.begin() + First, Source.Masks.begin() + First + Count, this->Masks.begin() + First);
+            }
+        }
+    }
+
+    // Bake the face masks of the occupied voxels in a region, empty voxels are never shaded.
+    void AmbientOcclusion::Bake(const Volume& Scene, const Region& Target) {
+        const Region Bounds = Scene.GetRegion();
+        for (int IndexZ = Target.Minimum[2]; IndexZ < Target.Maximum[2]; ++IndexZ) {
+            for (int IndexY = Target.Minimum[1]; IndexY < Target.Maximum[1]; ++IndexY) {
+                for (int IndexX = Target.Minimum[0]; IndexX < Target.Maximum[0]; ++IndexX) {
+                    std::uint32_t Words[2] = {0, 0};
+                    if (Scene(IndexX, IndexY, IndexZ).GetAlpha() > 0) {
+                        for (std::size_t Face = 0; Face < 6; ++Face) {
+                            const FaceBasis& Basis = Faces[Face];
+                            std::uint32_t FaceMask = 0;
+                            for (std::size_t Bit = 0; Bit < 8; ++Bit) {
+                                const int NeighbourX = IndexX + Basis.Normal[0] + NeighbourSteps[Bit][0] * Basis.Up[0] + NeighbourSteps[Bit][1] * Basis.Right[0];
+                                const int NeighbourY = IndexY + Basis.Normal[1] + NeighbourSteps[Bit][0] * Basis.Up[1] + NeighbourSteps[Bit][1] * Basis.Right[1];
+                                const int NeighbourZ = IndexZ + Basis.Normal[2] + NeighbourSteps[Bit][0] * Basis.Up[2] + NeighbourSteps[Bit][1] * Basis.Right[2];
+                                if (Bounds.Contains(NeighbourX, NeighbourY, NeighbourZ) && (Scene(NeighbourX, NeighbourY, NeighbourZ).GetAlpha() >= OccludingAlpha)) {
+                                    FaceMask |= 1u << Bit;
+                                }
+                            }
+                            Words[Face / 4] |= FaceMask << ((Face % 4) * 8);
+                        }
+                    }
+                    const std::size_t Index = static_cast<std::size_t>(IndexX) + this->Size[0] * (static_cast<std::size_t>(IndexY) + this->Size[1] * static_cast<std::size_t>(IndexZ));
+                    this->Masks[Index * 2 + 0] = Words[0];
+                    this->Masks[Index * 2 + 1] = Words[1];
+                }
+            }
+        }
+    }
+}
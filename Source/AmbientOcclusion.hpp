@@ -0,0 +1,89 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_AMBIENTOCCLUSION_HPP
+#define RAYMARCH_AMBIENTOCCLUSION_HPP
+
+#include "Region.hpp"
+#include "Volume.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  AmbientOcclusion bakes, for each face of each voxel, which of the eight voxels around the empty voxel in front of the face are occupied.
+    /// @note   The masks are stored as two 32 bit words per voxel, faces +X, -X, +Y, -Y in the first and +Z, -Z in the second, eight bits per face.
+    ///         Bits are +Up, -Up, +Right, -Right, +Up+Right, +Up-Right, -Up+Right, -Up-Right, using the Up and Right directions of the voxel shader.
+    class AmbientOcclusion {
+    public:
+        /// @brief  The alpha at or above which a neighbouring voxel occludes.
+        constexpr static const std::uint8_t OccludingAlpha = 4;
+
+    private:
+        /// @brief  The size of the baked volume.
+        std::array<std::size_t, 3> Size;
+
+        /// @brief  The two occlusion words of each voxel.
+        std::vector<std::uint32_t> Masks;
+
+    public:
+        /// @brief  Constructor that creates an empty occlusion volume.
+        AmbientOcclusion(void);
+
+    public:
+        /// @brief  Get the size of the baked volume.
+        /// @return The size of the baked volume.
+        const std::array<std::size_t, 3>& GetSize(void) const;
+
+        /// @brief  Get the occlusion words, two per voxel in the same order as the voxels of the volume.
+        /// @return A pointer to the occlusion words.
+        const std::uint32_t* data(void) const;
+
+    public:
+        /// @brief  Bake the occlusion of every voxel of a volume, in parallel slabs.
+        /// @param  Scene - The volume to bake, its size may differ from the last call.
+        void Rebuild(const Volume& Scene);
+
+        /// @brief  Bake the occlusion of the voxels that are affected by a changed region.
+        /// @param  Scene - The volume to bake, it must be the volume given to the last call of Rebuild.
+        /// @param  Changed - The region of voxels that changed.
+        /// @return The region of voxels whose occlusion was baked again.
+        Region Update(const Volume& Scene, const Region& Changed);
+
+        /// @brief  Copy the occlusion of a region from another occlusion volume of the same size.
+        /// @param  Source - The occlusion volume to copy from.
+        /// @param  Target - The region to copy.
+        void Copy(const AmbientOcclusion& Source, const Region& Target);
+
+    private:
+        /// @brief  Bake the occlusion of the voxels in a region.
+        /// @param  Scene - The volume to bake.
+        /// @param  Target - The region to bake.
+        void Bake(const Volume& Scene, const Region& Target);
+    };
+}
+
+#endif // RAYMARCH_AMBIENTOCCLUSION_HPP
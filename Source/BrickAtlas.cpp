@@ -0,0 +1,340 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "BrickAtlas.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace Raymarch {
+    // The number of voxels along the X and Y axes of the atlas.
+    constexpr static const std::size_t AtlasSide = BrickAtlas::AtlasWidth * BrickAtlas::BrickSize;
+
+    // The number of voxels in each layer of the atlas.
+    constexpr static const std::size_t LayerVoxelCount = AtlasSide * AtlasSide * BrickAtlas::BrickSize;
+
+    // The owner of a slot that has been evicted.
+    constexpr static const std::size_t NoOwner = std::numeric_limits<std::size_t>::max();
+
+    // Constructor for an empty atlas.
+    BrickAtlas::BrickAtlas(std::size_t LayerCount, std::size_t MaximumLayerCount)
+        : SceneSize{{0, 0, 0}}
+        , PageSize{{0, 0, 0}}
+        , IndexWidth(0)
+        , LayerCount(std::max<std::size_t>(LayerCount, 1))
+        , MaximumLayerCount(std::max(MaximumLayerCount, std::max<std::size_t>(LayerCount, 1)))
+        , Resized(false)
+        , Repacked(false)
+        , PagesChanged(false)
+        , OverflowCount(0) {
+    }
+
+    // Get the page table size.
+    const std::array<std::size_t, 3>& BrickAtlas::GetPageSize(void) const {
+        return this->PageSize;
+    }
+
+    // Get the page table.
+    const std::uint32_t* BrickAtlas::GetPages(void) const {
+        return this->Pages.data();
+    }
+
+    // Get the atlas size in voxels.
+    std::array<std::size_t, 3> BrickAtlas::GetAtlasSize(void) const {
+        return {{AtlasSide, AtlasSide, this->LayerCount * BrickSize}};
+    }
+
+    // Get the index width.
+    std::size_t BrickAtlas::GetIndexWidth(void) const {
+        return this->IndexWidth;
+    }
+
+    // Get the atlas indices.
+    const std::uint8_t* BrickAtlas::GetIndices(void) const {
+        return this->Indices.data();
+    }
+
+    // Get the atlas occlusion.
+    const std::uint32_t* BrickAtlas::GetOcclusion(void) const {
+        return this->Occlusion.data();
+    }
+
+    // Get the number of layers up to the last slot handed out.
+    std::size_t BrickAtlas::GetUsedLayerCount(void) const {
+        return (this->Owners.size() + LayerSize - 1) / LayerSize;
+    }
+
+    // Get the number of resident bricks.
+    std::size_t BrickAtlas::GetResidentCount(void) const {
+        return this->Owners.size() - this->FreeSlots.size();
+    }
+
+    // Get the number of overflowing bricks.
+    std::size_t BrickAtlas::GetOverflowCount(void) const {
+        return this->OverflowCount;
+    }
+
+    // Slots fill the atlas along X, then Y, then Z.
+    std::array<std::size_t, 3> BrickAtlas::GetSlotPosition(std::uint32_t Slot) {
+        return {{(Slot % AtlasWidth) * BrickSize, ((Slot / AtlasWidth) % AtlasWidth) * BrickSize, (Slot / LayerSize) * BrickSize}};
+    }
+
+    // Test if the atlas was resized.
+    bool BrickAtlas::IsResized(void) const {
+        return this->Resized;
+    }
+
+    // Test if the bricks were repacked.
+    bool BrickAtlas::IsRepacked(void) const {
+        return this->Repacked;
+    }
+
+    // Test if the pages changed.
+    bool BrickAtlas::IsPagesChanged(void) const {
+        return this->PagesChanged;
+    }
+
+    // Get the written slots.
+    const std::vector<std::uint32_t>& BrickAtlas::GetWrittenSlots(void) const {
+        return this->WrittenSlots;
+    }
+
+    // Update the bricks, repacking them all or only touching the bricks overlapping the changed region.
+    void BrickAtlas::Update(const PaletteVolume& Scene, const AmbientOcclusion& SceneOcclusion, const Region& Changed, bool Repack) {
+        RAYMARCH_TRACE_SCOPE("BrickAtlas::Update");
+
+        this->WrittenSlots.clear();
+        this->Resized = false;
+        this->Repacked = false;
+        this->PagesChanged = false;
+
+        // A brick is empty when none of its voxels are visible, which is decided once for each palette entry.
+        const std::vector<Voxel>& Palette = Scene.GetPalette();
+        std::vector<std::uint8_t> Visible(Palette.size());
+        for (std::size_t Index = 0; Index < Palette.size(); ++Index) {
+            Visible[Index] = (Palette[Index].GetAlpha() > 0) ? 1 : 0;
+        }
+
+        // The atlas holds indices of the same width as the scene, so a change of width or size starts again.
+        if ((Scene.GetSize() != this->SceneSize) || (Scene.GetIndexWidth() != this->IndexWidth)) {
+            this->SceneSize = Scene.GetSize();
+            this->IndexWidth = Scene.GetIndexWidth();
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                this->PageSize[Index] = (this->SceneSize[Index] + BrickSize - 1) / BrickSize;
+            }
+            this->Pages.assign(this->PageSize[0] * this->PageSize[1] * this->PageSize[2], EmptyPage);
+            this->Indices.assign(this->LayerCount * LayerVoxelCount * this->IndexWidth, 0);
+            this->Occlusion.assign(this->LayerCount * LayerVoxelCount * 2, 0);
+            this->Resized = true;
+            Repack = true;
+        }
+
+        if (Repack) {
+            // Find the occupied bricks in parallel, then hand out the first slots in page order.
+            const std::size_t PageCount = this->Pages.size();
+            std::vector<std::uint8_t> Occupied(PageCount);
+            JobSystem::GetGlobal().ParallelFor(0, PageCount, 64, [this, &Scene, &Visible, &Occupied](std::size_t First, std::size_t Last) -> void {
+                for (std::size_t Page = First; Page < Last; ++Page) {
+                    Occupied[Page] = this->IsOccupied(Scene, Visible, Page) ? 1 : 0;
+                }
+            });
+            this->Owners.clear();
+            this->FreeSlots.clear();
+            this->Overflowed.assign(PageCount, 0);
+            this->OverflowCount = 0;
+            this->Reserve(static_cast<std::size_t>(std::count(Occupied.begin(), Occupied.end(), 1)));
+            const std::size_t Capacity = this->LayerCount * LayerSize;
+            for (std::size_t Page = 0; Page < PageCount; ++Page) {
+                if (Occupied[Page] == 0) {
+                    this->Pages[Page] = EmptyPage;
+                }
+                else if (this->Owners.size() < Capacity) {
+                    this->Pages[Page] = static_cast<std::uint32_t>(this->Owners.size()) + 1;
+                    this->Owners.push_back(Page);
+                }
+                else {
+                    this->Pages[Page] = EmptyPage;
+                    this->Overflowed[Page] = 1;
+                    ++this->OverflowCount;
+                }
+            }
+
+            // Every slot is written by one brick so they are copied in parallel.
+            JobSystem::GetGlobal().ParallelFor(0, this->Owners.size(), 16, [this, &Scene, &SceneOcclusion](std::size_t First, std::size_t Last) -> void {
+                for (std::size_t Slot = First; Slot < Last; ++Slot) {
+                    this->Write(Scene, SceneOcclusion, this->Owners[Slot], static_cast<std::uint32_t>(Slot));
+                }
+            });
+            this->Repacked = true;
+            this->PagesChanged = true;
+            return;
+        }
+
+        const Region Clipped = Changed.Intersection(Region({{0, 0, 0}}, {{static_cast<int>(this->SceneSize[0]), static_cast<int>(this->SceneSize[1]), static_cast<int>(this->SceneSize[2])}}));
+        if (Clipped.IsEmpty()) {
+            return;
+        }
+
+        // Write the changed bricks that are occupied and evict those that became empty, a brick overflows at most once until it
+        // becomes empty or finds a slot.
+        const int Side = static_cast<int>(BrickSize);
+        for (int BrickZ = Clipped.Minimum[2] / Side; BrickZ <= (Clipped.Maximum[2] - 1) / Side; ++BrickZ) {
+            for (int BrickY = Clipped.Minimum[1] / Side; BrickY <= (Clipped.Maximum[1] - 1) / Side; ++BrickY) {
+                for (int BrickX = Clipped.Minimum[0] / Side; BrickX <= (Clipped.Maximum[0] - 1) / Side; ++BrickX) {
+                    const std::size_t Page = static_cast<std::size_t>(BrickX) + this->PageSize[0] * (static_cast<std::size_t>(BrickY) + this->PageSize[1] * static_cast<std::size_t>(BrickZ));
+                    std::uint32_t& Entry = this->Pages[Page];
+                    if (!this->IsOccupied(Scene, Visible, Page)) {
+                        if (this->Overflowed[Page] != 0) {
+                            this->Overflowed[Page] = 0;
+                            --this->OverflowCount;
+                        }
+                        if (Entry != EmptyPage) {
+                            this->Owners[Entry - 1] = NoOwner;
+                            this->FreeSlots.push_back(Entry - 1);
+                            Entry = EmptyPage;
+                            this->PagesChanged = true;
+                        }
+                        continue;
+                    }
+                    if (Entry == EmptyPage) {
+                        std::uint32_t Slot = 0;
+                        if (!this->Allocate(Slot)) {
+                            if (this->Overflowed[Page] == 0) {
+                                this->Overflowed[Page] = 1;
+                                ++this->OverflowCount;
+                            }
+                            continue;
+                        }
+                        if (this->Overflowed[Page] != 0) {
+                            this->Overflowed[Page] = 0;
+                            --this->OverflowCount;
+                        }
+                        this->Owners[Slot] = Page;
+                        Entry = Slot + 1;
+                        this->PagesChanged = true;
+                    }
+                    this->Write(Scene, SceneOcclusion, Page, Entry - 1);
+                    this->WrittenSlots.push_back(Entry - 1);
+                }
+            }
+        }
+    }
+
+    // Test the voxels of a brick until one is visible.
+    bool BrickAtlas::IsOccupied(const PaletteVolume& Scene, const std::vector<std::uint8_t>& Visible, std::size_t Page) const {
+        const std::size_t BrickX = Page % this->PageSize[0];
+        const std::size_t BrickY = (Page / this->PageSize[0]) % this->PageSize[1];
+        const std::size_t BrickZ = Page / (this->PageSize[0] * this->PageSize[1]);
+        const std::size_t MinimumX = BrickX * BrickSize;
+        const std::size_t MaximumX = std::min(MinimumX + BrickSize, this->SceneSize[0]);
+        const std::size_t MaximumY = std::min(BrickY * BrickSize + BrickSize, this->SceneSize[1]);
+        const std::size_t MaximumZ = std::min(BrickZ * BrickSize + BrickSize, this->SceneSize[2]);
+        const std::uint8_t* Data = Scene.data();
+        for (std::size_t Z = BrickZ * BrickSize; Z < MaximumZ; ++Z) {
+            for (std::size_t Y = BrickY * BrickSize; Y < MaximumY; ++Y) {
+                const std::size_t RowStart = this->SceneSize[0] * (Y + this->SceneSize[1] * Z);
+                for (std::size_t X = MinimumX; X < MaximumX; ++X) {
+                    switch (this->IndexWidth) {
+                        case 1: {
+                            if (Visible[Data[RowStart + X]] != 0) {
+                                return true;
+                            }
+                        } break;
+                        case 2: {
+                            std::uint16_t PaletteIndex;
+                            std::memcpy(&PaletteIndex, &Data[(RowStart + X) * 2], sizeof(PaletteIndex));
+                            if (Visible[PaletteIndex] != 0) {
+                                return true;
+                            }
+                        } break;
+                        default: {
+                            std::uint32_t Bits;
+                            std::memcpy(&Bits, &Data[(RowStart + X) * 4], sizeof(Bits));
+                            if (Voxel::FromBits(Bits).GetAlpha() > 0) {
+                                return true;
+                            }
+                        } break;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    // Copy a brick row by row, the voxels of a brick beyond the scene are never sampled.
+    void BrickAtlas::Write(const PaletteVolume& Scene, const AmbientOcclusion& SceneOcclusion, std::size_t Page, std::uint32_t Slot) {
+        const std::size_t BrickX = Page % this->PageSize[0];
+        const std::size_t BrickY = (Page / this->PageSize[0]) % this->PageSize[1];
+        const std::size_t BrickZ = Page / (this->PageSize[0] * this->PageSize[1]);
+        const std::size_t MinimumX = BrickX * BrickSize;
+        const std::size_t MinimumY = BrickY * BrickSize;
+        const std::size_t MinimumZ = BrickZ * BrickSize;
+        const std::size_t Width = std::min(BrickSize, this->SceneSize[0] - MinimumX);
+        const std::size_t Height = std::min(BrickSize, this->SceneSize[1] - MinimumY);
+        const std::size_t Depth = std::min(BrickSize, this->SceneSize[2] - MinimumZ);
+        const std::array<std::size_t, 3> Position = GetSlotPosition(Slot);
+        for (std::size_t Z = 0; Z < Depth; ++Z) {
+            for (std::size_t Y = 0; Y < Height; ++Y) {
+                const std::size_t Source = MinimumX + this->SceneSize[0] * ((MinimumY + Y) + this->SceneSize[1] * (MinimumZ + Z));
+                const std::size_t Target = Position[0] + AtlasSide * ((Position[1] + Y) + AtlasSide * (Position[2] + Z));
+                std::memcpy(&this->Indices[Target * this->IndexWidth], &Scene.data()[Source * this->IndexWidth], Width * this->IndexWidth);
+                std::memcpy(&this->Occlusion[Target * 2], &SceneOcclusion.data()[Source * 2], Width * 2 * sizeof(std::uint32_t));
+            }
+        }
+    }
+
+    // Reuse the most recently evicted slot, or hand out the next slot.
+    bool BrickAtlas::Allocate(std::uint32_t& Slot) {
+        if (!this->FreeSlots.empty()) {
+            Slot = this->FreeSlots.back();
+            this->FreeSlots.pop_back();
+            return true;
+        }
+        if (!this->Reserve(this->Owners.size() + 1)) {
+            return false;
+        }
+        Slot = static_cast<std::uint32_t>(this->Owners.size());
+        this->Owners.push_back(NoOwner);
+        return true;
+    }
+
+    // Grow the atlas by doubling its layers, layers are the outermost axis so the bricks it holds stay in place.
+    bool BrickAtlas::Reserve(std::size_t SlotCount) {
+        const std::size_t NeededLayerCount = (SlotCount + LayerSize - 1) / LayerSize;
+        if (NeededLayerCount <= this->LayerCount) {
+            return true;
+        }
+        if (this->LayerCount == this->MaximumLayerCount) {
+            return false;
+        }
+        this->LayerCount = std::min(std::max(NeededLayerCount, this->LayerCount * 2), this->MaximumLayerCount);
+        this->Indices.resize(this->LayerCount * LayerVoxelCount * this->IndexWidth, 0);
+        this->Occlusion.resize(this->LayerCount * LayerVoxelCount * 2, 0);
+        this->Resized = true;
+        return NeededLayerCount <= this->LayerCount;
+    }
+}
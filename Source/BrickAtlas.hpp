@@ -0,0 +1,207 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_BRICKATLAS_HPP
+#define RAYMARCH_BRICKATLAS_HPP
+
+#include "AmbientOcclusion.hpp"
+#include "PaletteVolume.hpp"
+#include "Region.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  BrickAtlas keeps the non-empty 8^3 bricks of the packed scene resident in an atlas, with a page table mapping each brick of the scene to its slot.
+    /// @note   The atlas and the page table mirror the textures the renderer uploads, so the GPU memory follows the occupied bricks rather
+    ///         than the size of the scene. The atlas is 16 by 16 bricks wide and grows in layers of 256 slots, a page holds zero for an
+    ///         empty brick or its slot plus one. Composing the whole scene repacks every brick into the first slots, a changed region only
+    ///         writes the bricks it overlaps, evicting those that became empty so their slots are reused.
+    class BrickAtlas {
+    public:
+        /// @brief  The number of voxels along each axis of a brick.
+        constexpr static const std::size_t BrickSize = 8;
+
+        /// @brief  The number of bricks along the X and Y axes of the atlas.
+        constexpr static const std::size_t AtlasWidth = 16;
+
+        /// @brief  The number of slots in each layer of bricks along the Z axis of the atlas.
+        constexpr static const std::size_t LayerSize = AtlasWidth * AtlasWidth;
+
+        /// @brief  The page of an empty brick.
+        constexpr static const std::uint32_t EmptyPage = 0;
+
+    private:
+        /// @brief  The size of the scene the pages cover.
+        std::array<std::size_t, 3> SceneSize;
+
+        /// @brief  The number of bricks along each axis of the scene.
+        std::array<std::size_t, 3> PageSize;
+
+        /// @brief  The number of bytes of each index in the atlas, that of the packed scene.
+        std::size_t IndexWidth;
+
+        /// @brief  The page of each brick, indexed by X + PageSizeX * (Y + PageSizeY * Z).
+        std::vector<std::uint32_t> Pages;
+
+        /// @brief  The page index held by each used slot.
+        std::vector<std::size_t> Owners;
+
+        /// @brief  The slots freed by evicted bricks, reused before the atlas grows.
+        std::vector<std::uint32_t> FreeSlots;
+
+        /// @brief  The number of layers of the atlas.
+        std::size_t LayerCount;
+
+        /// @brief  The largest number of layers the atlas may grow to.
+        std::size_t MaximumLayerCount;
+
+        /// @brief  The indices of the atlas, in the order of the atlas texture.
+        std::vector<std::uint8_t> Indices;
+
+        /// @brief  The occlusion words of the atlas, two per voxel in the order of the atlas texture.
+        std::vector<std::uint32_t> Occlusion;
+
+        /// @brief  The slots written since the last update.
+        std::vector<std::uint32_t> WrittenSlots;
+
+        /// @brief  Set when the atlas changed size or index width and must be allocated again.
+        bool Resized;
+
+        /// @brief  Set when the bricks were repacked and every used layer must be uploaded.
+        bool Repacked;
+
+        /// @brief  Set when any page changed in the last update.
+        bool PagesChanged;
+
+        /// @brief  Set for each page whose brick is non-empty but did not fit in the atlas at its largest, indexed as the pages.
+        std::vector<std::uint8_t> Overflowed;
+
+        /// @brief  The number of pages set in the overflowed pages.
+        std::size_t OverflowCount;
+
+    public:
+        /// @brief  Constructor that creates an empty atlas.
+        /// @param  LayerCount - The number of layers to allocate at first.
+        /// @param  MaximumLayerCount - The largest number of layers, limited by the largest 3D texture.
+        BrickAtlas(std::size_t LayerCount = 1, std::size_t MaximumLayerCount = 256);
+
+    public:
+        /// @brief  Get the number of bricks along each axis of the scene.
+        /// @return The size of the page table.
+        const std::array<std::size_t, 3>& GetPageSize(void) const;
+
+        /// @brief  Get the page table.
+        /// @return A pointer to the pages, indexed by X + PageSizeX * (Y + PageSizeY * Z).
+        const std::uint32_t* GetPages(void) const;
+
+        /// @brief  Get the number of voxels along each axis of the atlas.
+        /// @return The size of the atlas.
+        std::array<std::size_t, 3> GetAtlasSize(void) const;
+
+        /// @brief  Get the number of bytes of each index in the atlas.
+        /// @return 1 or 2 for palette indices, or 4 for raw voxels.
+        std::size_t GetIndexWidth(void) const;
+
+        /// @brief  Get the indices of the atlas.
+        /// @return A pointer to the first index, in the order of the atlas texture.
+        const std::uint8_t* GetIndices(void) const;
+
+        /// @brief  Get the occlusion of the atlas.
+        /// @return A pointer to the first occlusion word, two per voxel in the order of the atlas texture.
+        const std::uint32_t* GetOcclusion(void) const;
+
+        /// @brief  Get the number of layers holding used slots.
+        /// @return The number of layers from the first that must be uploaded after a repack.
+        std::size_t GetUsedLayerCount(void) const;
+
+        /// @brief  Get the number of bricks resident in the atlas.
+        /// @return The number of used slots.
+        std::size_t GetResidentCount(void) const;
+
+        /// @brief  Get the number of bricks that did not fit in the atlas, they are rendered as empty.
+        /// @return The number of overflowing bricks.
+        std::size_t GetOverflowCount(void) const;
+
+        /// @brief  Get the position of a slot in the atlas.
+        /// @param  Slot - The slot.
+        /// @return The voxel position of the minimum corner of the slot.
+        static std::array<std::size_t, 3> GetSlotPosition(std::uint32_t Slot);
+
+    public:
+        /// @brief  Test if the atlas must be allocated again, every used layer is then uploaded.
+        /// @return True if the size or index width of the atlas changed in the last update.
+        bool IsResized(void) const;
+
+        /// @brief  Test if every used layer must be uploaded.
+        /// @return True if the bricks were repacked in the last update.
+        bool IsRepacked(void) const;
+
+        /// @brief  Test if the page table must be uploaded.
+        /// @return True if any page changed in the last update.
+        bool IsPagesChanged(void) const;
+
+        /// @brief  Get the slots written in the last update, each is uploaded unless the used layers are uploaded.
+        /// @return The written slots.
+        const std::vector<std::uint32_t>& GetWrittenSlots(void) const;
+
+    public:
+        /// @brief  Update the bricks from the packed scene.
+        /// @param  Scene - The packed scene.
+        /// @param  SceneOcclusion - The ambient occlusion of the scene.
+        /// @param  Changed - The region of the scene that changed, ignored when repacking.
+        /// @param  Repack - Set when the whole scene changed, the bricks are also repacked when the size or index width of the scene changed.
+        void Update(const PaletteVolume& Scene, const AmbientOcclusion& SceneOcclusion, const Region& Changed, bool Repack);
+
+    private:
+        /// @brief  Test if a brick of the packed scene has any visible voxel.
+        /// @param  Scene - The packed scene.
+        /// @param  Visible - The visibility of each palette entry.
+        /// @param  Page - The page index of the brick.
+        /// @return True if the brick must be resident.
+        bool IsOccupied(const PaletteVolume& Scene, const std::vector<std::uint8_t>& Visible, std::size_t Page) const;
+
+        /// @brief  Copy a brick of the packed scene and its occlusion into a slot.
+        /// @param  Scene - The packed scene.
+        /// @param  SceneOcclusion - The ambient occlusion of the scene.
+        /// @param  Page - The page index of the brick.
+        /// @param  Slot - The slot to write.
+        void Write(const PaletteVolume& Scene, const AmbientOcclusion& SceneOcclusion, std::size_t Page, std::uint32_t Slot);
+
+        /// @brief  Find a slot for a brick, reusing an evicted slot or growing the atlas.
+        /// @param  Slot - The slot found.
+        /// @return False if the atlas is full at its largest.
+        bool Allocate(std::uint32_t& Slot);
+
+        /// @brief  Grow the atlas to hold a number of slots, keeping the bricks it holds.
+        /// @param  SlotCount - The number of slots needed.
+        /// @return False if the slots need more than the largest number of layers.
+        bool Reserve(std::size_t SlotCount);
+    };
+}
+
+#endif // RAYMARCH_BRICKATLAS_HPP
@@ -0,0 +1,200 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "Brush.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace Raymarch {
+    // Constructor.
+    Brush::Brush(ShapeType Shape, OperationType Operation, const std::array<float, 3>& Centre, const std::array<float, 3>& Extent, const Voxel& Value)
+        : Shape(Shape)
+        , Operation(Operation)
+        , Centre(Centre)
+        , Extent(Extent)
+        , Value(Value) {
+    }
+
+    // Get the bounds of the shape.
+    Region Brush::GetBounds(void) const {
+        std::array<float, 3> HalfSize = this->Extent;
+        if (this->Shape == ShapeType::Sphere) {
+            HalfSize = {{this->Extent[0], this->Extent[0], this->Extent[0]}};
+        }
+        else if (this->Shape == ShapeType::Cylinder) {
+            HalfSize = {{this->Extent[0], this->Extent[1], this->Extent[0]}};
+        }
+        Region Result;
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            Result.Minimum[Index] = static_cast<int>(std::floor(this->Centre[Index] - HalfSize[Index]));
+            Result.Maximum[Index] = static_cast<int>(std::floor(this->Centre[Index] + HalfSize[Index])) + 1;
+        }
+        return Result;
+    }
+
+    // Test the centre of a voxel against the shape.
+    bool Brush::Contains(int X, int Y, int Z) const {
+        const float OffsetX = static_cast<float>(X) + 0.5f - this->Centre[0];
+        const float OffsetY = static_cast<float>(Y) + 0.5f - this->Centre[1];
+        const float OffsetZ = static_cast<float>(Z) + 0.5f - this->Centre[2];
+        switch (this->Shape) {
+            case ShapeType::Sphere: {
+                return (OffsetX * OffsetX + OffsetY * OffsetY + OffsetZ * OffsetZ) <= (this->Extent[0] * this->Extent[0]);
+            }
+            case ShapeType::Box: {
+                return (std::abs(OffsetX) <= this->Extent[0]) && (std::abs(OffsetY) <= this->Extent[1]) && (std::abs(OffsetZ) <= this->Extent[2]);
+            }
+            case ShapeType::Cylinder: {
+                return ((OffsetX * OffsetX + OffsetZ * OffsetZ) <= (this->Extent[0] * this->Extent[0])) && (std::abs(OffsetY) <= this->Extent[1]);
+            }
+        }
+        return false;
+    }
+
+    // Edit the chunks overlapping the shape in parallel, each job owns one chunk.
+    Region Brush::Apply(World& Target) const {
+        RAYMARCH_TRACE_SCOPE("Brush::Apply");
+
+        // Only adding can fill chunks that are not stored, they are stored before the jobs start.
+        const Region Bounds = this->GetBounds();
+        std::vector<std::array<int, 3> > Keys;
+        std::vector<Volume*> Chunks;
+        for (const std::array<int, 3>& Key : World::GetChunkKeys(Bounds)) {
+            Volume* Chunk = (this->Operation == OperationType::Add) ? &Target.GetChunk(Key) : Target.FindChunk(Key);
+            if (Chunk) {
+                Keys.push_back(Key);
+                Chunks.push_back(Chunk);
+            }
+        }
+
+        std::vector<Region> Changes(Chunks.size());
+        JobSystem::GetGlobal().ParallelFor(0, Chunks.size(), 1, [this, &Bounds, &Keys, &Chunks, &Changes](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Index = First; Index < Last; ++Index) {
+                const Region ChunkRegion = World::GetChunkRegion(Keys[Index]);
+                const Region Clipped = ChunkRegion.Intersection(Bounds);
+                Volume& Chunk = *Chunks[Index];
+                std::array<int, 3> Minimum = Clipped.Maximum;
+                std::array<int, 3> Maximum = Clipped.Minimum;
+                for (int IndexZ = Clipped.Minimum[2]; IndexZ < Clipped.Maximum[2]; ++IndexZ) {
+                    for (int IndexY = Clipped.Minimum[1]; IndexY < Clipped.Maximum[1]; ++IndexY) {
+                        for (int IndexX = Clipped.Minimum[0]; IndexX < Clipped.Maximum[0]; ++IndexX) {
+                            if (!this->Contains(IndexX, IndexY, IndexZ)) {
+                                continue;
+                            }
+                            Voxel& Current = Chunk(IndexX - ChunkRegion.Minimum[0], IndexY - ChunkRegion.Minimum[1], IndexZ - ChunkRegion.Minimum[2]);
+                            Voxel Next = Current;
+                            switch (this->Operation) {
+                                case OperationType::Add: {
+                                    Next = this->Value;
+                                } break;
+                                case OperationType::Subtract: {
+                                    Next = Voxel();
+                                } break;
+                                case OperationType::Paint: {
+                                    if (Current.GetAlpha() > 0) {
+                                        Next.SetHue(this->Value.GetHue());
+                                        Next.SetSaturation(this->Value.GetSaturation());
+                                        Next.SetTint(this->Value.GetTint());
+                                    }
+                                } break;
+                            }
+                            if (Next.GetBits() == Current.GetBits()) {
+                                continue;
+                            }
+                            Current = Next;
+                            const std::array<int, 3> Position = {{IndexX, IndexY, IndexZ}};
+                            for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                                Minimum[Axis] = std::min(Minimum[Axis], Position[Axis]);
+                                Maximum[Axis] = std::max(Maximum[Axis], Position[Axis] + 1);
+                            }
+                        }
+                    }
+                }
+                Changes[Index] = Region(Minimum, Maximum);
+            }
+        });
+
+        Region Result;
+        for (const Region& Changed : Changes) {
+            Result = Result.Union(Changed.IsEmpty() ? Region() : Changed);
+        }
+        return Result;
+    }
+
+    // Breadth first fill through the six face neighbours, the last chunk used is kept to avoid a lookup per voxel.
+    Region Brush::FloodFill(World& Target, const std::array<int, 3>& Seed, const Voxel& Replacement, const Region& Limit) {
+        RAYMARCH_TRACE_SCOPE("Brush::FloodFill");
+
+        const std::uint32_t Match = Target.Get(Seed[0], Seed[1], Seed[2]).GetBits();
+        if (!Limit.Contains(Seed[0], Seed[1], Seed[2]) || (Match == Replacement.GetBits())) {
+            return Region();
+        }
+
+        // Chunks that are not stored are empty, they are only stored when empty voxels are being replaced.
+        const bool FillsEmpty = (Match == Voxel().GetBits());
+        bool Cached = false;
+        std::array<int, 3> CachedKey = {{0, 0, 0}};
+        Volume* CachedChunk = nullptr;
+        auto Access = [&Target, FillsEmpty, &Cached, &CachedKey, &CachedChunk](int X, int Y, int Z) -> Voxel* {
+            const std::array<int, 3> Key = World::GetChunkKey(X, Y, Z);
+            if (!Cached || (Key != CachedKey)) {
+                Cached = true;
+                CachedKey = Key;
+                CachedChunk = FillsEmpty ? &Target.GetChunk(Key) : Target.FindChunk(Key);
+            }
+            return CachedChunk ? &(*CachedChunk)(X - Key[0] * World::ChunkSize, Y - Key[1] * World::ChunkSize, Z - Key[2] * World::ChunkSize) : nullptr;
+        };
+
+        constexpr static const std::array<std::array<int, 3>, 6> Neighbours = {{
+            {{+1, 0, 0}}, {{-1, 0, 0}}, {{0, +1, 0}}, {{0, -1, 0}}, {{0, 0, +1}}, {{0, 0, -1}}
+        }};
+
+        // Voxels are replaced as they are queued, so a replaced voxel never matches again.
+        Region Result;
+        std::vector<std::array<int, 3> > Queue = {Seed};
+        *Access(Seed[0], Seed[1], Seed[2]) = Replacement;
+        Result = Region(Seed, {{Seed[0] + 1, Seed[1] + 1, Seed[2] + 1}});
+        for (std::size_t Head = 0; Head < Queue.size(); ++Head) {
+            const std::array<int, 3> Position = Queue[Head];
+            for (const std::array<int, 3>& Offset : Neighbours) {
+                const std::array<int, 3> Neighbour = {{Position[0] + Offset[0], Position[1] + Offset[1], Position[2] + Offset[2]}};
+                if (!Limit.Contains(Neighbour[0], Neighbour[1], Neighbour[2])) {
+                    continue;
+                }
+                Voxel* Value = Access(Neighbour[0], Neighbour[1], Neighbour[2]);
+                if (!Value || (Value->GetBits() != Match)) {
+                    continue;
+                }
+                *Value = Replacement;
+                Queue.push_back(Neighbour);
+                Result = Result.Union(Region(Neighbour, {{Neighbour[0] + 1, Neighbour[1] + 1, Neighbour[2] + 1}}));
+            }
+        }
+        return Result;
+    }
+}
@@ -0,0 +1,108 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_BRUSH_HPP
+#define RAYMARCH_BRUSH_HPP
+
+#include "Region.hpp"
+#include "Voxel.hpp"
+#include "World.hpp"
+
+#include <array>
+
+namespace Raymarch {
+    /// @brief  Brush edits the voxels of a world within a shape.
+    /// @note   A voxel is inside the shape when its centre is. Edits only visit the chunks overlapping the bounds of the shape.
+    class Brush {
+    public:
+        /// @brief  The shape of the brush.
+        enum class ShapeType {
+            Sphere, Box, Cylinder
+        };
+
+        /// @brief  The edit made to the voxels inside the shape.
+        enum class OperationType {
+            /// @brief  Set every voxel to the brush voxel.
+            Add,
+            /// @brief  Empty every voxel.
+            Subtract,
+            /// @brief  Set the hue, saturation and tint of every non-empty voxel to those of the brush voxel.
+            Paint
+        };
+
+    private:
+        /// @brief  The shape of the brush.
+        ShapeType Shape;
+
+        /// @brief  The edit made by the brush.
+        OperationType Operation;
+
+        /// @brief  The centre of the shape.
+        std::array<float, 3> Centre;
+
+        /// @brief  The half size of the shape, the radius of a sphere uses X, the radius and half height of a vertical cylinder use X and Y.
+        std::array<float, 3> Extent;
+
+        /// @brief  The voxel added or painted.
+        Voxel Value;
+
+    public:
+        /// @brief  Constructor that creates a brush.
+        /// @param  Shape - The shape of the brush.
+        /// @param  Operation - The edit made by the brush.
+        /// @param  Centre - The centre of the shape in world coordinates.
+        /// @param  Extent - The half size of the shape.
+        /// @param  Value - The voxel added or painted.
+        Brush(ShapeType Shape, OperationType Operation, const std::array<float, 3>& Centre, const std::array<float, 3>& Extent, const Voxel& Value = Voxel());
+
+    public:
+        /// @brief  Get the voxels that may be inside the shape.
+        /// @return The bounds of the shape in world coordinates.
+        Region GetBounds(void) const;
+
+        /// @brief  Test if a voxel is inside the shape.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return True if the centre of the voxel is inside the shape.
+        bool Contains(int X, int Y, int Z) const;
+
+        /// @brief  Edit the voxels of a world inside the shape, the chunks are edited in parallel.
+        /// @param  Target - The world to edit.
+        /// @return The bounds of the voxels that changed.
+        Region Apply(World& Target) const;
+
+    public:
+        /// @brief  Replace the connected voxels that match a seed voxel.
+        /// @param  Target - The world to edit.
+        /// @param  Seed - The world coordinate of the first voxel to replace.
+        /// @param  Replacement - The voxel to replace them with.
+        /// @param  Limit - The region the fill may not leave.
+        /// @return The bounds of the voxels that changed.
+        static Region FloodFill(World& Target, const std::array<int, 3>& Seed, const Voxel& Replacement, const Region& Limit);
+    };
+}
+
+#endif // RAYMARCH_BRUSH_HPP
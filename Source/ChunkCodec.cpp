@@ -0,0 +1,150 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "ChunkCodec.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+namespace Raymarch {
+    // Append a variable length integer, seven bits at a time with the high bit set on every byte but the last.
+    static void WriteNumber(std::uint64_t Value, std::vector<std::uint8_t>& Output) {
+        while (Value >= 0x80) {
+            Output.push_back(static_cast<std::uint8_t>(Value | 0x80));
+            Value >>= 7;
+        }
+        Output.push_back(static_cast<std::uint8_t>(Value));
+    }
+
+    // Read a variable length integer, failing at the end of the data or when it is too long.
+    static bool ReadNumber(const std::uint8_t* Data, std::size_t Size, std::size_t& Position, std::uint64_t& Value) {
+        Value = 0;
+        for (unsigned int Shift = 0; Shift < 64; Shift += 7) {
+            if (Position >= Size) {
+                return false;
+            }
+            const std::uint8_t Byte = Data[Position++];
+            Value |= static_cast<std::uint64_t>(Byte & 0x7F) << Shift;
+            if ((Byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Compress a volume.
+    void ChunkCodec::Compress(const Volume& Source, std::vector<std::uint8_t>& Output) {
+        RAYMARCH_TRACE_SCOPE("ChunkCodec::Compress");
+
+        const std::size_t Count = Source.GetSizeX() * Source.GetSizeY() * Source.GetSizeZ();
+        const Voxel* Voxels = Source.data();
+
+        // Palette indices are given in order of first appearance, and the runs are collected while the palette is built.
+        std::vector<Voxel> Palette;
+        std::unordered_map<std::uint32_t, std::uint32_t> Lookup;
+        std::vector<std::pair<std::uint64_t, std::uint32_t> > Runs;
+        for (std::size_t Index = 0; Index < Count;) {
+            const std::uint32_t Bits = Voxels[Index].GetBits();
+            std::size_t End = Index + 1;
+            while ((End < Count) && (Voxels[End].GetBits() == Bits)) {
+                ++End;
+            }
+            const auto Inserted = Lookup.emplace(Bits, static_cast<std::uint32_t>(Palette.size()));
+            if (Inserted.second) {
+                Palette.push_back(Voxels[Index]);
+            }
+            Runs.emplace_back(End - Index, Inserted.first->second);
+            Index = End;
+        }
+
+        Output.clear();
+        WriteNumber(Source.GetSizeX(), Output);
+        WriteNumber(Source.GetSizeY(), Output);
+        WriteNumber(Source.GetSizeZ(), Output);
+        WriteNumber(Palette.size(), Output);
+        for (const Voxel& Entry : Palette) {
+            const std::uint32_t Bits = Entry.GetBits();
+            for (unsigned int Shift = 0; Shift < 32; Shift += 8) {
+                Output.push_back(static_cast<std::uint8_t>(Bits >> Shift));
+            }
+        }
+        WriteNumber(Runs.size(), Output);
+        for (const std::pair<std::uint64_t, std::uint32_t>& Run : Runs) {
+            WriteNumber(Run.first, Output);
+            WriteNumber(Run.second, Output);
+        }
+    }
+
+    // Decompress a volume, every count and index is checked against what has been read so far.
+    bool ChunkCodec::Decompress(const std::uint8_t* Data, std::size_t Size, const std::array<std::size_t, 3>& ExpectedSize, Volume& Target) {
+        RAYMARCH_TRACE_SCOPE("ChunkCodec::Decompress");
+
+        Target = Volume();
+        std::size_t Position = 0;
+        std::uint64_t SizeX = 0;
+        std::uint64_t SizeY = 0;
+        std::uint64_t SizeZ = 0;
+        std::uint64_t PaletteSize = 0;
+        if (!ReadNumber(Data, Size, Position, SizeX) || !ReadNumber(Data, Size, Position, SizeY) || !ReadNumber(Data, Size, Position, SizeZ) || !ReadNumber(Data, Size, Position, PaletteSize)) {
+            return false;
+        }
+        if ((SizeX != ExpectedSize[0]) || (SizeY != ExpectedSize[1]) || (SizeZ != ExpectedSize[2]) || (PaletteSize > (Size - Position) / 4)) {
+            return false;
+        }
+        std::vector<Voxel> Palette;
+        Palette.reserve(static_cast<std::size_t>(PaletteSize));
+        for (std::uint64_t Entry = 0; Entry < PaletteSize; ++Entry) {
+            std::uint32_t Bits = 0;
+            for (unsigned int Shift = 0; Shift < 32; Shift += 8) {
+                Bits |= static_cast<std::uint32_t>(Data[Position++]) << Shift;
+            }
+            Palette.push_back(Voxel::FromBits(Bits));
+        }
+
+        const std::uint64_t Count = SizeX * SizeY * SizeZ;
+        std::uint64_t RunCount = 0;
+        if (!ReadNumber(Data, Size, Position, RunCount) || (RunCount > Count)) {
+            return false;
+        }
+        Volume Result(static_cast<std::size_t>(SizeX), static_cast<std::size_t>(SizeY), static_cast<std::size_t>(SizeZ));
+        Voxel* Voxels = Result.data();
+        std::uint64_t Written = 0;
+        for (std::uint64_t Run = 0; Run < RunCount; ++Run) {
+            std::uint64_t Length = 0;
+            std::uint64_t Index = 0;
+            if (!ReadNumber(Data, Size, Position, Length) || !ReadNumber(Data, Size, Position, Index) || (Length > Count - Written) || (Index >= PaletteSize)) {
+                return false;
+            }
+            std::fill(Voxels + Written, Voxels + Written + Length, Palette[static_cast<std::size_t>(Index)]);
+            Written += Length;
+        }
+        if ((Written != Count) || (Position != Size)) {
+            return false;
+        }
+        Target = std::move(Result);
+        return true;
+    }
+}
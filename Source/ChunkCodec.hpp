@@ -0,0 +1,64 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_CHUNKCODEC_HPP
+#define RAYMARCH_CHUNKCODEC_HPP
+
+#include "Volume.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  ChunkCodec compresses volumes as a palette of their distinct voxels and runs of palette indices.
+    /// @note   The encoding is the size of the volume, the palette size and palette, then pairs of run length and palette index
+    ///         covering the voxels in volume order. Every number is a little endian base 128 variable length integer except the
+    ///         palette entries, which are the raw voxel bits.
+    class ChunkCodec {
+    private:
+        /// @brief  Deleted destructor.
+        ~ChunkCodec(void) = delete;
+        /// @brief  Deleted constructor.
+        ChunkCodec(void) = delete;
+
+    public:
+        /// @brief  Compress a volume.
+        /// @param  Source - The volume to compress.
+        /// @param  Output - Receives the compressed bytes, replacing its contents.
+        static void Compress(const Volume& Source, std::vector<std::uint8_t>& Output);
+
+        /// @brief  Decompress a volume of a known size, the size is checked before the volume is allocated.
+        /// @param  Data - The compressed bytes.
+        /// @param  Size - The number of compressed bytes.
+        /// @param  ExpectedSize - The size the volume must have.
+        /// @param  Target - Receives the volume.
+        /// @return False if the bytes are not a valid compressed volume of the expected size, the target is then left empty.
+        static bool Decompress(const std::uint8_t* Data, std::size_t Size, const std::array<std::size_t, 3>& ExpectedSize, Volume& Target);
+    };
+}
+
+#endif // RAYMARCH_CHUNKCODEC_HPP
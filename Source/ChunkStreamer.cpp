@@ -0,0 +1,226 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "ChunkStreamer.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <unordered_map>
+
+namespace Raymarch {
+    // The bytes of a stored chunk.
+    constexpr static const std::size_t ChunkBytes = static_cast<std::size_t>(World::ChunkSize) * World::ChunkSize * World::ChunkSize * sizeof(Voxel);
+
+    // The hit rate.
+    double ChunkStreamer::Metrics::GetHitRate(void) const {
+        const std::uint64_t Total = this->PrefetchHits + this->PrefetchMisses;
+        return (Total == 0) ? 1.0 : static_cast<double>(this->PrefetchHits) / static_cast<double>(Total);
+    }
+
+    // Constructor, the generator keeps to a quarter of the cores as it is background work and the job system already has a worker on every other core.
+    ChunkStreamer::ChunkStreamer(std::uint32_t Seed, std::size_t CacheBudget, std::size_t CompressedBudget, std::size_t ResidentBudget)
+        : Terrain(Seed, CacheBudget, CompressedBudget, std::max<std::size_t>(std::thread::hardware_concurrency() / 4, 1))
+        , ResidentBudget(ResidentBudget)
+        , Counters() {
+    }
+
+    // Get the generator.
+    const TerrainGenerator& ChunkStreamer::GetTerrain(void) const {
+        return this->Terrain;
+    }
+
+    // Get the counters.
+    const ChunkStreamer::Metrics& ChunkStreamer::GetMetrics(void) const {
+        return this->Counters;
+    }
+
+    // Forget the merged chunks.
+    void ChunkStreamer::Clear(void) {
+        this->Merged.clear();
+        this->Pristine.clear();
+        this->Covered.clear();
+        this->Counters.ResidentBytes = 0;
+    }
+
+    // Changed chunks hold changes the generator cannot regenerate.
+    void ChunkStreamer::NotifyChanged(const Region& Changed) {
+        for (const std::array<int, 3>& Key : World::GetChunkKeys(Changed)) {
+            this->Pristine.erase(Key);
+        }
+    }
+
+    // Loaded chunks replace the terrain they cover.
+    void ChunkStreamer::NotifyLoaded(const std::array<int, 3>& Key) {
+        this->Merged.insert(Key);
+        this->Pristine.erase(Key);
+    }
+
+    // Stream around the window.
+    std::vector<Region> ChunkStreamer::Update(World& Target, const std::array<int, 3>& Offset, const std::array<std::size_t, 3>& Size, const std::array<float, 3>& Velocity, float DeltaTime, bool Recompose) {
+        RAYMARCH_TRACE_SCOPE("ChunkStreamer::Update");
+
+        // Predict the window along its velocity, sampled every half chunk of movement, each chunk is prioritised by the first sample that
+        // covers it with a chunk of margin and then by its distance from the centre of the window at that sample.
+        struct Priority {
+            int Sample;
+            int Distance;
+        };
+        const float Lookahead = static_cast<float>(PrefetchFrames) * DeltaTime;
+        const float Travel = std::sqrt(Velocity[0] * Velocity[0] + Velocity[1] * Velocity[1] + Velocity[2] * Velocity[2]) * Lookahead;
+        const int Samples = std::min(static_cast<int>(std::ceil(Travel / (0.5f * static_cast<float>(World::ChunkSize)))), 64);
+        std::unordered_map<std::array<int, 3>, Priority, World::ChunkKeyHash> Wanted;
+        std::array<int, 3> PredictedCentre = Offset;
+        for (int Sample = 0; Sample <= Samples; ++Sample) {
+            const float Fraction = (Samples == 0) ? 0.0f : static_cast<float>(Sample) / static_cast<float>(Samples);
+            Region Window;
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                Window.Minimum[Index] = Offset[Index] + static_cast<int>(std::round(Velocity[Index] * Lookahead * Fraction));
+                Window.Maximum[Index] = Window.Minimum[Index] + static_cast<int>(Size[Index]);
+                PredictedCentre[Index] = (Window.Minimum[Index] + Window.Maximum[Index]) / 2;
+            }
+            for (const std::array<int, 3>& Key : World::GetChunkKeys(Window.Expand(World::ChunkSize))) {
+                if (Wanted.count(Key) != 0) {
+                    continue;
+                }
+                const Region Bounds = World::GetChunkRegion(Key);
+                int Distance = 0;
+                for (std::size_t Index = 0; Index < 3; ++Index) {
+                    const int Separation = (Bounds.Minimum[Index] + Bounds.Maximum[Index]) / 2 - PredictedCentre[Index];
+                    Distance += Separation * Separation;
+                }
+                Wanted.emplace(Key, Priority{Sample, Distance});
+            }
+        }
+
+        // The chunks the window covers now.
+        const Region Window = Region(Offset, {{Offset[0] + static_cast<int>(Size[0]), Offset[1] + static_cast<int>(Size[1]), Offset[2] + static_cast<int>(Size[2])}});
+        std::unordered_set<std::array<int, 3>, World::ChunkKeyHash> Covering;
+        for (const std::array<int, 3>& Key : World::GetChunkKeys(Window)) {
+            Covering.insert(Key);
+        }
+
+        // Each chunk is counted when the window first covers it, as a hit when it was merged or generated by then.
+        for (const std::array<int, 3>& Key : Covering) {
+            if (this->Covered.count(Key) == 0) {
+                std::shared_ptr<const Volume> Chunk;
+                const bool Ready = (this->Merged.count(Key) != 0) || this->Terrain.Acquire(Key, Chunk);
+                ++(Ready ? this->Counters.PrefetchHits : this->Counters.PrefetchMisses);
+            }
+        }
+
+        std::vector<std::pair<std::array<int, 3>, Priority> > Missing;
+        for (const std::pair<const std::array<int, 3>, Priority>& KeyPriorityPair : Wanted) {
+            if (this->Merged.count(KeyPriorityPair.first) == 0) {
+                Missing.push_back(KeyPriorityPair);
+            }
+        }
+        std::sort(Missing.begin(), Missing.end(), [](const std::pair<std::array<int, 3>, Priority>& Left, const std::pair<std::array<int, 3>, Priority>& Right) -> bool {
+            return (Left.second.Sample != Right.second.Sample) ? (Left.second.Sample < Right.second.Sample) : (Left.second.Distance < Right.second.Distance);
+        });
+
+        // Merge ready chunks under the world, the rest are requested in priority order, replacing the requests of the last update.
+        std::vector<Region> Changes;
+        std::vector<std::array<int, 3> > Requests;
+        std::size_t Merges = 0;
+        bool Stalled = false;
+        for (const std::pair<std::array<int, 3>, Priority>& KeyPriorityPair : Missing) {
+            const std::array<int, 3>& Key = KeyPriorityPair.first;
+            const bool Needed = (Covering.count(Key) != 0);
+            const bool CanMerge = Recompose || (Merges < MergesPerUpdate);
+            if (!CanMerge && !Needed) {
+                Requests.push_back(Key);
+                continue;
+            }
+            std::shared_ptr<const Volume> Chunk;
+            if (!this->Terrain.Acquire(Key, Chunk)) {
+                Requests.push_back(Key);
+                Stalled = Stalled || Needed;
+                continue;
+            }
+            if (!CanMerge) {
+                continue;
+            }
+            this->Merged.insert(Key);
+            if (!Chunk) {
+                continue;
+            }
+            if (!Target.MergeChunk(Key, *Chunk)) {
+                this->Pristine.insert(Key);
+            }
+            Changes.push_back(World::GetChunkRegion(Key));
+            ++Merges;
+        }
+        this->Covered.swap(Covering);
+        this->Terrain.Request(Requests);
+        if (Stalled) {
+            ++this->Counters.Stalls;
+        }
+
+        // Merged chunks the world does not store and no longer wants are forgotten, merging them again changes nothing.
+        for (std::unordered_set<std::array<int, 3>, World::ChunkKeyHash>::iterator Iterator = this->Merged.begin(); Iterator != this->Merged.end();) {
+            if ((Wanted.count(*Iterator) == 0) && !Target.FindChunk(*Iterator)) {
+                this->Pristine.erase(*Iterator);
+                Iterator = this->Merged.erase(Iterator);
+            }
+            else {
+                ++Iterator;
+            }
+        }
+
+        // Over the budget the unwanted pristine chunks furthest from the predicted window are evicted first, which are those behind the movement.
+        if (this->Pristine.size() * ChunkBytes > this->ResidentBudget) {
+            std::vector<std::pair<int, std::array<int, 3> > > Candidates;
+            for (const std::array<int, 3>& Key : this->Pristine) {
+                if (Wanted.count(Key) != 0) {
+                    continue;
+                }
+                const Region Bounds = World::GetChunkRegion(Key);
+                int Distance = 0;
+                for (std::size_t Index = 0; Index < 3; ++Index) {
+                    const int Separation = (Bounds.Minimum[Index] + Bounds.Maximum[Index]) / 2 - PredictedCentre[Index];
+                    Distance += Separation * Separation;
+                }
+                Candidates.emplace_back(Distance, Key);
+            }
+            std::sort(Candidates.begin(), Candidates.end(), [](const std::pair<int, std::array<int, 3> >& Left, const std::pair<int, std::array<int, 3> >& Right) -> bool {
+                return Left.first > Right.first;
+            });
+            for (const std::pair<int, std::array<int, 3> >& Candidate : Candidates) {
+                if (this->Pristine.size() * ChunkBytes <= this->ResidentBudget) {
+                    break;
+                }
+                Target.RemoveChunk(Candidate.second);
+                this->Merged.erase(Candidate.second);
+                this->Pristine.erase(Candidate.second);
+                ++this->Counters.Evictions;
+            }
+        }
+
+        this->Counters.QueueDepth = this->Terrain.GetPendingCount();
+        this->Counters.ResidentBytes = this->Pristine.size() * ChunkBytes;
+        return Changes;
+    }
+}
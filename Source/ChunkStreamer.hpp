@@ -0,0 +1,136 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_CHUNKSTREAMER_HPP
+#define RAYMARCH_CHUNKSTREAMER_HPP
+
+#include "Region.hpp"
+#include "TerrainGenerator.hpp"
+#include "World.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  ChunkStreamer streams generated terrain chunks into a world around a moving window.
+    /// @note   The window is predicted ahead along its velocity, chunks it will cover soonest are merged or requested first.
+    ///         Merged chunks that have not changed since are resident only while they fit the resident budget, those furthest
+    ///         from the predicted window, behind the movement, are evicted first and merged again from the generator when needed.
+    class ChunkStreamer {
+    public:
+        /// @brief  The number of frames the window is predicted ahead.
+        constexpr static const int PrefetchFrames = 30;
+
+        /// @brief  The number of chunks merged in an update that does not compose the whole window anyway.
+        constexpr static const std::size_t MergesPerUpdate = 2;
+
+        /// @brief  Counters describing how well the streaming keeps up with the window.
+        struct Metrics {
+            /// @brief  Chunks that were ready when the window first needed them.
+            std::uint64_t PrefetchHits;
+
+            /// @brief  Chunks that were not ready when the window first needed them.
+            std::uint64_t PrefetchMisses;
+
+            /// @brief  Updates in which the window was missing a chunk that had not been generated.
+            std::uint64_t Stalls;
+
+            /// @brief  Chunks evicted from the world.
+            std::uint64_t Evictions;
+
+            /// @brief  The chunks requested and being generated after the last update.
+            std::size_t QueueDepth;
+
+            /// @brief  The bytes of the resident chunks that can be evicted.
+            std::size_t ResidentBytes;
+
+            /// @brief  Get the fraction of chunks that were ready when first needed.
+            /// @return The hit rate, one when no chunk has been needed yet.
+            double GetHitRate(void) const;
+        };
+
+    private:
+        /// @brief  The generator of the chunks.
+        TerrainGenerator Terrain;
+
+        /// @brief  The largest number of bytes the evictable resident chunks may use.
+        std::size_t ResidentBudget;
+
+        /// @brief  The chunks of the world the terrain has been merged into.
+        std::unordered_set<std::array<int, 3>, World::ChunkKeyHash> Merged;
+
+        /// @brief  The merged chunks that held nothing else and have not changed since, they can be evicted.
+        std::unordered_set<std::array<int, 3>, World::ChunkKeyHash> Pristine;
+
+        /// @brief  The chunks the window covered in the last update, chunks are counted as hits or misses when they are first covered.
+        std::unordered_set<std::array<int, 3>, World::ChunkKeyHash> Covered;
+
+        /// @brief  The streaming counters.
+        Metrics Counters;
+
+    public:
+        /// @brief  Constructor that starts the generator.
+        /// @param  Seed - The seed of the terrain.
+        /// @param  CacheBudget - The largest number of bytes the generator may cache.
+        /// @param  CompressedBudget - The largest number of bytes the generator may cache compressed.
+        /// @param  ResidentBudget - The largest number of bytes the evictable resident chunks may use.
+        ChunkStreamer(std::uint32_t Seed, std::size_t CacheBudget, std::size_t CompressedBudget, std::size_t ResidentBudget);
+
+    public:
+        /// @brief  Get the generator of the chunks.
+        /// @return The terrain generator.
+        const TerrainGenerator& GetTerrain(void) const;
+
+        /// @brief  Get the streaming counters.
+        /// @return The current metrics.
+        const Metrics& GetMetrics(void) const;
+
+        /// @brief  Forget every merged chunk, used when the world has been cleared.
+        void Clear(void);
+
+        /// @brief  Mark the chunks overlapping a change to the world so they are never evicted.
+        /// @param  Changed - The region of the world that changed.
+        void NotifyChanged(const Region& Changed);
+
+        /// @brief  Mark a chunk loaded into the world as merged so the generator never refills it, it is never evicted.
+        /// @param  Key - The chunk coordinate.
+        void NotifyLoaded(const std::array<int, 3>& Key);
+
+        /// @brief  Merge ready chunks around the window, request the missing ones and evict over the budget.
+        /// @param  Target - The world to stream into.
+        /// @param  Offset - The world position of the window.
+        /// @param  Size - The size of the window.
+        /// @param  Velocity - The velocity of the window in voxels per second.
+        /// @param  DeltaTime - The time of a frame, used to predict the window.
+        /// @param  Recompose - Set when the whole window is composed this update, every ready chunk is merged.
+        /// @return The regions of the world that were merged into.
+        std::vector<Region> Update(World& Target, const std::array<int, 3>& Offset, const std::array<std::size_t, 3>& Size, const std::array<float, 3>& Velocity, float DeltaTime, bool Recompose);
+    };
+}
+
+#endif // RAYMARCH_CHUNKSTREAMER_HPP
@@ -0,0 +1,337 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "Clipmap.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+
+namespace Raymarch {
+    // Divide rounding towards negative infinity.
+    static int FloorDivide(int Value, int Divisor) {
+        return (Value >= 0) ? (Value / Divisor) : -((-Value + Divisor - 1) / Divisor);
+    }
+
+    // Halve the resolution of a cube of voxels, each cell takes the first visible voxel of its upper half or else its lower half, so surfaces keep their colour.
+    static void Downsample(const Voxel* Source, std::size_t SourceSide, Voxel* Target) {
+        const std::size_t TargetSide = SourceSide / 2;
+        for (std::size_t Z = 0; Z < TargetSide; ++Z) {
+            for (std::size_t Y = 0; Y < TargetSide; ++Y) {
+                for (std::size_t X = 0; X < TargetSide; ++X) {
+                    Voxel Result;
+                    for (std::size_t Child = 0; Child < 8; ++Child) {
+                        const std::size_t ChildX = X * 2 + (Child & 1);
+                        const std::size_t ChildY = Y * 2 + 1 - ((Child >> 2) & 1);
+                        const std::size_t ChildZ = Z * 2 + ((Child >> 1) & 1);
+                        const Voxel& Value = Source[ChildX + SourceSide * (ChildY + SourceSide * ChildZ)];
+                        if (Value.GetAlpha() > 0) {
+                            Result = Value;
+                            break;
+                        }
+                    }
+                    Target[X + TargetSide * (Y + TargetSide * Z)] = Result;
+                }
+            }
+        }
+    }
+
+    // Build the mips of a chunk, each from the one before.
+    static void BuildMips(const Volume& Chunk, std::size_t Count, std::vector<std::vector<Voxel> >& Mips) {
+        Mips.resize(Count);
+        const Voxel* Source = Chunk.data();
+        std::size_t Side = static_cast<std::size_t>(World::ChunkSize);
+        for (std::size_t Level = 0; Level < Count; ++Level) {
+            Mips[Level].resize((Side / 2) * (Side / 2) * (Side / 2));
+            Downsample(Source, Side, Mips[Level].data());
+            Source = Mips[Level].data();
+            Side /= 2;
+        }
+    }
+
+    // Constructor that creates a clipmap without cascades.
+    Clipmap::Clipmap(void)
+        : Size{{0, 0, 0}}
+        , NextLevel(0) {
+    }
+
+    // Get the number of cascades.
+    std::size_t Clipmap::GetLevelCount(void) const {
+        return this->Cascades.size();
+    }
+
+    // Get the size of a cascade.
+    const std::array<std::size_t, 3>& Clipmap::GetSize(void) const {
+        return this->Size;
+    }
+
+    // Get the cell size of a cascade.
+    int Clipmap::GetCellSize(std::size_t Level) const {
+        return 2 << Level;
+    }
+
+    // Get the origin of a cascade.
+    const std::array<int, 3>& Clipmap::GetOrigin(std::size_t Level) const {
+        return this->Origins[Level];
+    }
+
+    // Get the region covered by a cascade.
+    Region Clipmap::GetRegion(std::size_t Level) const {
+        const int CellSize = this->GetCellSize(Level);
+        const std::array<int, 3>& Origin = this->Origins[Level];
+        return Region(Origin, {{
+            Origin[0] + static_cast<int>(this->Size[0]) * CellSize,
+            Origin[1] + static_cast<int>(this->Size[1]) * CellSize,
+            Origin[2] + static_cast<int>(this->Size[2]) * CellSize
+        }});
+    }
+
+    // Get the cells of a cascade.
+    const Voxel* Clipmap::data(std::size_t Level) const {
+        return this->Cascades[Level].data();
+    }
+
+    // Get the version of a cascade.
+    std::uint64_t Clipmap::GetVersion(std::size_t Level) const {
+        return this->Versions[Level];
+    }
+
+    // Resize the cascades.
+    void Clipmap::Resize(const std::array<std::size_t, 3>& Size, std::size_t LevelCount) {
+        LevelCount = std::min(LevelCount, MaximumLevels);
+        this->Size = Size;
+        this->Origins.assign(LevelCount, {{0, 0, 0}});
+        this->Cascades.assign(LevelCount, std::vector<Voxel>(Size[0] * Size[1] * Size[2]));
+        this->Versions.assign(LevelCount, 0);
+        this->Dirty.assign(LevelCount, Region());
+        this->Stale.assign(LevelCount, true);
+        this->NextLevel = 0;
+        this->Mips.clear();
+    }
+
+    // Forget every chunk mip.
+    void Clipmap::Clear(void) {
+        this->Mips.clear();
+        this->Dirty.assign(this->Cascades.size(), Region());
+        this->Stale.assign(this->Cascades.size(), true);
+    }
+
+    // Forget the changed chunk mips.
+    void Clipmap::NotifyChanged(const Region& Changed) {
+        if (this->Cascades.empty()) {
+            return;
+        }
+        for (const std::array<int, 3>& Key : World::GetChunkKeys(Changed)) {
+            this->Mips.erase(Key);
+        }
+        for (std::size_t Level = 0; Level < this->Cascades.size(); ++Level) {
+            this->Dirty[Level] = this->Dirty[Level].Union(Changed.Intersection(this->GetRegion(Level)));
+        }
+    }
+
+    // Move and fill the cascades.
+    bool Clipmap::Update(const World& Source, const std::array<int, 3>& SceneOffset, const std::array<std::size_t, 3>& SceneSize) {
+        RAYMARCH_TRACE_SCOPE("Clipmap::Update");
+
+        // Cascades are centred on the scene horizontally and start at its floor, in whole cells.
+        bool Changed = false;
+        bool Moved = false;
+        for (std::size_t Level = 0; Level < this->Cascades.size(); ++Level) {
+            const int CellSize = this->GetCellSize(Level);
+            const std::array<int, 3> Origin = {{
+                FloorDivide(SceneOffset[0] + static_cast<int>(SceneSize[0]) / 2 - static_cast<int>(this->Size[0]) * CellSize / 2, CellSize) * CellSize,
+                FloorDivide(SceneOffset[1], CellSize) * CellSize,
+                FloorDivide(SceneOffset[2] + static_cast<int>(SceneSize[2]) / 2 - static_cast<int>(this->Size[2]) * CellSize / 2, CellSize) * CellSize
+            }};
+            if (Origin != this->Origins[Level]) {
+                Moved = Moved || (Level + 1 == this->Cascades.size());
+                if (!this->Stale[Level] && this->Scroll(Source, Level, Origin)) {
+                    Changed = true;
+                }
+                else {
+                    this->Origins[Level] = Origin;
+                    this->Stale[Level] = true;
+                }
+            }
+            if (this->Stale[Level]) {
+                this->Fill(Source, Level, this->GetRegion(Level));
+                this->Stale[Level] = false;
+                this->Dirty[Level] = Region();
+                ++this->Versions[Level];
+                Changed = true;
+            }
+        }
+
+        // Mips outside the outermost cascade are never read again.
+        if (Moved) {
+            const Region Outermost = this->GetRegion(this->Cascades.size() - 1);
+            for (auto Iterator = this->Mips.begin(); Iterator != this->Mips.end();) {
+                Iterator = World::GetChunkRegion(Iterator->first).Intersection(Outermost).IsEmpty() ? this->Mips.erase(Iterator) : std::next(Iterator);
+            }
+        }
+
+        // Changes are applied to the next cascade that has any, the others catch up on later updates.
+        for (std::size_t Attempt = 0; Attempt < this->Cascades.size(); ++Attempt) {
+            const std::size_t Level = this->NextLevel;
+            this->NextLevel = (this->NextLevel + 1) % this->Cascades.size();
+            if (!this->Dirty[Level].IsEmpty()) {
+                this->Fill(Source, Level, this->Dirty[Level]);
+                this->Dirty[Level] = Region();
+                ++this->Versions[Level];
+                Changed = true;
+                break;
+            }
+        }
+        return Changed;
+    }
+
+    // Scroll a cascade to a new origin.
+    bool Clipmap::Scroll(const World& Source, std::size_t Level, const std::array<int, 3>& Origin) {
+        RAYMARCH_TRACE_SCOPE("Clipmap::Scroll");
+
+        // A cascade that moved further than its size has nothing to keep.
+        const int CellSize = this->GetCellSize(Level);
+        std::array<int, 3> Shift;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            Shift[Axis] = (Origin[Axis] - this->Origins[Level][Axis]) / CellSize;
+            if (std::abs(Shift[Axis]) >= static_cast<int>(this->Size[Axis])) {
+                return false;
+            }
+        }
+
+        // Move the kept cells a row at a time.
+        const std::vector<Voxel>& Previous = this->Cascades[Level];
+        std::vector<Voxel> Cells(Previous.size());
+        const int SizeX = static_cast<int>(this->Size[0]);
+        const int SizeY = static_cast<int>(this->Size[1]);
+        const int SizeZ = static_cast<int>(this->Size[2]);
+        const int FirstX = std::max(0, -Shift[0]);
+        const int LastX = std::min(SizeX, SizeX - Shift[0]);
+        for (int Z = std::max(0, -Shift[2]); Z < std::min(SizeZ, SizeZ - Shift[2]); ++Z) {
+            for (int Y = std::max(0, -Shift[1]); Y < std::min(SizeY, SizeY - Shift[1]); ++Y) {
+                const Voxel* Row = &Previous[static_cast<std::size_t>((FirstX + Shift[0]) + SizeX * ((Y + Shift[1]) + SizeY * (Z + Shift[2])))];
+                std::copy(Row, Row + (LastX - FirstX), &Cells[static_cast<std::size_t>(FirstX + SizeX * (Y + SizeY * Z))]);
+            }
+        }
+        this->Cascades[Level] = std::move(Cells);
+        this->Origins[Level] = Origin;
+
+        // Fill the slab uncovered along each axis.
+        const Region Extent = this->GetRegion(Level);
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            if (Shift[Axis] == 0) {
+                continue;
+            }
+            Region Uncovered = Extent;
+            if (Shift[Axis] > 0) {
+                Uncovered.Minimum[Axis] = Extent.Maximum[Axis] - Shift[Axis] * CellSize;
+            }
+            else {
+                Uncovered.Maximum[Axis] = Extent.Minimum[Axis] - Shift[Axis] * CellSize;
+            }
+            this->Fill(Source, Level, Uncovered);
+        }
+        ++this->Versions[Level];
+        return true;
+    }
+
+    // Copy the changed cascades.
+    void Clipmap::CopyLevels(const Clipmap& Source) {
+        if ((this->Size != Source.Size) || (this->Cascades.size() != Source.Cascades.size())) {
+            this->Resize(Source.Size, Source.Cascades.size());
+        }
+        this->Origins = Source.Origins;
+        for (std::size_t Level = 0; Level < this->Cascades.size(); ++Level) {
+            if (this->Versions[Level] != Source.Versions[Level]) {
+                this->Cascades[Level] = Source.Cascades[Level];
+                this->Versions[Level] = Source.Versions[Level];
+            }
+        }
+    }
+
+    // Fill part of a cascade.
+    void Clipmap::Fill(const World& Source, std::size_t Level, const Region& Target) {
+        RAYMARCH_TRACE_SCOPE("Clipmap::Fill");
+
+        // Whole chunks are filled, chunk boundaries are always cell boundaries.
+        const std::vector<std::array<int, 3> > Keys = World::GetChunkKeys(Target.Intersection(this->GetRegion(Level)));
+        if (Keys.empty()) {
+            return;
+        }
+
+        // Downsample the stored chunks that have no mips yet in parallel.
+        std::vector<std::array<int, 3> > Missing;
+        for (const std::array<int, 3>& Key : Keys) {
+            if ((this->Mips.count(Key) == 0) && (Source.FindChunk(Key) != nullptr)) {
+                Missing.push_back(Key);
+            }
+        }
+        std::vector<std::vector<std::vector<Voxel> > > Built(Missing.size());
+        const std::size_t LevelCount = this->Cascades.size();
+        JobSystem::GetGlobal().ParallelFor(0, Missing.size(), 1, [&Source, &Missing, &Built, LevelCount](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Index = First; Index < Last; ++Index) {
+                BuildMips(*Source.FindChunk(Missing[Index]), LevelCount, Built[Index]);
+            }
+        });
+        for (std::size_t Index = 0; Index < Missing.size(); ++Index) {
+            this->Mips[Missing[Index]] = std::move(Built[Index]);
+        }
+
+        // Copy the mip of each chunk into its cells in parallel a row at a time, the chunks cover disjoint cells.
+        const Region Extent = this->GetRegion(Level);
+        const int CellSize = this->GetCellSize(Level);
+        const std::size_t MipSide = static_cast<std::size_t>(World::ChunkSize / CellSize);
+        JobSystem::GetGlobal().ParallelFor(0, Keys.size(), 16, [this, &Keys, &Extent, Level, CellSize, MipSide](std::size_t First, std::size_t Last) -> void {
+            std::vector<Voxel>& Cells = this->Cascades[Level];
+            for (std::size_t Index = First; Index < Last; ++Index) {
+                const auto Found = this->Mips.find(Keys[Index]);
+                const Voxel* Mip = (Found != this->Mips.end()) ? Found->second[Level].data() : nullptr;
+                const Region Chunk = World::GetChunkRegion(Keys[Index]);
+                const Region Covered = Chunk.Intersection(Extent);
+                std::array<std::size_t, 3> CellMinimum;
+                std::array<std::size_t, 3> MipMinimum;
+                std::array<std::size_t, 3> Count;
+                for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                    CellMinimum[Axis] = static_cast<std::size_t>((Covered.Minimum[Axis] - Extent.Minimum[Axis]) / CellSize);
+                    MipMinimum[Axis] = static_cast<std::size_t>((Covered.Minimum[Axis] - Chunk.Minimum[Axis]) / CellSize);
+                    Count[Axis] = static_cast<std::size_t>((Covered.Maximum[Axis] - Covered.Minimum[Axis]) / CellSize);
+                }
+                for (std::size_t Z = 0; Z < Count[2]; ++Z) {
+                    for (std::size_t Y = 0; Y < Count[1]; ++Y) {
+                        Voxel* Row = &Cells[CellMinimum[0] + this->Size[0] * ((CellMinimum[1] + Y) + this->Size[1] * (CellMinimum[2] + Z))];
+                        if (Mip != nullptr) {
+                            const Voxel* MipRow = &Mip[MipMinimum[0] + MipSide * ((MipMinimum[1] + Y) + MipSide * (MipMinimum[2] + Z))];
+                            std::copy(MipRow, MipRow + Count[0], Row);
+                        }
+                        else {
+                            std::fill(Row, Row + Count[0], Voxel());
+                        }
+                    }
+                }
+            }
+        });
+    }
+}
@@ -0,0 +1,154 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_CLIPMAP_HPP
+#define RAYMARCH_CLIPMAP_HPP
+
+#include "Region.hpp"
+#include "Voxel.hpp"
+#include "World.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  Clipmap holds nested cascades of the world around the scene, each covering twice the extent of the last at half the resolution.
+    /// @note   Every cascade has as many cells as the scene, cascade N has cells of 2^(N+1) voxels and is aligned to its cell size so
+    ///         it only moves in whole cells, keeping the cells it still covers and filling only the uncovered slabs. Cells are filled
+    ///         from mips of the world chunks, each built by 2x downsampling the mip below and cached until the chunk changes, so far
+    ///         terrain stays visible after its chunks are evicted from the world. Changes to the world are applied to one cascade
+    ///         per update to bound the work.
+    class Clipmap {
+    public:
+        /// @brief  The largest number of cascades, the coarsest has a cell per chunk.
+        constexpr static const std::size_t MaximumLevels = 5;
+
+    private:
+        /// @brief  The number of cells of every cascade along each axis.
+        std::array<std::size_t, 3> Size;
+
+        /// @brief  The world position of the minimum corner of each cascade.
+        std::vector<std::array<int, 3> > Origins;
+
+        /// @brief  The cells of each cascade, indexed by X + SizeX * (Y + SizeY * Z).
+        std::vector<std::vector<Voxel> > Cascades;
+
+        /// @brief  The version of each cascade, incremented whenever its cells change.
+        std::vector<std::uint64_t> Versions;
+
+        /// @brief  The region of the world that changed since each cascade was filled.
+        std::vector<Region> Dirty;
+
+        /// @brief  Set for each cascade that needs filling in full.
+        std::vector<bool> Stale;
+
+        /// @brief  The cascade whose changes are applied next.
+        std::size_t NextLevel;
+
+        /// @brief  The downsampled mips of each chunk, the first mip has half the resolution of the chunk.
+        std::unordered_map<std::array<int, 3>, std::vector<std::vector<Voxel> >, World::ChunkKeyHash> Mips;
+
+    public:
+        /// @brief  Constructor that creates a clipmap without cascades.
+        Clipmap(void);
+
+    public:
+        /// @brief  Get the number of cascades.
+        /// @return The number of cascades.
+        std::size_t GetLevelCount(void) const;
+
+        /// @brief  Get the number of cells of every cascade along each axis.
+        /// @return The size of a cascade.
+        const std::array<std::size_t, 3>& GetSize(void) const;
+
+        /// @brief  Get the size of the cells of a cascade.
+        /// @param  Level - The cascade.
+        /// @return The number of voxels along each axis of a cell.
+        int GetCellSize(std::size_t Level) const;
+
+        /// @brief  Get the position of a cascade.
+        /// @param  Level - The cascade.
+        /// @return The world position of the minimum corner of the cascade.
+        const std::array<int, 3>& GetOrigin(std::size_t Level) const;
+
+        /// @brief  Get the region of the world covered by a cascade.
+        /// @param  Level - The cascade.
+        /// @return The region in world coordinates.
+        Region GetRegion(std::size_t Level) const;
+
+        /// @brief  Get the cells of a cascade.
+        /// @param  Level - The cascade.
+        /// @return A pointer to the cells, indexed by X + SizeX * (Y + SizeY * Z).
+        const Voxel* data(std::size_t Level) const;
+
+        /// @brief  Get the version of a cascade, it changes whenever the cells of the cascade change.
+        /// @param  Level - The cascade.
+        /// @return The current version.
+        std::uint64_t GetVersion(std::size_t Level) const;
+
+    public:
+        /// @brief  Set the number and size of the cascades, every cascade is filled again on the next update.
+        /// @param  Size - The number of cells of every cascade along each axis, usually the size of the scene.
+        /// @param  LevelCount - The number of cascades, at most the maximum.
+        void Resize(const std::array<std::size_t, 3>& Size, std::size_t LevelCount);
+
+        /// @brief  Forget every chunk mip, used when the world has been replaced.
+        void Clear(void);
+
+        /// @brief  Forget the mips of the chunks overlapping a change to the world and mark the cascades covering it.
+        /// @param  Changed - The region of the world that changed.
+        void NotifyChanged(const Region& Changed);
+
+        /// @brief  Move the cascades to stay centred on the scene and fill the cells that moved or changed.
+        /// @param  Source - The world to downsample.
+        /// @param  SceneOffset - The world position of the scene.
+        /// @param  SceneSize - The size of the scene.
+        /// @return True if any cascade changed.
+        bool Update(const World& Source, const std::array<int, 3>& SceneOffset, const std::array<std::size_t, 3>& SceneSize);
+
+        /// @brief  Copy the cascades of another clipmap whose versions differ, without its chunk mips.
+        /// @param  Source - The clipmap to copy.
+        void CopyLevels(const Clipmap& Source);
+
+    private:
+        /// @brief  Move a cascade to a new origin, keeping the cells it still covers and filling the rest.
+        /// @param  Source - The world to downsample.
+        /// @param  Level - The cascade.
+        /// @param  Origin - The new world position of the minimum corner of the cascade.
+        /// @return False if the cascade moved too far to keep any cells, it is then unchanged.
+        bool Scroll(const World& Source, std::size_t Level, const std::array<int, 3>& Origin);
+
+        /// @brief  Fill the cells of a cascade covering part of the world, building any missing chunk mips.
+        /// @param  Source - The world to downsample.
+        /// @param  Level - The cascade.
+        /// @param  Target - The region of the world to fill, clipped to the cascade.
+        void Fill(const World& Source, std::size_t Level, const Region& Target);
+    };
+}
+
+#endif // RAYMARCH_CLIPMAP_HPP
@@ -0,0 +1,403 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "CollisionMap.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Raymarch {
+    // The number of queries of a batch handled by each job.
+    constexpr static const std::size_t QueryGrain = 256;
+
+    // Get the sign of a value as the shader does.
+    static float Sign(float Value) {
+        return (Value > 0.0f) ? 1.0f : ((Value < 0.0f) ? -1.0f : 0.0f);
+    }
+
+    // Test for ray intersection with a box, the same as the voxel shader.
+    static bool RayBoxIntersect(const std::array<float, 3>& RayOrigin, const std::array<float, 3>& RayDirection, const std::array<float, 3>& BoxMin, const std::array<float, 3>& BoxMax, float& IntersectionDepth) {
+        std::array<float, 3> MaximumVector;
+        std::array<float, 3> MinimumVector;
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            const float OriginToBoxMinimum = (BoxMin[Index] - RayOrigin[Index]) / RayDirection[Index];
+            const float OriginToBoxMaximum = (BoxMax[Index] - RayOrigin[Index]) / RayDirection[Index];
+            MaximumVector[Index] = std::max(OriginToBoxMaximum, OriginToBoxMinimum);
+            MinimumVector[Index] = std::min(OriginToBoxMaximum, OriginToBoxMinimum);
+        }
+
+        const float BackIntersectionDepth = std::min(MaximumVector[0], std::min(MaximumVector[1], MaximumVector[2]));
+
+        IntersectionDepth = std::max(std::max(MinimumVector[0], 0.0f), std::max(MinimumVector[1], MinimumVector[2]));
+
+        return BackIntersectionDepth > IntersectionDepth;
+    }
+
+    // Constructor for an empty map.
+    CollisionMap::CollisionMap(void)
+        : Size{{0, 0, 0}}
+        , BrickCount{{0, 0, 0}} {
+    }
+
+    // Get the size.
+    const std::array<std::size_t, 3>& CollisionMap::GetSize(void) const {
+        return this->Size;
+    }
+
+    // Map every voxel.
+    void CollisionMap::Rebuild(const Volume& Scene) {
+        RAYMARCH_TRACE_SCOPE("CollisionMap::Rebuild");
+
+        this->Size = Scene.GetSize();
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            this->BrickCount[Index] = (this->Size[Index] + BrickSize - 1) / BrickSize;
+        }
+        this->Occupancy = Scene.GetOccupancyMask();
+        this->Bricks.assign(this->BrickCount[0] * this->BrickCount[1] * this->BrickCount[2], 0);
+
+        // Each job sets the bricks of its own slab along Z.
+        JobSystem::GetGlobal().ParallelFor(0, this->BrickCount[2], 1, [this, &Scene](std::size_t FirstBrickZ, std::size_t LastBrickZ) -> void {
+            Region Slab = Scene.GetRegion();
+            Slab.Minimum[2] = static_cast<int>(FirstBrickZ) * BrickSize;
+            Slab.Maximum[2] = std::min(static_cast<int>(this->Size[2]), static_cast<int>(LastBrickZ) * BrickSize);
+            this->UpdateBricks(Slab);
+        });
+    }
+
+    // Map a changed region again.
+    void CollisionMap::Update(const Volume& Scene, const Region& Changed) {
+        const Region Target = Changed.Intersection(Scene.GetRegion());
+        if (Target.IsEmpty()) {
+            return;
+        }
+        for (int IndexZ = Target.Minimum[2]; IndexZ < Target.Maximum[2]; ++IndexZ) {
+            for (int IndexY = Target.Minimum[1]; IndexY < Target.Maximum[1]; ++IndexY) {
+                for (int IndexX = Target.Minimum[0]; IndexX < Target.Maximum[0]; ++IndexX) {
+                    const std::size_t Bit = IndexX + this->Size[0] * (IndexY + this->Size[1] * IndexZ);
+                    const std::uint64_t Mask = std::uint64_t(1) << (Bit % 64);
+                    if (Scene(IndexX, IndexY, IndexZ).GetAlpha() > 0) {
+                        this->Occupancy[Bit / 64] |= Mask;
+                    }
+                    else {
+                        this->Occupancy[Bit / 64] &= ~Mask;
+                    }
+                }
+            }
+        }
+        this->UpdateBricks(Target);
+    }
+
+    // Test a voxel, the brick is tested first as most of the bricks of a scene are empty.
+    bool CollisionMap::IsOccupied(int X, int Y, int Z) const {
+        if ((X < 0) || (Y < 0) || (Z < 0) || (X >= static_cast<int>(this->Size[0])) || (Y >= static_cast<int>(this->Size[1])) || (Z >= static_cast<int>(this->Size[2]))) {
+            return false;
+        }
+        if (!this->Bricks[(X / BrickSize) + this->BrickCount[0] * ((Y / BrickSize) + this->BrickCount[1] * (Z / BrickSize))]) {
+            return false;
+        }
+        const std::size_t Bit = X + this->Size[0] * (Y + this->Size[1] * Z);
+        return (this->Occupancy[Bit / 64] >> (Bit % 64)) & 1;
+    }
+
+    // Test a region, skipping empty bricks and testing the rows of the others a word at a time.
+    bool CollisionMap::IsOccupied(const Region& Target) const {
+        const Region Clipped = Target.Intersection(Region({{0, 0, 0}}, {{static_cast<int>(this->Size[0]), static_cast<int>(this->Size[1]), static_cast<int>(this->Size[2])}}));
+        if (Clipped.IsEmpty()) {
+            return false;
+        }
+        for (int BrickZ = Clipped.Minimum[2] / BrickSize; BrickZ <= (Clipped.Maximum[2] - 1) / BrickSize; ++BrickZ) {
+            for (int BrickY = Clipped.Minimum[1] / BrickSize; BrickY <= (Clipped.Maximum[1] - 1) / BrickSize; ++BrickY) {
+                for (int BrickX = Clipped.Minimum[0] / BrickSize; BrickX <= (Clipped.Maximum[0] - 1) / BrickSize; ++BrickX) {
+                    if (!this->Bricks[BrickX + this->BrickCount[0] * (BrickY + this->BrickCount[1] * BrickZ)]) {
+                        continue;
+                    }
+                    const Region Brick = Region({{BrickX * BrickSize, BrickY * BrickSize, BrickZ * BrickSize}}, {{(BrickX + 1) * BrickSize, (BrickY + 1) * BrickSize, (BrickZ + 1) * BrickSize}}).Intersection(Clipped);
+                    for (int IndexZ = Brick.Minimum[2]; IndexZ < Brick.Maximum[2]; ++IndexZ) {
+                        for (int IndexY = Brick.Minimum[1]; IndexY < Brick.Maximum[1]; ++IndexY) {
+                            if (this->IsRowOccupied(IndexY, IndexZ, Brick.Minimum[0], Brick.Maximum[0])) {
+                                return true;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    // March a ray through the voxels as the voxel shader does.
+    CollisionMap::RayHit CollisionMap::CastRay(const RayQuery& Query) const {
+        RayHit Result = {false, {{0, 0, 0}}, {{0, 0, 0}}, 0.0f, {{0.0f, 0.0f, 0.0f}}, 0};
+
+        const float Length = std::sqrt(Query.Direction[0] * Query.Direction[0] + Query.Direction[1] * Query.Direction[1] + Query.Direction[2] * Query.Direction[2]);
+        if (!(Length > 0.0f)) {
+            return Result;
+        }
+
+        // The direction in which to advance the ray position, offset to prevent the same artifacts as the shader.
+        const std::array<float, 3>& RayOrigin = Query.Origin;
+        std::array<float, 3> RayDirection;
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            RayDirection[Index] = Query.Direction[Index] / Length + 0.000001f;
+        }
+
+        // The ray march origin may be further forward than the ray origin if we can jump forward to the volume.
+        const std::array<float, 3> VolumeSize = {{static_cast<float>(this->Size[0]), static_cast<float>(this->Size[1]), static_cast<float>(this->Size[2])}};
+        std::array<float, 3> RayMarchOrigin = RayOrigin;
+        bool Inside = true;
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            Inside = Inside && (RayOrigin[Index] >= 0.0f) && (RayOrigin[Index] < VolumeSize[Index]);
+        }
+        if (!Inside) {
+            float IntersectionDepth;
+            if (!RayBoxIntersect(RayOrigin, RayDirection, {{0.0f, 0.0f, 0.0f}}, VolumeSize, IntersectionDepth)) {
+                return Result;
+            }
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                RayMarchOrigin[Index] = RayOrigin[Index] + RayDirection[Index] * IntersectionDepth + RayDirection[Index] * 0.0001f;
+            }
+        }
+
+        // Set up the ray marching parameters.
+        std::array<float, 3> RayPosition;
+        std::array<float, 3> RayStep;
+        std::array<float, 3> MaxTranslation;
+        std::array<float, 3> DeltaTranslation;
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            RayPosition[Index] = std::floor(RayMarchOrigin[Index]);
+            RayStep[Index] = Sign(RayDirection[Index]);
+            MaxTranslation[Index] = (((0.5f + RayPosition[Index]) + 0.5f * RayStep[Index]) - RayMarchOrigin[Index]) / RayDirection[Index];
+            DeltaTranslation[Index] = RayStep[Index] / RayDirection[Index];
+        }
+
+        // Ray marching loop.
+        for (int Iteration = 0; Iteration < MaximumRaySteps; ++Iteration) {
+            Result.Steps = Iteration + 1;
+            const std::array<int, 3> Position = {{static_cast<int>(RayPosition[0]), static_cast<int>(RayPosition[1]), static_cast<int>(RayPosition[2])}};
+            if (this->IsOccupied(Position[0], Position[1], Position[2])) {
+                // Calculate the intersection depth.
+                float IntersectionDepth;
+                if (!RayBoxIntersect(RayOrigin, RayDirection, RayPosition, {{RayPosition[0] + 1.0f, RayPosition[1] + 1.0f, RayPosition[2] + 1.0f}}, IntersectionDepth)) {
+                    return Result;
+                }
+
+                // Calculate the face from the direction of the intersection from the voxel centre.
+                std::array<float, 3> Direction;
+                for (std::size_t Index = 0; Index < 3; ++Index) {
+                    Result.Position[Index] = RayOrigin[Index] + RayDirection[Index] * IntersectionDepth;
+                    Direction[Index] = Result.Position[Index] - (RayPosition[Index] + 0.5f);
+                }
+                const std::array<float, 3> AbsoluteDirection = {{std::abs(Direction[0]), std::abs(Direction[1]), std::abs(Direction[2])}};
+                if ((AbsoluteDirection[1] > AbsoluteDirection[0]) && (AbsoluteDirection[1] > AbsoluteDirection[2])) {
+                    Result.Normal = {{0, static_cast<int>(Sign(Direction[1])), 0}};
+                }
+                else if (AbsoluteDirection[0] > AbsoluteDirection[2]) {
+                    Result.Normal = {{static_cast<int>(Sign(Direction[0])), 0, 0}};
+                }
+                else {
+                    Result.Normal = {{0, 0, static_cast<int>(Sign(Direction[2]))}};
+                }
+                Result.Hit = true;
+                Result.Voxel = Position;
+                Result.Distance = IntersectionDepth;
+                return Result;
+            }
+
+            // Advance along every axis whose next boundary is nearest.
+            const bool AdvanceX = MaxTranslation[0] <= std::min(MaxTranslation[1], MaxTranslation[2]);
+            const bool AdvanceY = MaxTranslation[1] <= std::min(MaxTranslation[2], MaxTranslation[0]);
+            const bool AdvanceZ = MaxTranslation[2] <= std::min(MaxTranslation[0], MaxTranslation[1]);
+            const std::array<bool, 3> RayAdvanceMask = {{AdvanceX, AdvanceY, AdvanceZ}};
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                if (RayAdvanceMask[Index]) {
+                    MaxTranslation[Index] += DeltaTranslation[Index];
+                    RayPosition[Index] += RayStep[Index];
+                }
+            }
+
+            // Test within bounds.
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                if ((RayPosition[Index] >= VolumeSize[Index]) || (RayPosition[Index] < 0.0f)) {
+                    return Result;
+                }
+            }
+        }
+        return Result;
+    }
+
+    // Find the earliest contact of the moving box with any occupied voxel it passes.
+    CollisionMap::SweepResult CollisionMap::Sweep(const SweepQuery& Query) const {
+        SweepResult Result = {1.0f, {{0, 0, 0}}};
+
+        // The voxels the box can touch on its way, if none are occupied the box moves freely.
+        Region Broad;
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            Broad.Minimum[Index] = static_cast<int>(std::floor(std::min(Query.Minimum[Index], Query.Minimum[Index] + Query.Motion[Index])));
+            Broad.Maximum[Index] = static_cast<int>(std::floor(std::max(Query.Maximum[Index], Query.Maximum[Index] + Query.Motion[Index]))) + 1;
+        }
+        Broad = Broad.Intersection(Region({{0, 0, 0}}, {{static_cast<int>(this->Size[0]), static_cast<int>(this->Size[1]), static_cast<int>(this->Size[2])}}));
+        if (!this->IsOccupied(Broad)) {
+            return Result;
+        }
+
+        // The time the box meets a voxel, and the axis it meets it on.
+        auto TestVoxel = [&Query, &Result](int X, int Y, int Z) -> void {
+            const std::array<int, 3> Position = {{X, Y, Z}};
+            float Entry = -std::numeric_limits<float>::infinity();
+            float Exit = std::numeric_limits<float>::infinity();
+            std::size_t Axis = 3;
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                const float Lower = static_cast<float>(Position[Index]);
+                const float Upper = Lower + 1.0f;
+                if (Query.Motion[Index] == 0.0f) {
+                    // A box that does not move along an axis only meets voxels it overlaps along that axis, touching faces slide.
+                    if ((Query.Maximum[Index] <= Lower + Skin) || (Query.Minimum[Index] >= Upper - Skin)) {
+                        return;
+                    }
+                    continue;
+                }
+                const float AxisEntry = ((Query.Motion[Index] > 0.0f) ? (Lower - Query.Maximum[Index]) : (Upper - Query.Minimum[Index])) / Query.Motion[Index];
+                const float AxisExit = ((Query.Motion[Index] > 0.0f) ? (Upper - Query.Minimum[Index]) : (Lower - Query.Maximum[Index])) / Query.Motion[Index];
+                if (AxisEntry > Entry) {
+                    Entry = AxisEntry;
+                    Axis = Index;
+                }
+                Exit = std::min(Exit, AxisExit);
+            }
+            if ((Axis == 3) || (Entry >= Exit) || (Entry >= Result.Time) || (Exit <= 0.0f)) {
+                return;
+            }
+
+            // A box already further inside the voxel than the skin is left to move out of it.
+            if (-Entry * std::abs(Query.Motion[Axis]) > Skin) {
+                return;
+            }
+            Result.Time = std::max(0.0f, Entry);
+            Result.Normal = {{0, 0, 0}};
+            Result.Normal[Axis] = (Query.Motion[Axis] > 0.0f) ? -1 : +1;
+        };
+
+        // Only the occupied voxels of occupied rows of occupied bricks are tested.
+        for (int BrickZ = Broad.Minimum[2] / BrickSize; BrickZ <= (Broad.Maximum[2] - 1) / BrickSize; ++BrickZ) {
+            for (int BrickY = Broad.Minimum[1] / BrickSize; BrickY <= (Broad.Maximum[1] - 1) / BrickSize; ++BrickY) {
+                for (int BrickX = Broad.Minimum[0] / BrickSize; BrickX <= (Broad.Maximum[0] - 1) / BrickSize; ++BrickX) {
+                    if (!this->Bricks[BrickX + this->BrickCount[0] * (BrickY + this->BrickCount[1] * BrickZ)]) {
+                        continue;
+                    }
+                    const Region Brick = Region({{BrickX * BrickSize, BrickY * BrickSize, BrickZ * BrickSize}}, {{(BrickX + 1) * BrickSize, (BrickY + 1) * BrickSize, (BrickZ + 1) * BrickSize}}).Intersection(Broad);
+                    for (int IndexZ = Brick.Minimum[2]; IndexZ < Brick.Maximum[2]; ++IndexZ) {
+                        for (int IndexY = Brick.Minimum[1]; IndexY < Brick.Maximum[1]; ++IndexY) {
+                            if (!this->IsRowOccupied(IndexY, IndexZ, Brick.Minimum[0], Brick.Maximum[0])) {
+                                continue;
+                            }
+                            for (int IndexX = Brick.Minimum[0]; IndexX < Brick.Maximum[0]; ++IndexX) {
+                                const std::size_t Bit = IndexX + this->Size[0] * (IndexY + this->Size[1] * IndexZ);
+                                if ((this->Occupancy[Bit / 64] >> (Bit % 64)) & 1) {
+                                    TestVoxel(IndexX, IndexY, IndexZ);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return Result;
+    }
+
+    // Test a batch of voxels.
+    void CollisionMap::IsOccupied(const std::vector<std::array<int, 3> >& Queries, std::vector<std::uint8_t>& Results) const {
+        Results.resize(Queries.size());
+        JobSystem::GetGlobal().ParallelFor(0, Queries.size(), QueryGrain, [this, &Queries, &Results](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Index = First; Index < Last; ++Index) {
+                Results[Index] = this->IsOccupied(Queries[Index][0], Queries[Index][1], Queries[Index][2]) ? 1 : 0;
+            }
+        });
+    }
+
+    // Cast a batch of rays.
+    void CollisionMap::CastRay(const std::vector<RayQuery>& Queries, std::vector<RayHit>& Results) const {
+        RAYMARCH_TRACE_SCOPE("CollisionMap::CastRay");
+
+        Results.resize(Queries.size());
+        JobSystem::GetGlobal().ParallelFor(0, Queries.size(), QueryGrain, [this, &Queries, &Results](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Index = First; Index < Last; ++Index) {
+                Results[Index] = this->CastRay(Queries[Index]);
+            }
+        });
+    }
+
+    // Sweep a batch of boxes.
+    void CollisionMap::Sweep(const std::vector<SweepQuery>& Queries, std::vector<SweepResult>& Results) const {
+        RAYMARCH_TRACE_SCOPE("CollisionMap::Sweep");
+
+        Results.resize(Queries.size());
+        JobSystem::GetGlobal().ParallelFor(0, Queries.size(), QueryGrain, [this, &Queries, &Results](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Index = First; Index < Last; ++Index) {
+                Results[Index] = this->Sweep(Queries[Index]);
+            }
+        });
+    }
+
+    // Test the bits of a row, masking the partial words at either end.
+    bool CollisionMap::IsRowOccupied(int Y, int Z, int FirstX, int LastX) const {
+        const std::size_t RowStart = this->Size[0] * (Y + this->Size[1] * Z);
+        std::size_t First = RowStart + FirstX;
+        const std::size_t Last = RowStart + LastX;
+        while (First < Last) {
+            const std::size_t Bit = First % 64;
+            const std::size_t Count = std::min<std::size_t>(64 - Bit, Last - First);
+            const std::uint64_t Mask = (Count == 64) ? ~std::uint64_t(0) : (((std::uint64_t(1) << Count) - 1) << Bit);
+            if (this->Occupancy[First / 64] & Mask) {
+                return true;
+            }
+            First += Count;
+        }
+        return false;
+    }
+
+    // Set the bricks overlapping a region.
+    void CollisionMap::UpdateBricks(const Region& Target) {
+        if (Target.IsEmpty()) {
+            return;
+        }
+        const Region Bounds = Region({{0, 0, 0}}, {{static_cast<int>(this->Size[0]), static_cast<int>(this->Size[1]), static_cast<int>(this->Size[2])}});
+        for (int BrickZ = Target.Minimum[2] / BrickSize; BrickZ <= (Target.Maximum[2] - 1) / BrickSize; ++BrickZ) {
+            for (int BrickY = Target.Minimum[1] / BrickSize; BrickY <= (Target.Maximum[1] - 1) / BrickSize; ++BrickY) {
+                for (int BrickX = Target.Minimum[0] / BrickSize; BrickX <= (Target.Maximum[0] - 1) / BrickSize; ++BrickX) {
+                    const Region Brick = Region({{BrickX * BrickSize, BrickY * BrickSize, BrickZ * BrickSize}}, {{(BrickX + 1) * BrickSize, (BrickY + 1) * BrickSize, (BrickZ + 1) * BrickSize}}).Intersection(Bounds);
+                    bool Occupied = false;
+                    for (int IndexZ = Brick.Minimum[2]; (IndexZ < Brick.Maximum[2]) && !Occupied; ++IndexZ) {
+                        for (int IndexY = Brick.Minimum[1]; (IndexY < Brick.Maximum[1]) && !Occupied; ++IndexY) {
+                            Occupied = this->IsRowOccupied(IndexY, IndexZ, Brick.Minimum[0], Brick.Maximum[0]);
+                        }
+                    }
+                    this->Bricks[BrickX + this->BrickCount[0] * (BrickY + this->BrickCount[1] * BrickZ)] = Occupied ? 1 : 0;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,187 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_COLLISIONMAP_HPP
+#define RAYMARCH_COLLISIONMAP_HPP
+
+#include "Region.hpp"
+#include "Volume.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  CollisionMap answers occupancy, ray and swept box queries against the non-empty voxels of a volume.
+    /// @note   Occupancy is one bit per voxel, as the renderer treats any voxel with alpha as hit, with a coarse level of one byte per brick
+    ///         so that empty bricks are skipped without touching their bits. Everything outside the volume is empty.
+    class CollisionMap {
+    public:
+        /// @brief  The edge length of the cubic bricks of the coarse level.
+        constexpr static const int BrickSize = 4;
+
+        /// @brief  The maximum number of voxels a ray visits, matching the voxel shader.
+        constexpr static const int MaximumRaySteps = 2048;
+
+        /// @brief  The distance a box may overlap a voxel and still slide along it rather than being stuck inside it.
+        constexpr static const float Skin = 0.0001f;
+
+        /// @brief  A ray to cast.
+        struct RayQuery {
+            /// @brief  The start of the ray.
+            std::array<float, 3> Origin;
+
+            /// @brief  The direction of the ray, it does not need to be normalised.
+            std::array<float, 3> Direction;
+        };
+
+        /// @brief  The first voxel hit by a ray.
+        struct RayHit {
+            /// @brief  Set when the ray hit a voxel.
+            bool Hit;
+
+            /// @brief  The coordinate of the hit voxel.
+            std::array<int, 3> Voxel;
+
+            /// @brief  The normal of the hit face.
+            std::array<int, 3> Normal;
+
+            /// @brief  The distance along the normalised direction from the origin to the hit.
+            float Distance;
+
+            /// @brief  The position of the hit.
+            std::array<float, 3> Position;
+
+            /// @brief  The number of voxels visited before the ray hit or left the volume, as the voxel shader iterates.
+            int Steps;
+        };
+
+        /// @brief  A box to move.
+        struct SweepQuery {
+            /// @brief  The minimum corner of the box.
+            std::array<float, 3> Minimum;
+
+            /// @brief  The maximum corner of the box.
+            std::array<float, 3> Maximum;
+
+            /// @brief  The motion of the box.
+            std::array<float, 3> Motion;
+        };
+
+        /// @brief  The first contact of a moving box.
+        struct SweepResult {
+            /// @brief  The fraction of the motion before contact, one when the box moves freely.
+            float Time;
+
+            /// @brief  The normal of the contact face, zero when the box moves freely.
+            std::array<int, 3> Normal;
+        };
+
+    private:
+        /// @brief  The size of the mapped volume.
+        std::array<std::size_t, 3> Size;
+
+        /// @brief  The number of bricks along each axis.
+        std::array<std::size_t, 3> BrickCount;
+
+        /// @brief  One bit per voxel in volume order, set when the voxel is not empty.
+        std::vector<std::uint64_t> Occupancy;
+
+        /// @brief  One byte per brick, set when any voxel of the brick is not empty.
+        std::vector<std::uint8_t> Bricks;
+
+    public:
+        /// @brief  Constructor that creates an empty map.
+        CollisionMap(void);
+
+    public:
+        /// @brief  Get the size of the mapped volume.
+        /// @return The size of the mapped volume.
+        const std::array<std::size_t, 3>& GetSize(void) const;
+
+        /// @brief  Map every voxel of a volume.
+        /// @param  Scene - The volume to map, its size may differ from the last call.
+        void Rebuild(const Volume& Scene);
+
+        /// @brief  Map the voxels of a changed region again.
+        /// @param  Scene - The volume to map, it must be the volume given to the last call of Rebuild.
+        /// @param  Changed - The region of voxels that changed.
+        void Update(const Volume& Scene, const Region& Changed);
+
+    public:
+        /// @brief  Test if a voxel is occupied.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return True if the voxel is inside the volume and not empty.
+        bool IsOccupied(int X, int Y, int Z) const;
+
+        /// @brief  Test if any voxel within a region is occupied.
+        /// @param  Target - The region to test.
+        /// @return True if any voxel of the region is inside the volume and not empty.
+        bool IsOccupied(const Region& Target) const;
+
+        /// @brief  Find the first voxel hit by a ray, stepping through the voxels exactly as the voxel shader does.
+        /// @param  Query - The ray to cast.
+        /// @return The hit.
+        RayHit CastRay(const RayQuery& Query) const;
+
+        /// @brief  Find the first contact of a box moving through the voxels.
+        /// @param  Query - The box and its motion.
+        /// @return The contact, voxels the box already overlaps by more than the skin are ignored so it can move out of them.
+        SweepResult Sweep(const SweepQuery& Query) const;
+
+    public:
+        /// @brief  Test a batch of voxels for occupancy in parallel.
+        /// @param  Queries - The voxel coordinates.
+        /// @param  Results - Receives one value per query, one when the voxel is occupied.
+        void IsOccupied(const std::vector<std::array<int, 3> >& Queries, std::vector<std::uint8_t>& Results) const;
+
+        /// @brief  Cast a batch of rays in parallel.
+        /// @param  Queries - The rays.
+        /// @param  Results - Receives one hit per ray.
+        void CastRay(const std::vector<RayQuery>& Queries, std::vector<RayHit>& Results) const;
+
+        /// @brief  Sweep a batch of boxes in parallel.
+        /// @param  Queries - The boxes and their motions.
+        /// @param  Results - Receives one contact per box.
+        void Sweep(const std::vector<SweepQuery>& Queries, std::vector<SweepResult>& Results) const;
+
+    private:
+        /// @brief  Test the bits of a row of voxels, a word at a time.
+        /// @param  Y - The Y coordinate of the row.
+        /// @param  Z - The Z coordinate of the row.
+        /// @param  FirstX - The first X coordinate to test.
+        /// @param  LastX - One past the last X coordinate to test.
+        /// @return True if any voxel of the row is occupied.
+        bool IsRowOccupied(int Y, int Z, int FirstX, int LastX) const;
+
+        /// @brief  Set the coarse level of the bricks overlapping a region from the voxel bits.
+        /// @param  Target - The region whose bricks are set.
+        void UpdateBricks(const Region& Target);
+    };
+}
+
+#endif // RAYMARCH_COLLISIONMAP_HPP
@@ -23,11 +23,19 @@ THE SOFTWARE
 */
 
 #include "GameState.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+#include "WorldFile.hpp"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <utility>
 
 namespace Raymarch {
+    // The file the save and load keys use.
+    static const char* const QuickSavePath = "World.rmw";
+
     // Constructor that initialises all member variables with workable defaults.
     GameState::GameState(const std::array<std::size_t, 3>& SceneSize) {
         // Offset of the visible scene in the map.
@@ -39,6 +47,10 @@ namespace Raymarch {
         // Floating point speed.
         this->SceneVelocity = {{0, 0, 0}};
 
+        // The player body stands on the grass below the camera target.
+        this->PlayerMinimum = {{static_cast<float>(SceneSize[0]) / 2.0f - 1.0f, 4.0f, static_cast<float>(SceneSize[2]) / 2.0f - 1.0f}};
+        this->PlayerMaximum = {{static_cast<float>(SceneSize[0]) / 2.0f + 1.0f, 8.0f, static_cast<float>(SceneSize[2]) / 2.0f + 1.0f}};
+
         // Position of the sun / global light source.
         this->LightPosition  = {{0, 1024, 0}};
 
@@ -62,6 +74,13 @@ namespace Raymarch {
 
         // The rendered scene volume, the map is unioned into this before rendering.
         this->Scene = Volume(SceneSize);
+
+        // Nothing has been built or composed yet.
+        this->MapChanged = true;
+        this->SceneStale = true;
+        this->ComposedOffset = this->SceneOffset;
+        this->SceneVersion = 0;
+        this->SceneBaseVersion = 0;
     }
 
     // Get the scene offset, the renderer shader applies noise based on position.
@@ -109,14 +128,86 @@ namespace Raymarch {
         return this->Scene;
     }
 
+    // Get the scene version, the renderer only uploads the scene when this changes.
+    std::uint64_t GameState::GetSceneVersion(void) const {
+        return this->SceneVersion;
+    }
+
+    // Get the packed scene, the renderer uploads this rather than the full scene.
+    const PaletteVolume& GameState::GetPackedScene(void) const {
+        return this->PackedScene;
+    }
+
+    // Get the base scene version, the renderer only uploads the dirty region if it has this version.
+    std::uint64_t GameState::GetSceneBaseVersion(void) const {
+        return this->SceneBaseVersion;
+    }
+
+    // Get the dirty region of the scene.
+    const Region& GameState::GetSceneDirtyRegion(void) const {
+        return this->SceneDirtyRegion;
+    }
+
+    // Get the ambient occlusion, the renderer shader shades faces with this.
+    const AmbientOcclusion& GameState::GetAmbientOcclusion(void) const {
+        return this->Occlusion;
+    }
+
+    // Get the shadow map, the renderer shader shadows the global light with this.
+    const ShadowMap& GameState::GetShadowMap(void) const {
+        return this->Shadows;
+    }
+
+    // Get the cascades, the renderer shader continues rays beyond the scene through these.
+    const Clipmap& GameState::GetCascades(void) const {
+        return this->Cascades;
+    }
+
+    // Get the world, it holds every voxel of the map including the changes made by the simulation.
+    const World& GameState::GetWorld(void) const {
+        return this->WorldVoxels;
+    }
+
+    // Get the collision map.
+    const CollisionMap& GameState::GetCollisionMap(void) const {
+        return this->Collision;
+    }
+
+    // Get the simulation.
+    Simulation& GameState::GetSimulation(void) {
+        return this->Simulator;
+    }
+
+    // Set the terrain.
+    void GameState::SetTerrain(std::uint32_t Seed, std::size_t CacheBudget, std::size_t CompressedBudget, std::size_t ResidentBudget) {
+        this->Streamer.reset(new ChunkStreamer(Seed, CacheBudget, CompressedBudget, ResidentBudget));
+        this->MapChanged = true;
+    }
+
+    // Get the terrain streamer.
+    const ChunkStreamer* GameState::GetStreamer(void) const {
+        return this->Streamer.get();
+    }
+
+    // Set the number of cascades.
+    void GameState::SetCascadeCount(std::size_t LevelCount) {
+        this->Cascades.Resize(this->Scene.GetSize(), LevelCount);
+        if (this->Cascades.GetLevelCount() > 0) {
+            const std::size_t Outermost = this->Cascades.GetLevelCount() - 1;
+            this->FogDistance = std::max(this->FogDistance, 0.5f * static_cast<float>(this->Scene.GetSizeX() * this->Cascades.GetCellSize(Outermost)));
+        }
+    }
+
     // Clear all models from the map.
     void GameState::ClearMap(void) {
         this->Map.clear();
+        this->MapChanged = true;
     }
 
     // Set a map.
     void GameState::SetMap(const std::vector<std::pair<std::array<int, 3>, Volume> >& Map) {
         this->Map = Map;
+        this->MapChanged = true;
     }
 
     // Get the map.
@@ -127,6 +218,222 @@ namespace Raymarch {
     // Add a model to the map at a position.
     void GameState::AddToMap(const std::array<int, 3>& Position, const Volume& Model) {
         this->Map.push_back(std::make_pair(Position, Model));
+
+        // Once the world is built models are written straight into it, only the region they cover is composed again.
+        if (!this->MapChanged) {
+            const Region Changed = this->WorldVoxels.Insert(Position, Model);
+            this->Simulator.Activate(Changed);
+            this->WorldChanges.push_back(Changed);
+        }
+    }
+
+    // Test voxels in world coordinates.
+    void GameState::QueryOccupancy(const std::vector<std::array<int, 3> >& Positions, std::vector<std::uint8_t>& Results) const {
+        std::vector<std::array<int, 3> > ScenePositions(Positions);
+        for (std::array<int, 3>& Position : ScenePositions) {
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                Position[Index] -= this->ComposedOffset[Index];
+            }
+        }
+        this->Collision.IsOccupied(ScenePositions, Results);
+    }
+
+    // Cast rays in world coordinates.
+    void GameState::CastRays(const std::vector<CollisionMap::RayQuery>& Rays, std::vector<CollisionMap::RayHit>& Hits) const {
+        std::vector<CollisionMap::RayQuery> SceneRays(Rays);
+        for (CollisionMap::RayQuery& Ray : SceneRays) {
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                Ray.Origin[Index] -= static_cast<float>(this->ComposedOffset[Index]);
+            }
+        }
+        this->Collision.CastRay(SceneRays, Hits);
+        for (CollisionMap::RayHit& Hit : Hits) {
+            if (!Hit.Hit) {
+                continue;
+            }
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                Hit.Voxel[Index] += this->ComposedOffset[Index];
+                Hit.Position[Index] += static_cast<float>(this->ComposedOffset[Index]);
+            }
+        }
+    }
+
+    // Sweep boxes in world coordinates.
+    void GameState::SweepBoxes(const std::vector<CollisionMap::SweepQuery>& Boxes, std::vector<CollisionMap::SweepResult>& Contacts) const {
+        std::vector<CollisionMap::SweepQuery> SceneBoxes(Boxes);
+        for (CollisionMap::SweepQuery& Box : SceneBoxes) {
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                Box.Minimum[Index] -= static_cast<float>(this->ComposedOffset[Index]);
+                Box.Maximum[Index] -= static_cast<float>(this->ComposedOffset[Index]);
+            }
+        }
+        this->Collision.Sweep(SceneBoxes, Contacts);
+    }
+
+    // Get a screen ray in world coordinates.
+    CollisionMap::RayQuery GameState::GetScreenRay(const std::array<float, 2>& ScreenPosition, const std::array<float, 2>& ScreenResolution) const {
+        CollisionMap::RayQuery Ray;
+        this->GetSceneRay(ScreenPosition, ScreenResolution, Ray);
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            Ray.Origin[Index] += static_cast<float>(this->ComposedOffset[Index]);
+        }
+        return Ray;
+    }
+
+    // Pick the voxels under points of the screen, the rays are cast in scene coordinates exactly as the shader casts them.
+    void GameState::Pick(const std::vector<std::array<float, 2> >& ScreenPositions, const std::array<float, 2>& ScreenResolution, std::vector<CollisionMap::RayHit>& Hits) const {
+        RAYMARCH_TRACE_SCOPE("GameState::Pick");
+
+        // Points outside the rendered region get a zero direction, which never hits.
+        std::vector<CollisionMap::RayQuery> Rays(ScreenPositions.size());
+        for (std::size_t Index = 0; Index < ScreenPositions.size(); ++Index) {
+            if (!this->GetSceneRay(ScreenPositions[Index], ScreenResolution, Rays[Index])) {
+                Rays[Index].Direction = {{0.0f, 0.0f, 0.0f}};
+            }
+        }
+        this->Collision.CastRay(Rays, Hits);
+        for (CollisionMap::RayHit& Hit : Hits) {
+            if (!Hit.Hit) {
+                continue;
+            }
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                Hit.Voxel[Index] += this->ComposedOffset[Index];
+                Hit.Position[Index] += static_cast<float>(this->ComposedOffset[Index]);
+            }
+        }
+    }
+
+    // Build a screen ray with the camera math of the voxel shader.
+    bool GameState::GetSceneRay(const std::array<float, 2>& ScreenPosition, const std::array<float, 2>& ScreenResolution, CollisionMap::RayQuery& Ray) const {
+        auto Normalise = [](const std::array<float, 3>& Vector) -> std::array<float, 3> {
+            const float Length = std::sqrt(Vector[0] * Vector[0] + Vector[1] * Vector[1] + Vector[2] * Vector[2]);
+            return {{Vector[0] / Length, Vector[1] / Length, Vector[2] / Length}};
+        };
+        auto Cross = [](const std::array<float, 3>& Left, const std::array<float, 3>& Right) -> std::array<float, 3> {
+            return {{Left[1] * Right[2] - Left[2] * Right[1], Left[2] * Right[0] - Left[0] * Right[2], Left[0] * Right[1] - Left[1] * Right[0]}};
+        };
+
+        // Calculate direction vectors from camera and target.
+        const std::array<float, 3> ForwardVector = Normalise({{this->CameraTarget[0] - this->CameraPosition[0], this->CameraTarget[1] - this->CameraPosition[1], this->CameraTarget[2] - this->CameraPosition[2]}});
+        const std::array<float, 3> RightVector = Normalise(Cross({{0.0f, 1.0f, 0.0f}}, ForwardVector));
+        const std::array<float, 3> UpVector = Normalise(Cross(ForwardVector, RightVector));
+
+        // Calculate the position on the viewport.
+        const std::array<float, 2> ViewportPosition = {{ScreenPosition[0] / ScreenResolution[0], ScreenPosition[1] / ScreenResolution[1]}};
+
+        // Viewport size.
+        const float ViewportWidth = 2.0f * this->NearClip * std::tan(this->FieldOfView * 0.5f * static_cast<float>(M_PI) / 180.0f);
+        const std::array<float, 2> ViewportSize = {{ViewportWidth, ViewportWidth * ScreenResolution[1] / ScreenResolution[0]}};
+
+        // The point on the viewport, from the lower left point of the viewport, and the direction from the camera through it.
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            const float ViewportOrigin = (this->CameraPosition[Index] + (ForwardVector[Index] * this->NearClip)) - (0.5f * ViewportSize[0] * RightVector[Index]) - (0.5f * ViewportSize[1] * UpVector[Index]);
+            Ray.Origin[Index] = ViewportOrigin + (ViewportPosition[0] * ViewportSize[0] * RightVector[Index]) + (ViewportPosition[1] * ViewportSize[1] * UpVector[Index]);
+            Ray.Direction[Index] = Ray.Origin[Index] - this->CameraPosition[Index];
+        }
+
+        // The shader renders fog outside the rendered region.
+        return (ViewportPosition[0] <= 1.0f) && (ViewportPosition[1] <= 1.0f);
+    }
+
+    // Edit the world with a brush.
+    Region GameState::Edit(const Brush& Stroke) {
+        RAYMARCH_TRACE_SCOPE("GameState::Edit");
+
+        // Edits are made to the built world, so a replaced map is built first rather than discarding the edit later.
+        if (this->MapChanged) {
+            this->BuildWorld();
+        }
+
+        const Region Changed = Stroke.Apply(this->WorldVoxels);
+        if (!Changed.IsEmpty()) {
+            this->Simulator.Activate(Changed);
+            this->WorldChanges.push_back(Changed);
+        }
+        return Changed;
+    }
+
+    // Flood fill the world from a seed.
+    Region GameState::FloodFill(const std::array<int, 3>& Seed, const Voxel& Replacement, int Radius) {
+        RAYMARCH_TRACE_SCOPE("GameState::FloodFill");
+
+        if (this->MapChanged) {
+            this->BuildWorld();
+        }
+
+        const Region Limit = Region({{Seed[0] - Radius, Seed[1] - Radius, Seed[2] - Radius}}, {{Seed[0] + Radius + 1, Seed[1] + Radius + 1, Seed[2] + Radius + 1}});
+        const Region Changed = Brush::FloodFill(this->WorldVoxels, Seed, Replacement, Limit);
+        if (!Changed.IsEmpty()) {
+            this->Simulator.Activate(Changed);
+            this->WorldChanges.push_back(Changed);
+        }
+        return Changed;
+    }
+
+    // Save the world in the background.
+    bool GameState::SaveWorld(const std::string& Path) {
+        RAYMARCH_TRACE_SCOPE("GameState::SaveWorld");
+
+        if (this->IsSaving()) {
+            return false;
+        }
+        if (this->PendingSave.valid()) {
+            this->PendingSave.get();
+        }
+        if (this->MapChanged) {
+            this->BuildWorld();
+        }
+
+        // The snapshot is the only work on the calling thread, the world can change as soon as it is taken.
+        std::vector<std::pair<std::array<int, 3>, Volume> > Snapshot;
+        const std::vector<std::array<int, 3> > Keys = this->WorldVoxels.GetChunkKeys();
+        Snapshot.reserve(Keys.size());
+        for (const std::array<int, 3>& Key : Keys) {
+            Snapshot.push_back(std::make_pair(Key, *this->WorldVoxels.FindChunk(Key)));
+        }
+        this->PendingSave = std::async(std::launch::async, [Path](std::vector<std::pair<std::array<int, 3>, Volume> > Chunks) -> bool {
+            return WorldFile::Save(Path, Chunks);
+        }, std::move(Snapshot));
+        return true;
+    }
+
+    // Check for a running save.
+    bool GameState::IsSaving(void) const {
+        return this->PendingSave.valid() && (this->PendingSave.wait_for(std::chrono::seconds(0)) != std::future_status::ready);
+    }
+
+    // Wait for the running save.
+    bool GameState::WaitForSave(void) {
+        return this->PendingSave.valid() ? this->PendingSave.get() : true;
+    }
+
+    // Load the world from a file.
+    bool GameState::LoadWorld(const std::string& Path) {
+        RAYMARCH_TRACE_SCOPE("GameState::LoadWorld");
+
+        WorldFile File;
+        World Loaded;
+        if (!File.Open(Path) || !File.Load(Loaded)) {
+            return false;
+        }
+
+        // The loaded chunks replace the world, they are simulated until they settle and the terrain never refills them.
+        this->WorldVoxels = std::move(Loaded);
+        this->WorldChanges.clear();
+        this->MapChanged = false;
+        this->SceneStale = true;
+        this->Simulator.Clear();
+        this->Cascades.Clear();
+        if (this->Streamer) {
+            this->Streamer->Clear();
+        }
+        for (const WorldFile::IndexEntry& Entry : File.GetIndex()) {
+            this->Simulator.Activate(World::GetChunkRegion(Entry.Key));
+            if (this->Streamer) {
+                this->Streamer->NotifyLoaded(Entry.Key);
+            }
+        }
+        return true;
     }
 
     // Apply a key press to the game state.
@@ -148,14 +455,74 @@ namespace Raymarch {
                 if      (State == KeyStateType::Press)   this->SceneVelocity[0] = -10.0;
                 else if (State == KeyStateType::Release) this->SceneVelocity[0] =  +0.0;
             } break;
+            case KeyType::Save: {
+                if (State == KeyStateType::Press) this->SaveWorld(QuickSavePath);
+            } break;
+            case KeyType::Load: {
+                if (State == KeyStateType::Press) this->LoadWorld(QuickSavePath);
+            } break;
+        }
+    }
+
+    // Apply a mouse click to the game state.
+    void GameState::Input(ButtonType Button, const std::array<float, 2>& ScreenPosition, const std::array<float, 2>& ScreenResolution) {
+        std::vector<CollisionMap::RayHit> Hits;
+        this->Pick({ScreenPosition}, ScreenResolution, Hits);
+        if (Hits.empty() || !Hits[0].Hit) {
+            return;
+        }
+        const CollisionMap::RayHit& Hit = Hits[0];
+
+        constexpr static const float Radius = 2.5f;
+        switch (Button) {
+            case ButtonType::Primary: {
+                // Build onto the clicked face with the material of the clicked voxel.
+                const std::array<float, 3> Centre = {{
+                    static_cast<float>(Hit.Voxel[0] + Hit.Normal[0]) + 0.5f,
+                    static_cast<float>(Hit.Voxel[1] + Hit.Normal[1]) + 0.5f,
+                    static_cast<float>(Hit.Voxel[2] + Hit.Normal[2]) + 0.5f
+                }};
+                this->Edit(Brush(Brush::ShapeType::Sphere, Brush::OperationType::Add, Centre, {{Radius, Radius, Radius}}, this->WorldVoxels.Get(Hit.Voxel[0], Hit.Voxel[1], Hit.Voxel[2])));
+            } break;
+            case ButtonType::Secondary: {
+                // Dig away around the clicked voxel.
+                const std::array<float, 3> Centre = {{
+                    static_cast<float>(Hit.Voxel[0]) + 0.5f,
+                    static_cast<float>(Hit.Voxel[1]) + 0.5f,
+                    static_cast<float>(Hit.Voxel[2]) + 0.5f
+                }};
+                this->Edit(Brush(Brush::ShapeType::Sphere, Brush::OperationType::Subtract, Centre, {{Radius, Radius, Radius}}));
+            } break;
         }
     }
 
     // Update the game state after a time.
     void GameState::Update(float DeltaTime) {
-        // Move player.
+        RAYMARCH_TRACE_SCOPE("GameState::Update");
+
+        // Changes made by this update are relative to the current scene.
+        this->SceneBaseVersion = this->SceneVersion;
+        this->SceneDirtyRegion = Region();
+
+        // Move player, sliding along the voxels of the composed scene that block the body.
+        CollisionMap::SweepQuery Body;
         for (std::size_t Index = 0; Index < 3; ++Index) {
-            this->ScenePosition[Index] += this->SceneVelocity[Index] * DeltaTime;
+            Body.Minimum[Index] = this->ScenePosition[Index] - static_cast<float>(this->ComposedOffset[Index]) + this->PlayerMinimum[Index];
+            Body.Maximum[Index] = this->ScenePosition[Index] - static_cast<float>(this->ComposedOffset[Index]) + this->PlayerMaximum[Index];
+            Body.Motion[Index] = this->SceneVelocity[Index] * DeltaTime;
+        }
+        for (std::size_t Slide = 0; Slide < 3; ++Slide) {
+            const CollisionMap::SweepResult Contact = this->Collision.Sweep(Body);
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                const float Step = Body.Motion[Index] * Contact.Time;
+                this->ScenePosition[Index] += Step;
+                Body.Minimum[Index] += Step;
+                Body.Maximum[Index] += Step;
+                Body.Motion[Index] = (Contact.Normal[Index] != 0) ? 0.0f : (Body.Motion[Index] - Step);
+            }
+            if (Contact.Time >= 1.0f) {
+                break;
+            }
         }
 
         // Update scene offset from position.
@@ -178,14 +545,178 @@ namespace Raymarch {
             this->FogColour[Index] = NewFogColour;
         }
 
-        // Clear current scene.
-        this->Scene.Clear();
+        // Build the world when the map has been replaced.
+        if (this->MapChanged) {
+            this->BuildWorld();
+        }
+
+        // Step the liquid, heat and fire simulation within its budget.
+        for (const Region& Changed : this->Simulator.Update(this->WorldVoxels, DeltaTime)) {
+            this->WorldChanges.push_back(Changed);
+        }
+
+        // Pull in the terrain that has been generated around the scene and ahead of the player, only unchanged terrain can be evicted.
+        if (this->Streamer) {
+            for (const Region& Changed : this->WorldChanges) {
+                this->Streamer->NotifyChanged(Changed);
+            }
+            const bool Recompose = this->SceneStale || (this->ComposedOffset != this->SceneOffset);
+            for (const Region& Merged : this->Streamer->Update(this->WorldVoxels, this->SceneOffset, this->Scene.GetSize(), this->SceneVelocity, DeltaTime, Recompose)) {
+                this->WorldChanges.push_back(Merged);
+            }
+        }
+
+        // The cascades downsample the world, so they see every change before composing consumes them.
+        for (const Region& Changed : this->WorldChanges) {
+            this->Cascades.NotifyChanged(Changed);
+        }
+
+        // The whole scene only needs composing and relighting when the map or the offset changes, otherwise only the changes of the world do.
+        if (this->SceneStale || (this->ComposedOffset != this->SceneOffset)) {
+            this->Compose();
+        }
+        else if (!this->WorldChanges.empty()) {
+            this->ComposeChanges();
+        }
+
+        // Sweep the shadows for the direction from the centre of the scene to the light.
+        const std::array<float, 3> LightDirection = {{
+            this->LightPosition[0] - static_cast<float>(this->Scene.GetSizeX()) / 2.0f,
+            this->LightPosition[1] - static_cast<float>(this->Scene.GetSizeY()) / 2.0f,
+            this->LightPosition[2] - static_cast<float>(this->Scene.GetSizeZ()) / 2.0f
+        }};
+        this->Shadows.Update(LightDirection);
+
+        // Move the cascades with the scene and apply the changes to one of them.
+        this->Cascades.Update(this->WorldVoxels, this->SceneOffset, this->Scene.GetSize());
+    }
 
-        // Add model data to the scene.
+    // Build the world from the map.
+    void GameState::BuildWorld(void) {
+        RAYMARCH_TRACE_SCOPE("GameState::BuildWorld");
+
+        // Models are written in map order so overlaps resolve as before, and everything they cover is simulated until it settles.
+        this->MapChanged = false;
+        this->SceneStale = true;
+        this->WorldVoxels.Clear();
+        this->Simulator.Clear();
+        this->Cascades.Clear();
+        if (this->Streamer) {
+            this->Streamer->Clear();
+        }
         for (const std::pair<std::array<int, 3>, Volume>& PositionModelPair : this->Map) {
-            const std::array<int, 3>& Position = PositionModelPair.first;
-            const Volume& Model = PositionModelPair.second;
-            this->Scene.Insert(Position[0] - this->SceneOffset[0], Position[1] - this->SceneOffset[1], Position[2] - this->SceneOffset[2], Model);
+            this->Simulator.Activate(this->WorldVoxels.Insert(PositionModelPair.first, PositionModelPair.second));
+        }
+    }
+
+    // Compose the world into the scene.
+    void GameState::Compose(void) {
+        RAYMARCH_TRACE_SCOPE("GameState::Compose");
+
+        this->SceneStale = false;
+        this->ComposedOffset = this->SceneOffset;
+        this->WorldChanges.clear();
+        ++this->SceneVersion;
+        this->SceneDirtyRegion = this->Scene.GetRegion();
+
+        // Compose the scene in parallel slabs along Z, each slab is extracted from the chunks of the world it overlaps.
+        constexpr static const int SlabDepth = 8;
+        const int SceneDepth = static_cast<int>(this->Scene.GetSizeZ());
+        const std::size_t SlabCount = static_cast<std::size_t>((SceneDepth + SlabDepth - 1) / SlabDepth);
+        JobSystem::GetGlobal().ParallelFor(0, SlabCount, 1, [this, SceneDepth](std::size_t FirstSlab, std::size_t LastSlab) -> void {
+            for (std::size_t SlabIndex = FirstSlab; SlabIndex < LastSlab; ++SlabIndex) {
+                // The disjoint region of the scene owned by this slab.
+                Region Slab = this->Scene.GetRegion();
+                Slab.Minimum[2] = static_cast<int>(SlabIndex) * SlabDepth;
+                Slab.Maximum[2] = std::min(SceneDepth, Slab.Minimum[2] + SlabDepth);
+
+                RAYMARCH_TRACE_SCOPE("GameState::Compose::Extract");
+                this->WorldVoxels.Extract(this->SceneOffset, this->Scene, Slab);
+            }
+        });
+
+        // Flood fill the light of the emissive voxels.
+        this->Lighting.Relight(this->Scene);
+
+        // Find the column tops that cast shadows.
+        this->Shadows.Rebuild(this->Scene);
+
+        // Bake the ambient occlusion of every face.
+        this->Occlusion.Rebuild(this->Scene);
+
+        // Map the occupied voxels for collision.
+        this->Collision.Rebuild(this->Scene);
+
+        // Encode the scene for upload.
+        this->PackedScene.Encode(this->Scene);
+    }
+
+    // Compose only the changed regions of the world.
+    void GameState::ComposeChanges(void) {
+        RAYMARCH_TRACE_SCOPE("GameState::ComposeChanges");
+
+        // Extract each change that is visible and update the caches that depend on its voxels.
+        const std::array<int, 3> WorldToScene = {{-this->SceneOffset[0], -this->SceneOffset[1], -this->SceneOffset[2]}};
+        Region Dirty;
+        for (const Region& Changed : this->WorldChanges) {
+            const Region Target = Changed.Translate(WorldToScene).Intersection(this->Scene.GetRegion());
+            if (Target.IsEmpty()) {
+                continue;
+            }
+            this->WorldVoxels.Extract(this->SceneOffset, this->Scene, Target);
+            this->Lighting.NotifyChanged(Target);
+            this->Shadows.NotifyChanged(this->Scene, Target);
+            this->Collision.Update(this->Scene, Target);
+            Dirty = Dirty.Union(this->Occlusion.Update(this->Scene, Target));
         }
+        this->WorldChanges.clear();
+        if (Dirty.IsEmpty()) {
+            return;
+        }
+
+        // Relight around the changes, and encode everything that changed for upload.
+        Dirty = Dirty.Union(this->Lighting.Propagate(this->Scene));
+        if (this->PackedScene.Update(this->Scene, Dirty)) {
+            Dirty = this->Scene.GetRegion();
+        }
+        ++this->SceneVersion;
+        this->SceneDirtyRegion = this->SceneDirtyRegion.Union(Dirty);
+    }
+
+    // Publish everything the renderer reads to another state.
+    void GameState::PublishTo(GameState& Target) {
+        Target.SceneOffset = this->SceneOffset;
+        Target.ScenePosition = this->ScenePosition;
+        Target.SceneVelocity = this->SceneVelocity;
+        Target.LightPosition = this->LightPosition;
+        Target.CameraPosition = this->CameraPosition;
+        Target.CameraTarget = this->CameraTarget;
+        Target.NearClip = this->NearClip;
+        Target.FieldOfView = this->FieldOfView;
+        Target.FogDistance = this->FogDistance;
+        Target.FogColour = this->FogColour;
+
+        // The packed scene is only copied when it has changed since it was last published, and only the dirty region when the target has the base version.
+        if (Target.SceneVersion != this->SceneVersion) {
+            if (Target.SceneVersion == this->SceneBaseVersion) {
+                Target.PackedScene.Copy(this->PackedScene, this->SceneDirtyRegion);
+                Target.Occlusion.Copy(this->Occlusion, this->SceneDirtyRegion);
+            }
+            else {
+                Target.PackedScene = this->PackedScene;
+                Target.Occlusion = this->Occlusion;
+            }
+            Target.SceneVersion = this->SceneVersion;
+        }
+        Target.SceneBaseVersion = this->SceneBaseVersion;
+        Target.SceneDirtyRegion = this->SceneDirtyRegion;
+
+        // The shadow heights are only copied when they have been swept since they were last published.
+        if (Target.Shadows.GetVersion() != this->Shadows.GetVersion()) {
+            Target.Shadows = this->Shadows;
+        }
+
+        // Only the cascades that changed are copied, the chunk mips stay with the source.
+        Target.Cascades.CopyLevels(this->Cascades);
     }
 }
@@ -26,9 +26,23 @@ THE SOFTWARE
 #ifndef RAYMARCH_GAMESTATE_HPP
 #define RAYMARCH_GAMESTATE_HPP
 
+#include "AmbientOcclusion.hpp"
+#include "Brush.hpp"
+#include "ChunkStreamer.hpp"
+#include "Clipmap.hpp"
+#include "CollisionMap.hpp"
+#include "LightPropagation.hpp"
+#include "PaletteVolume.hpp"
+#include "ShadowMap.hpp"
+#include "Simulation.hpp"
 #include "Volume.hpp"
+#include "World.hpp"
 
 #include <array>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
 #include <vector>
 
 namespace Raymarch {
@@ -37,7 +51,7 @@ namespace Raymarch {
     public:
         /// @brief  Input keys.
         enum class KeyType {
-            Up, Down, Left, Right
+            Up, Down, Left, Right, Save, Load
         };
 
         /// @brief  Input key states.
@@ -45,6 +59,11 @@ namespace Raymarch {
             Press, Release
         };
 
+        /// @brief  Input mouse buttons.
+        enum class ButtonType {
+            Primary, Secondary
+        };
+
     private:
         /// @brief  The offset of the visible scene in the map.
         std::array<int, 3> SceneOffset;
@@ -56,6 +75,12 @@ namespace Raymarch {
         /// @brief  The player velocity.
         std::array<float, 3> SceneVelocity;
 
+        /// @brief  The minimum corner of the player body relative to the player position.
+        std::array<float, 3> PlayerMinimum;
+
+        /// @brief  The maximum corner of the player body relative to the player position.
+        std::array<float, 3> PlayerMaximum;
+
     private:
         /// @brief  The global light position.
         std::array<float, 3> LightPosition;
@@ -85,9 +110,64 @@ namespace Raymarch {
         /// @brief  An array of volumes to render at locations.
         std::vector<std::pair<std::array<int, 3>, Volume> > Map;
 
-        /// @brief  The scene rendered by the renderer, constructed from the map.
+        /// @brief  The persistent voxels of the map, built from the map and changed by the simulation.
+        World WorldVoxels;
+
+        /// @brief  The regions of the world that changed since the scene was last composed, in world coordinates.
+        std::vector<Region> WorldChanges;
+
+        /// @brief  The scene rendered by the renderer, extracted from the world.
         Volume Scene;
 
+        /// @brief  The scene as palette indices, this is what the renderer uploads.
+        PaletteVolume PackedScene;
+
+        /// @brief  Set when the map is replaced so the world is built again.
+        bool MapChanged;
+
+        /// @brief  Set when the whole scene must be composed again.
+        bool SceneStale;
+
+        /// @brief  The scene offset the scene was last composed at.
+        std::array<int, 3> ComposedOffset;
+
+        /// @brief  Incremented whenever the contents of the scene change.
+        std::uint64_t SceneVersion;
+
+        /// @brief  The scene version the dirty region is relative to.
+        std::uint64_t SceneBaseVersion;
+
+        /// @brief  The region of the scene that changed between the base version and the current version.
+        Region SceneDirtyRegion;
+
+    private:
+        /// @brief  The light propagated from emissive voxels into the scene.
+        LightPropagation Lighting;
+
+        /// @brief  The shadow heights of the scene columns for the global light.
+        ShadowMap Shadows;
+
+        /// @brief  The baked ambient occlusion of the scene.
+        AmbientOcclusion Occlusion;
+
+        /// @brief  The occupancy of the scene for collision queries.
+        CollisionMap Collision;
+
+        /// @brief  The coarse cascades of the world around the scene, rendered beyond it.
+        Clipmap Cascades;
+
+    private:
+        /// @brief  The liquid, heat and fire simulation of the world.
+        Simulation Simulator;
+
+    private:
+        /// @brief  The procedural terrain streamed into the world around the scene, null when the world is only the map.
+        std::unique_ptr<ChunkStreamer> Streamer;
+
+    private:
+        /// @brief  The result of the save being written in the background, invalid when no save has been started.
+        std::future<bool> PendingSave;
+
     public:
         /// @brief  Constructor to initialise member valiables based on the scene size.
         /// @param  SceneSize - The size of the scene that will be rendered.
@@ -147,15 +227,159 @@ namespace Raymarch {
         /// @return The current scene volume.
         const Volume& GetScene(void) const;
 
+        /// @brief  Get the version of the scene volume, it changes whenever the scene contents change.
+        /// @return The current scene version.
+        std::uint64_t GetSceneVersion(void) const;
+
+        /// @brief  Get the scene encoded as palette indices.
+        /// @return The current packed scene.
+        const PaletteVolume& GetPackedScene(void) const;
+
+        /// @brief  Get the scene version the dirty region is relative to.
+        /// @return The current base scene version.
+        std::uint64_t GetSceneBaseVersion(void) const;
+
+        /// @brief  Get the region of the scene that changed since the base version, a copy of the scene at the base version only needs this region updating.
+        /// @return The current dirty region.
+        const Region& GetSceneDirtyRegion(void) const;
+
+        /// @brief  Get the baked ambient occlusion of the scene.
+        /// @return The current ambient occlusion.
+        const AmbientOcclusion& GetAmbientOcclusion(void) const;
+
+        /// @brief  Get the shadow map of the global light.
+        /// @return The current shadow map.
+        const ShadowMap& GetShadowMap(void) const;
+
+        /// @brief  Get the cascades of the world around the scene.
+        /// @return The current clipmap.
+        const Clipmap& GetCascades(void) const;
+
+        /// @brief  Get the persistent voxels of the map.
+        /// @return The current world.
+        const World& GetWorld(void) const;
+
+        /// @brief  Get the occupancy of the scene for collision queries, in scene coordinates relative to the composed offset.
+        /// @return The current collision map.
+        const CollisionMap& GetCollisionMap(void) const;
+
+        /// @brief  Get the liquid, heat and fire simulation.
+        /// @return The simulation, its budget may be changed.
+        Simulation& GetSimulation(void);
+
+        /// @brief  Stream a procedural terrain into the world around the scene, under the voxels of the map.
+        /// @param  Seed - The seed of the terrain.
+        /// @param  CacheBudget - The largest number of bytes the generated chunks may cache.
+        /// @param  CompressedBudget - The largest number of bytes the generated chunks may cache compressed once evicted from the cache.
+        /// @param  ResidentBudget - The largest number of bytes unchanged terrain chunks may use in the world.
+        void SetTerrain(std::uint32_t Seed, std::size_t CacheBudget, std::size_t CompressedBudget, std::size_t ResidentBudget);
+
+        /// @brief  Get the streamer of the procedural terrain, its metrics show how well it keeps up with the player.
+        /// @return The streamer, null when there is no terrain.
+        const ChunkStreamer* GetStreamer(void) const;
+
+        /// @brief  Render the world beyond the scene with clipmap cascades, the fog distance is raised to reach the outermost cascade.
+        /// @param  LevelCount - The number of cascades, each covering twice the extent of the last, zero renders only the scene.
+        void SetCascadeCount(std::size_t LevelCount);
+
+    public:
+        /// @brief  Test a batch of voxels for occupancy, voxels outside the scene are empty.
+        /// @param  Positions - The world coordinates of the voxels.
+        /// @param  Results - Receives one value per voxel, one when it is occupied.
+        void QueryOccupancy(const std::vector<std::array<int, 3> >& Positions, std::vector<std::uint8_t>& Results) const;
+
+        /// @brief  Cast a batch of rays through the scene, stepping through the voxels exactly as the renderer does.
+        /// @param  Rays - The rays in world coordinates.
+        /// @param  Hits - Receives one hit per ray in world coordinates.
+        void CastRays(const std::vector<CollisionMap::RayQuery>& Rays, std::vector<CollisionMap::RayHit>& Hits) const;
+
+        /// @brief  Sweep a batch of boxes through the scene.
+        /// @param  Boxes - The boxes and their motions in world coordinates.
+        /// @param  Contacts - Receives the first contact of each box.
+        void SweepBoxes(const std::vector<CollisionMap::SweepQuery>& Boxes, std::vector<CollisionMap::SweepResult>& Contacts) const;
+
+    public:
+        /// @brief  Get the ray the renderer casts through a point of the screen.
+        /// @param  ScreenPosition - The point in pixels from the bottom left corner of the screen, pixel centres are at half pixel offsets as in the shader.
+        /// @param  ScreenResolution - The size of the screen in pixels.
+        /// @return The ray in world coordinates, starting on the near clip plane.
+        CollisionMap::RayQuery GetScreenRay(const std::array<float, 2>& ScreenPosition, const std::array<float, 2>& ScreenResolution) const;
+
+        /// @brief  Find the voxels the renderer shows at a batch of points of the screen, in parallel.
+        /// @param  ScreenPositions - The points in pixels from the bottom left corner of the screen.
+        /// @param  ScreenResolution - The size of the screen in pixels.
+        /// @param  Hits - Receives the hit voxel, face normal, distance from the near clip plane and position of each point in world coordinates.
+        void Pick(const std::vector<std::array<float, 2> >& ScreenPositions, const std::array<float, 2>& ScreenResolution, std::vector<CollisionMap::RayHit>& Hits) const;
+
+    public:
+        /// @brief  Edit the world with a brush, only the bricks the brush touches are composed, lit and uploaded again.
+        /// @param  Stroke - The brush in world coordinates.
+        /// @return The region of the world that changed.
+        Region Edit(const Brush& Stroke);
+
+        /// @brief  Replace the connected voxels that match the voxel at a seed.
+        /// @param  Seed - The world coordinate of the first voxel to replace.
+        /// @param  Replacement - The voxel to replace them with.
+        /// @param  Radius - The largest distance along each axis the fill may reach from the seed.
+        /// @return The region of the world that changed.
+        Region FloodFill(const std::array<int, 3>& Seed, const Voxel& Replacement, int Radius);
+
+    public:
+        /// @brief  Save the world to a file, the chunks are copied and then compressed and written on a background thread.
+        /// @param  Path - The path of the file.
+        /// @return False if a save is still being written, the world is then not saved.
+        bool SaveWorld(const std::string& Path);
+
+        /// @brief  Check if a save is still being written.
+        /// @return True while the background save runs.
+        bool IsSaving(void) const;
+
+        /// @brief  Wait for the background save to finish.
+        /// @return False if the last save failed, true if it succeeded or there was none.
+        bool WaitForSave(void);
+
+        /// @brief  Replace the world with the chunks of a saved file, the map is kept but not built again until it is changed.
+        /// @param  Path - The path of the file.
+        /// @return False if the file could not be read, the world is then unchanged.
+        bool LoadWorld(const std::string& Path);
+
     public:
         /// @brief  Input key presses to the state.
         /// @param  Key - The input key.
         /// @param  State - The state of the key.
         void Input(KeyType Key, KeyStateType State);
 
+        /// @brief  Input a mouse click to the state, the primary button adds material where the screen shows a voxel and the secondary button digs it away.
+        /// @param  Button - The clicked button.
+        /// @param  ScreenPosition - The point in pixels from the bottom left corner of the screen.
+        /// @param  ScreenResolution - The size of the screen in pixels.
+        void Input(ButtonType Button, const std::array<float, 2>& ScreenPosition, const std::array<float, 2>& ScreenResolution);
+
         /// @brief  Update the state given a time step.
         /// @param  DeltaTime - The time since update was last called.
         void Update(float DeltaTime);
+
+        /// @brief  Publish the rendered parameters and scene to another state, used to hand frames between threads.
+        /// @param  Target - The state to publish to, only the changed parts of its packed scene and shadow map are copied.
+        /// @note   The full scene volume is not published, the target keeps only the packed scene up to date.
+        void PublishTo(GameState& Target);
+
+    private:
+        /// @brief  Get the ray the renderer casts through a point of the screen.
+        /// @param  ScreenPosition - The point in pixels from the bottom left corner of the screen.
+        /// @param  ScreenResolution - The size of the screen in pixels.
+        /// @param  Ray - Receives the ray in scene coordinates, its direction is not normalised.
+        /// @return False if the point is outside the rendered region of the screen.
+        bool GetSceneRay(const std::array<float, 2>& ScreenPosition, const std::array<float, 2>& ScreenResolution, CollisionMap::RayQuery& Ray) const;
+
+        /// @brief  Build the world from the map, discarding any simulated changes.
+        void BuildWorld(void);
+
+        /// @brief  Extract the world into the scene at the current scene offset and light it.
+        void Compose(void);
+
+        /// @brief  Extract only the changed regions of the world into the scene and update everything derived from them.
+        void ComposeChanges(void);
 	};
 }
 
@@ -0,0 +1,230 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <string>
+
+namespace Raymarch {
+    // The job system the calling thread is a worker of, and the index of its deque.
+    thread_local static const JobSystem* WorkerJobSystem = nullptr;
+    thread_local static std::size_t WorkerQueueIndex = 0;
+
+    // The number of times a waiting thread checks its group again before blocking, long enough to cover the last short jobs.
+    constexpr static const std::size_t WaitSpinCount = 256;
+
+    // Constructor for an empty group.
+    JobSystem::Group::Group(void)
+        : Pending(0) {
+    }
+
+    // Constructor that starts the workers.
+    JobSystem::JobSystem(std::size_t WorkerCount)
+        : QueuedJobs(0)
+        , Stopping(false) {
+        for (std::size_t Index = 0; Index < WorkerCount + 1; ++Index) {
+            this->Queues.emplace_back(new Queue());
+        }
+        for (std::size_t Index = 0; Index < WorkerCount; ++Index) {
+            this->Workers.emplace_back(&JobSystem::RunWorker, this, Index + 1);
+        }
+    }
+
+    // Destructor that stops the workers.
+    JobSystem::~JobSystem(void) {
+        {
+            std::lock_guard<std::mutex> Lock(this->SleepMutex);
+            this->Stopping = true;
+        }
+        this->SleepCondition.notify_all();
+        for (std::thread& Worker : this->Workers) {
+            Worker.join();
+        }
+        assert(this->QueuedJobs == 0);
+    }
+
+    // The shared job system, leaving one core for the thread that waits on jobs.
+    JobSystem& JobSystem::GetGlobal(void) {
+        static JobSystem Global(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        return Global;
+    }
+
+    // The workers plus the waiting thread.
+    std::size_t JobSystem::GetThreadCount(void) const {
+        return this->Workers.size() + 1;
+    }
+
+    // Queue a job on the deque of the calling thread.
+    void JobSystem::Run(Group& Owner, std::function<void(void)> Function) {
+        Owner.Pending.fetch_add(1, std::memory_order_relaxed);
+        Queue& Target = *this->Queues[this->GetQueueIndex()];
+        {
+            std::lock_guard<std::mutex> Lock(Target.Mutex);
+            Target.Jobs.push_back(Job{std::move(Function), &Owner});
+        }
+        this->QueuedJobs.fetch_add(1, std::memory_order_release);
+
+        // Take the sleep lock so a worker cannot miss the notification between checking and sleeping.
+        {
+            std::lock_guard<std::mutex> Lock(this->SleepMutex);
+        }
+        this->SleepCondition.notify_one();
+    }
+
+    // Help run the jobs of the group, spin briefly once the rest are running elsewhere, then block until they finish.
+    void JobSystem::Wait(Group& Owner) {
+        RAYMARCH_TRACE_SCOPE("JobSystem::Wait");
+        const std::size_t QueueIndex = this->GetQueueIndex();
+        std::size_t Spins = 0;
+        while ((Owner.Pending.load(std::memory_order_acquire) > 0) && (Spins < WaitSpinCount)) {
+            if (this->TryRunOne(QueueIndex, &Owner)) {
+                Spins = 0;
+            }
+            else {
+                ++Spins;
+            }
+        }
+
+        // The last job decrements under the lock, so once it is held with nothing pending no job touches the group again.
+        std::unique_lock<std::mutex> Lock(Owner.Mutex);
+        Owner.Finished.wait(Lock, [&Owner]() -> bool {
+            return Owner.Pending.load(std::memory_order_acquire) == 0;
+        });
+    }
+
+    // Fork one function, run the other, then join.
+    void JobSystem::Invoke(const std::function<void(void)>& Left, const std::function<void(void)>& Right) {
+        Group Forked;
+        this->Run(Forked, Left);
+        Right();
+        this->Wait(Forked);
+    }
+
+    // Run a range in parallel chunks.
+    void JobSystem::ParallelFor(std::size_t Begin, std::size_t End, std::size_t Grain, const std::function<void(std::size_t, std::size_t)>& Function) {
+        if (Begin >= End) {
+            return;
+        }
+        const std::size_t Count = End - Begin;
+        Grain = std::max<std::size_t>(1, Grain);
+
+        // Split into a few chunks per thread so that stealing can balance uneven chunks.
+        const std::size_t MaximumChunks = this->GetThreadCount() * 4;
+        const std::size_t ChunkCount = std::min(MaximumChunks, (Count + Grain - 1) / Grain);
+        if (ChunkCount <= 1) {
+            Function(Begin, End);
+            return;
+        }
+
+        const std::size_t ChunkSize = (Count + ChunkCount - 1) / ChunkCount;
+        Group Chunks;
+        for (std::size_t ChunkBegin = Begin + ChunkSize; ChunkBegin < End; ChunkBegin += ChunkSize) {
+            const std::size_t ChunkEnd = std::min(End, ChunkBegin + ChunkSize);
+            this->Run(Chunks, [&Function, ChunkBegin, ChunkEnd]() -> void {
+                Function(ChunkBegin, ChunkEnd);
+            });
+        }
+
+        // The calling thread processes the first chunk itself.
+        Function(Begin, std::min(End, Begin + ChunkSize));
+        this->Wait(Chunks);
+    }
+
+    // The deque of the calling thread, threads that are not workers share deque zero.
+    std::size_t JobSystem::GetQueueIndex(void) const {
+        return (WorkerJobSystem == this) ? WorkerQueueIndex : 0;
+    }
+
+    // Pop from the own deque or steal from another, only considering the jobs of one group when given.
+    bool JobSystem::TryTake(std::size_t QueueIndex, const Group* Only, Job& Result) {
+        if (this->QueuedJobs.load(std::memory_order_acquire) == 0) {
+            return false;
+        }
+
+        // Own deque, newest first as its data is most likely to be in cache.
+        {
+            Queue& Own = *this->Queues[QueueIndex];
+            std::lock_guard<std::mutex> Lock(Own.Mutex);
+            for (auto Found = Own.Jobs.rbegin(); Found != Own.Jobs.rend(); ++Found) {
+                if ((Only == nullptr) || (Found->Owner == Only)) {
+                    Result = std::move(*Found);
+                    Own.Jobs.erase(std::next(Found).base());
+                    this->QueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+        }
+
+        // Steal the oldest job from the other deques, starting after our own to spread the thieves out.
+        for (std::size_t Offset = 1; Offset < this->Queues.size(); ++Offset) {
+            Queue& Victim = *this->Queues[(QueueIndex + Offset) % this->Queues.size()];
+            std::lock_guard<std::mutex> Lock(Victim.Mutex);
+            for (auto Found = Victim.Jobs.begin(); Found != Victim.Jobs.end(); ++Found) {
+                if ((Only == nullptr) || (Found->Owner == Only)) {
+                    Result = std::move(*Found);
+                    Victim.Jobs.erase(Found);
+                    this->QueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    // Run a single job if there is one, waking the thread waiting on its group when it is the last.
+    bool JobSystem::TryRunOne(std::size_t QueueIndex, const Group* Only) {
+        Job Taken;
+        if (!this->TryTake(QueueIndex, Only, Taken)) {
+            return false;
+        }
+        Taken.Function();
+        std::lock_guard<std::mutex> Lock(Taken.Owner->Mutex);
+        if (Taken.Owner->Pending.fetch_sub(1, std::memory_order_release) == 1) {
+            Taken.Owner->Finished.notify_all();
+        }
+        return true;
+    }
+
+    // Run jobs until stopped, sleeping while there are none.
+    void JobSystem::RunWorker(std::size_t QueueIndex) {
+        WorkerJobSystem = this;
+        WorkerQueueIndex = QueueIndex;
+        Trace::SetThreadName("Job Worker " + std::to_string(QueueIndex));
+
+        while (!this->Stopping.load(std::memory_order_acquire)) {
+            if (this->TryRunOne(QueueIndex, nullptr)) {
+                continue;
+            }
+            std::unique_lock<std::mutex> Lock(this->SleepMutex);
+            this->SleepCondition.wait(Lock, [this]() -> bool {
+                return this->Stopping.load(std::memory_order_acquire) || (this->QueuedJobs.load(std::memory_order_acquire) > 0);
+            });
+        }
+    }
+}
@@ -0,0 +1,172 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_JOBSYSTEM_HPP
+#define RAYMARCH_JOBSYSTEM_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  JobSystem is a work-stealing task scheduler with a deque per thread.
+    /// @note   Workers push and pop jobs at the back of their own deque and steal from the front of the others. A thread waiting on
+    ///         a group only runs jobs of that group, so it is never held up by a long job another thread submitted, and blocks once
+    ///         none of them are left to take.
+    class JobSystem {
+    public:
+        /// @brief  Group counts outstanding jobs so that they can be joined with Wait.
+        class Group {
+        private:
+            friend class JobSystem;
+
+            /// @brief  The number of jobs in the group that have not yet finished.
+            std::atomic<std::size_t> Pending;
+
+            /// @brief  Guards the last job finishing against the group being waited on and destroyed.
+            std::mutex Mutex;
+
+            /// @brief  Wakes the waiting thread when the last job finishes.
+            std::condition_variable Finished;
+
+        public:
+            /// @brief  Constructor that creates an empty group.
+            Group(void);
+
+            /// @brief  Deleted copy constructor.
+            Group(const Group&) = delete;
+
+            /// @brief  Deleted copy assignment.
+            Group& operator=(const Group&) = delete;
+        };
+
+    private:
+        /// @brief  A job and the group it belongs to.
+        struct Job {
+            std::function<void(void)> Function;
+            Group* Owner;
+        };
+
+        /// @brief  A deque of jobs belonging to one thread.
+        struct Queue {
+            std::mutex Mutex;
+            std::deque<Job> Jobs;
+        };
+
+    private:
+        /// @brief  The job deques, index zero is shared by all threads that are not workers of this system.
+        std::vector<std::unique_ptr<Queue> > Queues;
+
+        /// @brief  The worker threads.
+        std::vector<std::thread> Workers;
+
+        /// @brief  The number of jobs queued and not yet taken, used to let idle workers sleep.
+        std::atomic<std::size_t> QueuedJobs;
+
+        /// @brief  Set when the workers should exit.
+        std::atomic<bool> Stopping;
+
+        /// @brief  Guards sleeping on the condition.
+        std::mutex SleepMutex;
+
+        /// @brief  Wakes sleeping workers when jobs are queued.
+        std::condition_variable SleepCondition;
+
+    public:
+        /// @brief  Constructor that starts a number of worker threads.
+        /// @param  WorkerCount - The number of workers, the calling thread also runs jobs while it waits.
+        JobSystem(std::size_t WorkerCount);
+
+        /// @brief  Destructor that stops and joins the workers, all groups must have been waited on.
+        ~JobSystem(void);
+
+        /// @brief  Deleted copy constructor.
+        JobSystem(const JobSystem&) = delete;
+
+        /// @brief  Deleted copy assignment.
+        JobSystem& operator=(const JobSystem&) = delete;
+
+    public:
+        /// @brief  Get the job system shared by the engine, with a worker for every core except the calling one.
+        /// @return The shared job system.
+        static JobSystem& GetGlobal(void);
+
+    public:
+        /// @brief  Get the number of threads that run jobs, the workers plus the waiting thread.
+        /// @return The number of threads.
+        std::size_t GetThreadCount(void) const;
+
+        /// @brief  Queue a job (fork).
+        /// @param  Owner - The group to add the job to.
+        /// @param  Function - The job to run.
+        void Run(Group& Owner, std::function<void(void)> Function);
+
+        /// @brief  Run the queued jobs of a group, then block until every job in it has finished (join).
+        /// @param  Owner - The group to wait for.
+        void Wait(Group& Owner);
+
+        /// @brief  Run two functions in parallel and wait for both to finish.
+        /// @param  Left - The function to run on another thread if one is free.
+        /// @param  Right - The function to run on the calling thread.
+        void Invoke(const std::function<void(void)>& Left, const std::function<void(void)>& Right);
+
+        /// @brief  Split a range into chunks and process them in parallel, returning when all are finished.
+        /// @param  Begin - The first index of the range.
+        /// @param  End - One past the last index of the range.
+        /// @param  Grain - The minimum number of indices in a chunk.
+        /// @param  Function - The function to call for each chunk with its first and one past last index.
+        void ParallelFor(std::size_t Begin, std::size_t End, std::size_t Grain, const std::function<void(std::size_t, std::size_t)>& Function);
+
+    private:
+        /// @brief  Get the deque of the calling thread.
+        /// @return The index of the deque.
+        std::size_t GetQueueIndex(void) const;
+
+        /// @brief  Take a job from a deque, popping from the back of the own deque or stealing from the front of another.
+        /// @param  QueueIndex - The index of the deque of the calling thread.
+        /// @param  Only - The group the job must belong to, or null for a job of any group.
+        /// @param  Result - The job that was taken.
+        /// @return True if a job was taken.
+        bool TryTake(std::size_t QueueIndex, const Group* Only, Job& Result);
+
+        /// @brief  Take and run a single job.
+        /// @param  QueueIndex - The index of the deque of the calling thread.
+        /// @param  Only - The group the job must belong to, or null for a job of any group.
+        /// @return True if a job was run.
+        bool TryRunOne(std::size_t QueueIndex, const Group* Only);
+
+        /// @brief  The worker thread loop.
+        /// @param  QueueIndex - The index of the deque of the worker.
+        void RunWorker(std::size_t QueueIndex);
+    };
+}
+
+#endif // RAYMARCH_JOBSYSTEM_HPP
@@ -0,0 +1,486 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "LightPropagation.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace Raymarch {
+    // The six face neighbours of a voxel.
+    constexpr static const int NeighbourOffsets[6][3] = {
+        {-1,  0,  0}, {+1,  0,  0},
+        { 0, -1,  0}, { 0, +1,  0},
+        { 0,  0, -1}, { 0,  0, +1}
+    };
+
+    // Constructor for an engine without light.
+    LightPropagation::LightPropagation(void)
+        : Size{{0, 0, 0}}
+        , ChunkCounts{{0, 0, 0}} {
+    }
+
+    // Plasma voxels emit light.
+    bool LightPropagation::IsEmitter(const Voxel& Value) {
+        return (Value.GetAlpha() > 0) && (Value.GetState() == Voxel::StateType::Plasma) && (Value.GetLight() > 0);
+    }
+
+    // Light passes through anything that is not fully opaque.
+    bool LightPropagation::IsTransparent(const Voxel& Value) {
+        return Value.GetAlpha() < 7;
+    }
+
+    // Get the index of a voxel, matching the layout of the volume.
+    std::size_t LightPropagation::GetIndex(int X, int Y, int Z) const {
+        return static_cast<std::size_t>(X) + this->Size[0] * (static_cast<std::size_t>(Y) + this->Size[1] * static_cast<std::size_t>(Z));
+    }
+
+    // Get the index of a chunk, chunks are ordered as the voxels are.
+    std::size_t LightPropagation::GetChunkIndex(int X, int Y, int Z) const {
+        return static_cast<std::size_t>((X / ChunkSize) + this->ChunkCounts[0] * ((Y / ChunkSize) + this->ChunkCounts[1] * (Z / ChunkSize)));
+    }
+
+    // Full relight, chunks flood fill in parallel and exchange light crossing their borders between rounds.
+    void LightPropagation::Relight(Volume& Scene) {
+        RAYMARCH_TRACE_SCOPE("LightPropagation::Relight");
+
+        this->Size = Scene.GetSize();
+        const std::size_t Count = this->Size[0] * this->Size[1] * this->Size[2];
+        this->Levels.assign(Count, 0);
+        this->Tints.assign(Count, 0);
+        this->Changed.clear();
+
+        // Light travelling into a voxel, owned by the chunk containing the voxel.
+        struct Candidate {
+            std::size_t Index;
+            std::uint8_t Level;
+            std::uint8_t Tint;
+        };
+
+        // Light leaving a chunk, queued for the chunk it enters.
+        struct Outgoing {
+            std::size_t Chunk;
+            Candidate Light;
+        };
+
+        // Layout of the chunks, kept for the incremental updates.
+        this->ChunkCounts = {{
+            static_cast<int>((this->Size[0] + ChunkSize - 1) / ChunkSize),
+            static_cast<int>((this->Size[1] + ChunkSize - 1) / ChunkSize),
+            static_cast<int>((this->Size[2] + ChunkSize - 1) / ChunkSize)
+        }};
+        const std::size_t ChunkCount = static_cast<std::size_t>(this->ChunkCounts[0] * this->ChunkCounts[1] * this->ChunkCounts[2]);
+        auto GetChunkRegion = [this](std::size_t Chunk) -> Region {
+            const int ChunkX = static_cast<int>(Chunk) % this->ChunkCounts[0];
+            const int ChunkY = (static_cast<int>(Chunk) / this->ChunkCounts[0]) % this->ChunkCounts[1];
+            const int ChunkZ = static_cast<int>(Chunk) / (this->ChunkCounts[0] * this->ChunkCounts[1]);
+            const Region Chunked({{ChunkX * ChunkSize, ChunkY * ChunkSize, ChunkZ * ChunkSize}}, {{(ChunkX + 1) * ChunkSize, (ChunkY + 1) * ChunkSize, (ChunkZ + 1) * ChunkSize}});
+            return Chunked.Intersection(Region({{0, 0, 0}}, {{static_cast<int>(this->Size[0]), static_cast<int>(this->Size[1]), static_cast<int>(this->Size[2])}}));
+        };
+
+        std::vector<std::vector<Candidate> > Inboxes(ChunkCount);
+        std::vector<std::vector<Outgoing> > Outboxes(ChunkCount);
+
+        // Seed every chunk with its own emitters.
+        JobSystem::GetGlobal().ParallelFor(0, ChunkCount, 1, [&](std::size_t FirstChunk, std::size_t LastChunk) -> void {
+            for (std::size_t Chunk = FirstChunk; Chunk < LastChunk; ++Chunk) {
+                const Region Bounds = GetChunkRegion(Chunk);
+                for (int IndexZ = Bounds.Minimum[2]; IndexZ < Bounds.Maximum[2]; ++IndexZ) {
+                    for (int IndexY = Bounds.Minimum[1]; IndexY < Bounds.Maximum[1]; ++IndexY) {
+                        for (int IndexX = Bounds.Minimum[0]; IndexX < Bounds.Maximum[0]; ++IndexX) {
+                            const Voxel& Value = Scene(IndexX, IndexY, IndexZ);
+                            if (IsEmitter(Value)) {
+                                Inboxes[Chunk].push_back(Candidate{this->GetIndex(IndexX, IndexY, IndexZ), Value.GetLight(), Value.GetTint()});
+                            }
+                        }
+                    }
+                }
+            }
+        });
+
+        // Flood fill rounds until no light crosses a chunk border.
+        bool LightMoved = true;
+        while (LightMoved) {
+            RAYMARCH_TRACE_SCOPE("LightPropagation::Relight::Round");
+
+            // Each chunk only writes the light of its own voxels, light leaving it is queued instead.
+            JobSystem::GetGlobal().ParallelFor(0, ChunkCount, 1, [&](std::size_t FirstChunk, std::size_t LastChunk) -> void {
+                std::vector<std::size_t> Queue;
+                for (std::size_t Chunk = FirstChunk; Chunk < LastChunk; ++Chunk) {
+                    Queue.clear();
+                    for (const Candidate& Incoming : Inboxes[Chunk]) {
+                        if (Incoming.Level > this->Levels[Incoming.Index]) {
+                            this->Levels[Incoming.Index] = Incoming.Level;
+                            this->Tints[Incoming.Index] = Incoming.Tint;
+                            Queue.push_back(Incoming.Index);
+                        }
+                    }
+                    Inboxes[Chunk].clear();
+
+                    for (std::size_t Head = 0; Head < Queue.size(); ++Head) {
+                        const std::size_t Index = Queue[Head];
+                        const int X = static_cast<int>(Index % this->Size[0]);
+                        const int Y = static_cast<int>((Index / this->Size[0]) % this->Size[1]);
+                        const int Z = static_cast<int>(Index / (this->Size[0] * this->Size[1]));
+                        const Voxel& Value = Scene(X, Y, Z);
+                        const std::uint8_t Level = this->Levels[Index];
+                        if ((Level <= 1) || (!IsEmitter(Value) && !IsTransparent(Value))) {
+                            continue;
+                        }
+                        for (const int (&Offset)[3] : NeighbourOffsets) {
+                            const int NeighbourX = X + Offset[0];
+                            const int NeighbourY = Y + Offset[1];
+                            const int NeighbourZ = Z + Offset[2];
+                            if ((NeighbourX < 0) || (NeighbourY < 0) || (NeighbourZ < 0) || (NeighbourX >= static_cast<int>(this->Size[0])) || (NeighbourY >= static_cast<int>(this->Size[1])) || (NeighbourZ >= static_cast<int>(this->Size[2]))) {
+                                continue;
+                            }
+                            const std::size_t NeighbourIndex = this->GetIndex(NeighbourX, NeighbourY, NeighbourZ);
+                            const std::size_t NeighbourChunk = this->GetChunkIndex(NeighbourX, NeighbourY, NeighbourZ);
+                            const Candidate Light = {NeighbourIndex, static_cast<std::uint8_t>(Level - 1), this->Tints[Index]};
+                            if (NeighbourChunk != Chunk) {
+                                Outboxes[Chunk].push_back(Outgoing{NeighbourChunk, Light});
+                            }
+                            else if (Light.Level > this->Levels[NeighbourIndex]) {
+                                this->Levels[NeighbourIndex] = Light.Level;
+                                this->Tints[NeighbourIndex] = Light.Tint;
+                                Queue.push_back(NeighbourIndex);
+                            }
+                        }
+                    }
+                }
+            });
+
+            // Deliver the light that crossed chunk borders for the next round.
+            LightMoved = false;
+            for (std::vector<Outgoing>& Outbox : Outboxes) {
+                for (const Outgoing& Light : Outbox) {
+                    Inboxes[Light.Chunk].push_back(Light.Light);
+                    LightMoved = true;
+                }
+                Outbox.clear();
+            }
+        }
+
+        // Write the light into the voxels.
+        JobSystem::GetGlobal().ParallelFor(0, this->Size[2], 1, [&](std::size_t FirstZ, std::size_t LastZ) -> void {
+            Region Slab = Scene.GetRegion();
+            Slab.Minimum[2] = static_cast<int>(FirstZ);
+            Slab.Maximum[2] = static_cast<int>(LastZ);
+            this->Apply(Scene, Slab);
+        });
+    }
+
+    // Record a changed voxel.
+    void LightPropagation::NotifyChanged(int X, int Y, int Z) {
+        this->Changed.push_back({{X, Y, Z}});
+    }
+
+    // Queue every voxel of a changed region.
+    void LightPropagation::NotifyChanged(const Region& Target) {
+        for (int IndexZ = Target.Minimum[2]; IndexZ < Target.Maximum[2]; ++IndexZ) {
+            for (int IndexY = Target.Minimum[1]; IndexY < Target.Maximum[1]; ++IndexY) {
+                for (int IndexX = Target.Minimum[0]; IndexX < Target.Maximum[0]; ++IndexX) {
+                    this->Changed.push_back({{IndexX, IndexY, IndexZ}});
+                }
+            }
+        }
+    }
+
+    // Incremental update of the changed voxels and their neighbourhoods. The removal pass and then the addition pass run in parallel
+    // across the chunks holding their queues, each chunk only writes the light of its own voxels and hands the removed or added light
+    // crossing its border to the chunk it enters for the next round, as the full relight does.
+    Region LightPropagation::Propagate(Volume& Scene) {
+        if (this->Changed.empty()) {
+            return Region();
+        }
+
+        RAYMARCH_TRACE_SCOPE("LightPropagation::Propagate");
+
+        assert(Scene.GetSize() == this->Size);
+        const Region Bounds = Scene.GetRegion();
+        const std::size_t ChunkCount = static_cast<std::size_t>(this->ChunkCounts[0] * this->ChunkCounts[1] * this->ChunkCounts[2]);
+
+        // Light that has been removed from a voxel, or is leaving a voxel next to it, with the level it had.
+        struct Removal {
+            std::size_t Index;
+            std::uint8_t Level;
+        };
+
+        // Light travelling into a voxel.
+        struct Candidate {
+            std::size_t Index;
+            std::uint8_t Level;
+            std::uint8_t Tint;
+        };
+
+        // Removed or added light leaving a chunk, queued for the chunk it enters.
+        struct OutgoingRemoval {
+            std::size_t Chunk;
+            Removal Light;
+        };
+        struct OutgoingCandidate {
+            std::size_t Chunk;
+            Candidate Light;
+        };
+
+        // The queues of each chunk, and the region of its voxels whose light may have changed.
+        std::vector<std::vector<Removal> > RemovalQueues(ChunkCount);
+        std::vector<std::vector<Removal> > RemovalInboxes(ChunkCount);
+        std::vector<std::vector<OutgoingRemoval> > RemovalOutboxes(ChunkCount);
+        std::vector<std::vector<std::size_t> > AdditionQueues(ChunkCount);
+        std::vector<std::vector<Candidate> > AdditionInboxes(ChunkCount);
+        std::vector<std::vector<OutgoingCandidate> > AdditionOutboxes(ChunkCount);
+        std::vector<Region> Touched(ChunkCount);
+        auto Touch = [&Touched](std::size_t Chunk, const std::array<int, 3>& Position) -> void {
+            Touched[Chunk] = Touched[Chunk].Union(Region(Position, {{Position[0] + 1, Position[1] + 1, Position[2] + 1}}));
+        };
+
+        // Helper to decode a voxel index.
+        auto GetPosition = [this](std::size_t Index) -> std::array<int, 3> {
+            return {{
+                static_cast<int>(Index % this->Size[0]),
+                static_cast<int>((Index / this->Size[0]) % this->Size[1]),
+                static_cast<int>(Index / (this->Size[0] * this->Size[1]))
+            }};
+        };
+
+        // Darken a voxel of a chunk that was lit more weakly than light removed next to it, stopping at brighter light which is relit.
+        auto Remove = [this, &Scene, &RemovalQueues, &AdditionQueues, &Touch, &GetPosition](std::size_t Chunk, std::size_t Index, std::uint8_t RemovedLevel) -> void {
+            const std::uint8_t Level = this->Levels[Index];
+            if (Level == 0) {
+                return;
+            }
+            if (Level >= RemovedLevel) {
+                AdditionQueues[Chunk].push_back(Index);
+                return;
+            }
+            const std::array<int, 3> Position = GetPosition(Index);
+            Touch(Chunk, Position);
+            RemovalQueues[Chunk].push_back(Removal{Index, Level});
+            this->Levels[Index] = 0;
+            this->Tints[Index] = 0;
+
+            // Emitters keep their own light.
+            const Voxel& Value = Scene(Position[0], Position[1], Position[2]);
+            if (IsEmitter(Value)) {
+                this->Levels[Index] = Value.GetLight();
+                this->Tints[Index] = Value.GetTint();
+                AdditionQueues[Chunk].push_back(Index);
+            }
+        };
+
+        // Remove the old light of every changed voxel, relight it if it now emits, and let light flow back in from around it.
+        for (const std::array<int, 3>& Position : this->Changed) {
+            if (!Bounds.Contains(Position[0], Position[1], Position[2])) {
+                continue;
+            }
+            const std::size_t Chunk = this->GetChunkIndex(Position[0], Position[1], Position[2]);
+            Touch(Chunk, Position);
+            const std::size_t Index = this->GetIndex(Position[0], Position[1], Position[2]);
+            if (this->Levels[Index] > 0) {
+                RemovalQueues[Chunk].push_back(Removal{Index, this->Levels[Index]});
+                this->Levels[Index] = 0;
+                this->Tints[Index] = 0;
+            }
+            const Voxel& Value = Scene(Position[0], Position[1], Position[2]);
+            if (IsEmitter(Value)) {
+                this->Levels[Index] = Value.GetLight();
+                this->Tints[Index] = Value.GetTint();
+                AdditionQueues[Chunk].push_back(Index);
+            }
+            for (const int (&Offset)[3] : NeighbourOffsets) {
+                if (Bounds.Contains(Position[0] + Offset[0], Position[1] + Offset[1], Position[2] + Offset[2])) {
+                    const std::size_t NeighbourIndex = this->GetIndex(Position[0] + Offset[0], Position[1] + Offset[1], Position[2] + Offset[2]);
+                    if (this->Levels[NeighbourIndex] > 0) {
+                        AdditionQueues[this->GetChunkIndex(Position[0] + Offset[0], Position[1] + Offset[1], Position[2] + Offset[2])].push_back(NeighbourIndex);
+                    }
+                }
+            }
+        }
+        this->Changed.clear();
+
+        // The chunks with work in the next round.
+        std::vector<std::size_t> Active;
+        for (std::size_t Chunk = 0; Chunk < ChunkCount; ++Chunk) {
+            if (!RemovalQueues[Chunk].empty()) {
+                Active.push_back(Chunk);
+            }
+        }
+
+        // Removal rounds until no removed light crosses a chunk border.
+        while (!Active.empty()) {
+            RAYMARCH_TRACE_SCOPE("LightPropagation::Propagate::Removal");
+
+            JobSystem::GetGlobal().ParallelFor(0, Active.size(), 1, [&](std::size_t First, std::size_t Last) -> void {
+                for (std::size_t Entry = First; Entry < Last; ++Entry) {
+                    const std::size_t Chunk = Active[Entry];
+                    for (const Removal& Incoming : RemovalInboxes[Chunk]) {
+                        Remove(Chunk, Incoming.Index, Incoming.Level);
+                    }
+                    RemovalInboxes[Chunk].clear();
+
+                    std::vector<Removal>& Queue = RemovalQueues[Chunk];
+                    for (std::size_t Head = 0; Head < Queue.size(); ++Head) {
+                        const Removal Removed = Queue[Head];
+                        const std::array<int, 3> Position = GetPosition(Removed.Index);
+                        for (const int (&Offset)[3] : NeighbourOffsets) {
+                            const int NeighbourX = Position[0] + Offset[0];
+                            const int NeighbourY = Position[1] + Offset[1];
+                            const int NeighbourZ = Position[2] + Offset[2];
+                            if (!Bounds.Contains(NeighbourX, NeighbourY, NeighbourZ)) {
+                                continue;
+                            }
+                            const std::size_t NeighbourIndex = this->GetIndex(NeighbourX, NeighbourY, NeighbourZ);
+                            const std::size_t NeighbourChunk = this->GetChunkIndex(NeighbourX, NeighbourY, NeighbourZ);
+                            if (NeighbourChunk != Chunk) {
+                                RemovalOutboxes[Chunk].push_back(OutgoingRemoval{NeighbourChunk, Removal{NeighbourIndex, Removed.Level}});
+                            }
+                            else {
+                                Remove(Chunk, NeighbourIndex, Removed.Level);
+                            }
+                        }
+                    }
+                    Queue.clear();
+                }
+            });
+
+            // Deliver the removed light that crossed chunk borders for the next round.
+            std::vector<std::size_t> Next;
+            for (const std::size_t Chunk : Active) {
+                for (const OutgoingRemoval& Light : RemovalOutboxes[Chunk]) {
+                    if (RemovalInboxes[Light.Chunk].empty()) {
+                        Next.push_back(Light.Chunk);
+                    }
+                    RemovalInboxes[Light.Chunk].push_back(Light.Light);
+                }
+                RemovalOutboxes[Chunk].clear();
+            }
+            Active.swap(Next);
+        }
+
+        for (std::size_t Chunk = 0; Chunk < ChunkCount; ++Chunk) {
+            if (!AdditionQueues[Chunk].empty()) {
+                Active.push_back(Chunk);
+            }
+        }
+
+        // Addition rounds, flood fill outwards from the emitters and the edges of the removed light until no light crosses a chunk border.
+        while (!Active.empty()) {
+            RAYMARCH_TRACE_SCOPE("LightPropagation::Propagate::Addition");
+
+            JobSystem::GetGlobal().ParallelFor(0, Active.size(), 1, [&](std::size_t First, std::size_t Last) -> void {
+                for (std::size_t Entry = First; Entry < Last; ++Entry) {
+                    const std::size_t Chunk = Active[Entry];
+                    std::vector<std::size_t>& Queue = AdditionQueues[Chunk];
+                    for (const Candidate& Incoming : AdditionInboxes[Chunk]) {
+                        if (Incoming.Level > this->Levels[Incoming.Index]) {
+                            Touch(Chunk, GetPosition(Incoming.Index));
+                            this->Levels[Incoming.Index] = Incoming.Level;
+                            this->Tints[Incoming.Index] = Incoming.Tint;
+                            Queue.push_back(Incoming.Index);
+                        }
+                    }
+                    AdditionInboxes[Chunk].clear();
+
+                    for (std::size_t Head = 0; Head < Queue.size(); ++Head) {
+                        const std::size_t Index = Queue[Head];
+                        const std::array<int, 3> Position = GetPosition(Index);
+                        const std::uint8_t Level = this->Levels[Index];
+                        const Voxel& Value = Scene(Position[0], Position[1], Position[2]);
+                        if ((Level <= 1) || (!IsEmitter(Value) && !IsTransparent(Value))) {
+                            continue;
+                        }
+                        for (const int (&Offset)[3] : NeighbourOffsets) {
+                            const std::array<int, 3> Neighbour = {{Position[0] + Offset[0], Position[1] + Offset[1], Position[2] + Offset[2]}};
+                            if (!Bounds.Contains(Neighbour[0], Neighbour[1], Neighbour[2])) {
+                                continue;
+                            }
+                            const std::size_t NeighbourIndex = this->GetIndex(Neighbour[0], Neighbour[1], Neighbour[2]);
+                            const std::size_t NeighbourChunk = this->GetChunkIndex(Neighbour[0], Neighbour[1], Neighbour[2]);
+                            if (NeighbourChunk != Chunk) {
+                                AdditionOutboxes[Chunk].push_back(OutgoingCandidate{NeighbourChunk, Candidate{NeighbourIndex, static_cast<std::uint8_t>(Level - 1), this->Tints[Index]}});
+                            }
+                            else if (Level - 1 > this->Levels[NeighbourIndex]) {
+                                Touch(Chunk, Neighbour);
+                                this->Levels[NeighbourIndex] = static_cast<std::uint8_t>(Level - 1);
+                                this->Tints[NeighbourIndex] = this->Tints[Index];
+                                Queue.push_back(NeighbourIndex);
+                            }
+                        }
+                    }
+                    Queue.clear();
+                }
+            });
+
+            // Deliver the light that crossed chunk borders for the next round.
+            std::vector<std::size_t> Next;
+            for (const std::size_t Chunk : Active) {
+                for (const OutgoingCandidate& Light : AdditionOutboxes[Chunk]) {
+                    if (AdditionInboxes[Light.Chunk].empty()) {
+                        Next.push_back(Light.Chunk);
+                    }
+                    AdditionInboxes[Light.Chunk].push_back(Light.Light);
+                }
+                AdditionOutboxes[Chunk].clear();
+            }
+            Active.swap(Next);
+        }
+
+        // Write the changed light into the voxels.
+        Region Updated;
+        for (const Region& Chunk : Touched) {
+            Updated = Updated.Union(Chunk);
+        }
+        this->Apply(Scene, Updated);
+        return Updated;
+    }
+
+    // Write propagated light into visible, non-emissive voxels.
+    void LightPropagation::Apply(Volume& Scene, const Region& Target) const {
+        const Region Clipped = Target.Intersection(Scene.GetRegion());
+        for (int IndexZ = Clipped.Minimum[2]; IndexZ < Clipped.Maximum[2]; ++IndexZ) {
+            for (int IndexY = Clipped.Minimum[1]; IndexY < Clipped.Maximum[1]; ++IndexY) {
+                for (int IndexX = Clipped.Minimum[0]; IndexX < Clipped.Maximum[0]; ++IndexX) {
+                    Voxel& Value = Scene(IndexX, IndexY, IndexZ);
+
+                    // Empty voxels are skipped so that air stays a single voxel value.
+                    if ((Value.GetAlpha() == 0) || IsEmitter(Value)) {
+                        continue;
+                    }
+                    const std::size_t Index = this->GetIndex(IndexX, IndexY, IndexZ);
+                    if (this->Levels[Index] > AmbientLevel) {
+                        Value.SetLight(this->Levels[Index]);
+                        Value.SetTint(this->Tints[Index]);
+                    }
+                    else {
+                        Value.SetLight(AmbientLevel);
+                        Value.SetTint(0);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,122 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_LIGHTPROPAGATION_HPP
+#define RAYMARCH_LIGHTPROPAGATION_HPP
+
+#include "Region.hpp"
+#include "Volume.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  LightPropagation flood fills light from emissive voxels into the Light and Tint of nearby voxels.
+    /// @note   Plasma voxels are emitters, they emit their own Light level coloured by their own Tint.
+    ///         Light loses one level per voxel travelled, passes through voxels that are not fully opaque,
+    ///         and lights the surface of opaque voxels. The Light of non-emissive voxels is owned by this class.
+    class LightPropagation {
+    public:
+        /// @brief  The light level of voxels that are not reached by any emitter.
+        constexpr static const std::uint8_t AmbientLevel = 0b1000;
+
+        /// @brief  The edge length of the cubic chunks that are lit in parallel.
+        constexpr static const int ChunkSize = 16;
+
+    private:
+        /// @brief  The size of the lit volume.
+        std::array<std::size_t, 3> Size;
+
+        /// @brief  The number of chunks along each axis of the lit volume.
+        std::array<int, 3> ChunkCounts;
+
+        /// @brief  The propagated light level of each voxel.
+        std::vector<std::uint8_t> Levels;
+
+        /// @brief  The tint of the strongest light reaching each voxel.
+        std::vector<std::uint8_t> Tints;
+
+        /// @brief  Positions that have changed since the last propagation.
+        std::vector<std::array<int, 3> > Changed;
+
+    public:
+        /// @brief  Constructor that creates an engine with no light.
+        LightPropagation(void);
+
+    public:
+        /// @brief  Test if a voxel emits light.
+        /// @param  Value - The voxel to test.
+        /// @return True if the voxel is an emitter.
+        static bool IsEmitter(const Voxel& Value);
+
+        /// @brief  Test if light passes through a voxel.
+        /// @param  Value - The voxel to test.
+        /// @return True if the voxel is not fully opaque.
+        static bool IsTransparent(const Voxel& Value);
+
+    public:
+        /// @brief  Discard all light and flood fill the whole volume from its emitters, in parallel across chunks.
+        /// @param  Scene - The volume to light, its size may differ from the last call.
+        void Relight(Volume& Scene);
+
+        /// @brief  Record that a voxel has been added, removed or changed since the last propagation.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        void NotifyChanged(int X, int Y, int Z);
+
+        /// @brief  Record that every voxel within a region may have changed since the last propagation.
+        /// @param  Target - The changed region.
+        void NotifyChanged(const Region& Target);
+
+        /// @brief  Update only the neighbourhood of the changed voxels using removal and addition queues, in parallel across chunks.
+        /// @param  Scene - The volume to light, it must be the volume given to the last call of Relight.
+        /// @return The region of voxels whose Light or Tint may have changed.
+        Region Propagate(Volume& Scene);
+
+    private:
+        /// @brief  Get the index of a voxel in the light arrays.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return The index of the voxel.
+        std::size_t GetIndex(int X, int Y, int Z) const;
+
+        /// @brief  Get the index of the chunk containing a voxel.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return The index of the chunk.
+        std::size_t GetChunkIndex(int X, int Y, int Z) const;
+
+        /// @brief  Write the propagated light into the Light and Tint of the voxels in a region.
+        /// @param  Scene - The lit volume.
+        /// @param  Target - The region to write.
+        void Apply(Volume& Scene, const Region& Target) const;
+    };
+}
+
+#endif // RAYMARCH_LIGHTPROPAGATION_HPP
@@ -22,23 +22,313 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE
 */
 
+#include "Pipeline.hpp"
+#include "RenderFarm.hpp"
 #include "Renderer.hpp"
+#include "SparseVoxelOctree.hpp"
+#include "TileRenderer.hpp"
+#include "Trace.hpp"
 #include "Volume.hpp"
 #include "VolumeFactory.hpp"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <random>
+#include <string>
+#include <thread>
+
+// Render a deterministic map at increasing scene window sizes up to the maximum and report the iteration throughput of each, from the brick atlas and from the octree.
+static void RunBenchmark(GLFWwindow* WindowHandle, int ScreenWidth, int ScreenHeight, const std::array<std::size_t, 3>& MaximumSize) {
+    constexpr static const std::size_t FrameCount = 32;
+    constexpr static const int SampleSpacing = 4;
+
+    std::cout << "Running the benchmark..." << std::endl;
+
+    // The window doubles horizontally every stage and vertically every other stage.
+    std::array<std::size_t, 3> Size = {{64, 32, 64}};
+    for (std::size_t Stage = 0; (Size[0] <= MaximumSize[0]) && (Size[1] <= MaximumSize[1]) && (Size[2] <= MaximumSize[2]); ++Stage) {
+        Raymarch::GameState State(Size);
+
+        // A floor, a sponge of grass and a column every 32 voxels squared, placed the same on every run.
+        const int SizeX = static_cast<int>(Size[0]);
+        const int SizeY = static_cast<int>(Size[1]);
+        const int SizeZ = static_cast<int>(Size[2]);
+        State.AddToMap({{0, 0, 0}}, Raymarch::VolumeFactory::CreateSolid(Size[0], 1, Size[2], Raymarch::Voxel(128, 128, 128, 255)));
+        State.AddToMap({{0, 1, 0}}, Raymarch::VolumeFactory::CreateRandomSponge(Size[0], 3, Size[2], 0.5, Raymarch::Voxel(0, 255, 0, 255)));
+        const Raymarch::Volume Column = Raymarch::VolumeFactory::CreateColumn(16, std::min(30, SizeY - 2), 16, 0.3, Raymarch::Voxel(0, 0, 128, 32));
+        std::default_random_engine RandomGenerator(Stage + 1);
+        for (int Index = 0; Index < (SizeX / 32) * (SizeZ / 32); ++Index) {
+            const int X = static_cast<int>(RandomGenerator() % static_cast<unsigned int>(SizeX / 16)) * 16;
+            const int Z = static_cast<int>(RandomGenerator() % static_cast<unsigned int>(SizeZ / 16)) * 16;
+            State.AddToMap({{X, 1, Z}}, Column);
+        }
+        State.Update(0.0f);
+
+        // The first frame uploads the scene, only the frames after it are timed, the window is split into views of the same camera along each axis.
+        auto TimeFrames = [&](bool OctreeEnabled, std::size_t Split, std::size_t LightingScale, bool CheckerboardEnabled) -> double {
+            Raymarch::Renderer Renderer(ScreenWidth, ScreenHeight, OctreeEnabled, LightingScale, CheckerboardEnabled);
+            std::vector<Raymarch::Renderer::View> Views;
+            for (std::size_t Y = 0; Y < Split; ++Y) {
+                for (std::size_t X = 0; X < Split; ++X) {
+                    Raymarch::Renderer::View Part = Renderer.GetView(State);
+                    Part.Size = {{static_cast<std::size_t>(ScreenWidth) / Split, static_cast<std::size_t>(ScreenHeight) / Split}};
+                    Part.Position = {{X * Part.Size[0], Y * Part.Size[1]}};
+                    Views.push_back(Part);
+                }
+            }
+            Renderer.Render(State, Views);
+            glFinish();
+            const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+            for (std::size_t Frame = 0; Frame < FrameCount; ++Frame) {
+                Renderer.Render(State, Views);
+                glfwSwapBuffers(WindowHandle);
+            }
+            glFinish();
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count() / static_cast<double>(FrameCount);
+        };
+        const double Milliseconds = TimeFrames(false, 1, 1, false);
+        const double OctreeMilliseconds = TimeFrames(true, 1, 1, false);
+        const double SplitMilliseconds = TimeFrames(false, 2, 1, false);
+        const double HalfLightingMilliseconds = TimeFrames(false, 1, 2, false);
+        const double QuarterLightingMilliseconds = TimeFrames(false, 1, 4, false);
+        const double CheckerboardMilliseconds = TimeFrames(false, 1, 1, true);
+
+        // The octree is built from the same scene, its size is compared to the four bytes per voxel of the dense scene.
+        Raymarch::SparseVoxelOctree Octree;
+        const std::chrono::steady_clock::time_point BuildStart = std::chrono::steady_clock::now();
+        Octree.Build(State.GetScene());
+        const double BuildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - BuildStart).count();
+        const double DenseBytes = static_cast<double>(Size[0] * Size[1] * Size[2] * sizeof(Raymarch::Voxel));
+
+        // OpenGL 3.3 cannot count shader iterations, so a grid of the screen rays is replayed through the same traversals on the CPU.
+        std::vector<Raymarch::CollisionMap::RayQuery> Rays;
+        for (int Y = 0; Y < ScreenHeight; Y += SampleSpacing) {
+            for (int X = 0; X < ScreenWidth; X += SampleSpacing) {
+                Raymarch::CollisionMap::RayQuery Ray = State.GetScreenRay({{static_cast<float>(X) + 0.5f, static_cast<float>(Y) + 0.5f}}, {{static_cast<float>(ScreenWidth), static_cast<float>(ScreenHeight)}});
+                for (std::size_t Index = 0; Index < 3; ++Index) {
+                    Ray.Origin[Index] -= static_cast<float>(State.GetSceneOffset()[Index]);
+                }
+                Rays.push_back(Ray);
+            }
+        }
+        auto CastRays = [&](auto Cast, double& CastMilliseconds) -> double {
+            std::vector<Raymarch::CollisionMap::RayHit> Hits;
+            const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+            Cast(Hits);
+            CastMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+            std::size_t Steps = 0;
+            for (const Raymarch::CollisionMap::RayHit& Hit : Hits) {
+                Steps += static_cast<std::size_t>(Hit.Steps);
+            }
+            return static_cast<double>(Steps) / static_cast<double>(std::max<std::size_t>(Hits.size(), 1));
+        };
+        double CastMilliseconds = 0.0;
+        double OctreeCastMilliseconds = 0.0;
+        const double StepsPerRay = CastRays([&](std::vector<Raymarch::CollisionMap::RayHit>& Hits) { State.GetCollisionMap().CastRay(Rays, Hits); }, CastMilliseconds);
+        const double OctreeStepsPerRay = CastRays([&](std::vector<Raymarch::CollisionMap::RayHit>& Hits) { Octree.CastRay(Rays, Hits); }, OctreeCastMilliseconds);
+
+        const double RaysPerSecond = static_cast<double>(ScreenWidth * ScreenHeight) * 1000.0 / std::max(Milliseconds, 1e-6);
+        const double OctreeRaysPerSecond = static_cast<double>(ScreenWidth * ScreenHeight) * 1000.0 / std::max(OctreeMilliseconds, 1e-6);
+        const double SampleRays = static_cast<double>(Rays.size());
+
+        std::cout << "  Scene " << Size[0] << "x" << Size[1] << "x" << Size[2] << ": "
+                  << Milliseconds << " ms/frame, "
+                  << RaysPerSecond / 1e6 << " Mrays/s, "
+                  << StepsPerRay << " steps/ray, "
+                  << RaysPerSecond * StepsPerRay / 1e6 << " Msteps/s, "
+                  << SampleRays / std::max(CastMilliseconds, 1e-6) / 1e3 << " CPU Mrays/s, "
+                  << DenseBytes / (1024.0 * 1024.0) << " MB." << std::endl;
+        std::cout << "    Octree: "
+                  << OctreeMilliseconds << " ms/frame, "
+                  << OctreeRaysPerSecond / 1e6 << " Mrays/s, "
+                  << OctreeStepsPerRay << " steps/ray, "
+                  << OctreeRaysPerSecond * OctreeStepsPerRay / 1e6 << " Msteps/s, "
+                  << SampleRays / std::max(OctreeCastMilliseconds, 1e-6) / 1e3 << " CPU Mrays/s, "
+                  << static_cast<double>(Octree.GetByteCount()) / (1024.0 * 1024.0) << " MB in "
+                  << Octree.GetNodeCount() << " nodes built in "
+                  << BuildMilliseconds << " ms." << std::endl;
+        std::cout << "    Four views of a quarter of the window sharing one upload: "
+                  << SplitMilliseconds << " ms/frame." << std::endl;
+        std::cout << "    Lighting at half and quarter resolution: "
+                  << HalfLightingMilliseconds << " and "
+                  << QuarterLightingMilliseconds << " ms/frame." << std::endl;
+        std::cout << "    Half of the pixels marched in a checkerboard and reconstructed: "
+                  << CheckerboardMilliseconds << " ms/frame." << std::endl;
+
+        Size[0] *= 2;
+        Size[2] *= 2;
+        if ((Stage % 2) == 1) {
+            Size[1] *= 2;
+        }
+    }
+
+    std::cout << "Finished the benchmark." << std::endl;
+    std::cout << "----------" << std::endl;
+}
+
+// Fill the map of a game state with the environment explored by the player, the scene follows once the state is updated.
+static void CreateEnvironment(Raymarch::GameState& State) {
+    std::cout << "  Creating a floor volume..." << std::endl;
+
+    // Build the floor
+    Raymarch::Voxel FloorVoxel = Raymarch::Voxel(128, 128, 128, 255);
+    Raymarch::Volume Floor = Raymarch::VolumeFactory::CreateSolid(512, 1, 512, FloorVoxel);
+    State.AddToMap({{0, 0, 0}}, Floor);
+
+    std::cout << "  Creating a grass volume..." << std::endl;
+
+	// Build the grass brownie.
+    Raymarch::Voxel GrassVoxel = Raymarch::Voxel(0, 255, 0, 255);
+    Raymarch::Volume Grass = Raymarch::VolumeFactory::CreateRandomSponge(512, 3, 512, 0.5, GrassVoxel);
+    State.AddToMap({{0, 1, 0}}, Grass);
+
+    std::cout << "  Creating a sphere volume..." << std::endl;
+
+    Raymarch::Voxel SphereVoxel = Raymarch::Voxel(255, 0, 0, 255);
+    Raymarch::Volume Sphere = Raymarch::VolumeFactory::CreateEllipsoid(16, 16, 16, SphereVoxel);
+    State.AddToMap({{64, 8, 64}}, Sphere);
+
+    std::cout << "  Creating a column volume..." << std::endl;
+
+    Raymarch::Voxel ColumnVoxel = Raymarch::Voxel(0, 0, 128, 32);
+    Raymarch::Volume Column = Raymarch::VolumeFactory::CreateColumn(16, 30, 16, 0.3, ColumnVoxel);
+
+    std::cout << "  Creating random locations for 100 columns..." << std::endl;
+
+    std::default_random_engine RandomGenerator;
+    RandomGenerator.seed(std::random_device()());
+    std::uniform_real_distribution<double> RandomDistribution(0, 1);
+
+	// Generate random positions for 100 columns.
+	for (int i = 0; i < 100; i++) {
+        int x = std::floor(RandomDistribution(RandomGenerator) * 32) * 16;
+        int z = std::floor(RandomDistribution(RandomGenerator) * 32) * 16;
+        State.AddToMap({{x, 1, z}}, Column);
+	}
+
+    std::cout << "  Creating some coloured block volumes..." << std::endl;
+
+    Raymarch::Voxel BlockVoxelRed   = Raymarch::Voxel(255,   0,   0, 64);
+    Raymarch::Voxel BlockVoxelGreen = Raymarch::Voxel(  0, 255,   0, 64);
+    Raymarch::Voxel BlockVoxelBlue  = Raymarch::Voxel(  0,   0, 255, 64);
+    Raymarch::Voxel BlockVoxelBlack = Raymarch::Voxel(  0,   0,   0, 64);
+    Raymarch::Voxel BlockVoxelGrey  = Raymarch::Voxel(128, 128, 128, 64);
+    Raymarch::Voxel BlockVoxelWhite = Raymarch::Voxel(255, 255, 255, 64);
+    Raymarch::Volume BlockRed   = Raymarch::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelRed);
+    Raymarch::Volume BlockGreen = Raymarch::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelGreen);
+    Raymarch::Volume BlockBlue  = Raymarch::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelBlue);
+    Raymarch::Volume BlockBlack = Raymarch::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelBlack);
+    Raymarch::Volume BlockGrey  = Raymarch::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelGrey);
+    Raymarch::Volume BlockWhite = Raymarch::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelWhite);
+    State.AddToMap({{ 8 * 2 + 80, 8, 64}}, BlockRed  );
+    State.AddToMap({{12 * 2 + 80, 8, 64}}, BlockGreen);
+    State.AddToMap({{16 * 2 + 80, 8, 64}}, BlockBlue );
+    State.AddToMap({{20 * 2 + 80, 8, 64}}, BlockBlack);
+    State.AddToMap({{24 * 2 + 80, 8, 64}}, BlockGrey );
+    State.AddToMap({{28 * 2 + 80, 8, 64}}, BlockWhite);
+
+    std::cout << "  Creating some lamp volumes..." << std::endl;
+
+    // Plasma voxels emit light into their surroundings.
+    Raymarch::Voxel LampVoxelYellow = Raymarch::Voxel(255, 255, 0, 255);
+    LampVoxelYellow.SetState(Raymarch::Voxel::StateType::Plasma);
+    LampVoxelYellow.SetLight(0b1111);
+    LampVoxelYellow.SetTint(0b110);
+    Raymarch::Voxel LampVoxelCyan = Raymarch::Voxel(0, 255, 255, 255);
+    LampVoxelCyan.SetState(Raymarch::Voxel::StateType::Plasma);
+    LampVoxelCyan.SetLight(0b1111);
+    LampVoxelCyan.SetTint(0b011);
+    Raymarch::Volume LampYellow = Raymarch::VolumeFactory::CreateSolid(2, 2, 2, LampVoxelYellow);
+    Raymarch::Volume LampCyan   = Raymarch::VolumeFactory::CreateSolid(2, 2, 2, LampVoxelCyan);
+    State.AddToMap({{ 72, 4,  96}}, LampYellow);
+    State.AddToMap({{120, 4,  48}}, LampCyan  );
+    State.AddToMap({{ 40, 4,  40}}, LampYellow);
+    State.AddToMap({{160, 4, 100}}, LampCyan  );
+
+    std::cout << "  Creating a water volume..." << std::endl;
+
+    // Liquid voxels are simulated, this block falls and spreads across the grass.
+    Raymarch::Voxel WaterVoxel = Raymarch::Voxel(32, 96, 224, 255);
+    WaterVoxel.SetState(Raymarch::Voxel::StateType::Liquid);
+    WaterVoxel.SetFillLevel(0b111);
+    Raymarch::Volume Water = Raymarch::VolumeFactory::CreateSolid(8, 8, 8, WaterVoxel);
+    State.AddToMap({{ 96, 12, 112}}, Water);
+
+    std::cout << "  Creating a procedural terrain..." << std::endl;
+
+    // The terrain is generated in the background around the player and reaches beyond the map, the map is kept on top of it.
+    State.SetTerrain(static_cast<std::uint32_t>(RandomGenerator()), 64 * 1024 * 1024, 64 * 1024 * 1024, 128 * 1024 * 1024);
+
+    std::cout << "  Creating the clipmap cascades..." << std::endl;
+
+    // Beyond the scene the world is rendered from four cascades of doubling cell size, reaching a kilometre from the player.
+    State.SetCascadeCount(4);
+}
+
+// Render one image of the environment on the processor, split into tiles raymarched by worker processes, and save it.
+static bool RunRender(const std::string& Executable, Raymarch::GameState& State, const std::string& ImagePath, const std::array<std::size_t, 2>& ImageSize, std::size_t WorkerCount) {
+    constexpr static const std::size_t MaximumUpdates = 600;
+
+    std::cout << "Rendering an image on the processor..." << std::endl;
+
+    std::cout << "  Waiting for the terrain around the player..." << std::endl;
+
+    // Update until no chunk is queued and an update no longer changes the scene, or give up after half a minute.
+    for (std::size_t Update = 0; Update < MaximumUpdates; ++Update) {
+        const std::uint64_t SceneVersion = State.GetSceneVersion();
+        State.Update(0.0f);
+        const bool Queued = (State.GetStreamer() != nullptr) && (State.GetStreamer()->GetMetrics().QueueDepth > 0);
+        if ((!Queued) && (State.GetSceneVersion() == SceneVersion)) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    std::cout << "  Building the octree of the scene..." << std::endl;
+
+    const auto BuildStart = std::chrono::steady_clock::now();
+    Raymarch::SparseVoxelOctree Octree;
+    Octree.Build(State.GetScene());
+    const double BuildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - BuildStart).count();
+
+    std::cout << "  Octree: " << (static_cast<double>(Octree.GetByteCount()) / (1024.0 * 1024.0)) << " MB built in " << BuildMilliseconds << " ms." << std::endl;
+
+    std::cout << "  Rendering " << ImageSize[0] << "x" << ImageSize[1] << " with " << WorkerCount << " workers..." << std::endl;
+
+    const auto RenderStart = std::chrono::steady_clock::now();
+    std::vector<std::uint8_t> Image;
+    Raymarch::RenderFarm::Statistics Report;
+    if (!Raymarch::RenderFarm::Render(Executable, Octree, Raymarch::TileRenderer::GetCamera(State, ImageSize), WorkerCount, Image, Report)) {
+        std::cerr << "Failed to render the image." << std::endl;
+        return false;
+    }
+    const double RenderMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - RenderStart).count();
+
+    std::cout << "  Rendered " << Report.TileCount << " tiles in " << RenderMilliseconds << " ms: "
+              << Report.WorkerCount << " workers connected, "
+              << Report.WorkerFailures << " failed, "
+              << Report.RequeuedTiles << " tiles requeued, "
+              << Report.LocalTiles << " tiles rendered locally." << std::endl;
+
+    if (!Raymarch::RenderFarm::SaveImage(ImagePath, ImageSize, Image)) {
+        std::cerr << "Failed to save the image to: " << ImagePath << std::endl;
+        return false;
+    }
+
+    std::cout << "Finished rendering to: " << ImagePath << std::endl;
+    std::cout << "----------" << std::endl;
+
+    return true;
+}
 
 // The main entry point.
 int main(int ArgumentCount, char* ArgumentArray[]) {
-    // Cast the main arguments to void to avoid unused variable warnings.
-    static_cast<void>(ArgumentCount);
-    static_cast<void>(ArgumentArray);
-
     // Store the project name for use when printing output.
     constexpr static const char* ProjectName = "Raymarch";
 
@@ -49,6 +339,108 @@ int main(int ArgumentCount, char* ArgumentArray[]) {
     std::cout << "Build:    " <<  __DATE__ << " @ " << __TIME__ << std::endl;
     std::cout << "----------" << std::endl;
 
+    ///////////////////////////////////////////////////////////////////////////
+    /// Parse the command line arguments.                                    //
+    ///////////////////////////////////////////////////////////////////////////
+
+    // When set the trace of the run is written to this path on exit.
+    std::string TracePath;
+
+    // When set the game state is updated on a worker thread while the previous frame is rendered.
+    bool Pipelined = false;
+
+    // The size of the scene window, clamped to the largest the driver can hold once a context exists.
+    std::array<std::size_t, 3> SceneSize = {{128, 32, 128}};
+    bool SceneSizeSet = false;
+
+    // When set the iteration throughput is measured at increasing scene sizes, up to the scene size when one is given, instead of running.
+    bool Benchmark = false;
+
+    // When set the scene is rendered from a sparse voxel octree rather than the brick atlas.
+    bool OctreeEnabled = false;
+
+    // When set an overhead view of the player is drawn in the corner of the window.
+    bool MinimapEnabled = false;
+
+    // The divisor of the resolution the first voxel of each pixel is lit at, one lights every pixel.
+    std::size_t LightingScale = 1;
+
+    // When set half of the pixels are marched each frame in alternating checkerboard patterns and the rest are reconstructed.
+    bool CheckerboardEnabled = false;
+
+    // When set one image is raymarched on the processor by worker processes and saved here, without a window.
+    std::string RenderPath;
+    std::array<std::size_t, 2> RenderSize = {{640, 480}};
+    std::size_t RenderWorkers = 4;
+
+    // When set this process is a render worker serving tiles to the coordinator listening on this socket.
+    std::string WorkerSocket;
+
+    for (int ArgumentIndex = 1; ArgumentIndex < ArgumentCount; ++ArgumentIndex) {
+        const std::string Argument = ArgumentArray[ArgumentIndex];
+        if ((Argument == "--trace") && (ArgumentIndex + 1 < ArgumentCount)) {
+            TracePath = ArgumentArray[++ArgumentIndex];
+        }
+        else if (Argument == "--pipelined") {
+            Pipelined = true;
+        }
+        else if ((Argument == "--scene") && (ArgumentIndex + 3 < ArgumentCount)) {
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                SceneSize[Index] = static_cast<std::size_t>(std::max(std::atoi(ArgumentArray[++ArgumentIndex]), 1));
+            }
+            SceneSizeSet = true;
+        }
+        else if (Argument == "--benchmark") {
+            Benchmark = true;
+        }
+        else if (Argument == "--octree") {
+            OctreeEnabled = true;
+        }
+        else if (Argument == "--minimap") {
+            MinimapEnabled = true;
+        }
+        else if ((Argument == "--lighting") && (ArgumentIndex + 1 < ArgumentCount)) {
+            LightingScale = static_cast<std::size_t>(std::max(std::atoi(ArgumentArray[++ArgumentIndex]), 1));
+        }
+        else if (Argument == "--checkerboard") {
+            CheckerboardEnabled = true;
+        }
+        else if ((Argument == "--render") && (ArgumentIndex + 4 < ArgumentCount)) {
+            RenderPath = ArgumentArray[++ArgumentIndex];
+            for (std::size_t Index = 0; Index < 2; ++Index) {
+                RenderSize[Index] = static_cast<std::size_t>(std::max(std::atoi(ArgumentArray[++ArgumentIndex]), 1));
+            }
+            RenderWorkers = static_cast<std::size_t>(std::max(std::atoi(ArgumentArray[++ArgumentIndex]), 0));
+        }
+        else if ((Argument == "--worker") && (ArgumentIndex + 1 < ArgumentCount)) {
+            WorkerSocket = ArgumentArray[++ArgumentIndex];
+        }
+        else {
+            std::cerr << "Usage: " << ArgumentArray[0] << " [--trace <trace.json>] [--pipelined] [--scene <x> <y> <z>] [--benchmark] [--octree] [--minimap] [--lighting <scale>] [--checkerboard] [--render <image.ppm> <width> <height> <workers>] [--worker <socket>]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // A worker needs no window, it serves tiles until the coordinator closes its connection.
+    if (!WorkerSocket.empty()) {
+        return Raymarch::RenderFarm::RunWorker(WorkerSocket) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // Start tracing before anything is created so that the environment generation is captured.
+    if (!TracePath.empty()) {
+        std::cout << "Tracing to: " << TracePath << std::endl;
+        std::cout << "----------" << std::endl;
+        Raymarch::Trace::SetThreadName("Main");
+        Raymarch::Trace::Enable();
+    }
+
+    // An offline render needs no window either, the scene is built as normal and handed to the workers.
+    if (!RenderPath.empty()) {
+        Raymarch::GameState State(SceneSize);
+        CreateEnvironment(State);
+        return RunRender(ArgumentArray[0], State, RenderPath, RenderSize, RenderWorkers) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     ///////////////////////////////////////////////////////////////////////////
     /// Initialise the GLFW.                                                 //
     ///////////////////////////////////////////////////////////////////////////
@@ -157,77 +549,35 @@ int main(int ArgumentCount, char* ArgumentArray[]) {
     glBindVertexArray(VA);
     assert(glGetError() == GL_NO_ERROR);
 
+    std::cout << "  Querying the largest scene..." << std::endl;
+
+    // The scene and occlusion are 3D textures, the cascades stack their levels along the height of another.
+    const std::array<std::size_t, 3> MaximumSceneSize = Raymarch::Renderer::GetMaximumSceneSize(4);
+    std::cout << "  Largest scene: " << MaximumSceneSize[0] << "x" << MaximumSceneSize[1] << "x" << MaximumSceneSize[2] << "." << std::endl;
+    for (std::size_t Index = 0; Index < 3; ++Index) {
+        SceneSize[Index] = std::min(SceneSize[Index], MaximumSceneSize[Index]);
+    }
+
     std::cout << "Finished configuring OpenGL." << std::endl;
     std::cout << "----------" << std::endl;
 
+    if (Benchmark) {
+        RunBenchmark(WindowHandle, ScreenWidth, ScreenHeight, SceneSizeSet ? SceneSize : MaximumSceneSize);
+        glfwTerminate();
+        return EXIT_SUCCESS;
+    }
+
     ///////////////////////////////////////////////////////////////////////////
     /// Create an environment.                                               //
     ///////////////////////////////////////////////////////////////////////////
 
     std::cout << "Creating an environment..." << std::endl;
 
-    std::cout << "  Creating a game state..." << std::endl;
-
-    Raymarch::GameState State(std::array<std::size_t, 3>{{128, 32, 128}});
-
-    std::cout << "  Creating a floor volume..." << std::endl;
-
-    // Build the floor
-    Raymarch::Voxel FloorVoxel = Raymarch::Voxel(128, 128, 128, 255);
-    Raymarch::Volume Floor = Raymarch::VolumeFactory::CreateSolid(512, 1, 512, FloorVoxel);
-    State.AddToMap({{0, 0, 0}}, Floor);
-
-    std::cout << "  Creating a grass volume..." << std::endl;
-
-	// Build the grass brownie.
-    Raymarch::Voxel GrassVoxel = Raymarch::Voxel(0, 255, 0, 255);
-    Raymarch::Volume Grass = Raymarch::VolumeFactory::CreateRandomSponge(512, 3, 512, 0.5, GrassVoxel);
-    State.AddToMap({{0, 1, 0}}, Grass);
-
-    std::cout << "  Creating a sphere volume..." << std::endl;
-
-    Raymarch::Voxel SphereVoxel = Raymarch::Voxel(255, 0, 0, 255);
-    Raymarch::Volume Sphere = Raymarch::VolumeFactory::CreateEllipsoid(16, 16, 16, SphereVoxel);
-    State.AddToMap({{64, 8, 64}}, Sphere);
-
-    std::cout << "  Creating a column volume..." << std::endl;
+    std::cout << "  Creating a game state of " << SceneSize[0] << "x" << SceneSize[1] << "x" << SceneSize[2] << "..." << std::endl;
 
-    Raymarch::Voxel ColumnVoxel = Raymarch::Voxel(0, 0, 128, 32);
-    Raymarch::Volume Column = Raymarch::VolumeFactory::CreateColumn(16, 30, 16, 0.3, ColumnVoxel);
+    Raymarch::GameState State(SceneSize);
 
-    std::cout << "  Creating random locations for 100 columns..." << std::endl;
-
-    std::default_random_engine RandomGenerator;
-    RandomGenerator.seed(std::random_device()());
-    std::uniform_real_distribution<double> RandomDistribution(0, 1);
-
-	// Generate random positions for 100 columns.
-	for (int i = 0; i < 100; i++) {
-        int x = std::floor(RandomDistribution(RandomGenerator) * 32) * 16;
-        int z = std::floor(RandomDistribution(RandomGenerator) * 32) * 16;
-        State.AddToMap({{x, 1, z}}, Column);
-	}
-
-    std::cout << "  Creating some coloured block volumes..." << std::endl;
-
-    Raymarch::Voxel BlockVoxelRed   = Raymarch::Voxel(255,   0,   0, 64);
-    Raymarch::Voxel BlockVoxelGreen = Raymarch::Voxel(  0, 255,   0, 64);
-    Raymarch::Voxel BlockVoxelBlue  = Raymarch::Voxel(  0,   0, 255, 64);
-    Raymarch::Voxel BlockVoxelBlack = Raymarch::Voxel(  0,   0,   0, 64);
-    Raymarch::Voxel BlockVoxelGrey  = Raymarch::Voxel(128, 128, 128, 64);
-    Raymarch::Voxel BlockVoxelWhite = Raymarch::Voxel(255, 255, 255, 64);
-    Raymarch::Volume BlockRed   = Raymarch::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelRed);
-    Raymarch::Volume BlockGreen = Raymarch::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelGreen);
-    Raymarch::Volume BlockBlue  = Raymarch::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelBlue);
-    Raymarch::Volume BlockBlack = Raymarch::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelBlack);
-    Raymarch::Volume BlockGrey  = Raymarch::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelGrey);
-    Raymarch::Volume BlockWhite = Raymarch::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelWhite);
-    State.AddToMap({{ 8 * 2 + 80, 8, 64}}, BlockRed  );
-    State.AddToMap({{12 * 2 + 80, 8, 64}}, BlockGreen);
-    State.AddToMap({{16 * 2 + 80, 8, 64}}, BlockBlue );
-    State.AddToMap({{20 * 2 + 80, 8, 64}}, BlockBlack);
-    State.AddToMap({{24 * 2 + 80, 8, 64}}, BlockGrey );
-    State.AddToMap({{28 * 2 + 80, 8, 64}}, BlockWhite);
+    CreateEnvironment(State);
 
     std::cout << "Finished creating an environment." << std::endl;
     std::cout << "----------" << std::endl;
@@ -238,21 +588,32 @@ int main(int ArgumentCount, char* ArgumentArray[]) {
 
     std::cout << "Creating a renderer..." << std::endl;
 
-    Raymarch::Renderer Renderer(ScreenWidth, ScreenHeight);
+    Raymarch::Renderer Renderer(ScreenWidth, ScreenHeight, OctreeEnabled, LightingScale, CheckerboardEnabled);
 
     std::cout << "Finished creating a renderer." << std::endl;
     std::cout << "----------" << std::endl;
 
     ///////////////////////////////////////////////////////////////////////////
-    /// Attach the keyboard callback.                                        //
+    /// Create a pipeline.                                                   //
     ///////////////////////////////////////////////////////////////////////////
 
-    std::cout << "Attaching the keyboard callback..." << std::endl;
+    std::cout << "Creating a " << (Pipelined ? "pipelined" : "serial") << " update pipeline..." << std::endl;
+
+    Raymarch::Pipeline Pipeline(State, Pipelined);
+
+    std::cout << "Finished creating a pipeline." << std::endl;
+    std::cout << "----------" << std::endl;
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// Attach the keyboard and mouse callbacks.                             //
+    ///////////////////////////////////////////////////////////////////////////
 
-    // To handle key presses during the rendering loop the gamestate is set as a user pointer in GLFW.
-    glfwSetWindowUserPointer(WindowHandle, &State);
+    std::cout << "Attaching the keyboard and mouse callbacks..." << std::endl;
 
-    // When "glfwPollEvents()" is called GLFW calls this callback which in turn sends input to the state.
+    // To handle key presses during the rendering loop the pipeline is set as a user pointer in GLFW.
+    glfwSetWindowUserPointer(WindowHandle, &Pipeline);
+
+    // When "glfwPollEvents()" is called GLFW calls this callback which in turn queues input for the state.
     glfwSetKeyCallback(WindowHandle, [](GLFWwindow* WindowHandle, int Key, int ScanCode, int Action, int Mode){
         // Unused parameters.
         static_cast<void>(ScanCode);
@@ -265,6 +626,8 @@ int main(int ArgumentCount, char* ArgumentArray[]) {
             case GLFW_KEY_DOWN: ConvertedKey = Raymarch::GameState::KeyType::Down; break;
             case GLFW_KEY_LEFT: ConvertedKey = Raymarch::GameState::KeyType::Left; break;
             case GLFW_KEY_RIGHT: ConvertedKey = Raymarch::GameState::KeyType::Right; break;
+            case GLFW_KEY_F5: ConvertedKey = Raymarch::GameState::KeyType::Save; break;
+            case GLFW_KEY_F9: ConvertedKey = Raymarch::GameState::KeyType::Load; break;
         }
         // Convert the GLFW action into the gamestate type.
         Raymarch::GameState::KeyStateType ConvertedAction;
@@ -273,13 +636,46 @@ int main(int ArgumentCount, char* ArgumentArray[]) {
             case GLFW_PRESS: ConvertedAction = Raymarch::GameState::KeyStateType::Press; break;
             case GLFW_RELEASE: ConvertedAction = Raymarch::GameState::KeyStateType::Release; break;
         }
-        // Get the stored gamestate pointer.
-        Raymarch::GameState& State = *static_cast<Raymarch::GameState*>(glfwGetWindowUserPointer(WindowHandle));
-        // Input the pressed key to the gamestate.
-        State.Input(ConvertedKey, ConvertedAction);
+        // Get the stored pipeline pointer.
+        Raymarch::Pipeline& Pipeline = *static_cast<Raymarch::Pipeline*>(glfwGetWindowUserPointer(WindowHandle));
+        // Queue the pressed key for the next gamestate update.
+        Pipeline.Input(ConvertedKey, ConvertedAction);
+    });
+
+    // Mouse clicks edit the voxel under the cursor.
+    glfwSetMouseButtonCallback(WindowHandle, [](GLFWwindow* WindowHandle, int Button, int Action, int Mode){
+        // Unused parameters.
+        static_cast<void>(Mode);
+        // Only presses edit.
+        if (Action != GLFW_PRESS) {
+            return;
+        }
+        // Convert the GLFW button into the gamestate type.
+        Raymarch::GameState::ButtonType ConvertedButton;
+        switch (Button) {
+            default: return;
+            case GLFW_MOUSE_BUTTON_LEFT: ConvertedButton = Raymarch::GameState::ButtonType::Primary; break;
+            case GLFW_MOUSE_BUTTON_RIGHT: ConvertedButton = Raymarch::GameState::ButtonType::Secondary; break;
+        }
+        // GLFW measures the cursor from the top left corner, the shader measures pixels from the bottom left corner.
+        double CursorX = 0.0;
+        double CursorY = 0.0;
+        glfwGetCursorPos(WindowHandle, &CursorX, &CursorY);
+        int WindowWidth = 0;
+        int WindowHeight = 0;
+        glfwGetWindowSize(WindowHandle, &WindowWidth, &WindowHeight);
+        if ((WindowWidth <= 0) || (WindowHeight <= 0)) {
+            return;
+        }
+        const std::array<float, 2> ScreenPosition = {{ static_cast<float>(CursorX), static_cast<float>(WindowHeight) - static_cast<float>(CursorY) }};
+        const std::array<float, 2> ScreenResolution = {{ static_cast<float>(WindowWidth), static_cast<float>(WindowHeight) }};
+        // Get the stored pipeline pointer.
+        Raymarch::Pipeline& Pipeline = *static_cast<Raymarch::Pipeline*>(glfwGetWindowUserPointer(WindowHandle));
+        // Queue the click for the next gamestate update.
+        Pipeline.Input(ConvertedButton, ScreenPosition, ScreenResolution);
     });
 
-    std::cout << "Finished attaching the keyboard callback." << std::endl;
+    std::cout << "Finished attaching the keyboard and mouse callbacks." << std::endl;
     std::cout << "----------" << std::endl;
 
     ///////////////////////////////////////////////////////////////////////////
@@ -290,6 +686,8 @@ int main(int ArgumentCount, char* ArgumentArray[]) {
 
     // Run the update and render loop until the escape key is pressed or the window is closed.
     while ((glfwGetKey(WindowHandle, GLFW_KEY_ESCAPE) != GLFW_PRESS) && (glfwWindowShouldClose(WindowHandle) == 0)) {
+        RAYMARCH_TRACE_SCOPE("Frame");
+
         // Delta time
         static float LastFrameTime = static_cast<float>(glfwGetTime());
         float ThisFrameTime = static_cast<float>(glfwGetTime());
@@ -310,32 +708,66 @@ int main(int ArgumentCount, char* ArgumentArray[]) {
         #endif
 
         //#define AVOID_OLD_GLFWBUG 1
-        #ifdef AVOID_OLD_GLFWBUG
-            // Call this 100 times to try and avoid a GLFW bug and prevent duplicate key presses.
-            // This is only required if the FPS of the renderer is low ( < 30ish).
-            // The bug has been fixed in modern versions of GLFW. ( https://github.com/glfw/glfw/issues/747 )
-            for (std::size_t I = 0; I < 100; ++I) {
+        {
+            RAYMARCH_TRACE_SCOPE("PollEvents");
+            #ifdef AVOID_OLD_GLFWBUG
+                // Call this 100 times to try and avoid a GLFW bug and prevent duplicate key presses.
+                // This is only required if the FPS of the renderer is low ( < 30ish).
+                // The bug has been fixed in modern versions of GLFW. ( https://github.com/glfw/glfw/issues/747 )
+                for (std::size_t I = 0; I < 100; ++I) {
+                    // Poll for events.
+                    glfwPollEvents();
+                }
+            #else
                 // Poll for events.
                 glfwPollEvents();
-            }
-        #else
-            // Poll for events.
-            glfwPollEvents();
-        #endif
-
-        // Update state.
-        State.Update(DeltaTime);
+            #endif
+        }
 
-        // Draw state scene, the scene is already linked by reference to the renderer.
-        Renderer.Render(State);
+        // Get the next frame, when pipelined the following frame is composed while this one is rendered.
+        const Raymarch::GameState& Frame = Pipeline.BeginFrame(DeltaTime);
+
+        // Draw the frame scene, then release it so the next frame can be published.
+        if (MinimapEnabled) {
+            // The minimap looks down on the camera target from above, tilted slightly as the camera cannot look straight down.
+            Raymarch::Renderer::View Minimap = Renderer.GetView(Frame);
+            Minimap.Size = {{ScreenWidth / 4, ScreenHeight / 4}};
+            Minimap.Position = {{ScreenWidth - Minimap.Size[0], ScreenHeight - Minimap.Size[1]}};
+            Minimap.CameraPosition = {{Frame.GetCameraTarget()[0], Frame.GetCameraTarget()[1] + 96.0f, Frame.GetCameraTarget()[2] - 1.0f}};
+            Minimap.FogDistance += 96.0f;
+            Renderer.Render(Frame, {Renderer.GetView(Frame), Minimap});
+        }
+        else {
+            Renderer.Render(Frame);
+        }
+        Pipeline.EndFrame();
 
         // Swap buffers.
-        glfwSwapBuffers(WindowHandle);
+        {
+            RAYMARCH_TRACE_SCOPE("SwapBuffers");
+            glfwSwapBuffers(WindowHandle);
+        }
     }
 
     std::cout << "Finished the rendering loop." << std::endl;
     std::cout << "----------" << std::endl;
 
+    ///////////////////////////////////////////////////////////////////////////
+    /// Write the trace.                                                     //
+    ///////////////////////////////////////////////////////////////////////////
+
+    if (!TracePath.empty()) {
+        std::cout << "Writing the trace..." << std::endl;
+
+        Raymarch::Trace::Disable();
+        if (!Raymarch::Trace::Write(TracePath)) {
+            std::cerr << "Failed to write the trace to: " << TracePath << std::endl;
+        }
+
+        std::cout << "Finished writing the trace." << std::endl;
+        std::cout << "----------" << std::endl;
+    }
+
     // Return a successful exit status.
     return EXIT_SUCCESS;
 }
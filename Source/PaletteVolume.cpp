@@ -0,0 +1,215 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "PaletteVolume.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Raymarch {
+    // Constructor for an empty palette volume.
+    PaletteVolume::PaletteVolume(void)
+        : Size{{0, 0, 0}}
+        , IndexWidth(1)
+        , PaletteVersion(0) {
+    }
+
+    // Get the size.
+    const std::array<std::size_t, 3>& PaletteVolume::GetSize(void) const {
+        return this->Size;
+    }
+
+    // Get the index width.
+    std::size_t PaletteVolume::GetIndexWidth(void) const {
+        return this->IndexWidth;
+    }
+
+    // Get the index data.
+    const std::uint8_t* PaletteVolume::data(void) const {
+        return this->Indices.data();
+    }
+
+    // Get the palette.
+    const std::vector<Voxel>& PaletteVolume::GetPalette(void) const {
+        return this->Palette;
+    }
+
+    // Get the palette version.
+    std::uint64_t PaletteVolume::GetPaletteVersion(void) const {
+        return this->PaletteVersion;
+    }
+
+    // Decode a voxel from its index.
+    Voxel PaletteVolume::Get(std::size_t X, std::size_t Y, std::size_t Z) const {
+        const std::size_t Index = X + this->Size[0] * (Y + this->Size[1] * Z);
+        switch (this->IndexWidth) {
+            case 1: {
+                return this->Palette[this->Indices[Index]];
+            }
+            case 2: {
+                std::uint16_t PaletteIndex;
+                std::memcpy(&PaletteIndex, &this->Indices[Index * 2], sizeof(PaletteIndex));
+                return this->Palette[PaletteIndex];
+            }
+            default: {
+                std::uint32_t Bits;
+                std::memcpy(&Bits, &this->Indices[Index * 4], sizeof(Bits));
+                return Voxel::FromBits(Bits);
+            }
+        }
+    }
+
+    // Encode a whole volume, runs of equal voxels only look up the palette once.
+    void PaletteVolume::Encode(const Volume& Source) {
+        RAYMARCH_TRACE_SCOPE("PaletteVolume::Encode");
+
+        this->Size = Source.GetSize();
+        const std::size_t Count = this->Size[0] * this->Size[1] * this->Size[2];
+        this->Palette.clear();
+        this->Lookup.clear();
+        ++this->PaletteVersion;
+
+        // Find the palette index of every voxel, stopping if there are too many distinct values.
+        std::vector<std::uint32_t> PaletteIndices(Count);
+        const Voxel* Voxels = Source.data();
+        std::uint32_t PreviousBits = 0;
+        std::uint32_t PreviousIndex = 0;
+        bool HasPrevious = false;
+        for (std::size_t Index = 0; Index < Count; ++Index) {
+            const std::uint32_t Bits = Voxels[Index].GetBits();
+            if (!HasPrevious || (Bits != PreviousBits)) {
+                PreviousIndex = this->FindOrAdd(Voxels[Index]);
+                PreviousBits = Bits;
+                HasPrevious = true;
+                if (this->Palette.size() > MaximumPaletteSize) {
+                    break;
+                }
+            }
+            PaletteIndices[Index] = PreviousIndex;
+        }
+
+        // Store the narrowest indices, or the raw voxels.
+        this->IndexWidth = (this->Palette.size() <= 256) ? 1 : ((this->Palette.size() <= MaximumPaletteSize) ? 2 : 4);
+        this->Indices.resize(Count * this->IndexWidth);
+        if (this->IndexWidth == 4) {
+            this->Palette.clear();
+            this->Lookup.clear();
+            std::memcpy(this->Indices.data(), Voxels, Count * sizeof(Voxel));
+            return;
+        }
+        for (std::size_t Index = 0; Index < Count; ++Index) {
+            this->SetIndex(Index, PaletteIndices[Index]);
+        }
+    }
+
+    // Encode a changed region, the palette only grows so existing indices stay valid.
+    bool PaletteVolume::Update(const Volume& Source, const Region& Changed) {
+        if (Source.GetSize() != this->Size) {
+            this->Encode(Source);
+            return true;
+        }
+        const Region Clipped = Changed.Intersection(Source.GetRegion());
+        if (Clipped.IsEmpty()) {
+            return false;
+        }
+
+        RAYMARCH_TRACE_SCOPE("PaletteVolume::Update");
+
+        const std::size_t PreviousPaletteSize = this->Palette.size();
+        const std::size_t Capacity = (this->IndexWidth == 1) ? 256 : MaximumPaletteSize;
+        for (int IndexZ = Clipped.Minimum[2]; IndexZ < Clipped.Maximum[2]; ++IndexZ) {
+            for (int IndexY = Clipped.Minimum[1]; IndexY < Clipped.Maximum[1]; ++IndexY) {
+                for (int IndexX = Clipped.Minimum[0]; IndexX < Clipped.Maximum[0]; ++IndexX) {
+                    const Voxel& Value = Source(IndexX, IndexY, IndexZ);
+                    const std::size_t Index = static_cast<std::size_t>(IndexX) + this->Size[0] * (static_cast<std::size_t>(IndexY) + this->Size[1] * static_cast<std::size_t>(IndexZ));
+                    if (this->IndexWidth == 4) {
+                        this->SetIndex(Index, Value.GetBits());
+                        continue;
+                    }
+                    const std::uint32_t PaletteIndex = this->FindOrAdd(Value);
+                    if (this->Palette.size() > Capacity) {
+                        this->Encode(Source);
+                        return true;
+                    }
+                    this->SetIndex(Index, PaletteIndex);
+                }
+            }
+        }
+        if (this->Palette.size() != PreviousPaletteSize) {
+            ++this->PaletteVersion;
+        }
+        return false;
+    }
+
+    // Copy a region of indices row by row.
+    void PaletteVolume::Copy(const PaletteVolume& Source, const Region& Target) {
+        if ((this->Size != Source.Size) || (this->IndexWidth != Source.IndexWidth)) {
+            *this = Source;
+            return;
+        }
+        if (this->PaletteVersion != Source.PaletteVersion) {
+            this->Palette = Source.Palette;
+            this->Lookup = Source.Lookup;
+            this->PaletteVersion = Source.PaletteVersion;
+        }
+        const Region Clipped = Target.Intersection(Region({{0, 0, 0}}, {{static_cast<int>(this->Size[0]), static_cast<int>(this->Size[1]), static_cast<int>(this->Size[2])}}));
+        for (int IndexZ = Clipped.Minimum[2]; IndexZ < Clipped.Maximum[2]; ++IndexZ) {
+            for (int IndexY = Clipped.Minimum[1]; IndexY < Clipped.Maximum[1]; ++IndexY) {
+                const std::size_t First = (static_cast<std::size_t>(Clipped.Minimum[0]) + this->Size[0] * (static_cast<std::size_t>(IndexY) + this->Size[1] * static_cast<std::size_t>(IndexZ))) * this->IndexWidth;
+                const std::size_t Count = static_cast<std::size_t>(Clipped.Maximum[0] - Clipped.Minimum[0]) * this->IndexWidth;
+                std::copy(Source.Indices.begin() + First, Source.Indices.begin() + First + Count, this->Indices.begin() + First);
+            }
+        }
+    }
+
+    // Find or append a palette entry.
+    std::uint32_t PaletteVolume::FindOrAdd(const Voxel& Value) {
+        const std::uint32_t Bits = Value.GetBits();
+        const std::unordered_map<std::uint32_t, std::uint32_t>::const_iterator Iterator = this->Lookup.find(Bits);
+        if (Iterator != this->Lookup.end()) {
+            return Iterator->second;
+        }
+        const std::uint32_t PaletteIndex = static_cast<std::uint32_t>(this->Palette.size());
+        this->Palette.push_back(Value);
+        this->Lookup.emplace(Bits, PaletteIndex);
+        return PaletteIndex;
+    }
+
+    // Store an index in the current index width.
+    void PaletteVolume::SetIndex(std::size_t Index, std::uint32_t Value) {
+        switch (this->IndexWidth) {
+            case 1: {
+                this->Indices[Index] = static_cast<std::uint8_t>(Value);
+            } break;
+            case 2: {
+                const std::uint16_t Narrow = static_cast<std::uint16_t>(Value);
+                std::memcpy(&this->Indices[Index * 2], &Narrow, sizeof(Narrow));
+            } break;
+            default: {
+                std::memcpy(&this->Indices[Index * 4], &Value, sizeof(Value));
+            } break;
+        }
+    }
+}
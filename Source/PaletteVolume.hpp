@@ -0,0 +1,130 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_PALETTEVOLUME_HPP
+#define RAYMARCH_PALETTEVOLUME_HPP
+
+#include "Region.hpp"
+#include "Volume.hpp"
+#include "Voxel.hpp"
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  PaletteVolume stores a volume as 8 or 16 bit indices into a palette of distinct voxel values.
+    /// @note   Volumes with more distinct values than a 16 bit index can address store the raw 32 bit voxels instead,
+    ///         which is reported by an index width of 4 and an empty palette.
+    class PaletteVolume {
+    public:
+        /// @brief  The largest palette that can be addressed.
+        constexpr static const std::size_t MaximumPaletteSize = 65536;
+
+        /// @brief  The number of palette entries in each row of the palette texture.
+        constexpr static const std::size_t PaletteRowSize = 256;
+
+    private:
+        /// @brief  The size of the volume.
+        std::array<std::size_t, 3> Size;
+
+        /// @brief  The number of bytes used by each index, 1, 2, or 4 for raw voxels.
+        std::size_t IndexWidth;
+
+        /// @brief  The indices, or raw voxels, in the same order as the voxels of a volume.
+        std::vector<std::uint8_t> Indices;
+
+        /// @brief  The distinct voxel values.
+        std::vector<Voxel> Palette;
+
+        /// @brief  The palette index of each distinct voxel value.
+        std::unordered_map<std::uint32_t, std::uint32_t> Lookup;
+
+        /// @brief  Incremented whenever the palette changes.
+        std::uint64_t PaletteVersion;
+
+    public:
+        /// @brief  Constructor that creates an empty palette volume.
+        PaletteVolume(void);
+
+    public:
+        /// @brief  Get the size of the volume.
+        /// @return The size of the volume.
+        const std::array<std::size_t, 3>& GetSize(void) const;
+
+        /// @brief  Get the number of bytes used by each index.
+        /// @return 1 or 2 for palette indices, or 4 for raw voxels.
+        std::size_t GetIndexWidth(void) const;
+
+        /// @brief  Get the indices, or raw voxels when the index width is 4.
+        /// @return A pointer to the first index.
+        const std::uint8_t* data(void) const;
+
+        /// @brief  Get the palette.
+        /// @return The distinct voxel values, empty when raw voxels are stored.
+        const std::vector<Voxel>& GetPalette(void) const;
+
+        /// @brief  Get the version of the palette, it changes whenever the palette changes.
+        /// @return The current palette version.
+        std::uint64_t GetPaletteVersion(void) const;
+
+        /// @brief  Decode a voxel.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return The voxel value.
+        Voxel Get(std::size_t X, std::size_t Y, std::size_t Z) const;
+
+    public:
+        /// @brief  Encode a whole volume, choosing the narrowest index that addresses its distinct values.
+        /// @param  Source - The volume to encode.
+        void Encode(const Volume& Source);
+
+        /// @brief  Encode a changed region of the volume given to the last call of Encode, new values are appended to the palette.
+        /// @param  Source - The volume to encode.
+        /// @param  Changed - The region of voxels that changed.
+        /// @return True if the palette outgrew the index width and the whole volume was encoded again.
+        bool Update(const Volume& Source, const Region& Changed);
+
+        /// @brief  Copy a region of indices and the palette from another palette volume, the whole volume is copied if the layouts differ.
+        /// @param  Source - The palette volume to copy from.
+        /// @param  Target - The region to copy.
+        void Copy(const PaletteVolume& Source, const Region& Target);
+
+    private:
+        /// @brief  Find or add the palette index of a voxel value.
+        /// @param  Value - The voxel value.
+        /// @return The palette index.
+        std::uint32_t FindOrAdd(const Voxel& Value);
+
+        /// @brief  Store an index.
+        /// @param  Index - The position of the voxel.
+        /// @param  Value - The palette index, or the raw voxel bits.
+        void SetIndex(std::size_t Index, std::uint32_t Value);
+    };
+}
+
+#endif // RAYMARCH_PALETTEVOLUME_HPP
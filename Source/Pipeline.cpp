@@ -0,0 +1,145 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "Pipeline.hpp"
+#include "Trace.hpp"
+
+#include <chrono>
+
+namespace Raymarch {
+    // Constructor that starts the worker when threaded.
+    Pipeline::Pipeline(GameState& State, bool Threaded)
+        : State(State)
+        , Front(State.GetScene().GetSize())
+        , Threaded(Threaded)
+        , FrameReady(false)
+        , FrameInUse(false)
+        , Stopping(false) {
+        if (this->Threaded) {
+            this->Worker = std::thread(&Pipeline::Run, this);
+        }
+    }
+
+    // Destructor that stops the worker.
+    Pipeline::~Pipeline(void) {
+        {
+            std::lock_guard<std::mutex> Lock(this->Mutex);
+            this->Stopping = true;
+        }
+        this->Condition.notify_all();
+        if (this->Worker.joinable()) {
+            this->Worker.join();
+        }
+    }
+
+    // Queue a key press.
+    void Pipeline::Input(GameState::KeyType Key, GameState::KeyStateType KeyState) {
+        std::lock_guard<std::mutex> Lock(this->Mutex);
+        this->Inputs.emplace_back(Key, KeyState);
+    }
+
+    // Queue a mouse click.
+    void Pipeline::Input(GameState::ButtonType Button, const std::array<float, 2>& ScreenPosition, const std::array<float, 2>& ScreenResolution) {
+        std::lock_guard<std::mutex> Lock(this->Mutex);
+        this->Clicks.push_back({Button, ScreenPosition, ScreenResolution});
+    }
+
+    // Get the next frame to render.
+    const GameState& Pipeline::BeginFrame(float DeltaTime) {
+        RAYMARCH_TRACE_SCOPE("Pipeline::BeginFrame");
+
+        // Without a worker update inline, exactly as if there was no pipeline.
+        if (!this->Threaded) {
+            this->ApplyInputs();
+            this->State.Update(DeltaTime);
+            return this->State;
+        }
+
+        // Wait for the worker to publish a frame and claim it.
+        std::unique_lock<std::mutex> Lock(this->Mutex);
+        this->Condition.wait(Lock, [this]() -> bool { return this->FrameReady; });
+        this->FrameReady = false;
+        this->FrameInUse = true;
+        return this->Front;
+    }
+
+    // Release the rendered frame.
+    void Pipeline::EndFrame(void) {
+        if (!this->Threaded) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> Lock(this->Mutex);
+            this->FrameInUse = false;
+        }
+        this->Condition.notify_all();
+    }
+
+    // Apply queued key presses and mouse clicks to the state.
+    void Pipeline::ApplyInputs(void) {
+        std::vector<std::pair<GameState::KeyType, GameState::KeyStateType> > PendingInputs;
+        std::vector<ClickInput> PendingClicks;
+        {
+            std::lock_guard<std::mutex> Lock(this->Mutex);
+            PendingInputs.swap(this->Inputs);
+            PendingClicks.swap(this->Clicks);
+        }
+        for (const std::pair<GameState::KeyType, GameState::KeyStateType>& KeyInput : PendingInputs) {
+            this->State.Input(KeyInput.first, KeyInput.second);
+        }
+        for (const ClickInput& Click : PendingClicks) {
+            this->State.Input(Click.Button, Click.ScreenPosition, Click.ScreenResolution);
+        }
+    }
+
+    // Update frames on the worker thread until stopped.
+    void Pipeline::Run(void) {
+        Trace::SetThreadName("Pipeline");
+
+        std::chrono::steady_clock::time_point LastFrameTime = std::chrono::steady_clock::now();
+        while (true) {
+            // Delta time.
+            const std::chrono::steady_clock::time_point ThisFrameTime = std::chrono::steady_clock::now();
+            const float DeltaTime = std::chrono::duration<float>(ThisFrameTime - LastFrameTime).count();
+            LastFrameTime = ThisFrameTime;
+
+            // Compose the next frame while the previous one is rendered.
+            this->ApplyInputs();
+            this->State.Update(DeltaTime);
+
+            // Wait for the renderer to be finished with the front state, then hand over the new frame.
+            {
+                RAYMARCH_TRACE_SCOPE("Pipeline::Publish");
+                std::unique_lock<std::mutex> Lock(this->Mutex);
+                this->Condition.wait(Lock, [this]() -> bool { return this->Stopping || (!this->FrameReady && !this->FrameInUse); });
+                if (this->Stopping) {
+                    return;
+                }
+                this->State.PublishTo(this->Front);
+                this->FrameReady = true;
+            }
+            this->Condition.notify_all();
+        }
+    }
+}
@@ -0,0 +1,134 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_PIPELINE_HPP
+#define RAYMARCH_PIPELINE_HPP
+
+#include "GameState.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  Pipeline hands frames from the game state update to the renderer.
+    /// @note   When threaded a worker composes frame N+1 while the main thread renders frame N from a second state.
+    class Pipeline {
+    private:
+        /// @brief  A mouse click queued for the next update.
+        struct ClickInput {
+            /// @brief  The clicked button.
+            GameState::ButtonType Button;
+
+            /// @brief  The point in pixels from the bottom left corner of the screen.
+            std::array<float, 2> ScreenPosition;
+
+            /// @brief  The size of the screen in pixels.
+            std::array<float, 2> ScreenResolution;
+        };
+
+    private:
+        /// @brief  The state that is updated, owned by the worker thread when threaded.
+        GameState& State;
+
+        /// @brief  The published state that is rendered when threaded.
+        GameState Front;
+
+        /// @brief  Whether the update runs on a worker thread.
+        bool Threaded;
+
+    private:
+        /// @brief  Guards the input queue and the hand-off flags.
+        std::mutex Mutex;
+
+        /// @brief  Signals changes to the hand-off flags.
+        std::condition_variable Condition;
+
+        /// @brief  Key input queued for the next update.
+        std::vector<std::pair<GameState::KeyType, GameState::KeyStateType> > Inputs;
+
+        /// @brief  Mouse clicks queued for the next update.
+        std::vector<ClickInput> Clicks;
+
+        /// @brief  A frame has been published to the front state and not yet rendered.
+        bool FrameReady;
+
+        /// @brief  The front state is being rendered.
+        bool FrameInUse;
+
+        /// @brief  The worker thread has been asked to finish.
+        bool Stopping;
+
+        /// @brief  The worker thread running the update loop.
+        std::thread Worker;
+
+    public:
+        /// @brief  Constructor that starts the worker thread when threaded.
+        /// @param  State - The state to update, this must outlive the pipeline.
+        /// @param  Threaded - Whether to update on a worker thread.
+        Pipeline(GameState& State, bool Threaded);
+
+        /// @brief  Destructor that stops and joins the worker thread.
+        ~Pipeline(void);
+
+        /// @brief  Deleted copy constructor.
+        Pipeline(const Pipeline&) = delete;
+
+        /// @brief  Deleted copy assignment.
+        Pipeline& operator=(const Pipeline&) = delete;
+
+    public:
+        /// @brief  Queue a key press for the next update, safe to call from the input callback.
+        /// @param  Key - The input key.
+        /// @param  KeyState - The state of the key.
+        void Input(GameState::KeyType Key, GameState::KeyStateType KeyState);
+
+        /// @brief  Queue a mouse click for the next update, safe to call from the input callback.
+        /// @param  Button - The clicked button.
+        /// @param  ScreenPosition - The point in pixels from the bottom left corner of the screen.
+        /// @param  ScreenResolution - The size of the screen in pixels.
+        void Input(GameState::ButtonType Button, const std::array<float, 2>& ScreenPosition, const std::array<float, 2>& ScreenResolution);
+
+        /// @brief  Get the next frame to render, updating the state first when not threaded.
+        /// @param  DeltaTime - The time since the last frame, unused when threaded as the worker keeps its own time.
+        /// @return The state to render, valid until EndFrame is called.
+        const GameState& BeginFrame(float DeltaTime);
+
+        /// @brief  Release the frame returned by BeginFrame so the next one can be published.
+        void EndFrame(void);
+
+    private:
+        /// @brief  Apply and clear the queued key presses and mouse clicks.
+        void ApplyInputs(void);
+
+        /// @brief  The worker thread update loop.
+        void Run(void);
+    };
+}
+
+#endif // RAYMARCH_PIPELINE_HPP
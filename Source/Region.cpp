@@ -0,0 +1,120 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "Region.hpp"
+
+#include <algorithm>
+
+namespace Raymarch {
+    // Constructor for an empty region.
+    Region::Region(void)
+        : Minimum{{0, 0, 0}}
+        , Maximum{{0, 0, 0}} {
+    }
+
+    // Constructor from bounds.
+    Region::Region(const std::array<int, 3>& Minimum, const std::array<int, 3>& Maximum)
+        : Minimum(Minimum)
+        , Maximum(Maximum) {
+    }
+
+    // Test for emptiness.
+    bool Region::IsEmpty(void) const {
+        return (this->Minimum[0] >= this->Maximum[0]) || (this->Minimum[1] >= this->Maximum[1]) || (this->Minimum[2] >= this->Maximum[2]);
+    }
+
+    // Get the size along each axis.
+    std::array<std::size_t, 3> Region::GetSize(void) const {
+        if (this->IsEmpty()) {
+            return {{0, 0, 0}};
+        }
+        return {{
+            static_cast<std::size_t>(this->Maximum[0] - this->Minimum[0]),
+            static_cast<std::size_t>(this->Maximum[1] - this->Minimum[1]),
+            static_cast<std::size_t>(this->Maximum[2] - this->Minimum[2])
+        }};
+    }
+
+    // Get the number of voxels.
+    std::size_t Region::GetCount(void) const {
+        const std::array<std::size_t, 3> Size = this->GetSize();
+        return Size[0] * Size[1] * Size[2];
+    }
+
+    // Test if a coordinate is inside.
+    bool Region::Contains(int X, int Y, int Z) const {
+        return (X >= this->Minimum[0]) && (X < this->Maximum[0])
+            && (Y >= this->Minimum[1]) && (Y < this->Maximum[1])
+            && (Z >= this->Minimum[2]) && (Z < this->Maximum[2]);
+    }
+
+    // Get the overlap.
+    Region Region::Intersection(const Region& Other) const {
+        Region Result;
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            Result.Minimum[Index] = std::max(this->Minimum[Index], Other.Minimum[Index]);
+            Result.Maximum[Index] = std::min(this->Maximum[Index], Other.Maximum[Index]);
+        }
+        return Result.IsEmpty() ? Region() : Result;
+    }
+
+    // Get the bounding box.
+    Region Region::Union(const Region& Other) const {
+        if (this->IsEmpty()) {
+            return Other;
+        }
+        if (Other.IsEmpty()) {
+            return *this;
+        }
+        Region Result;
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            Result.Minimum[Index] = std::min(this->Minimum[Index], Other.Minimum[Index]);
+            Result.Maximum[Index] = std::max(this->Maximum[Index], Other.Maximum[Index]);
+        }
+        return Result;
+    }
+
+    // Move by an offset.
+    Region Region::Translate(const std::array<int, 3>& Offset) const {
+        Region Result;
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            Result.Minimum[Index] = this->Minimum[Index] + Offset[Index];
+            Result.Maximum[Index] = this->Maximum[Index] + Offset[Index];
+        }
+        return Result;
+    }
+
+    // Grow in every direction.
+    Region Region::Expand(int Amount) const {
+        if (this->IsEmpty()) {
+            return Region();
+        }
+        Region Result;
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            Result.Minimum[Index] = this->Minimum[Index] - Amount;
+            Result.Maximum[Index] = this->Maximum[Index] + Amount;
+        }
+        return Result;
+    }
+}
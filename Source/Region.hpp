@@ -0,0 +1,94 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_REGION_HPP
+#define RAYMARCH_REGION_HPP
+
+#include <array>
+#include <cstddef>
+
+namespace Raymarch {
+    /// @brief  Region is an axis aligned box of voxel coordinates.
+    class Region {
+    public:
+        /// @brief  The first voxel coordinate within the region (inclusive).
+        std::array<int, 3> Minimum;
+
+        /// @brief  One past the last voxel coordinate within the region (exclusive).
+        std::array<int, 3> Maximum;
+
+    public:
+        /// @brief  Constructor that creates an empty region.
+        Region(void);
+
+        /// @brief  Constructor that creates a region from its bounds.
+        /// @param  Minimum - The first voxel coordinate within the region (inclusive).
+        /// @param  Maximum - One past the last voxel coordinate within the region (exclusive).
+        Region(const std::array<int, 3>& Minimum, const std::array<int, 3>& Maximum);
+
+    public:
+        /// @brief  Test if the region contains no voxels.
+        /// @return True if the region is empty.
+        bool IsEmpty(void) const;
+
+        /// @brief  Get the size of the region.
+        /// @return The size of the region along each axis, zero if empty.
+        std::array<std::size_t, 3> GetSize(void) const;
+
+        /// @brief  Get the number of voxels in the region.
+        /// @return The number of voxels in the region.
+        std::size_t GetCount(void) const;
+
+        /// @brief  Test if a voxel coordinate is within the region.
+        /// @param  X - The X coordinate to test.
+        /// @param  Y - The Y coordinate to test.
+        /// @param  Z - The Z coordinate to test.
+        /// @return True if the coordinate is within the region.
+        bool Contains(int X, int Y, int Z) const;
+
+    public:
+        /// @brief  Get the overlap of this region and another.
+        /// @param  Other - The other region.
+        /// @return The region within both regions.
+        Region Intersection(const Region& Other) const;
+
+        /// @brief  Get the bounding box of this region and another.
+        /// @param  Other - The other region.
+        /// @return The smallest region containing both regions, empty regions are ignored.
+        Region Union(const Region& Other) const;
+
+        /// @brief  Get this region moved by an offset.
+        /// @param  Offset - The offset to move by.
+        /// @return The moved region.
+        Region Translate(const std::array<int, 3>& Offset) const;
+
+        /// @brief  Get this region grown by an amount in every direction.
+        /// @param  Amount - The number of voxels to grow by.
+        /// @return The grown region, or empty if this region is empty.
+        Region Expand(int Amount) const;
+    };
+}
+
+#endif // RAYMARCH_REGION_HPP
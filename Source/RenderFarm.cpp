@@ -0,0 +1,455 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "RenderFarm.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <fstream>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace Raymarch {
+    // The largest payload of a valid message, the index and pixels of a whole tile.
+    constexpr static const std::size_t MaximumPayload = 4 + RenderFarm::TileSize * RenderFarm::TileSize * 4;
+
+    // Writing to a closed socket reports an error rather than raising a signal where the platform allows it.
+    #ifdef MSG_NOSIGNAL
+        constexpr static const int SendFlags = MSG_NOSIGNAL;
+    #else
+        constexpr static const int SendFlags = 0;
+    #endif
+
+    // Append a number in the byte order of the machine.
+    template <typename Type>
+    static void WriteNumber(Type Value, std::vector<std::uint8_t>& Output) {
+        const std::size_t Offset = Output.size();
+        Output.resize(Offset + sizeof(Type));
+        std::memcpy(&Output[Offset], &Value, sizeof(Type));
+    }
+
+    // Read a number and advance past it, false when the payload is too short.
+    template <typename Type>
+    static bool ReadNumber(const std::vector<std::uint8_t>& Input, std::size_t& Offset, Type& Value) {
+        if (Offset + sizeof(Type) > Input.size()) {
+            return false;
+        }
+        std::memcpy(&Value, &Input[Offset], sizeof(Type));
+        Offset += sizeof(Type);
+        return true;
+    }
+
+    // Get a tile of an image, tiles are ordered along rows from the bottom of the image.
+    static TileRenderer::Tile GetTile(const std::array<std::size_t, 2>& ImageSize, std::size_t Index) {
+        const std::size_t TilesX = (ImageSize[0] + RenderFarm::TileSize - 1) / RenderFarm::TileSize;
+        const std::array<std::size_t, 2> Position = {{(Index % TilesX) * RenderFarm::TileSize, (Index / TilesX) * RenderFarm::TileSize}};
+        return {Position, {{std::min(RenderFarm::TileSize, ImageSize[0] - Position[0]), std::min(RenderFarm::TileSize, ImageSize[1] - Position[1])}}};
+    }
+
+    // Serialise a tile to render.
+    static std::vector<std::uint8_t> EncodeTile(std::uint32_t Index, const TileRenderer::Camera& View, const TileRenderer::Tile& Target) {
+        std::vector<std::uint8_t> Payload;
+        WriteNumber<std::uint32_t>(Index, Payload);
+        for (std::size_t Axis = 0; Axis < 2; ++Axis) {
+            WriteNumber<std::uint32_t>(static_cast<std::uint32_t>(View.ImageSize[Axis]), Payload);
+            WriteNumber<std::uint32_t>(static_cast<std::uint32_t>(Target.Position[Axis]), Payload);
+            WriteNumber<std::uint32_t>(static_cast<std::uint32_t>(Target.Size[Axis]), Payload);
+        }
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            WriteNumber<float>(View.Position[Axis], Payload);
+            WriteNumber<float>(View.Target[Axis], Payload);
+            WriteNumber<float>(View.FogColour[Axis], Payload);
+            WriteNumber<float>(View.LightPosition[Axis], Payload);
+        }
+        WriteNumber<float>(View.NearClip, Payload);
+        WriteNumber<float>(View.FieldOfView, Payload);
+        WriteNumber<float>(View.FogDistance, Payload);
+        return Payload;
+    }
+
+    // Deserialise a tile to render, false when the payload is malformed or the tile is not within the image.
+    static bool DecodeTile(const std::vector<std::uint8_t>& Payload, std::uint32_t& Index, TileRenderer::Camera& View, TileRenderer::Tile& Target) {
+        std::size_t Offset = 0;
+        bool Valid = ReadNumber<std::uint32_t>(Payload, Offset, Index);
+        for (std::size_t Axis = 0; Axis < 2; ++Axis) {
+            std::uint32_t ImageSize = 0;
+            std::uint32_t Position = 0;
+            std::uint32_t Size = 0;
+            Valid = Valid && ReadNumber<std::uint32_t>(Payload, Offset, ImageSize) && ReadNumber<std::uint32_t>(Payload, Offset, Position) && ReadNumber<std::uint32_t>(Payload, Offset, Size);
+            Valid = Valid && (Size > 0) && (Size <= RenderFarm::TileSize) && (static_cast<std::uint64_t>(Position) + Size <= ImageSize);
+            View.ImageSize[Axis] = ImageSize;
+            Target.Position[Axis] = Position;
+            Target.Size[Axis] = Size;
+        }
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            Valid = Valid && ReadNumber<float>(Payload, Offset, View.Position[Axis]) && ReadNumber<float>(Payload, Offset, View.Target[Axis]);
+            Valid = Valid && ReadNumber<float>(Payload, Offset, View.FogColour[Axis]) && ReadNumber<float>(Payload, Offset, View.LightPosition[Axis]);
+        }
+        Valid = Valid && ReadNumber<float>(Payload, Offset, View.NearClip) && ReadNumber<float>(Payload, Offset, View.FieldOfView) && ReadNumber<float>(Payload, Offset, View.FogDistance);
+        return Valid && (Offset == Payload.size());
+    }
+
+    // Hand out tiles to workers, take back the tiles of failed workers and finish any tiles left when no worker remains.
+    bool RenderFarm::Render(const std::string& Executable, const SparseVoxelOctree& Octree, const TileRenderer::Camera& View, std::size_t WorkerCount, std::vector<std::uint8_t>& Image, Statistics& Report) {
+        RAYMARCH_TRACE_SCOPE("RenderFarm::Render");
+
+        const std::size_t TilesX = (View.ImageSize[0] + TileSize - 1) / TileSize;
+        const std::size_t TilesY = (View.ImageSize[1] + TileSize - 1) / TileSize;
+        Report = {TilesX * TilesY, 0, 0, 0, 0};
+        Image.assign(View.ImageSize[0] * View.ImageSize[1] * 4, 0);
+
+        std::vector<bool> Finished(Report.TileCount, false);
+        std::deque<std::size_t> Pending;
+        for (std::size_t Index = 0; Index < Report.TileCount; ++Index) {
+            Pending.push_back(Index);
+        }
+
+        // Copy the rows of a finished tile into the image.
+        auto Store = [&View, &Image, &Finished](std::size_t Index, const std::uint8_t* Pixels) -> void {
+            const TileRenderer::Tile Target = GetTile(View.ImageSize, Index);
+            for (std::size_t Row = 0; Row < Target.Size[1]; ++Row) {
+                std::memcpy(&Image[((Target.Position[1] + Row) * View.ImageSize[0] + Target.Position[0]) * 4], &Pixels[Row * Target.Size[0] * 4], Target.Size[0] * 4);
+            }
+            Finished[Index] = true;
+        };
+
+        // The octree and the socket live in a private directory that is removed afterwards.
+        char Directory[] = "/tmp/raymarch-XXXXXX";
+        if ((WorkerCount > 0) && (mkdtemp(Directory) == nullptr)) {
+            return false;
+        }
+        const std::string MapPath = std::string(Directory) + "/map.svo";
+        const std::string SocketPath = std::string(Directory) + "/farm.sock";
+
+        int Listener = -1;
+        std::vector<pid_t> Children;
+        if (WorkerCount > 0) {
+            sockaddr_un Address;
+            std::memset(&Address, 0, sizeof(Address));
+            Address.sun_family = AF_UNIX;
+            std::strncpy(Address.sun_path, SocketPath.c_str(), sizeof(Address.sun_path) - 1);
+
+            // Workers inherit nothing but the standard streams, their output is discarded and their errors are kept.
+            Listener = socket(AF_UNIX, SOCK_STREAM, 0);
+            if ((Listener < 0) || (fcntl(Listener, F_SETFD, FD_CLOEXEC) != 0) || !Octree.Save(MapPath) ||
+                (bind(Listener, reinterpret_cast<const sockaddr*>(&Address), sizeof(Address)) != 0) || (listen(Listener, static_cast<int>(WorkerCount)) != 0)) {
+                if (Listener >= 0) {
+                    close(Listener);
+                }
+                unlink(SocketPath.c_str());
+                unlink(MapPath.c_str());
+                rmdir(Directory);
+                return false;
+            }
+
+            posix_spawn_file_actions_t Actions;
+            posix_spawn_file_actions_init(&Actions);
+            posix_spawn_file_actions_addopen(&Actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+            for (std::size_t Worker = 0; Worker < WorkerCount; ++Worker) {
+                char* Arguments[] = {const_cast<char*>(Executable.c_str()), const_cast<char*>("--worker"), const_cast<char*>(SocketPath.c_str()), nullptr};
+                pid_t Child;
+                if (posix_spawnp(&Child, Executable.c_str(), &Actions, nullptr, Arguments, environ) == 0) {
+                    Children.push_back(Child);
+                }
+            }
+            posix_spawn_file_actions_destroy(&Actions);
+        }
+
+        // A connected worker, the tiles it has been sent but not returned, oldest first, and when its oldest tile was due to start.
+        // The oldest tile starts when it is sent to an idle worker or when the tile before it is returned.
+        struct Connection {
+            int Socket;
+            std::deque<std::size_t> Assigned;
+            std::chrono::steady_clock::time_point Started;
+        };
+        std::vector<Connection> Connections;
+        const std::chrono::seconds ReplyTimeout(ReplyTimeoutSeconds);
+
+        // Give a failed worker's tiles back, at the front so they are finished first, and forget the worker.
+        auto Fail = [&Connections, &Pending, &Report](std::size_t Worker) -> void {
+            for (auto Tile = Connections[Worker].Assigned.rbegin(); Tile != Connections[Worker].Assigned.rend(); ++Tile) {
+                Pending.push_front(*Tile);
+            }
+            Report.RequeuedTiles += Connections[Worker].Assigned.size();
+            ++Report.WorkerFailures;
+            close(Connections[Worker].Socket);
+            Connections.erase(Connections.begin() + static_cast<std::ptrdiff_t>(Worker));
+        };
+
+        // Top up the tiles of a worker, false when it could not be sent one.
+        auto Assign = [&View, &Pending](Connection& Worker) -> bool {
+            while ((Worker.Assigned.size() < TilesInFlight) && !Pending.empty()) {
+                const std::size_t Index = Pending.front();
+                Pending.pop_front();
+                if (Worker.Assigned.empty()) {
+                    Worker.Started = std::chrono::steady_clock::now();
+                }
+                Worker.Assigned.push_back(Index);
+                if (!SendMessage(Worker.Socket, MessageType::Tile, EncodeTile(static_cast<std::uint32_t>(Index), View, GetTile(View.ImageSize, Index)))) {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        const std::vector<std::uint8_t> MapMessage(MapPath.begin(), MapPath.end());
+        std::size_t RunningChildren = Children.size();
+        std::chrono::steady_clock::time_point LastAccepted = std::chrono::steady_clock::now();
+        while (std::find(Finished.begin(), Finished.end(), false) != Finished.end()) {
+            // Reap workers that exited, once none is running or connected, or those running have not connected in time, the remaining
+            // tiles are rendered here.
+            for (pid_t& Child : Children) {
+                int Status;
+                if ((Child > 0) && (waitpid(Child, &Status, WNOHANG) == Child)) {
+                    Child = -1;
+                    --RunningChildren;
+                }
+            }
+            const std::chrono::steady_clock::time_point Now = std::chrono::steady_clock::now();
+            if (Connections.empty() && ((RunningChildren == 0) || (Now - LastAccepted > ReplyTimeout))) {
+                break;
+            }
+
+            // A worker that has not returned its oldest tile in time has stalled.
+            for (std::size_t Worker = Connections.size(); Worker-- > 0;) {
+                if (!Connections[Worker].Assigned.empty() && (Now - Connections[Worker].Started > ReplyTimeout)) {
+                    Fail(Worker);
+                }
+            }
+
+            std::vector<pollfd> Descriptors(1 + Connections.size());
+            Descriptors[0] = {Listener, POLLIN, 0};
+            for (std::size_t Worker = 0; Worker < Connections.size(); ++Worker) {
+                Descriptors[1 + Worker] = {Connections[Worker].Socket, POLLIN, 0};
+            }
+            if (poll(Descriptors.data(), Descriptors.size(), 100) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+
+            // Collect returned tiles, from the back so failed workers can be removed.
+            for (std::size_t Worker = Connections.size(); Worker-- > 0;) {
+                if (Descriptors[1 + Worker].revents == 0) {
+                    continue;
+                }
+                MessageType Type;
+                std::vector<std::uint8_t> Payload;
+                std::size_t Offset = 0;
+                std::uint32_t Index = 0;
+                std::deque<std::size_t>& Assigned = Connections[Worker].Assigned;
+                if (!ReceiveMessage(Connections[Worker].Socket, Type, Payload) || (Type != MessageType::Pixels) || !ReadNumber<std::uint32_t>(Payload, Offset, Index) ||
+                    (std::find(Assigned.begin(), Assigned.end(), Index) == Assigned.end())) {
+                    Fail(Worker);
+                    continue;
+                }
+                const TileRenderer::Tile Target = GetTile(View.ImageSize, Index);
+                if (Payload.size() != Offset + Target.Size[0] * Target.Size[1] * 4) {
+                    Fail(Worker);
+                    continue;
+                }
+                Assigned.erase(std::find(Assigned.begin(), Assigned.end(), Index));
+                Connections[Worker].Started = std::chrono::steady_clock::now();
+                if (!Finished[Index]) {
+                    Store(Index, &Payload[Offset]);
+                }
+            }
+
+            // Welcome a new worker with the path of the octree, a message that stops part way times out rather than blocking.
+            if ((Descriptors[0].revents & POLLIN) != 0) {
+                const int Socket = accept(Listener, nullptr, nullptr);
+                if (Socket >= 0) {
+                    const timeval MessageTimeout = {MessageTimeoutSeconds, 0};
+                    ++Report.WorkerCount;
+                    LastAccepted = std::chrono::steady_clock::now();
+                    Connections.push_back({Socket, {}, LastAccepted});
+                    if ((setsockopt(Socket, SOL_SOCKET, SO_RCVTIMEO, &MessageTimeout, sizeof(MessageTimeout)) != 0) ||
+                        (setsockopt(Socket, SOL_SOCKET, SO_SNDTIMEO, &MessageTimeout, sizeof(MessageTimeout)) != 0) ||
+                        !SendMessage(Socket, MessageType::Map, MapMessage)) {
+                        Fail(Connections.size() - 1);
+                    }
+                }
+            }
+
+            // Keep every worker busy, including with the tiles of failed workers.
+            for (std::size_t Worker = Connections.size(); Worker-- > 0;) {
+                if (!Assign(Connections[Worker])) {
+                    Fail(Worker);
+                }
+            }
+        }
+
+        // Closing the connections lets the workers exit, any that are stuck are stopped.
+        for (const Connection& Worker : Connections) {
+            close(Worker.Socket);
+        }
+        for (const pid_t Child : Children) {
+            if (Child > 0) {
+                kill(Child, SIGTERM);
+                waitpid(Child, nullptr, 0);
+            }
+        }
+        if (Listener >= 0) {
+            close(Listener);
+            unlink(SocketPath.c_str());
+            unlink(MapPath.c_str());
+            rmdir(Directory);
+        }
+
+        // Render whatever no worker finished.
+        std::vector<std::uint8_t> Pixels;
+        for (std::size_t Index = 0; Index < Report.TileCount; ++Index) {
+            if (!Finished[Index]) {
+                TileRenderer::Render(Octree, View, GetTile(View.ImageSize, Index), Pixels);
+                Store(Index, Pixels.data());
+                ++Report.LocalTiles;
+            }
+        }
+        return true;
+    }
+
+    // Connect, load the octree and render tiles until the coordinator closes the connection.
+    bool RenderFarm::RunWorker(const std::string& SocketPath) {
+        sockaddr_un Address;
+        std::memset(&Address, 0, sizeof(Address));
+        Address.sun_family = AF_UNIX;
+        std::strncpy(Address.sun_path, SocketPath.c_str(), sizeof(Address.sun_path) - 1);
+
+        const int Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+        if ((Socket < 0) || (connect(Socket, reinterpret_cast<const sockaddr*>(&Address), sizeof(Address)) != 0)) {
+            if (Socket >= 0) {
+                close(Socket);
+            }
+            return false;
+        }
+
+        SparseVoxelOctree Octree;
+        bool Loaded = false;
+        bool Success = true;
+        MessageType Type;
+        std::vector<std::uint8_t> Payload;
+        std::vector<std::uint8_t> Pixels;
+        while (Success && ReceiveMessage(Socket, Type, Payload)) {
+            std::uint32_t Index = 0;
+            TileRenderer::Camera View;
+            TileRenderer::Tile Target;
+            if (Type == MessageType::Map) {
+                Loaded = Octree.Load(std::string(Payload.begin(), Payload.end()));
+                Success = Loaded;
+            }
+            else if ((Type == MessageType::Tile) && Loaded && DecodeTile(Payload, Index, View, Target)) {
+                TileRenderer::Render(Octree, View, Target, Pixels);
+                std::vector<std::uint8_t> Reply;
+                Reply.reserve(4 + Pixels.size());
+                WriteNumber<std::uint32_t>(Index, Reply);
+                Reply.insert(Reply.end(), Pixels.begin(), Pixels.end());
+                Success = SendMessage(Socket, MessageType::Pixels, Reply);
+            }
+            else {
+                Success = false;
+            }
+        }
+        close(Socket);
+        return Success;
+    }
+
+    // Write the header, then the rows from the top of the image.
+    bool RenderFarm::SaveImage(const std::string& Path, const std::array<std::size_t, 2>& Size, const std::vector<std::uint8_t>& Image) {
+        std::ofstream Output(Path, std::ios::binary | std::ios::trunc);
+        Output << "P6\n" << Size[0] << " " << Size[1] << "\n255\n";
+        std::vector<char> Row(Size[0] * 3);
+        for (std::size_t Y = Size[1]; Y-- > 0;) {
+            for (std::size_t X = 0; X < Size[0]; ++X) {
+                for (std::size_t Channel = 0; Channel < 3; ++Channel) {
+                    Row[X * 3 + Channel] = static_cast<char>(Image[(Y * Size[0] + X) * 4 + Channel]);
+                }
+            }
+            Output.write(Row.data(), static_cast<std::streamsize>(Row.size()));
+        }
+        return static_cast<bool>(Output.flush());
+    }
+
+    // Send the header and payload, retrying partial sends.
+    bool RenderFarm::SendMessage(int Socket, MessageType Type, const std::vector<std::uint8_t>& Payload) {
+        std::vector<std::uint8_t> Message;
+        Message.reserve(8 + Payload.size());
+        WriteNumber<std::uint32_t>(static_cast<std::uint32_t>(Type), Message);
+        WriteNumber<std::uint32_t>(static_cast<std::uint32_t>(Payload.size()), Message);
+        Message.insert(Message.end(), Payload.begin(), Payload.end());
+        for (std::size_t Sent = 0; Sent < Message.size();) {
+            const ssize_t Count = send(Socket, &Message[Sent], Message.size() - Sent, SendFlags);
+            if (Count <= 0) {
+                if ((Count < 0) && (errno == EINTR)) {
+                    continue;
+                }
+                return false;
+            }
+            Sent += static_cast<std::size_t>(Count);
+        }
+        return true;
+    }
+
+    // Receive the header, then the payload it announces.
+    bool RenderFarm::ReceiveMessage(int Socket, MessageType& Type, std::vector<std::uint8_t>& Payload) {
+        auto ReceiveAll = [Socket](std::uint8_t* Data, std::size_t Size) -> bool {
+            for (std::size_t Received = 0; Received < Size;) {
+                const ssize_t Count = recv(Socket, Data + Received, Size - Received, 0);
+                if (Count <= 0) {
+                    if ((Count < 0) && (errno == EINTR)) {
+                        continue;
+                    }
+                    return false;
+                }
+                Received += static_cast<std::size_t>(Count);
+            }
+            return true;
+        };
+
+        std::vector<std::uint8_t> Header(8);
+        std::size_t Offset = 0;
+        std::uint32_t TypeValue = 0;
+        std::uint32_t Size = 0;
+        if (!ReceiveAll(Header.data(), Header.size()) || !ReadNumber<std::uint32_t>(Header, Offset, TypeValue) || !ReadNumber<std::uint32_t>(Header, Offset, Size) || (Size > MaximumPayload)) {
+            return false;
+        }
+        Type = static_cast<MessageType>(TypeValue);
+        Payload.resize(Size);
+        return ReceiveAll(Payload.data(), Payload.size());
+    }
+}
@@ -0,0 +1,136 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_RENDERFARM_HPP
+#define RAYMARCH_RENDERFARM_HPP
+
+#include "SparseVoxelOctree.hpp"
+#include "TileRenderer.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  RenderFarm renders an image on the CPU by handing its tiles to worker processes over a local socket.
+    /// @note   The coordinator saves the octree of the scene to a file every worker loads, starts the workers as copies of the
+    ///         executable and listens on a Unix domain socket. Each worker is kept a few tiles ahead. The tiles of a worker that dies
+    ///         or sends a bad message are handed to the others, and when every worker has gone the coordinator renders the rest itself. A
+    ///         worker that stays connected but does not return its oldest tile in time, or stalls part way through a message, has failed.
+    ///         Messages are a type and a payload size followed by the payload, numbers are in the byte order of the machine.
+    class RenderFarm {
+    private:
+        /// @brief  Deleted destructor.
+        ~RenderFarm(void) = delete;
+        /// @brief  Deleted constructor.
+        RenderFarm(void) = delete;
+
+    public:
+        /// @brief  The edge length of the square tiles, tiles at the right and top of the image are cut to fit.
+        constexpr static const std::size_t TileSize = 64;
+
+        /// @brief  The number of tiles a worker is given before it returns the first.
+        constexpr static const std::size_t TilesInFlight = 2;
+
+        /// @brief  The seconds a worker has to return its oldest tile, and the workers that were started have to connect.
+        constexpr static const int ReplyTimeoutSeconds = 30;
+
+        /// @brief  The seconds a message may take to arrive once it has started, or to be sent.
+        constexpr static const int MessageTimeoutSeconds = 5;
+
+        /// @brief  The counters of a render.
+        struct Statistics {
+            /// @brief  The tiles of the image.
+            std::size_t TileCount;
+
+            /// @brief  The workers that connected.
+            std::size_t WorkerCount;
+
+            /// @brief  The workers that died, stalled or sent a bad message before the image was finished.
+            std::size_t WorkerFailures;
+
+            /// @brief  The tiles handed to another worker after their worker failed.
+            std::size_t RequeuedTiles;
+
+            /// @brief  The tiles the coordinator rendered itself.
+            std::size_t LocalTiles;
+        };
+
+    private:
+        /// @brief  The types of message.
+        enum class MessageType : std::uint32_t {
+            /// @brief  Coordinator to worker, the path of the saved octree.
+            Map = 1,
+
+            /// @brief  Coordinator to worker, a tile index, camera and tile to render.
+            Tile = 2,
+
+            /// @brief  Worker to coordinator, a tile index and the pixels of the tile.
+            Pixels = 3
+        };
+
+    public:
+        /// @brief  Render an image with worker processes.
+        /// @param  Executable - The executable started for each worker with the arguments "--worker <socket>".
+        /// @param  Octree - The octree of the scene.
+        /// @param  View - The camera.
+        /// @param  WorkerCount - The number of workers to start, with none every tile is rendered by the coordinator.
+        /// @param  Image - Receives four bytes of red, green, blue and alpha per pixel, rows from the bottom of the image.
+        /// @param  Report - Receives the counters of the render.
+        /// @return False if the octree could not be shared or the socket could not be created.
+        static bool Render(const std::string& Executable, const SparseVoxelOctree& Octree, const TileRenderer::Camera& View, std::size_t WorkerCount, std::vector<std::uint8_t>& Image, Statistics& Report);
+
+        /// @brief  Run a worker, rendering the tiles it is sent until the coordinator closes the connection.
+        /// @param  SocketPath - The path of the socket of the coordinator.
+        /// @return False if the connection failed or the octree could not be loaded.
+        static bool RunWorker(const std::string& SocketPath);
+
+        /// @brief  Save an image as a binary portable pixmap.
+        /// @param  Path - The path of the file.
+        /// @param  Size - The size of the image in pixels.
+        /// @param  Image - Four bytes per pixel, rows from the bottom of the image, the alpha is dropped.
+        /// @return False if the file could not be written.
+        static bool SaveImage(const std::string& Path, const std::array<std::size_t, 2>& Size, const std::vector<std::uint8_t>& Image);
+
+    private:
+        /// @brief  Send a whole message.
+        /// @param  Socket - The connected socket.
+        /// @param  Type - The type of the message.
+        /// @param  Payload - The payload of the message.
+        /// @return False if the connection failed.
+        static bool SendMessage(int Socket, MessageType Type, const std::vector<std::uint8_t>& Payload);
+
+        /// @brief  Receive a whole message.
+        /// @param  Socket - The connected socket.
+        /// @param  Type - Receives the type of the message.
+        /// @param  Payload - Receives the payload of the message.
+        /// @return False if the connection closed or failed, or the message is larger than any valid message.
+        static bool ReceiveMessage(int Socket, MessageType& Type, std::vector<std::uint8_t>& Payload);
+    };
+}
+
+#endif // RAYMARCH_RENDERFARM_HPP
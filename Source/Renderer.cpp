@@ -24,11 +24,14 @@ THE SOFTWARE
 
 #include "Renderer.hpp"
 #include "ShaderSource.hpp"
+#include "Trace.hpp"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <iostream>
+#include <vector>
 
 // When debugging check for OpenGL errors after every usage.
 #ifdef _DEBUG
@@ -46,9 +49,19 @@ THE SOFTWARE
 
 namespace Raymarch {
     // Constructor that initialises the renderer at the provided size.
-    Renderer::Renderer(std::size_t ScreenWidth, std::size_t ScreenHeight)
+    Renderer::Renderer(std::size_t ScreenWidth, std::size_t ScreenHeight, bool OctreeEnabled, std::size_t LightingScale, bool CheckerboardEnabled)
         : ScreenWidth(ScreenWidth)
-        , ScreenHeight(ScreenHeight) {
+        , ScreenHeight(ScreenHeight)
+        , OctreeEnabled(OctreeEnabled)
+        , LightingScale(std::max<std::size_t>(LightingScale, 1))
+        , CheckerboardEnabled(CheckerboardEnabled)
+        , CheckerboardPhase(0)
+        , HistoryIndex(0)
+        , PreviousSceneOffset{{0, 0, 0}}
+        , UploadedSceneVersion(0)
+        , UploadedPaletteVersion(0)
+        , UploadedShadowVersion(0)
+        , UploadedCascadeSize{{0, 0, 0}} {
 
         // Create the WebGL context.
         CHECK_GL(glViewport(0, 0, this->ScreenWidth, this->ScreenHeight));
@@ -69,10 +82,15 @@ namespace Raymarch {
         CHECK_GL(glCompileShader(this->FragmentShaderFXAA));
 
         this->FragmentShaderVoxel = CHECK_GL(glCreateShader(GL_FRAGMENT_SHADER));
-        const char* VoxelShaderSource = ShaderSource::FragmentShaderSourceVoxel.c_str();
+        const char* VoxelShaderSource = (this->OctreeEnabled ? ShaderSource::FragmentShaderSourceVoxelOctree : ShaderSource::FragmentShaderSourceVoxel).c_str();
         CHECK_GL(glShaderSource(this->FragmentShaderVoxel, 1, &VoxelShaderSource, nullptr));
         CHECK_GL(glCompileShader(this->FragmentShaderVoxel));
 
+        this->FragmentShaderReconstruction = CHECK_GL(glCreateShader(GL_FRAGMENT_SHADER));
+        const char* ReconstructionShaderSource = ShaderSource::FragmentShaderSourceReconstruction.c_str();
+        CHECK_GL(glShaderSource(this->FragmentShaderReconstruction, 1, &ReconstructionShaderSource, nullptr));
+        CHECK_GL(glCompileShader(this->FragmentShaderReconstruction));
+
         // Set up the programs.
         this->ShaderProgramFXAA = CHECK_GL(glCreateProgram());
         CHECK_GL(glAttachShader(this->ShaderProgramFXAA, this->VertexShader));
@@ -84,8 +102,15 @@ namespace Raymarch {
         CHECK_GL(glAttachShader(this->ShaderProgramVoxel, this->VertexShader));
         CHECK_GL(glAttachShader(this->ShaderProgramVoxel, this->FragmentShaderVoxel));
         CHECK_GL(glBindFragDataLocation(this->ShaderProgramVoxel, 0, "out_gl_FragColor"));
+        CHECK_GL(glBindFragDataLocation(this->ShaderProgramVoxel, 1, "out_gl_FragDistance"));
         CHECK_GL(glLinkProgram(this->ShaderProgramVoxel));
 
+        this->ShaderProgramReconstruction = CHECK_GL(glCreateProgram());
+        CHECK_GL(glAttachShader(this->ShaderProgramReconstruction, this->VertexShader));
+        CHECK_GL(glAttachShader(this->ShaderProgramReconstruction, this->FragmentShaderReconstruction));
+        CHECK_GL(glBindFragDataLocation(this->ShaderProgramReconstruction, 0, "out_gl_FragColor"));
+        CHECK_GL(glLinkProgram(this->ShaderProgramReconstruction));
+
         // Catch any errors.
         GLint ErrorCode;
         CHECK_GL(glGetShaderiv(this->VertexShader, GL_COMPILE_STATUS, &ErrorCode));
@@ -109,6 +134,13 @@ namespace Raymarch {
             std::cerr << "The voxel fragment shader failed to compile with the error:" << std::endl << InfoLogBuffer << std::endl;
         }
 
+        CHECK_GL(glGetShaderiv(this->FragmentShaderReconstruction, GL_COMPILE_STATUS, &ErrorCode));
+        if (ErrorCode == GL_FALSE) {
+            char InfoLogBuffer[1024];
+            CHECK_GL(glGetShaderInfoLog(this->FragmentShaderReconstruction, 1024, NULL, InfoLogBuffer));
+            std::cerr << "The reconstruction fragment shader failed to compile with the error:" << std::endl << InfoLogBuffer << std::endl;
+        }
+
         CHECK_GL(glGetProgramiv(this->ShaderProgramFXAA, GL_LINK_STATUS, &ErrorCode));
         if (ErrorCode == GL_FALSE) {
             char InfoLogBuffer[1024];
@@ -123,6 +155,13 @@ namespace Raymarch {
             std::cerr << "The voxel shader program failed to compile with the error:" << std::endl << InfoLogBuffer << std::endl;
         }
 
+        CHECK_GL(glGetProgramiv(this->ShaderProgramReconstruction, GL_LINK_STATUS, &ErrorCode));
+        if (ErrorCode == GL_FALSE) {
+            char InfoLogBuffer[1024];
+            CHECK_GL(glGetProgramInfoLog(this->ShaderProgramReconstruction, 1024, NULL, InfoLogBuffer));
+            std::cerr << "The reconstruction shader program failed to compile with the error:" << std::endl << InfoLogBuffer << std::endl;
+        }
+
         ///////////////////////////////////////////////////////////////////////////
         /// Configure the FXAA program, uniforms, framebuffers, and texture.     //
         ///////////////////////////////////////////////////////////////////////////
@@ -151,6 +190,80 @@ namespace Raymarch {
 
         CHECK_GL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->TextureFXAA, 0));
 
+        ///////////////////////////////////////////////////////////////////////////
+        /// Configure the reconstruction program, framebuffers, and textures.     //
+        ///////////////////////////////////////////////////////////////////////////
+
+        CHECK_GL(glUseProgram(this->ShaderProgramReconstruction));
+
+        this->ShaderUniformReconstructionScreenResolution       = CHECK_GL(glGetUniformLocation(this->ShaderProgramReconstruction, "ScreenResolution"));
+        this->ShaderUniformReconstructionViewportOffset         = CHECK_GL(glGetUniformLocation(this->ShaderProgramReconstruction, "ViewportOffset"));
+        this->ShaderUniformReconstructionCameraPosition         = CHECK_GL(glGetUniformLocation(this->ShaderProgramReconstruction, "CameraPosition"));
+        this->ShaderUniformReconstructionCameraTarget           = CHECK_GL(glGetUniformLocation(this->ShaderProgramReconstruction, "CameraTarget"));
+        this->ShaderUniformReconstructionNearClip               = CHECK_GL(glGetUniformLocation(this->ShaderProgramReconstruction, "NearClip"));
+        this->ShaderUniformReconstructionFieldOfView            = CHECK_GL(glGetUniformLocation(this->ShaderProgramReconstruction, "FieldOfView"));
+        this->ShaderUniformReconstructionCheckerboardPhase      = CHECK_GL(glGetUniformLocation(this->ShaderProgramReconstruction, "CheckerboardPhase"));
+        this->ShaderUniformReconstructionHistoryEnabled         = CHECK_GL(glGetUniformLocation(this->ShaderProgramReconstruction, "HistoryEnabled"));
+        this->ShaderUniformReconstructionPreviousCameraPosition = CHECK_GL(glGetUniformLocation(this->ShaderProgramReconstruction, "PreviousCameraPosition"));
+        this->ShaderUniformReconstructionPreviousCameraTarget   = CHECK_GL(glGetUniformLocation(this->ShaderProgramReconstruction, "PreviousCameraTarget"));
+        this->ShaderUniformReconstructionSceneMotion            = CHECK_GL(glGetUniformLocation(this->ShaderProgramReconstruction, "SceneMotion"));
+
+        // The reconstructed frames have the size of the FXAA framebuffer, which reads them.
+        const GLint ShaderUniformHistoryResolution = CHECK_GL(glGetUniformLocation(this->ShaderProgramReconstruction, "HistoryResolution"));
+        CHECK_GL(glUniform2fv(ShaderUniformHistoryResolution, 1, ScreenResolution));
+
+        // The samplers live on the ninth to eleventh texture units, clear of those the voxel program reads.
+        const GLint ShaderUniformCheckerboardSampler = CHECK_GL(glGetUniformLocation(this->ShaderProgramReconstruction, "CheckerboardSampler"));
+        CHECK_GL(glUniform1i(ShaderUniformCheckerboardSampler, 8));
+        const GLint ShaderUniformDistanceSampler = CHECK_GL(glGetUniformLocation(this->ShaderProgramReconstruction, "DistanceSampler"));
+        CHECK_GL(glUniform1i(ShaderUniformDistanceSampler, 9));
+        const GLint ShaderUniformHistorySampler = CHECK_GL(glGetUniformLocation(this->ShaderProgramReconstruction, "HistorySampler"));
+        CHECK_GL(glUniform1i(ShaderUniformHistorySampler, 10));
+
+        // Create the framebuffer of the marched pixels, in pairs along X, with their distances alongside.
+        CHECK_GL(glGenFramebuffers(1, &this->FrameBufferCheckerboard));
+        CHECK_GL(glGenTextures(1, &this->TextureCheckerboard));
+        CHECK_GL(glGenTextures(1, &this->TextureDistance));
+        CHECK_GL(glGenFramebuffers(2, this->FrameBufferHistory.data()));
+        CHECK_GL(glGenTextures(2, this->TextureHistory.data()));
+        if (this->CheckerboardEnabled) {
+            CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, this->FrameBufferCheckerboard));
+
+            CHECK_GL(glActiveTexture(GL_TEXTURE8));
+            CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->TextureCheckerboard));
+            CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+            CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+            CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, FramebufferWidth / 2, FramebufferHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+            CHECK_GL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->TextureCheckerboard, 0));
+
+            CHECK_GL(glActiveTexture(GL_TEXTURE9));
+            CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->TextureDistance));
+            CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+            CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+            CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, FramebufferWidth / 2, FramebufferHeight, 0, GL_RED, GL_FLOAT, nullptr));
+            CHECK_GL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, this->TextureDistance, 0));
+
+            const GLenum DrawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+            CHECK_GL(glDrawBuffers(2, DrawBuffers));
+
+            // The reconstructed frames are filtered when the previous one is sampled between its pixels.
+            CHECK_GL(glActiveTexture(GL_TEXTURE10));
+            for (std::size_t Index = 0; Index < 2; ++Index) {
+                CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, this->FrameBufferHistory[Index]));
+                CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->TextureHistory[Index]));
+                CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+                CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+                CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+                CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+                CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, FramebufferWidth, FramebufferHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+                CHECK_GL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->TextureHistory[Index], 0));
+            }
+            CHECK_GL(glBindTexture(GL_TEXTURE_2D, 0));
+            CHECK_GL(glActiveTexture(GL_TEXTURE0));
+
+            CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, this->FrameBufferFXAA));
+        }
+
         ///////////////////////////////////////////////////////////////////////////
         /// Create the Voxel program, uniforms, and texture.                     //
         ///////////////////////////////////////////////////////////////////////////
@@ -158,7 +271,7 @@ namespace Raymarch {
         CHECK_GL(glUseProgram(this->ShaderProgramVoxel));
 
         this->ShaderUniformScreenResolution      = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "ScreenResolution"));
-        this->ShaderUniformFramebufferResolution = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "FramebufferResolution"));
+        this->ShaderUniformViewportOffset        = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "ViewportOffset"));
 
         this->ShaderUniformOffset                = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "SceneOffset"));
 
@@ -174,6 +287,19 @@ namespace Raymarch {
         this->ShaderUniformFogColour             = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "FogColour"));
 
         this->ShaderUniformVolumeSize            = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "VolumeSize"));
+        this->ShaderUniformPaletteEnabled        = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "PaletteEnabled"));
+
+        this->ShaderUniformCascadeCount          = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "CascadeCount"));
+        this->ShaderUniformCascadeOrigins        = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "CascadeOrigins"));
+
+        this->ShaderUniformOctreeSide            = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "OctreeSide"));
+
+        this->ShaderUniformLightingPass          = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "LightingPass"));
+        this->ShaderUniformLightingUpsampled     = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "LightingUpsampled"));
+        this->ShaderUniformLightingViewport      = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "LightingViewport"));
+
+        this->ShaderUniformCheckerboardEnabled   = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "CheckerboardEnabled"));
+        this->ShaderUniformCheckerboardPhase     = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "CheckerboardPhase"));
 
         // Configure OpenGL.
         CHECK_GL(glDisable(GL_DEPTH_TEST));
@@ -184,16 +310,153 @@ namespace Raymarch {
         CHECK_GL(glClearColor(0, 0, 0, 1));
         CHECK_GL(glClear(GL_COLOR_BUFFER_BIT));
 
-        // Create the volume texture.
+        // Create the brick atlas texture.
         CHECK_GL(glGenTextures(1, &this->TextureVoxel));
-        CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->TextureVoxel));
-        CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
-        CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+        CHECK_GL(glBindTexture(GL_TEXTURE_3D, this->TextureVoxel));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
         CHECK_GL(glActiveTexture(GL_TEXTURE0));
 
         // Set the sampler.
         const GLint ShaderUniformSampler = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "BinarySampler"));
         CHECK_GL(glUniform1i(ShaderUniformSampler, 0));
+
+        // Create the shadow texture, it lives on the second texture unit.
+        CHECK_GL(glActiveTexture(GL_TEXTURE1));
+        CHECK_GL(glGenTextures(1, &this->TextureShadow));
+        CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->TextureShadow));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+        CHECK_GL(glActiveTexture(GL_TEXTURE0));
+
+        // Set the shadow sampler.
+        const GLint ShaderUniformShadowSampler = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "ShadowSampler"));
+        CHECK_GL(glUniform1i(ShaderUniformShadowSampler, 1));
+
+        // Create the ambient occlusion atlas texture, it lives on the third texture unit.
+        CHECK_GL(glActiveTexture(GL_TEXTURE2));
+        CHECK_GL(glGenTextures(1, &this->TextureOcclusion));
+        CHECK_GL(glBindTexture(GL_TEXTURE_3D, this->TextureOcclusion));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+        CHECK_GL(glActiveTexture(GL_TEXTURE0));
+
+        // Set the ambient occlusion sampler.
+        const GLint ShaderUniformOcclusionSampler = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "OcclusionSampler"));
+        CHECK_GL(glUniform1i(ShaderUniformOcclusionSampler, 2));
+
+        // Create the palette texture, it lives on the fourth texture unit.
+        CHECK_GL(glActiveTexture(GL_TEXTURE3));
+        CHECK_GL(glGenTextures(1, &this->TexturePalette));
+        CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->TexturePalette));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+        CHECK_GL(glActiveTexture(GL_TEXTURE0));
+
+        // Set the palette sampler.
+        const GLint ShaderUniformPaletteSampler = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "PaletteSampler"));
+        CHECK_GL(glUniform1i(ShaderUniformPaletteSampler, 3));
+
+        // Create the cascade texture, it lives on the fifth texture unit.
+        CHECK_GL(glActiveTexture(GL_TEXTURE4));
+        CHECK_GL(glGenTextures(1, &this->TextureCascades));
+        CHECK_GL(glBindTexture(GL_TEXTURE_3D, this->TextureCascades));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+        CHECK_GL(glActiveTexture(GL_TEXTURE0));
+
+        // Set the cascade sampler.
+        const GLint ShaderUniformCascadeSampler = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "CascadeSampler"));
+        CHECK_GL(glUniform1i(ShaderUniformCascadeSampler, 4));
+
+        // Create the page texture, it lives on the sixth texture unit.
+        CHECK_GL(glActiveTexture(GL_TEXTURE5));
+        CHECK_GL(glGenTextures(1, &this->TexturePages));
+        CHECK_GL(glBindTexture(GL_TEXTURE_3D, this->TexturePages));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+        CHECK_GL(glActiveTexture(GL_TEXTURE0));
+
+        // Set the page sampler.
+        const GLint ShaderUniformPageSampler = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "PageSampler"));
+        CHECK_GL(glUniform1i(ShaderUniformPageSampler, 5));
+
+        // Create the octree buffer and its texture, it lives on the seventh texture unit.
+        CHECK_GL(glGenBuffers(1, &this->BufferOctree));
+        CHECK_GL(glActiveTexture(GL_TEXTURE6));
+        CHECK_GL(glGenTextures(1, &this->TextureOctree));
+        CHECK_GL(glActiveTexture(GL_TEXTURE0));
+
+        // Set the octree sampler.
+        const GLint ShaderUniformOctreeSampler = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "OctreeSampler"));
+        CHECK_GL(glUniform1i(ShaderUniformOctreeSampler, 6));
+
+        // Create the lighting pass framebuffer and its texture, it is read on the eighth texture unit once drawn.
+        CHECK_GL(glGenFramebuffers(1, &this->FrameBufferLighting));
+        CHECK_GL(glGenTextures(1, &this->TextureLighting));
+        if (this->LightingScale > 1) {
+            CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, this->FrameBufferLighting));
+            CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->TextureLighting));
+            CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+            CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+            CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, (this->ScreenWidth + this->LightingScale - 1) / this->LightingScale, (this->ScreenHeight + this->LightingScale - 1) / this->LightingScale, 0, GL_RGBA, GL_FLOAT, nullptr));
+            CHECK_GL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->TextureLighting, 0));
+            CHECK_GL(glBindTexture(GL_TEXTURE_2D, 0));
+            CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, this->FrameBufferFXAA));
+        }
+
+        // Set the lighting sampler.
+        const GLint ShaderUniformLightingSampler = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "LightingSampler"));
+        CHECK_GL(glUniform1i(ShaderUniformLightingSampler, 7));
+
+        // The atlas grows in layers of bricks up to the deepest 3D texture.
+        GLint Maximum3DTextureSize = 0;
+        CHECK_GL(glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &Maximum3DTextureSize));
+        this->Bricks = BrickAtlas(1, static_cast<std::size_t>(Maximum3DTextureSize) / BrickAtlas::BrickSize);
+    }
+
+    // Destructor, the framebuffers are deleted before the textures attached to them and the shaders are flagged for deletion
+    // with the programs they are attached to.
+    Renderer::~Renderer(void) {
+        CHECK_GL(glDeleteFramebuffers(1, &this->FrameBufferFXAA));
+        CHECK_GL(glDeleteFramebuffers(1, &this->FrameBufferLighting));
+        CHECK_GL(glDeleteFramebuffers(1, &this->FrameBufferCheckerboard));
+        CHECK_GL(glDeleteFramebuffers(2, this->FrameBufferHistory.data()));
+
+        CHECK_GL(glDeleteTextures(1, &this->TextureFXAA));
+        CHECK_GL(glDeleteTextures(1, &this->TextureLighting));
+        CHECK_GL(glDeleteTextures(1, &this->TextureCheckerboard));
+        CHECK_GL(glDeleteTextures(1, &this->TextureDistance));
+        CHECK_GL(glDeleteTextures(2, this->TextureHistory.data()));
+        CHECK_GL(glDeleteTextures(1, &this->TextureVoxel));
+        CHECK_GL(glDeleteTextures(1, &this->TextureShadow));
+        CHECK_GL(glDeleteTextures(1, &this->TextureOcclusion));
+        CHECK_GL(glDeleteTextures(1, &this->TexturePalette));
+        CHECK_GL(glDeleteTextures(1, &this->TextureCascades));
+        CHECK_GL(glDeleteTextures(1, &this->TexturePages));
+        CHECK_GL(glDeleteTextures(1, &this->TextureOctree));
+        CHECK_GL(glDeleteBuffers(1, &this->BufferOctree));
+
+        CHECK_GL(glDeleteProgram(this->ShaderProgramFXAA));
+        CHECK_GL(glDeleteProgram(this->ShaderProgramVoxel));
+        CHECK_GL(glDeleteProgram(this->ShaderProgramReconstruction));
+        CHECK_GL(glDeleteShader(this->VertexShader));
+        CHECK_GL(glDeleteShader(this->FragmentShaderFXAA));
+        CHECK_GL(glDeleteShader(this->FragmentShaderVoxel));
+        CHECK_GL(glDeleteShader(this->FragmentShaderReconstruction));
+    }
+
+    // Query the texture limits of the current context.
+    std::array<std::size_t, 3> Renderer::GetMaximumSceneSize(std::size_t CascadeCount) {
+        GLint MaximumTextureSize = 0;
+        GLint Maximum3DTextureSize = 0;
+        CHECK_GL(glGetIntegerv(GL_MAX_TEXTURE_SIZE, &MaximumTextureSize));
+        CHECK_GL(glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &Maximum3DTextureSize));
+
+        // The shadow map is a 2D texture over X and Z, and the cascades are stacked along Y.
+        const std::size_t Horizontal = static_cast<std::size_t>(std::min(MaximumTextureSize, Maximum3DTextureSize));
+        const std::size_t Vertical = static_cast<std::size_t>(Maximum3DTextureSize) / std::max<std::size_t>(1, CascadeCount);
+        return {{Horizontal, Vertical, Horizontal}};
     }
 
     // Round input to a power of two greater than or equal to the input value.
@@ -207,65 +470,382 @@ namespace Raymarch {
         return Value + 1;
     }
 
-    void Renderer::Render(const GameState& State) {
-        // Clear the colour buffer.
-        CHECK_GL(glClearColor(State.GetFogColour()[0], State.GetFogColour()[1], State.GetFogColour()[2], 1));
-        CHECK_GL(glClear(GL_COLOR_BUFFER_BIT));
+    // Upload the bricks of the packed scene that changed, every used layer of the atlas when the bricks were repacked.
+    void Renderer::UploadScene(const GameState& State) {
+        const PaletteVolume& Scene = State.GetPackedScene();
+        if (State.GetSceneVersion() == this->UploadedSceneVersion) {
+            return;
+        }
 
-        // Render the volume to the framebuffer.
-        CHECK_GL(glUseProgram(this->ShaderProgramVoxel));
-        CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, this->FrameBufferFXAA));
+        // Only the dirty region changed when the textures hold its base version, otherwise every brick is repacked.
+        this->Bricks.Update(Scene, State.GetAmbientOcclusion(), State.GetSceneDirtyRegion(), State.GetSceneBaseVersion() != this->UploadedSceneVersion);
+
+        // The atlas texture format follows the index width.
+        const std::size_t IndexWidth = this->Bricks.GetIndexWidth();
+        const GLint IndexFormat = (IndexWidth == 1) ? GL_R8UI : ((IndexWidth == 2) ? GL_R16UI : GL_R32UI);
+        const GLenum IndexType = (IndexWidth == 1) ? GL_UNSIGNED_BYTE : ((IndexWidth == 2) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+        const std::array<std::size_t, 3> AtlasSize = this->Bricks.GetAtlasSize();
+        CHECK_GL(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+
+        if (this->Bricks.IsResized()) {
+            CHECK_GL(glTexImage3D(GL_TEXTURE_3D, 0, IndexFormat, AtlasSize[0], AtlasSize[1], AtlasSize[2], 0, GL_RED_INTEGER, IndexType, nullptr));
+            CHECK_GL(glActiveTexture(GL_TEXTURE2));
+            CHECK_GL(glBindTexture(GL_TEXTURE_3D, this->TextureOcclusion));
+            CHECK_GL(glTexImage3D(GL_TEXTURE_3D, 0, GL_RG32UI, AtlasSize[0], AtlasSize[1], AtlasSize[2], 0, GL_RG_INTEGER, GL_UNSIGNED_INT, nullptr));
+            CHECK_GL(glActiveTexture(GL_TEXTURE0));
+        }
 
-        // Screen resolution.
-        const GLfloat ScreenResolution[2] = { static_cast<float>(this->ScreenWidth), static_cast<float>(this->ScreenHeight) };
-        CHECK_GL(glUniform2fv(this->ShaderUniformScreenResolution, 1, ScreenResolution));
-        const GLfloat FramebufferResolution[2] = { static_cast<float>(this->CeilPowerOfTwo(State.GetScene().GetSizeX())), static_cast<float>(this->CeilPowerOfTwo(State.GetScene().GetSizeY() * State.GetScene().GetSizeZ())) };
-        CHECK_GL(glUniform2fv(this->ShaderUniformFramebufferResolution, 1, FramebufferResolution));
+        if (this->Bricks.IsResized() || this->Bricks.IsRepacked()) {
+            // Repacked bricks fill the first layers, which are uploaded whole.
+            const std::size_t UsedDepth = this->Bricks.GetUsedLayerCount() * BrickAtlas::BrickSize;
+            if (UsedDepth > 0) {
+                CHECK_GL(glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, AtlasSize[0], AtlasSize[1], UsedDepth, GL_RED_INTEGER, IndexType, this->Bricks.GetIndices()));
+                CHECK_GL(glActiveTexture(GL_TEXTURE2));
+                CHECK_GL(glBindTexture(GL_TEXTURE_3D, this->TextureOcclusion));
+                CHECK_GL(glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, AtlasSize[0], AtlasSize[1], UsedDepth, GL_RG_INTEGER, GL_UNSIGNED_INT, this->Bricks.GetOcclusion()));
+                CHECK_GL(glActiveTexture(GL_TEXTURE0));
+            }
+        }
+        else if (!this->Bricks.GetWrittenSlots().empty()) {
+            // Each written brick is read out of the atlas by the row length and image height.
+            const std::size_t Side = BrickAtlas::BrickSize;
+            CHECK_GL(glPixelStorei(GL_UNPACK_ROW_LENGTH, AtlasSize[0]));
+            CHECK_GL(glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, AtlasSize[1]));
+            for (const std::uint32_t Slot : this->Bricks.GetWrittenSlots()) {
+                const std::array<std::size_t, 3> Position = BrickAtlas::GetSlotPosition(Slot);
+                const std::size_t Index = Position[0] + AtlasSize[0] * (Position[1] + AtlasSize[1] * Position[2]);
+                CHECK_GL(glTexSubImage3D(GL_TEXTURE_3D, 0, Position[0], Position[1], Position[2], Side, Side, Side, GL_RED_INTEGER, IndexType, &this->Bricks.GetIndices()[Index * IndexWidth]));
+            }
+            CHECK_GL(glActiveTexture(GL_TEXTURE2));
+            CHECK_GL(glBindTexture(GL_TEXTURE_3D, this->TextureOcclusion));
+            for (const std::uint32_t Slot : this->Bricks.GetWrittenSlots()) {
+                const std::array<std::size_t, 3> Position = BrickAtlas::GetSlotPosition(Slot);
+                const std::size_t Index = Position[0] + AtlasSize[0] * (Position[1] + AtlasSize[1] * Position[2]);
+                CHECK_GL(glTexSubImage3D(GL_TEXTURE_3D, 0, Position[0], Position[1], Position[2], Side, Side, Side, GL_RG_INTEGER, GL_UNSIGNED_INT, &this->Bricks.GetOcclusion()[Index * 2]));
+            }
+            CHECK_GL(glActiveTexture(GL_TEXTURE0));
+            CHECK_GL(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+            CHECK_GL(glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, 0));
+        }
+
+        // The page table has a page per brick of the scene, it is small enough to upload whole.
+        if (this->Bricks.IsPagesChanged()) {
+            const std::array<std::size_t, 3>& PageSize = this->Bricks.GetPageSize();
+            CHECK_GL(glActiveTexture(GL_TEXTURE5));
+            CHECK_GL(glBindTexture(GL_TEXTURE_3D, this->TexturePages));
+            CHECK_GL(glTexImage3D(GL_TEXTURE_3D, 0, GL_R32UI, PageSize[0], PageSize[1], PageSize[2], 0, GL_RED_INTEGER, GL_UNSIGNED_INT, this->Bricks.GetPages()));
+            CHECK_GL(glActiveTexture(GL_TEXTURE0));
+        }
 
-        // Scene offset.
-        const GLfloat SceneOffset[3] = {static_cast<float>(State.GetSceneOffset()[0]), static_cast<float>(State.GetSceneOffset()[1]), static_cast<float>(State.GetSceneOffset()[2])};
-        CHECK_GL(glUniform3fv(this->ShaderUniformOffset, 1, SceneOffset));
+        // The palette is stored in rows of a small texture, padded to whole rows.
+        if ((Scene.GetPaletteVersion() != this->UploadedPaletteVersion) && !Scene.GetPalette().empty()) {
+            const std::size_t PaletteRows = (Scene.GetPalette().size() + PaletteVolume::PaletteRowSize - 1) / PaletteVolume::PaletteRowSize;
+            std::vector<Voxel> PaddedPalette(Scene.GetPalette());
+            PaddedPalette.resize(PaletteRows * PaletteVolume::PaletteRowSize);
+            CHECK_GL(glActiveTexture(GL_TEXTURE3));
+            CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->TexturePalette));
+            CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, PaletteVolume::PaletteRowSize, PaletteRows, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, PaddedPalette.data()));
+            CHECK_GL(glActiveTexture(GL_TEXTURE0));
+            this->UploadedPaletteVersion = Scene.GetPaletteVersion();
+        }
+        CHECK_GL(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+
+        this->UploadedSceneVersion = State.GetSceneVersion();
+    }
+
+    // Rebuild the octree from the packed scene and replace the octree buffer, the octree is compact so it is not updated in place.
+    // The packed scene is built from rather than the scene as it is the copy published to the renderer when pipelined.
+    void Renderer::UploadOctree(const GameState& State) {
+        if (State.GetSceneVersion() == this->UploadedSceneVersion) {
+            return;
+        }
+
+        this->Octree.Build(State.GetPackedScene());
+
+        CHECK_GL(glBindBuffer(GL_TEXTURE_BUFFER, this->BufferOctree));
+        CHECK_GL(glBufferData(GL_TEXTURE_BUFFER, this->Octree.GetByteCount(), this->Octree.data(), GL_STATIC_DRAW));
+        CHECK_GL(glBindBuffer(GL_TEXTURE_BUFFER, 0));
+        CHECK_GL(glActiveTexture(GL_TEXTURE6));
+        CHECK_GL(glBindTexture(GL_TEXTURE_BUFFER, this->TextureOctree));
+        CHECK_GL(glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, this->BufferOctree));
+        CHECK_GL(glActiveTexture(GL_TEXTURE0));
+
+        // The side of the cube the root covers follows the scene size.
+        CHECK_GL(glUniform1f(this->ShaderUniformOctreeSide, static_cast<float>(this->Octree.GetSide())));
+
+        this->UploadedSceneVersion = State.GetSceneVersion();
+    }
+
+    // Upload the cascades, each is replaced in full when its version changes as a moved cascade changes every cell.
+    void Renderer::UploadCascades(const GameState& State) {
+        const Clipmap& Cascades = State.GetCascades();
+        const std::size_t LevelCount = Cascades.GetLevelCount();
+        if (LevelCount == 0) {
+            return;
+        }
+
+        // The cascades are stacked along Y, the axis the scene is smallest along.
+        const std::array<std::size_t, 3>& Size = Cascades.GetSize();
+        CHECK_GL(glActiveTexture(GL_TEXTURE4));
+        CHECK_GL(glBindTexture(GL_TEXTURE_3D, this->TextureCascades));
+        if ((Size != this->UploadedCascadeSize) || (LevelCount != this->UploadedCascadeVersions.size())) {
+            CHECK_GL(glTexImage3D(GL_TEXTURE_3D, 0, GL_R32UI, Size[0], Size[1] * LevelCount, Size[2], 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr));
+            this->UploadedCascadeSize = Size;
+            this->UploadedCascadeVersions.assign(LevelCount, 0);
+        }
+        for (std::size_t Level = 0; Level < LevelCount; ++Level) {
+            if (Cascades.GetVersion(Level) != this->UploadedCascadeVersions[Level]) {
+                CHECK_GL(glTexSubImage3D(GL_TEXTURE_3D, 0, 0, Size[1] * Level, 0, Size[0], Size[1], Size[2], GL_RED_INTEGER, GL_UNSIGNED_INT, Cascades.data(Level)));
+                this->UploadedCascadeVersions[Level] = Cascades.GetVersion(Level);
+            }
+        }
+        CHECK_GL(glActiveTexture(GL_TEXTURE0));
+    }
+
+    // The lighting pass covers a view at a fraction of its resolution, rounding up so that every pixel of the view has samples around it.
+    Renderer::View Renderer::GetLightingView(const View& Current) const {
+        View Lighting = Current;
+        for (std::size_t Index = 0; Index < 2; ++Index) {
+            Lighting.Position[Index] = Current.Position[Index] / this->LightingScale;
+            Lighting.Size[Index] = std::max<std::size_t>((Current.Size[Index] + this->LightingScale - 1) / this->LightingScale, 1);
+        }
+        return Lighting;
+    }
+
+    void Renderer::DrawView(const View& Current, bool Checkerboard) {
+        if (Checkerboard) {
+            // Each fragment marches one pixel of a pair along X, covering every pair the view touches.
+            CHECK_GL(glViewport(Current.Position[0] / 2, Current.Position[1], (Current.Position[0] + Current.Size[0] + 1) / 2 - Current.Position[0] / 2, Current.Size[1]));
+        }
+        else {
+            CHECK_GL(glViewport(Current.Position[0], Current.Position[1], Current.Size[0], Current.Size[1]));
+        }
+        CHECK_GL(glUniform1i(this->ShaderUniformCheckerboardEnabled, Checkerboard));
 
-        // Lighting.
-        const GLfloat LightPosition[3] = { State.GetLightPosition()[0], State.GetLightPosition()[1], State.GetLightPosition()[2] };
-        CHECK_GL(glUniform3fv(this->ShaderUniformLightPosition, 1, LightPosition));
+        // View rectangle.
+        const GLfloat ScreenResolution[2] = { static_cast<float>(Current.Size[0]), static_cast<float>(Current.Size[1]) };
+        CHECK_GL(glUniform2fv(this->ShaderUniformScreenResolution, 1, ScreenResolution));
+        const GLfloat ViewportOffset[2] = { static_cast<float>(Current.Position[0]), static_cast<float>(Current.Position[1]) };
+        CHECK_GL(glUniform2fv(this->ShaderUniformViewportOffset, 1, ViewportOffset));
 
         // Camera.
-        const GLfloat CameraPosition[3] = { State.GetCameraPosition()[0], State.GetCameraPosition()[1], State.GetCameraPosition()[2] };
+        const GLfloat CameraPosition[3] = { Current.CameraPosition[0], Current.CameraPosition[1], Current.CameraPosition[2] };
         CHECK_GL(glUniform3fv(this->ShaderUniformCameraPosition, 1, CameraPosition));
-        const GLfloat CameraTarget[3] = { State.GetCameraTarget()[0], State.GetCameraTarget()[1], State.GetCameraTarget()[2] };
+        const GLfloat CameraTarget[3] = { Current.CameraTarget[0], Current.CameraTarget[1], Current.CameraTarget[2] };
         CHECK_GL(glUniform3fv(this->ShaderUniformCameraTarget, 1, CameraTarget));
 
         // Perspective.
-        CHECK_GL(glUniform1f(this->ShaderUniformNearClip, State.GetNearClip()));
-        CHECK_GL(glUniform1f(this->ShaderUniformFieldOfView, State.GetFieldOfView()));
+        CHECK_GL(glUniform1f(this->ShaderUniformNearClip, Current.NearClip));
+        CHECK_GL(glUniform1f(this->ShaderUniformFieldOfView, Current.FieldOfView));
 
         // Fog.
-        CHECK_GL(glUniform1f(this->ShaderUniformFogDistance, State.GetFogDistance()));
-        const GLfloat FogColour[4] = { State.GetFogColour()[0], State.GetFogColour()[1], State.GetFogColour()[2], 1 };
-        CHECK_GL(glUniform4fv(this->ShaderUniformFogColour, 1, FogColour));
+        CHECK_GL(glUniform1f(this->ShaderUniformFogDistance, Current.FogDistance));
 
-        // Volume size.
-        const GLfloat VolumeSize[3] = { static_cast<float>(State.GetScene().GetSizeX()), static_cast<float>(State.GetScene().GetSizeY()), static_cast<float>(State.GetScene().GetSizeZ()) };
-        CHECK_GL(glUniform3fv(this->ShaderUniformVolumeSize, 1, VolumeSize));
+        CHECK_GL(glDrawArrays(GL_TRIANGLES, 0, 3));
+    }
 
-        // Volume texture.
-        CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->TextureVoxel));
+    // Missing pixels are taken from the previous frame where the view had one, otherwise from their neighbours alone.
+    void Renderer::DrawReconstruction(const View& Current, const View* Previous, const std::array<int, 3>& SceneMotion) {
+        CHECK_GL(glViewport(Current.Position[0], Current.Position[1], Current.Size[0], Current.Size[1]));
 
-        // Volume sampler.
-        const GLint ShaderUniformBinarySampler = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "BinarySampler"));
-        CHECK_GL(glUniform1i(ShaderUniformBinarySampler, 0));
+        // View rectangle.
+        const GLfloat ScreenResolution[2] = { static_cast<float>(Current.Size[0]), static_cast<float>(Current.Size[1]) };
+        CHECK_GL(glUniform2fv(this->ShaderUniformReconstructionScreenResolution, 1, ScreenResolution));
+        const GLfloat ViewportOffset[2] = { static_cast<float>(Current.Position[0]), static_cast<float>(Current.Position[1]) };
+        CHECK_GL(glUniform2fv(this->ShaderUniformReconstructionViewportOffset, 1, ViewportOffset));
 
-        // Upload
-        CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, State.GetScene().GetSizeX(), State.GetScene().GetSizeY() * State.GetScene().GetSizeZ(), 0, GL_RED_INTEGER, GL_UNSIGNED_INT, State.GetScene().data()));
-        CHECK_GL(glDrawArrays(GL_TRIANGLES, 0, 3));
+        // Camera.
+        const GLfloat CameraPosition[3] = { Current.CameraPosition[0], Current.CameraPosition[1], Current.CameraPosition[2] };
+        CHECK_GL(glUniform3fv(this->ShaderUniformReconstructionCameraPosition, 1, CameraPosition));
+        const GLfloat CameraTarget[3] = { Current.CameraTarget[0], Current.CameraTarget[1], Current.CameraTarget[2] };
+        CHECK_GL(glUniform3fv(this->ShaderUniformReconstructionCameraTarget, 1, CameraTarget));
+
+        // Perspective.
+        CHECK_GL(glUniform1f(this->ShaderUniformReconstructionNearClip, Current.NearClip));
+        CHECK_GL(glUniform1f(this->ShaderUniformReconstructionFieldOfView, Current.FieldOfView));
+
+        // Previous camera and the motion of the scene since.
+        CHECK_GL(glUniform1i(this->ShaderUniformReconstructionHistoryEnabled, Previous != nullptr));
+        if (Previous != nullptr) {
+            const GLfloat PreviousCameraPosition[3] = { Previous->CameraPosition[0], Previous->CameraPosition[1], Previous->CameraPosition[2] };
+            CHECK_GL(glUniform3fv(this->ShaderUniformReconstructionPreviousCameraPosition, 1, PreviousCameraPosition));
+            const GLfloat PreviousCameraTarget[3] = { Previous->CameraTarget[0], Previous->CameraTarget[1], Previous->CameraTarget[2] };
+            CHECK_GL(glUniform3fv(this->ShaderUniformReconstructionPreviousCameraTarget, 1, PreviousCameraTarget));
+            const GLfloat Motion[3] = { static_cast<float>(SceneMotion[0]), static_cast<float>(SceneMotion[1]), static_cast<float>(SceneMotion[2]) };
+            CHECK_GL(glUniform3fv(this->ShaderUniformReconstructionSceneMotion, 1, Motion));
+        }
 
-        // Apply FXAA
-        CHECK_GL(glUseProgram(this->ShaderProgramFXAA));
-        CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
-        CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->TextureFXAA));
-        const GLint ShaderUniformSampler = CHECK_GL(glGetUniformLocation(this->ShaderProgramFXAA, "Sampler"));
-        CHECK_GL(glUniform1i(ShaderUniformSampler, 0));
         CHECK_GL(glDrawArrays(GL_TRIANGLES, 0, 3));
     }
+
+    // The view of the game state camera over the whole window.
+    Renderer::View Renderer::GetView(const GameState& State) const {
+        return {{{0, 0}}, {{this->ScreenWidth, this->ScreenHeight}}, State.GetCameraPosition(), State.GetCameraTarget(), State.GetNearClip(), State.GetFieldOfView(), State.GetFogDistance()};
+    }
+
+    void Renderer::Render(const GameState& State) {
+        this->Render(State, {this->GetView(State)});
+    }
+
+    void Renderer::Render(const GameState& State, const std::vector<View>& Views) {
+        RAYMARCH_TRACE_SCOPE("Renderer::Render");
+
+        // In checkerboard rendering the voxel pass writes the marched pixels, which are reconstructed before FXAA.
+        const GLuint FrameBufferVoxel = this->CheckerboardEnabled ? this->FrameBufferCheckerboard : this->FrameBufferFXAA;
+
+        // Clear the colour buffer.
+        CHECK_GL(glClearColor(State.GetFogColour()[0], State.GetFogColour()[1], State.GetFogColour()[2], 1));
+        CHECK_GL(glClear(GL_COLOR_BUFFER_BIT));
+
+        // Set the voxel program uniforms shared by every view.
+        {
+            RAYMARCH_TRACE_SCOPE("Renderer::Render::Uniforms");
+
+            // Render the volume to the framebuffer, clearing the parts no view covers.
+            CHECK_GL(glUseProgram(this->ShaderProgramVoxel));
+            CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, FrameBufferVoxel));
+            CHECK_GL(glClear(GL_COLOR_BUFFER_BIT));
+
+            // Checkerboard pattern.
+            CHECK_GL(glUniform1i(this->ShaderUniformCheckerboardPhase, this->CheckerboardPhase));
+
+            // Scene offset.
+            const GLfloat SceneOffset[3] = {static_cast<float>(State.GetSceneOffset()[0]), static_cast<float>(State.GetSceneOffset()[1]), static_cast<float>(State.GetSceneOffset()[2])};
+            CHECK_GL(glUniform3fv(this->ShaderUniformOffset, 1, SceneOffset));
+
+            // Lighting.
+            const GLfloat LightPosition[3] = { State.GetLightPosition()[0], State.GetLightPosition()[1], State.GetLightPosition()[2] };
+            CHECK_GL(glUniform3fv(this->ShaderUniformLightPosition, 1, LightPosition));
+
+            // Fog.
+            const GLfloat FogColour[4] = { State.GetFogColour()[0], State.GetFogColour()[1], State.GetFogColour()[2], 1 };
+            CHECK_GL(glUniform4fv(this->ShaderUniformFogColour, 1, FogColour));
+
+            // Volume size.
+            const GLfloat VolumeSize[3] = { static_cast<float>(State.GetScene().GetSizeX()), static_cast<float>(State.GetScene().GetSizeY()), static_cast<float>(State.GetScene().GetSizeZ()) };
+            CHECK_GL(glUniform3fv(this->ShaderUniformVolumeSize, 1, VolumeSize));
+
+            // Palette, the volume texture holds raw voxels when the packed scene has no palette.
+            CHECK_GL(glUniform1i(this->ShaderUniformPaletteEnabled, State.GetPackedScene().GetIndexWidth() != 4));
+
+            // Cascades, their origins are relative to the scene.
+            const Clipmap& Cascades = State.GetCascades();
+            std::vector<GLfloat> CascadeOrigins(Clipmap::MaximumLevels * 3, 0.0f);
+            for (std::size_t Level = 0; Level < Cascades.GetLevelCount(); ++Level) {
+                for (std::size_t Index = 0; Index < 3; ++Index) {
+                    CascadeOrigins[Level * 3 + Index] = static_cast<float>(Cascades.GetOrigin(Level)[Index] - State.GetSceneOffset()[Index]);
+                }
+            }
+            CHECK_GL(glUniform1i(this->ShaderUniformCascadeCount, static_cast<GLint>(Cascades.GetLevelCount())));
+            CHECK_GL(glUniform3fv(this->ShaderUniformCascadeOrigins, Clipmap::MaximumLevels, CascadeOrigins.data()));
+
+            // Brick atlas texture.
+            CHECK_GL(glBindTexture(GL_TEXTURE_3D, this->TextureVoxel));
+
+            // Volume sampler.
+            const GLint ShaderUniformBinarySampler = CHECK_GL(glGetUniformLocation(this->ShaderProgramVoxel, "BinarySampler"));
+            CHECK_GL(glUniform1i(ShaderUniformBinarySampler, 0));
+        }
+
+        // Upload
+        {
+            RAYMARCH_TRACE_SCOPE("Renderer::Render::Upload");
+            if (this->OctreeEnabled) {
+                this->UploadOctree(State);
+            }
+            else {
+                this->UploadScene(State);
+            }
+            this->UploadCascades(State);
+
+            // The shadow heights are small but only change when swept again.
+            const ShadowMap& Shadows = State.GetShadowMap();
+            if (Shadows.GetVersion() != this->UploadedShadowVersion) {
+                CHECK_GL(glActiveTexture(GL_TEXTURE1));
+                CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->TextureShadow));
+                CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, Shadows.GetSizeX(), Shadows.GetSizeZ(), 0, GL_RED, GL_FLOAT, Shadows.data()));
+                CHECK_GL(glActiveTexture(GL_TEXTURE0));
+                this->UploadedShadowVersion = Shadows.GetVersion();
+            }
+        }
+
+        // Light the first voxel of every view at a fraction of its resolution, rays that hit nothing leave the cleared texture empty.
+        if (this->LightingScale > 1) {
+            RAYMARCH_TRACE_SCOPE("Renderer::Render::DrawLighting");
+            CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, this->FrameBufferLighting));
+            CHECK_GL(glActiveTexture(GL_TEXTURE7));
+            CHECK_GL(glBindTexture(GL_TEXTURE_2D, 0));
+            CHECK_GL(glActiveTexture(GL_TEXTURE0));
+            CHECK_GL(glClearColor(0, 0, 0, 0));
+            CHECK_GL(glClear(GL_COLOR_BUFFER_BIT));
+            CHECK_GL(glUniform1i(this->ShaderUniformLightingPass, 1));
+            CHECK_GL(glUniform1i(this->ShaderUniformLightingUpsampled, 0));
+            for (const View& Current : Views) {
+                this->DrawView(this->GetLightingView(Current), false);
+            }
+
+            // The voxel pass reads the lighting pass back from the eighth texture unit.
+            CHECK_GL(glUniform1i(this->ShaderUniformLightingPass, 0));
+            CHECK_GL(glUniform1i(this->ShaderUniformLightingUpsampled, 1));
+            CHECK_GL(glActiveTexture(GL_TEXTURE7));
+            CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->TextureLighting));
+            CHECK_GL(glActiveTexture(GL_TEXTURE0));
+            CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, FrameBufferVoxel));
+        }
+
+        // Raymarch the volume once per view, each into its own rectangle so the cost follows its pixel count.
+        {
+            RAYMARCH_TRACE_SCOPE("Renderer::Render::DrawVoxel");
+            for (const View& Current : Views) {
+                if (this->LightingScale > 1) {
+                    const View Lighting = this->GetLightingView(Current);
+                    const GLfloat LightingViewport[4] = { static_cast<float>(Lighting.Position[0]), static_cast<float>(Lighting.Position[1]), static_cast<float>(Lighting.Size[0]), static_cast<float>(Lighting.Size[1]) };
+                    CHECK_GL(glUniform4fv(this->ShaderUniformLightingViewport, 1, LightingViewport));
+                }
+                this->DrawView(Current, this->CheckerboardEnabled);
+            }
+            CHECK_GL(glViewport(0, 0, this->ScreenWidth, this->ScreenHeight));
+        }
+
+        // Reconstruct the pixels the checkerboard left out into this frame's history, clearing the parts no view covers.
+        if (this->CheckerboardEnabled) {
+            RAYMARCH_TRACE_SCOPE("Renderer::Render::DrawReconstruction");
+            CHECK_GL(glUseProgram(this->ShaderProgramReconstruction));
+            CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, this->FrameBufferHistory[this->HistoryIndex]));
+            CHECK_GL(glClearColor(State.GetFogColour()[0], State.GetFogColour()[1], State.GetFogColour()[2], 1));
+            CHECK_GL(glClear(GL_COLOR_BUFFER_BIT));
+            CHECK_GL(glActiveTexture(GL_TEXTURE10));
+            CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->TextureHistory[1 - this->HistoryIndex]));
+            CHECK_GL(glActiveTexture(GL_TEXTURE0));
+            CHECK_GL(glUniform1i(this->ShaderUniformReconstructionCheckerboardPhase, this->CheckerboardPhase));
+
+            // A view is reprojected into the previous frame only when it covered the same rectangle there.
+            const std::array<int, 3> SceneMotion = {{State.GetSceneOffset()[0] - this->PreviousSceneOffset[0], State.GetSceneOffset()[1] - this->PreviousSceneOffset[1], State.GetSceneOffset()[2] - this->PreviousSceneOffset[2]}};
+            for (std::size_t Index = 0; Index < Views.size(); ++Index) {
+                const bool Matched = (Index < this->PreviousViews.size()) && (this->PreviousViews[Index].Position == Views[Index].Position) && (this->PreviousViews[Index].Size == Views[Index].Size);
+                this->DrawReconstruction(Views[Index], Matched ? &this->PreviousViews[Index] : nullptr, SceneMotion);
+            }
+            CHECK_GL(glViewport(0, 0, this->ScreenWidth, this->ScreenHeight));
+
+            this->PreviousViews = Views;
+            this->PreviousSceneOffset = State.GetSceneOffset();
+        }
+
+        // Apply FXAA once over the whole window.
+        {
+            RAYMARCH_TRACE_SCOPE("Renderer::Render::DrawFXAA");
+            CHECK_GL(glUseProgram(this->ShaderProgramFXAA));
+            CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+            CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->CheckerboardEnabled ? this->TextureHistory[this->HistoryIndex] : this->TextureFXAA));
+            const GLint ShaderUniformSampler = CHECK_GL(glGetUniformLocation(this->ShaderProgramFXAA, "Sampler"));
+            CHECK_GL(glUniform1i(ShaderUniformSampler, 0));
+            CHECK_GL(glDrawArrays(GL_TRIANGLES, 0, 3));
+        }
+
+        // The next frame marches the other pattern and keeps this frame as its history.
+        if (this->CheckerboardEnabled) {
+            this->CheckerboardPhase = 1 - this->CheckerboardPhase;
+            this->HistoryIndex = 1 - this->HistoryIndex;
+        }
+    }
 }
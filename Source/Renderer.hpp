@@ -28,14 +28,43 @@ THE SOFTWARE
 
 #include "Volume.hpp"
 
+#include "BrickAtlas.hpp"
 #include "GameState.hpp"
+#include "SparseVoxelOctree.hpp"
 
 #include <GL/glew.h>
 
 #include <array>
+#include <cstdint>
+#include <vector>
 
 namespace Raymarch {
 	class Renderer {
+    public:
+        /// @brief  A view of the scene rendered into a rectangle of the window, every view of a frame shares the uploaded scene.
+        struct View {
+            /// @brief  The lower left pixel of the view.
+            std::array<std::size_t, 2> Position;
+
+            /// @brief  The size of the view in pixels.
+            std::array<std::size_t, 2> Size;
+
+            /// @brief  The position of the camera in world coordinates.
+            std::array<float, 3> CameraPosition;
+
+            /// @brief  The point the camera looks at in world coordinates, it must not be directly above or below the camera.
+            std::array<float, 3> CameraTarget;
+
+            /// @brief  The near clip distance.
+            float NearClip;
+
+            /// @brief  The horizontal field of view in degrees.
+            float FieldOfView;
+
+            /// @brief  The maximum render distance before fog.
+            float FogDistance;
+        };
+
 	private:
         /// @brief  The width of the OpenGL viewport.
         std::size_t ScreenWidth;
@@ -43,6 +72,18 @@ namespace Raymarch {
         /// @brief  The height of the OpenGL viewport.
         std::size_t ScreenHeight;
 
+        /// @brief  Whether the scene is rendered from a sparse voxel octree rather than the brick atlas.
+        bool OctreeEnabled;
+
+        /// @brief  The divisor of the resolution the first voxel of each pixel is lit at, one lights every pixel in the voxel pass.
+        std::size_t LightingScale;
+
+        /// @brief  Whether the voxel pass marches half of the pixels each frame in alternating checkerboard patterns and reconstructs the rest.
+        bool CheckerboardEnabled;
+
+        /// @brief  The checkerboard pattern marched this frame, pixels where the sum of X and Y has this parity.
+        int CheckerboardPhase;
+
 	private:
         /// @brief  The renderer vertex shader.
         GLuint VertexShader;
@@ -53,23 +94,102 @@ namespace Raymarch {
         /// @brief  The renderer fragment shader to raymarch the voxel volume.
         GLuint FragmentShaderVoxel;
 
+        /// @brief  The renderer fragment shader to reconstruct the pixels missing from a checkerboard frame.
+        GLuint FragmentShaderReconstruction;
+
         /// @brief  The combined vertex and fragment shaders for FXAA.
         GLuint ShaderProgramFXAA;
 
         /// @brief  The combined vertex and fragment shaders for volume renderers.
         GLuint ShaderProgramVoxel;
 
+        /// @brief  The combined vertex and fragment shaders for checkerboard reconstruction.
+        GLuint ShaderProgramReconstruction;
+
         /// @brief  The framebuffer used to store the intermediate render of the voxels.
         GLuint FrameBufferFXAA;
 
         /// @brief  The texture used to access the intermediate FXAA framebuffer.
         GLuint TextureFXAA;
 
-        /// @brief  The volume texture storing the voxel data.
+        /// @brief  The framebuffer used to store the pixels marched in a checkerboard frame and their distances.
+        GLuint FrameBufferCheckerboard;
+
+        /// @brief  The texture storing the pixels marched in a checkerboard frame, in pairs along X.
+        GLuint TextureCheckerboard;
+
+        /// @brief  The texture storing the distance to the first voxel of the pixels marched in a checkerboard frame.
+        GLuint TextureDistance;
+
+        /// @brief  The framebuffers used to store the reconstructed frames, written and read in turn.
+        std::array<GLuint, 2> FrameBufferHistory;
+
+        /// @brief  The textures storing the reconstructed frames.
+        std::array<GLuint, 2> TextureHistory;
+
+        /// @brief  The reconstructed frame written this frame, the other holds the previous frame.
+        std::size_t HistoryIndex;
+
+        /// @brief  The views of the previous frame, for reprojecting into its reconstructed frame.
+        std::vector<View> PreviousViews;
+
+        /// @brief  The scene offset of the previous frame.
+        std::array<int, 3> PreviousSceneOffset;
+
+        /// @brief  The framebuffer used to store the lighting pass.
+        GLuint FrameBufferLighting;
+
+        /// @brief  The texture storing the light, distance and normal of the first voxel of each pixel of the lighting pass.
+        GLuint TextureLighting;
+
+        /// @brief  The 3D atlas texture storing the palette indices, or raw voxel data, of the resident bricks.
         GLuint TextureVoxel;
 
+        /// @brief  The 3D atlas texture storing the baked ambient occlusion of each voxel of the resident bricks.
+        GLuint TextureOcclusion;
+
+        /// @brief  The 3D texture storing the page of each brick of the scene.
+        GLuint TexturePages;
+
+        /// @brief  The resident bricks of the scene, mirroring the atlas and page textures.
+        BrickAtlas Bricks;
+
+        /// @brief  The version of the scene last uploaded to the atlas and page textures, or the octree buffer.
+        std::uint64_t UploadedSceneVersion;
+
+        /// @brief  The buffer storing the nodes of the octree.
+        GLuint BufferOctree;
+
+        /// @brief  The buffer texture used to access the nodes of the octree.
+        GLuint TextureOctree;
+
+        /// @brief  The octree of the scene, mirroring the octree buffer.
+        SparseVoxelOctree Octree;
+
+        /// @brief  The texture storing the palette of the packed scene.
+        GLuint TexturePalette;
+
+        /// @brief  The version of the palette last uploaded to the palette texture.
+        std::uint64_t UploadedPaletteVersion;
+
+        /// @brief  The texture storing the shadow height of each scene column.
+        GLuint TextureShadow;
+
+        /// @brief  The version of the shadow map last uploaded to the shadow texture.
+        std::uint64_t UploadedShadowVersion;
+
+        /// @brief  The 3D texture storing the cells of every cascade stacked along Y.
+        GLuint TextureCascades;
+
+        /// @brief  The version of each cascade last uploaded to the cascade texture.
+        std::vector<std::uint64_t> UploadedCascadeVersions;
+
+        /// @brief  The size of the cascades last uploaded to the cascade texture.
+        std::array<std::size_t, 3> UploadedCascadeSize;
+
     private:
         GLint ShaderUniformScreenResolution;
+        GLint ShaderUniformViewportOffset;
 
         GLint ShaderUniformOffset;
         GLint ShaderUniformLightPosition;
@@ -81,12 +201,56 @@ namespace Raymarch {
         GLint ShaderUniformFogColour;
         GLint ShaderUniformFogDistance;
 
-        GLint ShaderUniformFramebufferResolution;
         GLint ShaderUniformVolumeSize;
+        GLint ShaderUniformPaletteEnabled;
+
+        GLint ShaderUniformCascadeCount;
+        GLint ShaderUniformCascadeOrigins;
+
+        GLint ShaderUniformOctreeSide;
+
+        GLint ShaderUniformLightingPass;
+        GLint ShaderUniformLightingUpsampled;
+        GLint ShaderUniformLightingViewport;
+
+        GLint ShaderUniformCheckerboardEnabled;
+        GLint ShaderUniformCheckerboardPhase;
+
+        GLint ShaderUniformReconstructionScreenResolution;
+        GLint ShaderUniformReconstructionViewportOffset;
+        GLint ShaderUniformReconstructionCameraPosition;
+        GLint ShaderUniformReconstructionCameraTarget;
+        GLint ShaderUniformReconstructionNearClip;
+        GLint ShaderUniformReconstructionFieldOfView;
+        GLint ShaderUniformReconstructionCheckerboardPhase;
+        GLint ShaderUniformReconstructionHistoryEnabled;
+        GLint ShaderUniformReconstructionPreviousCameraPosition;
+        GLint ShaderUniformReconstructionPreviousCameraTarget;
+        GLint ShaderUniformReconstructionSceneMotion;
 
 	public:
         /// @brief  Constructor that specifies the size of the renderer viewport.
-        Renderer(std::size_t ScreenWidth, std::size_t ScreenHeight);
+        /// @param  ScreenWidth - The width of the viewport.
+        /// @param  ScreenHeight - The height of the viewport.
+        /// @param  OctreeEnabled - Whether to render the scene from a sparse voxel octree rather than the brick atlas.
+        /// @param  LightingScale - The divisor of the resolution the first voxel of each pixel is lit at, one lights every pixel in the voxel pass.
+        /// @param  CheckerboardEnabled - Whether to march half of the pixels each frame and reconstruct the rest from their neighbours and the previous frame.
+        Renderer(std::size_t ScreenWidth, std::size_t ScreenHeight, bool OctreeEnabled = false, std::size_t LightingScale = 1, bool CheckerboardEnabled = false);
+
+        /// @brief  Destructor that deletes every shader, program, framebuffer, texture and buffer the renderer created.
+        ~Renderer(void);
+
+        /// @brief  Deleted copy constructor.
+        Renderer(const Renderer&) = delete;
+
+        /// @brief  Deleted copy assignment.
+        Renderer& operator=(const Renderer&) = delete;
+
+    public:
+        /// @brief  Get the largest scene the textures of the current OpenGL context can hold.
+        /// @param  CascadeCount - The number of clipmap cascades that will be rendered with the scene.
+        /// @return The largest size of the scene along each axis.
+        static std::array<std::size_t, 3> GetMaximumSceneSize(std::size_t CascadeCount);
 
     private:
         /// @brief  Round input to a power of two greater than or equal to the input value.
@@ -94,10 +258,48 @@ namespace Raymarch {
         /// @return A power of two greater than or equal to the input value.
         std::size_t CeilPowerOfTwo(std::size_t Value);
 
+        /// @brief  Upload the bricks of the scene and its ambient occlusion that changed since the last upload.
+        /// @param  State - the state of the game.
+        void UploadScene(const GameState& State);
+
+        /// @brief  Rebuild the octree of the scene and upload it when the scene changed since the last upload.
+        /// @param  State - the state of the game.
+        void UploadOctree(const GameState& State);
+
+        /// @brief  Upload the cascades that changed since the last upload.
+        /// @param  State - the state of the game.
+        void UploadCascades(const GameState& State);
+
+        /// @brief  Get the rectangle of the lighting pass covering a view, the lighting pass is drawn with the view camera into it.
+        /// @param  Current - the view.
+        /// @return The view scaled down to the lighting pass.
+        View GetLightingView(const View& Current) const;
+
+        /// @brief  Set the uniforms of a view and raymarch the scene into its rectangle of the bound framebuffer.
+        /// @param  Current - the view.
+        /// @param  Checkerboard - whether to march only the pixels of this frame's pattern, into a rectangle of half the width.
+        void DrawView(const View& Current, bool Checkerboard);
+
+        /// @brief  Reconstruct the pixels of a view missing from the checkerboard frame into the bound framebuffer.
+        /// @param  Current - the view.
+        /// @param  Previous - the view in the previous frame, or null when it has none.
+        /// @param  SceneMotion - the scene offset of this frame less that of the previous frame.
+        void DrawReconstruction(const View& Current, const View* Previous, const std::array<int, 3>& SceneMotion);
+
     public:
+        /// @brief  Get the view of the game state camera covering the whole window.
+        /// @param  State - the state of the game.
+        /// @return The view.
+        View GetView(const GameState& State) const;
+
         /// @brief  Render the gamestate to the current OpenGL window.
         /// @param  State - the state of the game.
         void Render(const GameState& State);
+
+        /// @brief  Render several views of the gamestate to the current OpenGL window, the scene is uploaded once for all of them.
+        /// @param  State - the state of the game.
+        /// @param  Views - the views, later views are drawn over earlier ones.
+        void Render(const GameState& State, const std::vector<View>& Views);
 	};
 }
 
@@ -23,6 +23,10 @@ THE SOFTWARE
 */
 
 #include "ShaderSource.hpp"
+#include "BrickAtlas.hpp"
+#include "Clipmap.hpp"
+#include "SparseVoxelOctree.hpp"
+#include "Voxel.hpp"
 
 namespace Raymarch {
     const std::string ShaderSource::VertexShaderSource = R"(
@@ -112,17 +116,158 @@ namespace Raymarch {
     }
     )";
 
-    const std::string ShaderSource::FragmentShaderSourceVoxel = R"(
+    const std::string ShaderSource::FragmentShaderSourceReconstruction = R"(
+
+    #version 330
+
+    //in vec2 gl_FragCoord;
+    out vec4 out_gl_FragColor;
+
+    // The view being reconstructed, with the same camera as the voxel shader.
+    uniform vec2 ScreenResolution;
+    uniform vec2 ViewportOffset;
+
+    uniform vec3 CameraPosition;
+    uniform vec3 CameraTarget;
+
+    uniform float NearClip;
+    uniform float FieldOfView;
+
+    // Pixels where the sum of X and Y has the parity of the phase were marched this frame, stored in pairs along X with the distance to their first voxel.
+    uniform int CheckerboardPhase;
+    uniform sampler2D CheckerboardSampler;
+    uniform sampler2D DistanceSampler;
+
+    // The previous reconstructed frame and the camera of this view in it, a point of the scene was at its position plus SceneMotion in the previous frame.
+    uniform bool HistoryEnabled;
+    uniform sampler2D HistorySampler;
+    uniform vec2 HistoryResolution;
+    uniform vec3 PreviousCameraPosition;
+    uniform vec3 PreviousCameraTarget;
+    uniform vec3 SceneMotion;
+
+    // Fetching a pixel marched this frame, clamped to the view.
+    vec4 FetchMarched(in ivec2 Pixel, out float Distance) {
+        ivec2 Clamped = clamp(Pixel, ivec2(ViewportOffset), ivec2(ViewportOffset + ScreenResolution) - 1);
+        ivec2 Texel = ivec2(Clamped.x >> 1, Clamped.y);
+        Distance = texelFetch(DistanceSampler, Texel, 0).r;
+        return texelFetch(CheckerboardSampler, Texel, 0);
+    }
+
+    // Calculate direction vectors from camera and target.
+    void GetCameraVectors(in vec3 Position, in vec3 Target, out vec3 ForwardVector, out vec3 RightVector, out vec3 UpVector) {
+        ForwardVector = normalize(Target - Position);
+        RightVector = normalize(cross(vec3(0.0, 1.0, 0.0), ForwardVector));
+        UpVector = normalize(cross(ForwardVector, RightVector));
+    }
+
+    void main(void) {
+        ivec2 Pixel = ivec2(gl_FragCoord.xy);
+
+        // Marched pixels are kept.
+        float Distance;
+        if (((Pixel.x + Pixel.y) & 1) == CheckerboardPhase) {
+            out_gl_FragColor = FetchMarched(Pixel, Distance);
+            return;
+        }
+
+        // Every neighbour of a missing pixel was marched.
+        float DistanceLeft;
+        float DistanceRight;
+        float DistanceDown;
+        float DistanceUp;
+        vec4 Left  = FetchMarched(Pixel + ivec2(-1,  0), DistanceLeft);
+        vec4 Right = FetchMarched(Pixel + ivec2(+1,  0), DistanceRight);
+        vec4 Down  = FetchMarched(Pixel + ivec2( 0, -1), DistanceDown);
+        vec4 Up    = FetchMarched(Pixel + ivec2( 0, +1), DistanceUp);
+
+        // Spatially the pixel is interpolated along the axis its neighbours differ least, so that edges are not blurred across.
+        vec4 Spatial = (length(Left - Right) < length(Down - Up)) ? 0.5 * (Left + Right) : 0.5 * (Down + Up);
+        if (!HistoryEnabled) {
+            out_gl_FragColor = Spatial;
+            return;
+        }
+
+        // The ray of the pixel.
+        vec3 ForwardVector;
+        vec3 RightVector;
+        vec3 UpVector;
+        GetCameraVectors(CameraPosition, CameraTarget, ForwardVector, RightVector, UpVector);
+        vec2 ViewportSize = vec2(
+            2.0 * NearClip * tan(radians(FieldOfView * 0.5)),
+            2.0 * NearClip * tan(radians(FieldOfView * 0.5)) * ScreenResolution.y / ScreenResolution.x
+        );
+        vec2 ViewportPosition = (gl_FragCoord.xy - ViewportOffset) / ScreenResolution;
+        vec3 RayDirection = normalize((ForwardVector * NearClip) + ((ViewportPosition.x - 0.5) * ViewportSize.x * RightVector) + ((ViewportPosition.y - 0.5) * ViewportSize.y * UpVector));
+
+        // Temporally the pixel is placed on the nearest surface around it and projected through the previous camera into the previous frame.
+        Distance = min(min(DistanceLeft, DistanceRight), min(DistanceDown, DistanceUp));
+        vec3 PreviousPosition = CameraPosition + RayDirection * Distance + SceneMotion;
+        GetCameraVectors(PreviousCameraPosition, PreviousCameraTarget, ForwardVector, RightVector, UpVector);
+        vec3 PreviousDirection = PreviousPosition - PreviousCameraPosition;
+        float PreviousDepth = dot(PreviousDirection, ForwardVector);
+        if (PreviousDepth < NearClip) {
+            out_gl_FragColor = Spatial;
+            return;
+        }
+        vec2 PreviousViewportPosition = vec2(dot(PreviousDirection, RightVector), dot(PreviousDirection, UpVector)) * (NearClip / PreviousDepth) / ViewportSize + 0.5;
+        if (any(lessThan(PreviousViewportPosition, vec2(0.0))) || any(greaterThan(PreviousViewportPosition, vec2(1.0)))) {
+            out_gl_FragColor = Spatial;
+            return;
+        }
+        vec4 History = texture(HistorySampler, (PreviousViewportPosition * ScreenResolution + ViewportOffset) / HistoryResolution);
+
+        // The history is clamped to the colours around the pixel, which rejects what was uncovered or has changed since.
+        out_gl_FragColor = clamp(History, min(min(Left, Right), min(Down, Up)), max(max(Left, Right), max(Down, Up)));
+    }
+    )";
+
+    // Generate a define of the shift and mask of every voxel field, from the packing in Voxel.hpp.
+    static std::string GenerateVoxelLayoutSource(void) {
+        std::string Source = "\n    // The voxel field layout, generated from Voxel.hpp.\n";
+        auto Define = [&Source](const std::string& Name, std::uint32_t Shift, std::uint32_t Mask) -> void {
+            Source += "    #define VOXEL_" + Name + "_SHIFT " + std::to_string(Shift) + "u\n";
+            Source += "    #define VOXEL_" + Name + "_MASK " + std::to_string(Mask) + "u\n";
+        };
+        Define("SATURATION", Voxel::SaturationShift, Voxel::SaturationMask);
+        Define("ALPHA", Voxel::AlphaShift, Voxel::AlphaMask);
+        Define("TINT", Voxel::TintShift, Voxel::TintMask);
+        Define("HUE", Voxel::HueShift, Voxel::HueMask);
+        Define("LIGHT", Voxel::LightShift, Voxel::LightMask);
+        Define("STATE", Voxel::StateShift, Voxel::StateMask);
+        Define("TEMPERATURE", Voxel::TemperatureShift, Voxel::TemperatureMask);
+        Define("DIRECTION", Voxel::DirectionShift, Voxel::DirectionMask);
+        Define("DENSITY", Voxel::DensityShift, Voxel::DensityMask);
+        Define("STRENGTH", Voxel::StrengthShift, Voxel::StrengthMask);
+        Define("FILLLEVEL", Voxel::FillLevelShift, Voxel::FillLevelMask);
+        return Source;
+    }
+
+    const std::string ShaderSource::VoxelLayoutSource = GenerateVoxelLayoutSource();
+
+    // Generate the voxel shader, the octree variant finds voxels in the octree instead of the brick atlas.
+    static std::string GenerateVoxelShaderSource(bool Octree) {
+        return R"(
 
     // Originally based on Voxgrind: https://github.com/ivl/Voxgrind/blob/master/src/glsl/voxel.fs
 
     #version 330
+    )" + ShaderSource::VoxelLayoutSource + (Octree ? "\n    #define VOXEL_OCTREE\n" : "") + R"(
+    #define CASCADE_MAXIMUM_LEVELS )" + std::to_string(Clipmap::MaximumLevels) + R"(
+    #define BRICK_SIZE )" + std::to_string(BrickAtlas::BrickSize) + R"(
+    #define ATLAS_WIDTH )" + std::to_string(BrickAtlas::AtlasWidth) + R"(
+    #define OCTREE_MAXIMUM_DEPTH )" + std::to_string(SparseVoxelOctree::MaximumDepth) + R"(
 
     //in vec2 gl_FragCoord;
     out vec4 out_gl_FragColor;
 
+    // The distance from the camera to the first voxel, read back by the checkerboard reconstruction.
+    out float out_gl_FragDistance;
+
     uniform vec2 ScreenResolution;
-    uniform vec2 FramebufferResolution;
+
+    // The lower left pixel of the view being rendered, ScreenResolution is the size of the view.
+    uniform vec2 ViewportOffset;
 
     uniform vec3 SceneOffset;
 
@@ -140,8 +285,44 @@ namespace Raymarch {
 
     uniform vec3 VolumeSize;
 
-    // This sampler will get 32 bits of data for each voxel.
-    uniform usampler2D BinarySampler;
+    // This sampler will get the page of each brick of the scene, zero for an empty brick or else its atlas slot plus one.
+    uniform usampler3D PageSampler;
+
+    // This sampler will get a palette index for each voxel of the resident bricks, or 32 bits of data for each voxel when the palette is disabled.
+    uniform usampler3D BinarySampler;
+
+    // This sampler will get 32 bits of data for each palette entry, in rows of 256 entries.
+    uniform usampler2D PaletteSampler;
+    uniform bool PaletteEnabled;
+
+    // This sampler will get the height below which each column is in shadow.
+    uniform sampler2D ShadowSampler;
+
+    // This sampler will get the baked ambient occlusion of each voxel face of the resident bricks, 8 bits per face.
+    uniform usampler3D OcclusionSampler;
+
+    // This sampler will get the octree nodes, eight children of two words, the first zero for a leaf or else the child node.
+    uniform usamplerBuffer OctreeSampler;
+    uniform float OctreeSide;
+
+    // This sampler will get 32 bits of data for each cascade cell, the cascades are stacked along Y.
+    uniform usampler3D CascadeSampler;
+    uniform int CascadeCount;
+
+    // The minimum corner of each cascade relative to the scene, cascade N has cells of 2^(N+1) voxels.
+    uniform vec3 CascadeOrigins[CASCADE_MAXIMUM_LEVELS];
+
+    // When set the march stops at the first voxel and writes its light, distance from the camera and normal, rays that hit nothing are discarded.
+    uniform bool LightingPass;
+
+    // When set the light of the first voxel is upsampled from the lighting pass, LightingViewport is the rectangle of this view in it.
+    uniform bool LightingUpsampled;
+    uniform sampler2D LightingSampler;
+    uniform vec4 LightingViewport;
+
+    // When set the viewport is halved along X and each fragment marches the pixel of its pair where the sum of X and Y has the parity of the phase.
+    uniform bool CheckerboardEnabled;
+    uniform int CheckerboardPhase;
 
     // Convert HSL (Hue Saturation Lightness) to RGB.
     vec3 HSL2RGB(in vec3 HSL) {
@@ -149,50 +330,94 @@ namespace Raymarch {
         return HSL.z + HSL.y * (RGB - 0.5) * (1.0 - abs(2.0 * HSL.z - 1.0));
     }
 
-    // Sampling from the voxel volume.
-    vec4 SampleVolume(in vec3 Position) {
-
-        // The voxel data structure (as in Voxel.hpp).
-        // std::uint8_t Saturation : 2;
-        // std::uint8_t Alpha : 3;
-        // std::uint8_t Tint : 3;
-        // std::uint8_t Hue : 4;
-        // std::uint8_t Light : 4;
-        // std::uint8_t State : 2;
-        // std::uint8_t Temperature : 3;
-        // std::uint8_t Direction : 3;
-        // std::uint8_t Density : 2;
-        // std::uint8_t Strength : 3;
-        // std::uint8_t FillLevel : 3;
-
-        uint Data = texelFetch(BinarySampler, ivec2(Position.x , (Position.y + VolumeSize.y * floor(Position.z))), 0).r;
-
-        uint SaturationValue = (Data >> uint(0)) & uint(0x3);
+    // Fetching the page of the brick holding a voxel.
+    uint FetchPage(in vec3 Position) {
+        return texelFetch(PageSampler, ivec3(Position) / BRICK_SIZE, 0).r;
+    }
+
+    // Finding a voxel of a resident brick in the atlas, slots fill the atlas along X, then Y, then Z.
+    ivec3 GetAtlasPosition(in uint Page, in vec3 Position) {
+        int Slot = int(Page) - 1;
+        ivec3 SlotPosition = ivec3(Slot % ATLAS_WIDTH, (Slot / ATLAS_WIDTH) % ATLAS_WIDTH, Slot / (ATLAS_WIDTH * ATLAS_WIDTH));
+        return SlotPosition * BRICK_SIZE + ivec3(Position) % BRICK_SIZE;
+    }
+
+    // Fetching the raw voxel data from a resident brick.
+    uint FetchBrick(in uint Page, in vec3 Position) {
+        uint Data = texelFetch(BinarySampler, GetAtlasPosition(Page, Position), 0).r;
+        if (PaletteEnabled) {
+            Data = texelFetch(PaletteSampler, ivec2(Data & uint(0xFF), Data >> uint(8)), 0).r;
+        }
+        return Data;
+    }
+
+    // Fetching the raw voxel data of a cascade cell.
+    uint FetchCascade(in int Level, in vec3 Position) {
+        return texelFetch(CascadeSampler, ivec3(Position.x, Position.y + VolumeSize.y * float(Level), Position.z), 0).r;
+    }
+
+    // Decoding the colour and alpha of raw voxel data.
+    vec4 DecodeVoxel(in uint Data) {
+
+        // The voxel fields are decoded with the masks and shifts of Voxel.hpp, defined at the top of this shader.
+
+        uint SaturationValue = (Data & VOXEL_SATURATION_MASK) >> VOXEL_SATURATION_SHIFT;
         float Saturation = float(SaturationValue) / 3.0f;
 
-        uint AlphaValue = (Data >> uint(2)) & uint(0x7);
+        uint AlphaValue = (Data & VOXEL_ALPHA_MASK) >> VOXEL_ALPHA_SHIFT;
         float Alpha = float(AlphaValue ) / 7.0f;
 
-        uint TintValue = (Data >> uint(2 + 3)) & uint(0x7);
+        uint TintValue = (Data & VOXEL_TINT_MASK) >> VOXEL_TINT_SHIFT;
         vec3 Tint = vec3(float((TintValue & uint(0x4)) == uint(0x4)), float((TintValue & uint(0x2)) == uint(0x2)), float((TintValue & uint(0x1)) == uint(0x1)));
 
-        uint HueValue = (Data >> uint(2 + 3 + 3)) & uint(0xF);
+        uint HueValue = (Data & VOXEL_HUE_MASK) >> VOXEL_HUE_SHIFT;
         float Hue = float(HueValue - uint(4)) / 11.0f;
         bool GreyscaleHueEnabled = (HueValue < uint(4));
         float Greyscale = float(HueValue) / 3.0f;
 
-        uint LightValue = (Data >> uint(2 + 3 + 3 + 4)) & uint(0xF);
+        uint LightValue = (Data & VOXEL_LIGHT_MASK) >> VOXEL_LIGHT_SHIFT;
         float Light = float(LightValue) / 15.0f;
 
-        uint StateValue = (Data >> uint(2 + 3 + 3 + 4 + 4)) & uint(0x3);
+        uint StateValue = (Data & VOXEL_STATE_MASK) >> VOXEL_STATE_SHIFT;
         bvec4 State = bvec4(StateValue == uint(0x3), StateValue == uint(0x2), StateValue == uint(0x1), StateValue == uint(0x0));
 
+        vec3 Colour;
         if (GreyscaleHueEnabled) {
-            return vec4(vec3(Greyscale * Light), Alpha);
+            Colour = vec3(Greyscale * Light);
         }
         else {
-            return vec4(HSL2RGB(vec3(Hue, Saturation, Light)), Alpha);
+            Colour = HSL2RGB(vec3(Hue, Saturation, Light));
+        }
+
+        // Tint the colour towards the colour of nearby light sources.
+        if (TintValue != uint(0)) {
+            Colour = mix(Colour, Tint * Light, 0.5);
         }
+
+        return vec4(Colour, Alpha);
+    }
+
+    // Sampling from a resident brick.
+    vec4 SampleVolume(in uint Page, in vec3 Position) {
+        return DecodeVoxel(FetchBrick(Page, Position));
+    }
+
+    // Descending the octree to the leaf holding a voxel, invisible voxels are stored as zero.
+    uint FetchOctree(in vec3 Position, out vec3 LeafMinimum, out float LeafSide) {
+        int Node = 0;
+        LeafMinimum = vec3(0.0);
+        LeafSide = OctreeSide;
+        for (int Level = 0; Level < OCTREE_MAXIMUM_DEPTH; ++Level) {
+            LeafSide *= 0.5;
+            bvec3 Upper = greaterThanEqual(Position, LeafMinimum + LeafSide);
+            LeafMinimum += vec3(Upper) * LeafSide;
+            uvec2 Entry = texelFetch(OctreeSampler, Node * 8 + int(Upper.x) + 2 * int(Upper.y) + 4 * int(Upper.z)).rg;
+            if (Entry.r == uint(0)) {
+                return Entry.g;
+            }
+            Node = int(Entry.r);
+        }
+        return uint(0);
     }
 
     // Testing for ray intersection with a box.
@@ -210,6 +435,12 @@ namespace Raymarch {
         return BackIntersectionDepth > IntersectionDepth;
     }
 
+    // Finding the depth at which a ray leaves a box it intersects.
+    float RayBoxExit(in vec3 RayOrigin, in vec3 RayDirection, in vec3 BoxMin, in vec3 BoxMax) {
+        vec3 MaximumVector = max((BoxMax - RayOrigin) / RayDirection, (BoxMin - RayOrigin) / RayDirection);
+        return min(MaximumVector.x, min(MaximumVector.y, MaximumVector.z));
+    }
+
     bool IsInsideBox(vec3 Position, vec3 BoxBottomLeft, vec3 BoxTopRight) {
         vec3 DimensionInside = step(BoxBottomLeft, Position) - step(BoxTopRight, Position);
         return DimensionInside.x * DimensionInside.y * DimensionInside.z > 0.5;
@@ -236,6 +467,150 @@ namespace Raymarch {
                    mix(Hash(BaseSeed + 170.0), Hash(BaseSeed + 171.0), FractSeed.x), FractSeed.y), FractSeed.z);
     }
 
+    // The noise function at a whole voxel position, where every interpolation weight is zero and only the first hash remains.
+    float VoxelNoise(vec3 Seed) {
+        return Hash(Seed.x + Seed.y * 57.0 + 113.0 * Seed.z);
+    }
+
+    // Continue a ray through the cascades beyond the scene from a depth, blending behind the colour so far.
+    vec4 MarchCascades(in vec3 RayOrigin, in vec3 RayDirection, in float Depth, in vec4 Colour) {
+        for (int Level = 0; Level < CascadeCount; ++Level) {
+            // The ray in the cells of this cascade, depths scale with the cell size.
+            float CellSize = exp2(float(Level + 1));
+            vec3 CascadeRayOrigin = (RayOrigin - CascadeOrigins[Level]) / CellSize;
+            float IntersectionDepth;
+            if (!RayBoxIntersect(CascadeRayOrigin, RayDirection, vec3(0.0, 0.0, 0.0), VolumeSize, IntersectionDepth)) {
+                continue;
+            }
+
+            // Start where the finer cascade was left, it covers the middle of this one.
+            vec3 RayMarchOrigin = CascadeRayOrigin + RayDirection * (max(IntersectionDepth, Depth / CellSize) + 0.0001);
+            vec3 RayPosition = clamp(floor(RayMarchOrigin), vec3(0.0), VolumeSize - 1.0);
+            vec3 RayStep = sign(RayDirection);
+            vec3 MaxTranslation = (((0.5 + RayPosition) + 0.5 * RayStep) - RayMarchOrigin) / RayDirection;
+            vec3 DeltaTranslation = RayStep / RayDirection;
+
+            // Every cascade has as many cells as the scene, so crossing one takes a bounded number of steps.
+            int IterationCount = int(VolumeSize.x + VolumeSize.y + VolumeSize.z);
+            for (int Iteration = 0; Iteration < IterationCount; ++Iteration) {
+                uint Data = FetchCascade(Level, RayPosition);
+                vec4 Voxel = DecodeVoxel(Data);
+                if (Voxel.a > 0.0) {
+                    float CellDepth;
+                    RayBoxIntersect(CascadeRayOrigin, RayDirection, RayPosition, RayPosition + vec3(1.0, 1.0, 1.0), CellDepth);
+                    vec3 Direction = (CascadeRayOrigin + RayDirection * CellDepth) - (RayPosition + vec3(0.5, 0.5, 0.5));
+                    vec3 AbsoluteDirection = abs(Direction);
+                    vec3 NormalDirection;
+                    if ((AbsoluteDirection.y > AbsoluteDirection.x) && (AbsoluteDirection.y > AbsoluteDirection.z)) {
+                        NormalDirection = vec3(0.0, sign(Direction.y), 0.0);
+                    }
+                    else if (AbsoluteDirection.x > AbsoluteDirection.z) {
+                        NormalDirection = vec3(sign(Direction.x), 0.0, 0.0);
+                    }
+                    else {
+                        NormalDirection = vec3(0.0, 0.0, sign(Direction.z));
+                    }
+
+                    // Cascades carry no occlusion or shadows, only the global light and emitters light them.
+                    vec3 IntersectionPosition = RayOrigin + RayDirection * (CellDepth * CellSize);
+                    uint StateValue = (Data & VOXEL_STATE_MASK) >> VOXEL_STATE_SHIFT;
+                    float PointLight = (StateValue == uint(0x3)) ? 1.0 : min(1.0, max(0.0, dot(NormalDirection, normalize(LightPosition - IntersectionPosition))));
+                    float Fog = min(1.0, length(IntersectionPosition - CameraPosition) / FogDistance);
+                    float ColourNoise = 0.3 * VoxelNoise(RayPosition * CellSize + CascadeOrigins[Level] + SceneOffset.xyz);
+                    Voxel.rgb += ColourNoise;
+                    vec4 VoxelColour = mix(Voxel * PointLight, FogColour, Fog);
+                    Colour = mix(Colour, VoxelColour, (1.0 - Colour.a) * Voxel.a);
+                    Colour.a = min(1.0, Colour.a + Voxel.a);
+                    if (Colour.a >= 1.0) {
+                        return vec4(Colour.rgb, 1.0);
+                    }
+                }
+
+                // Branchless advance.
+                bvec3 RayAdvanceMask = lessThanEqual(MaxTranslation.xyz, min(MaxTranslation.yzx, MaxTranslation.zxy));
+                MaxTranslation += vec3(RayAdvanceMask) * DeltaTranslation;
+                RayPosition += ivec3(RayAdvanceMask) * RayStep;
+                if (any(lessThan(RayPosition, vec3(0.0))) || any(greaterThanEqual(RayPosition, VolumeSize))) {
+                    break;
+                }
+            }
+
+            // The next cascade starts where the ray leaves this one.
+            Depth = RayBoxExit(CascadeRayOrigin, RayDirection, vec3(0.0, 0.0, 0.0), VolumeSize) * CellSize;
+        }
+        return vec4(Colour.rgb, 1.0);
+    }
+
+    // Lighting the face of a voxel hit by a ray, from its ambient occlusion, shadow, the global light and the light propagated into it.
+    float LightVoxel(in uint Page, in uint Data, in vec3 RayPosition, in vec3 IntersectionPosition, in vec3 NormalDirection, in vec3 ConsecutiveDirectionRight, in vec3 ConsecutiveDirectionUp) {
+        #ifndef VOXEL_OCTREE
+            // Ambient occlusion, baked as one bit for each of the eight voxels around the empty voxel in front of the face.
+            uvec2 OcclusionData = texelFetch(OcclusionSampler, GetAtlasPosition(Page, RayPosition), 0).rg;
+            uint FaceMask;
+            if (NormalDirection.x != 0.0) {
+                FaceMask = OcclusionData.r >> uint((NormalDirection.x > 0.0) ? 0 : 8);
+            }
+            else if (NormalDirection.y != 0.0) {
+                FaceMask = OcclusionData.r >> uint((NormalDirection.y > 0.0) ? 16 : 24);
+            }
+            else {
+                FaceMask = OcclusionData.g >> uint((NormalDirection.z > 0.0) ? 0 : 8);
+            }
+            vec4 OccludedSides = vec4(uvec4(FaceMask, FaceMask >> uint(1), FaceMask >> uint(2), FaceMask >> uint(3)) & uint(0x1));
+            vec4 OccludedCorners = vec4(uvec4(FaceMask >> uint(4), FaceMask >> uint(5), FaceMask >> uint(6), FaceMask >> uint(7)) & uint(0x1));
+            float AmbientOcclusion = 0.0;
+            vec3 FractionalIntersectionPosition = fract(IntersectionPosition);
+            float MagnitudeFromRight = dot(FractionalIntersectionPosition, ConsecutiveDirectionRight);
+            float MagnitudeFromUp = dot(FractionalIntersectionPosition, ConsecutiveDirectionUp);
+            AmbientOcclusion = max(AmbientOcclusion, OccludedSides.x * MagnitudeFromUp);
+            AmbientOcclusion = max(AmbientOcclusion, OccludedSides.y * (1.0 - MagnitudeFromUp));
+            AmbientOcclusion = max(AmbientOcclusion, OccludedSides.z * MagnitudeFromRight);
+            AmbientOcclusion = max(AmbientOcclusion, OccludedSides.w * (1.0 - MagnitudeFromRight));
+            AmbientOcclusion = max(AmbientOcclusion, OccludedCorners.x * min(MagnitudeFromUp, MagnitudeFromRight));
+            AmbientOcclusion = max(AmbientOcclusion, OccludedCorners.y * min(MagnitudeFromUp, (1.0 - MagnitudeFromRight)));
+            AmbientOcclusion = max(AmbientOcclusion, OccludedCorners.z * min((1.0 - MagnitudeFromUp), MagnitudeFromRight));
+            AmbientOcclusion = max(AmbientOcclusion, OccludedCorners.w * min((1.0 - MagnitudeFromUp), (1.0 - MagnitudeFromRight)));
+            AmbientOcclusion = max(0.0, min(1.0, AmbientOcclusion * 0.5));
+        #else
+            // The octree carries no baked occlusion.
+            float AmbientOcclusion = 0.0;
+        #endif
+
+        // Shadows, the centre of the empty voxel in front of the face is shadowed when it is below the shadow height of its column.
+        vec3 ShadowBlock = clamp(RayPosition + NormalDirection, vec3(0.0), VolumeSize - 1.0);
+        float ShadowHeight = texelFetch(ShadowSampler, ivec2(ShadowBlock.xz), 0).r;
+        float Shadow = clamp(ShadowHeight - (RayPosition.y + NormalDirection.y + 0.5), 0.0, 1.0);
+
+        // Point lighting.
+        float PointLight = (1.0 - AmbientOcclusion) * (1.0 - Shadow) * min(1.0, max(0.0, dot(NormalDirection, normalize(LightPosition - IntersectionPosition))));
+
+        // Local lighting, propagated light above the ambient level lights the voxel without the global light, emitters are fully lit.
+        uint VoxelLightValue = (Data & VOXEL_LIGHT_MASK) >> VOXEL_LIGHT_SHIFT;
+        uint VoxelStateValue = (Data & VOXEL_STATE_MASK) >> VOXEL_STATE_SHIFT;
+        float LocalLight = (VoxelStateValue == uint(0x3)) ? 1.0 : (1.0 - AmbientOcclusion) * max(0.0, float(VoxelLightValue) - 8.0) / 7.0;
+        return max(PointLight, LocalLight);
+    }
+
+    // Upsampling the light of the first voxel from the four nearest samples of the lighting pass.
+    // Samples are weighted bilinearly and dropped when their normal differs or their distance is off by more than a voxel plus a twentieth, a negative result means none matched.
+    float UpsampleLighting(in vec2 ViewportPosition, in float Distance, in float NormalCode) {
+        vec2 Position = LightingViewport.xy + ViewportPosition * LightingViewport.zw - 0.5;
+        vec2 Base = floor(Position);
+        vec2 Fraction = Position - Base;
+        float Tolerance = 1.0 + 0.05 * Distance;
+        float WeightSum = 0.0;
+        float LightSum = 0.0;
+        for (int Corner = 0; Corner < 4; ++Corner) {
+            vec2 Offset = vec2(float(Corner & 1), float(Corner >> 1));
+            vec4 Sample = texelFetch(LightingSampler, ivec2(clamp(Base + Offset, LightingViewport.xy, LightingViewport.xy + LightingViewport.zw - 1.0)), 0);
+            vec2 Bilinear = mix(1.0 - Fraction, Fraction, Offset);
+            float Weight = max(Bilinear.x * Bilinear.y, 0.001) * Sample.a * float(abs(Sample.b - NormalCode) < 0.5) * max(0.0, 1.0 - abs(Sample.g - Distance) / Tolerance);
+            WeightSum += Weight;
+            LightSum += Weight * Sample.r;
+        }
+        return (WeightSum > 0.0) ? (LightSum / WeightSum) : -1.0;
+    }
+
     // Main function.
     void main(void) {
         // Calculate direction bectors from camera and target.
@@ -243,11 +618,26 @@ namespace Raymarch {
         vec3 RightVector = normalize(cross(vec3(0.0, 1.0, 0.0), ForwardVector));
         vec3 UpVector = normalize(cross(ForwardVector, RightVector));
 
+        // Rays that hit nothing are far away.
+        out_gl_FragDistance = 65536.0;
+
+        // Find the pixel this fragment marches, in checkerboard rendering a pair beyond the edge of the view may hold only one pixel of it.
+        vec2 PixelPosition = gl_FragCoord.xy;
+        if (CheckerboardEnabled) {
+            PixelPosition.x = floor(gl_FragCoord.x) * 2.0 + float((int(gl_FragCoord.y) + CheckerboardPhase) & 1) + 0.5;
+            if ((PixelPosition.x < ViewportOffset.x) || (PixelPosition.x > ViewportOffset.x + ScreenResolution.x)) {
+                discard;
+            }
+        }
+
         // Calculate the fragment position on the viewport.
-        vec2 ViewportPosition = gl_FragCoord.xy / ScreenResolution;
+        vec2 ViewportPosition = (PixelPosition - ViewportOffset) / ScreenResolution;
 
         // Abort if we're not in the rendering region of the frame buffer.
         if ((ViewportPosition.x > 1.0) || (ViewportPosition.y > 1.0)) {
+            if (LightingPass) {
+                discard;
+            }
             out_gl_FragColor = FogColour;
             return;
         }
@@ -281,7 +671,10 @@ namespace Raymarch {
             // Initialize the marching inside the bounds.
             float IntersectionDepth;
             if (!RayBoxIntersect(RayOrigin, RayDirection, vec3(0.0, 0.0, 0.0), VolumeSize, IntersectionDepth)) {
-                out_gl_FragColor = FogColour;
+                if (LightingPass) {
+                    discard;
+                }
+                out_gl_FragColor = (CascadeCount > 0) ? MarchCascades(RayOrigin, RayDirection, 0.0, vec4(FogColour.rgb, 0.0)) : FogColour;
                 return;
             }
             RayMarchOrigin = RayOrigin + RayDirection * IntersectionDepth + RayDirection * 0.0001;
@@ -299,8 +692,21 @@ namespace Raymarch {
         // Ray marching loop.
         for (int Iteration = 0; Iteration < 2048; ++Iteration) {
 
-            // Sample the volume at the current ray position.
-            vec4 Voxel = SampleVolume(RayPosition);
+            #ifdef VOXEL_OCTREE
+                // Sample the leaf of the octree at the current ray position, an empty leaf is skipped whole.
+                vec3 SkipMinimum;
+                float SkipSide;
+                uint LeafData = FetchOctree(RayPosition, SkipMinimum, SkipSide);
+                bool Skip = (LeafData == uint(0));
+                vec4 Voxel = DecodeVoxel(LeafData);
+            #else
+                // Sample the volume at the current ray position, the voxels of an empty brick are empty and the brick is skipped whole.
+                uint Page = FetchPage(RayPosition);
+                vec3 SkipMinimum = floor(RayPosition / float(BRICK_SIZE)) * float(BRICK_SIZE);
+                float SkipSide = float(BRICK_SIZE);
+                bool Skip = (Page == uint(0));
+                vec4 Voxel = Skip ? vec4(0.0) : SampleVolume(Page, RayPosition);
+            #endif
 
             // Test if the voxel is empty.
             if (Voxel.a > 0.0) {
@@ -308,6 +714,9 @@ namespace Raymarch {
                 // Calculate the intersection depth.
                 float IntersectionDepth;
                 if (!RayBoxIntersect(RayOrigin, RayDirection, RayPosition, RayPosition + vec3(1.0, 1.0, 1.0), IntersectionDepth)) {
+                    if (LightingPass) {
+                        discard;
+                    }
                     out_gl_FragColor = mix(out_gl_FragColor, FogColour, FogColour.a);
                     return;
                 }
@@ -337,34 +746,39 @@ namespace Raymarch {
                     ConsecutiveDirectionUp = vec3(0.0, 1.0, 0.0);
                 }
 
-                #if 1
-                    // Ambient occlusion.
-                    vec3 NormalBlock = RayPosition + 0.5 + NormalDirection;
-                    float AmbientOcclusion = 0.0;
-                    vec3 FractionalIntersectionPosition = fract(IntersectionPosition);
-                    float MagnitudeFromRight = dot(FractionalIntersectionPosition, ConsecutiveDirectionRight);
-                    float MagnitudeFromUp = dot(FractionalIntersectionPosition, ConsecutiveDirectionUp);
-                    AmbientOcclusion = max(AmbientOcclusion, SampleVolume(NormalBlock + ConsecutiveDirectionUp).w * MagnitudeFromUp);
-                    AmbientOcclusion = max(AmbientOcclusion, SampleVolume(NormalBlock - ConsecutiveDirectionUp).w * (1.0 - MagnitudeFromUp));
-                    AmbientOcclusion = max(AmbientOcclusion, SampleVolume(NormalBlock + ConsecutiveDirectionRight).w * MagnitudeFromRight);
-                    AmbientOcclusion = max(AmbientOcclusion, SampleVolume(NormalBlock - ConsecutiveDirectionRight).w * (1.0 - MagnitudeFromRight));
-                    AmbientOcclusion = max(AmbientOcclusion, SampleVolume(NormalBlock + ConsecutiveDirectionUp + ConsecutiveDirectionRight).w * min(MagnitudeFromUp, MagnitudeFromRight));
-                    AmbientOcclusion = max(AmbientOcclusion, SampleVolume(NormalBlock + ConsecutiveDirectionUp - ConsecutiveDirectionRight).w * min(MagnitudeFromUp, (1.0 - MagnitudeFromRight)));
-                    AmbientOcclusion = max(AmbientOcclusion, SampleVolume(NormalBlock - ConsecutiveDirectionUp + ConsecutiveDirectionRight).w * min((1.0 - MagnitudeFromUp), MagnitudeFromRight));
-                    AmbientOcclusion = max(AmbientOcclusion, SampleVolume(NormalBlock - ConsecutiveDirectionUp - ConsecutiveDirectionRight).w * min((1.0 - MagnitudeFromUp), (1.0 - MagnitudeFromRight)));
-                    AmbientOcclusion = max(0.0, min(1.0, AmbientOcclusion * 0.5));
-                #else
-                    float AmbientOcclusion = 0.0;
-                #endif
-
-                // Point lighting.
-                float PointLight = (1.0 - AmbientOcclusion) * min(1.0, max(0.0, dot(NormalDirection, normalize(LightPosition - IntersectionPosition))));
+                // The distance from the camera and the normal identify the surface when upsampling its light.
+                float Distance = length(IntersectionPosition - CameraPosition);
+                float NormalCode = dot(NormalDirection, vec3(1.0, 2.0, 3.0));
+
+                // The light of the first voxel is upsampled where a sample of the lighting pass matches it, every other voxel is lit here.
+                float PointLight = -1.0;
+                if (LightingUpsampled && (out_gl_FragColor.a == 0.0)) {
+                    PointLight = UpsampleLighting(ViewportPosition, Distance, NormalCode);
+                }
+                if (PointLight < 0.0) {
+                    #ifdef VOXEL_OCTREE
+                        PointLight = LightVoxel(uint(0), LeafData, RayPosition, IntersectionPosition, NormalDirection, ConsecutiveDirectionRight, ConsecutiveDirectionUp);
+                    #else
+                        PointLight = LightVoxel(Page, FetchBrick(Page, RayPosition), RayPosition, IntersectionPosition, NormalDirection, ConsecutiveDirectionRight, ConsecutiveDirectionUp);
+                    #endif
+                }
+
+                // The lighting pass only needs the first voxel.
+                if (LightingPass) {
+                    out_gl_FragColor = vec4(PointLight, Distance, NormalCode, 1.0);
+                    return;
+                }
+
+                // The first voxel places the pixel for the checkerboard reconstruction.
+                if (out_gl_FragColor.a == 0.0) {
+                    out_gl_FragDistance = Distance;
+                }
 
                 // Fog colour.
-                float Fog = min(1.0, length(IntersectionPosition - CameraPosition) / FogDistance);
+                float Fog = min(1.0, Distance / FogDistance);
 
                 // Apply some noise to the colour of this voxel.
-                float ColourNoise = 0.3 * Noise(RayPosition.xyz + SceneOffset.xyz);
+                float ColourNoise = 0.3 * VoxelNoise(RayPosition.xyz + SceneOffset.xyz);
                 Voxel.r += ColourNoise;
                 Voxel.g += ColourNoise;
                 Voxel.b += ColourNoise;
@@ -384,23 +798,45 @@ namespace Raymarch {
                 }
             }
 
-            // Branchless advance.
-            bvec3 RayAdvanceMask = lessThanEqual(MaxTranslation.xyz, min(MaxTranslation.yzx, MaxTranslation.zxy));
-            MaxTranslation += vec3(RayAdvanceMask) * DeltaTranslation;
-            RayPosition += ivec3(RayAdvanceMask) * RayStep;
+            if (Skip) {
+                // Skip the rest of an empty box in one step, crossing the face the ray leaves through and staying within the box along the other axes.
+                vec3 SkipExits = max((SkipMinimum - RayOrigin) / RayDirection, (SkipMinimum + SkipSide - RayOrigin) / RayDirection);
+                vec3 ExitPosition = RayOrigin + RayDirection * min(SkipExits.x, min(SkipExits.y, SkipExits.z));
+                bvec3 ExitMask = lessThanEqual(SkipExits.xyz, min(SkipExits.yzx, SkipExits.zxy));
+                vec3 ExitNeighbour = SkipMinimum + mix(vec3(-1.0), vec3(SkipSide), greaterThan(RayStep, vec3(0.0)));
+                RayPosition = mix(clamp(floor(ExitPosition), SkipMinimum, SkipMinimum + SkipSide - 1.0), ExitNeighbour, ExitMask);
+                MaxTranslation = (((0.5 + RayPosition) + 0.5 * RayStep) - ExitPosition) / RayDirection;
+            }
+            else {
+                // Branchless advance.
+                bvec3 RayAdvanceMask = lessThanEqual(MaxTranslation.xyz, min(MaxTranslation.yzx, MaxTranslation.zxy));
+                MaxTranslation += vec3(RayAdvanceMask) * DeltaTranslation;
+                RayPosition += ivec3(RayAdvanceMask) * RayStep;
+            }
 
             // Test within bounds.
             if ((RayPosition.x >= VolumeSize.x || RayPosition.x < 0.0)
              || (RayPosition.y >= VolumeSize.y || RayPosition.y < 0.0)
              || (RayPosition.z >= VolumeSize.z || RayPosition.z < 0.0)) {
-                // If not within bounds return current colour.
-                out_gl_FragColor.a = 1.0;
+                // If not within bounds continue through the cascades, which return the current colour when there are none.
+                if (LightingPass) {
+                    discard;
+                }
+                out_gl_FragColor = MarchCascades(RayOrigin, RayDirection, RayBoxExit(RayOrigin, RayDirection, vec3(0.0, 0.0, 0.0), VolumeSize), out_gl_FragColor);
                 return;
             }
         }
 
         // If we have reached the maximum number of iterations, just return the current colour.
+        if (LightingPass) {
+            discard;
+        }
         out_gl_FragColor.a = 1.0;
     }
     )";
+    }
+
+    const std::string ShaderSource::FragmentShaderSourceVoxel = GenerateVoxelShaderSource(false);
+
+    const std::string ShaderSource::FragmentShaderSourceVoxelOctree = GenerateVoxelShaderSource(true);
 }
@@ -31,9 +31,12 @@ THE SOFTWARE
 namespace Raymarch {
     class ShaderSource {
     public:
+        static const std::string VoxelLayoutSource;
         static const std::string VertexShaderSource;
         static const std::string FragmentShaderSourceFXAA;
+        static const std::string FragmentShaderSourceReconstruction;
         static const std::string FragmentShaderSourceVoxel;
+        static const std::string FragmentShaderSourceVoxelOctree;
 	};
 }
 
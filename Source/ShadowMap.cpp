@@ -0,0 +1,184 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "ShadowMap.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Raymarch {
+    // Constructor for an empty shadow map.
+    ShadowMap::ShadowMap(void)
+        : Size{{0, 0, 0}}
+        , Direction{{0.0f, 1.0f, 0.0f}}
+        , Stale(true)
+        , Version(0) {
+    }
+
+    // Get the X size.
+    std::size_t ShadowMap::GetSizeX(void) const {
+        return this->Size[0];
+    }
+
+    // Get the Z size.
+    std::size_t ShadowMap::GetSizeZ(void) const {
+        return this->Size[2];
+    }
+
+    // Get the shadow height data.
+    const float* ShadowMap::data(void) const {
+        return this->Heights.data();
+    }
+
+    // Get the version of the heights.
+    std::uint64_t ShadowMap::GetVersion(void) const {
+        return this->Version;
+    }
+
+    // Recalculate all column tops in parallel slabs along Z.
+    void ShadowMap::Rebuild(const Volume& Scene) {
+        RAYMARCH_TRACE_SCOPE("ShadowMap::Rebuild");
+
+        this->Size = Scene.GetSize();
+        this->Tops.assign(this->Size[0] * this->Size[2], 0.0f);
+        this->Heights.assign(this->Size[0] * this->Size[2], 0.0f);
+        JobSystem::GetGlobal().ParallelFor(0, this->Size[2], 1, [this, &Scene](std::size_t FirstZ, std::size_t LastZ) -> void {
+            for (std::size_t IndexZ = FirstZ; IndexZ < LastZ; ++IndexZ) {
+                for (std::size_t IndexX = 0; IndexX < this->Size[0]; ++IndexX) {
+                    this->UpdateTop(Scene, static_cast<int>(IndexX), static_cast<int>(IndexZ));
+                }
+            }
+        });
+        this->DirtyColumns = Region();
+        this->Stale = true;
+    }
+
+    // Recalculate the column tops of a changed region.
+    void ShadowMap::NotifyChanged(const Volume& Scene, const Region& Changed) {
+        const Region Clipped = Changed.Intersection(Scene.GetRegion());
+        if (Clipped.IsEmpty()) {
+            return;
+        }
+        for (int IndexZ = Clipped.Minimum[2]; IndexZ < Clipped.Maximum[2]; ++IndexZ) {
+            for (int IndexX = Clipped.Minimum[0]; IndexX < Clipped.Maximum[0]; ++IndexX) {
+                this->UpdateTop(Scene, IndexX, IndexZ);
+            }
+        }
+        this->DirtyColumns = this->DirtyColumns.Union(Region({{Clipped.Minimum[0], 0, Clipped.Minimum[2]}}, {{Clipped.Maximum[0], 1, Clipped.Maximum[2]}}));
+    }
+
+    // Calculate the top of a column from the highest opaque voxel.
+    void ShadowMap::UpdateTop(const Volume& Scene, int X, int Z) {
+        float Top = 0.0f;
+        for (int IndexY = static_cast<int>(this->Size[1]) - 1; IndexY >= 0; --IndexY) {
+            if (Scene(X, IndexY, Z).GetAlpha() == 7) {
+                Top = static_cast<float>(IndexY + 1);
+                break;
+            }
+        }
+        this->Tops[static_cast<std::size_t>(X) + this->Size[0] * static_cast<std::size_t>(Z)] = Top;
+    }
+
+    // Sweep the heights away from the light, each column is shadowed by its own top or the height of the column towards the light lowered by the rise of the light.
+    bool ShadowMap::Update(const std::array<float, 3>& LightDirection) {
+        const float Length = std::sqrt(LightDirection[0] * LightDirection[0] + LightDirection[1] * LightDirection[1] + LightDirection[2] * LightDirection[2]);
+        if ((Length <= 0.0f) || this->Tops.empty()) {
+            return false;
+        }
+        const std::array<float, 3> NewDirection = {{LightDirection[0] / Length, LightDirection[1] / Length, LightDirection[2] / Length}};
+        const float Cosine = NewDirection[0] * this->Direction[0] + NewDirection[1] * this->Direction[1] + NewDirection[2] * this->Direction[2];
+        if (1.0f - Cosine > DirectionThreshold) {
+            this->Stale = true;
+        }
+        if (!this->Stale && this->DirtyColumns.IsEmpty()) {
+            return false;
+        }
+
+        RAYMARCH_TRACE_SCOPE("ShadowMap::Update");
+
+        // Small changes of direction are ignored so incremental sweeps keep using the direction of the last full sweep.
+        if (this->Stale) {
+            this->Direction = NewDirection;
+        }
+
+        // Sweep in rows along the axis that is closest to the light direction, starting at the side facing the light.
+        const bool MajorX = std::abs(this->Direction[0]) >= std::abs(this->Direction[2]);
+        const std::size_t MajorAxis = MajorX ? 0 : 2;
+        const std::size_t MinorAxis = MajorX ? 2 : 0;
+        const int SizeMajor = static_cast<int>(this->Size[MajorAxis]);
+        const int SizeMinor = static_cast<int>(this->Size[MinorAxis]);
+        const float LightMajor = this->Direction[MajorAxis];
+        const float LightMinor = this->Direction[MinorAxis];
+        const float LightVertical = this->Direction[1];
+        auto GetIndex = [this, MajorX](int Major, int Minor) -> std::size_t {
+            return MajorX ? (static_cast<std::size_t>(Major) + this->Size[0] * static_cast<std::size_t>(Minor)) : (static_cast<std::size_t>(Minor) + this->Size[0] * static_cast<std::size_t>(Major));
+        };
+
+        // Only the rows from the first changed row onwards need sweeping again.
+        int FirstRow = 0;
+        if (!this->Stale) {
+            FirstRow = (LightMajor > 0.0f) ? (SizeMajor - this->DirtyColumns.Maximum[MajorAxis]) : this->DirtyColumns.Minimum[MajorAxis];
+            FirstRow = std::max(0, FirstRow);
+        }
+
+        if (LightVertical <= 0.0f) {
+            // The light is below the horizon, everything is in shadow.
+            std::fill(this->Heights.begin(), this->Heights.end(), static_cast<float>(this->Size[1] + 1));
+        }
+        else if (std::abs(LightMajor) < 1e-6f) {
+            // The light is directly overhead, columns only shadow themselves.
+            this->Heights = this->Tops;
+        }
+        else {
+            const float Rise = LightVertical / std::abs(LightMajor);
+            const int StepMajor = (LightMajor > 0.0f) ? +1 : -1;
+            const float StepMinor = LightMinor / std::abs(LightMajor);
+            for (int Row = FirstRow; Row < SizeMajor; ++Row) {
+                const int Major = (LightMajor > 0.0f) ? (SizeMajor - 1 - Row) : Row;
+                const int Previous = Major + StepMajor;
+                const bool HasPrevious = (Previous >= 0) && (Previous < SizeMajor);
+                for (int Minor = 0; Minor < SizeMinor; ++Minor) {
+                    float Height = this->Tops[GetIndex(Major, Minor)];
+                    if (HasPrevious) {
+                        // Interpolate the height of the column one step towards the light, nothing outside the volume casts shadows.
+                        const float Sample = static_cast<float>(Minor) + StepMinor;
+                        const int Lower = static_cast<int>(std::floor(Sample));
+                        const float Fraction = Sample - static_cast<float>(Lower);
+                        const float LowerHeight = ((Lower >= 0) && (Lower < SizeMinor)) ? this->Heights[GetIndex(Previous, Lower)] : 0.0f;
+                        const float UpperHeight = ((Lower + 1 >= 0) && (Lower + 1 < SizeMinor)) ? this->Heights[GetIndex(Previous, Lower + 1)] : 0.0f;
+                        Height = std::max(Height, LowerHeight + (UpperHeight - LowerHeight) * Fraction - Rise);
+                    }
+                    this->Heights[GetIndex(Major, Minor)] = Height;
+                }
+            }
+        }
+
+        this->DirtyColumns = Region();
+        this->Stale = false;
+        ++this->Version;
+        return true;
+    }
+}
@@ -0,0 +1,113 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_SHADOWMAP_HPP
+#define RAYMARCH_SHADOWMAP_HPP
+
+#include "Region.hpp"
+#include "Volume.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  ShadowMap stores, for each XZ column of a volume, the height below which the column is in the shadow of the global light.
+    /// @note   Opaque voxels cast shadows and the volume is treated as a height field, so overhangs shade everything beneath them.
+    ///         Heights are swept column by column away from the light, and only swept again when the light direction has moved
+    ///         far enough or the columns towards the light of a change need updating.
+    class ShadowMap {
+    public:
+        /// @brief  The change in the light direction, as one minus the cosine of the angle, that causes the heights to be swept again.
+        constexpr static const float DirectionThreshold = 0.00002f;
+
+    private:
+        /// @brief  The size of the volume the heights are for.
+        std::array<std::size_t, 3> Size;
+
+        /// @brief  The height above the highest opaque voxel of each column.
+        std::vector<float> Tops;
+
+        /// @brief  The shadow height of each column.
+        std::vector<float> Heights;
+
+        /// @brief  The normalised light direction the heights were swept for.
+        std::array<float, 3> Direction;
+
+        /// @brief  The columns whose tops have changed since the heights were swept, as a region with a Y extent of one.
+        Region DirtyColumns;
+
+        /// @brief  Set when all heights need sweeping.
+        bool Stale;
+
+        /// @brief  Incremented whenever the heights change.
+        std::uint64_t Version;
+
+    public:
+        /// @brief  Constructor that creates an empty shadow map.
+        ShadowMap(void);
+
+    public:
+        /// @brief  Get the number of columns along the X axis.
+        /// @return The X size of the shadow map.
+        std::size_t GetSizeX(void) const;
+
+        /// @brief  Get the number of columns along the Z axis.
+        /// @return The Z size of the shadow map.
+        std::size_t GetSizeZ(void) const;
+
+        /// @brief  Get the shadow heights, indexed by X + SizeX * Z.
+        /// @return A pointer to the heights.
+        const float* data(void) const;
+
+        /// @brief  Get the version of the heights, it changes whenever the heights change.
+        /// @return The current version.
+        std::uint64_t GetVersion(void) const;
+
+    public:
+        /// @brief  Recalculate the tops of every column of a volume.
+        /// @param  Scene - The volume casting shadows, its size may differ from the last call.
+        void Rebuild(const Volume& Scene);
+
+        /// @brief  Recalculate the tops of the columns overlapping a changed region.
+        /// @param  Scene - The volume casting shadows, it must be the volume given to the last call of Rebuild.
+        /// @param  Changed - The region of voxels that changed.
+        void NotifyChanged(const Volume& Scene, const Region& Changed);
+
+        /// @brief  Sweep the heights that are affected by the light direction or changed columns.
+        /// @param  LightDirection - The direction towards the global light, it does not need to be normalised.
+        /// @return True if the heights changed.
+        bool Update(const std::array<float, 3>& LightDirection);
+
+    private:
+        /// @brief  Calculate the top of a single column.
+        /// @param  Scene - The volume casting shadows.
+        /// @param  X - The X coordinate of the column.
+        /// @param  Z - The Z coordinate of the column.
+        void UpdateTop(const Volume& Scene, int X, int Z);
+    };
+}
+
+#endif // RAYMARCH_SHADOWMAP_HPP
@@ -0,0 +1,388 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "Simulation.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace Raymarch {
+    // Test if a voxel holds liquid.
+    static bool IsLiquid(const Voxel& Value) {
+        return (Value.GetAlpha() > 0) && (Value.GetState() == Voxel::StateType::Liquid);
+    }
+
+    // Test if liquid may flow into a voxel.
+    static bool IsOpen(const Voxel& Value) {
+        return (Value.GetAlpha() == 0) || (Value.GetState() == Voxel::StateType::Liquid);
+    }
+
+    // Test if a voxel is burning, plasma without fuel is a permanent emitter rather than a fire.
+    static bool IsFire(const Voxel& Value) {
+        return (Value.GetAlpha() > 0) && (Value.GetState() == Voxel::StateType::Plasma) && (Value.GetFillLevel() > 0);
+    }
+
+    // Get the amount of liquid in a voxel.
+    static int GetAmount(const Voxel& Value) {
+        return IsLiquid(Value) ? (Value.GetFillLevel() + 1) : 0;
+    }
+
+    // Constructor for an idle simulation.
+    Simulation::Simulation(float BudgetMilliseconds)
+        : Stepping(false)
+        , Tick(0)
+        , Accumulator(0.0f)
+        , BudgetMilliseconds(BudgetMilliseconds) {
+    }
+
+    // Forget everything.
+    void Simulation::Clear(void) {
+        this->Active.clear();
+        this->Pending.clear();
+        this->Stepped.clear();
+        this->Stepping = false;
+        this->Accumulator = 0.0f;
+    }
+
+    // Activate the chunks that can see a change and restart the tick in progress, its steps may have read the old voxels.
+    void Simulation::Activate(const Region& Changed) {
+        for (const std::array<int, 3>& Key : World::GetChunkKeys(Changed.Expand(1))) {
+            if (Key[1] >= 0) {
+                this->Active[Key] = 0;
+            }
+        }
+        if (this->Stepping) {
+            this->Pending.clear();
+            this->Stepped.clear();
+            for (const std::pair<const std::array<int, 3>, std::uint8_t>& KeyRestPair : this->Active) {
+                this->Pending.push_back(KeyRestPair.first);
+            }
+        }
+    }
+
+    // Get the active chunk count.
+    std::size_t Simulation::GetActiveCount(void) const {
+        return this->Active.size();
+    }
+
+    // Get the tick.
+    std::uint64_t Simulation::GetTick(void) const {
+        return this->Tick;
+    }
+
+    // Get the budget.
+    float Simulation::GetBudget(void) const {
+        return this->BudgetMilliseconds;
+    }
+
+    // Set the budget.
+    void Simulation::SetBudget(float BudgetMilliseconds) {
+        this->BudgetMilliseconds = BudgetMilliseconds;
+    }
+
+    // Step chunks until the due ticks are done or the budget is spent.
+    std::vector<Region> Simulation::Update(World& Target, float DeltaTime) {
+        std::vector<Region> Changes;
+
+        // At most two ticks are kept due, a simulation that can not keep up slows down rather than falling further behind.
+        constexpr static const float TickInterval = 1.0f / TickRate;
+        this->Accumulator = std::min(this->Accumulator + DeltaTime, 2.0f * TickInterval);
+        if (!this->Stepping && this->Active.empty()) {
+            return Changes;
+        }
+
+        RAYMARCH_TRACE_SCOPE("Simulation::Update");
+
+        const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+        auto GetElapsed = [&Start]() -> float {
+            return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - Start).count();
+        };
+
+        JobSystem& Jobs = JobSystem::GetGlobal();
+        while (true) {
+            // Begin a tick with every active chunk.
+            if (!this->Stepping) {
+                if ((this->Accumulator < TickInterval) || this->Active.empty()) {
+                    break;
+                }
+                this->Accumulator -= TickInterval;
+                this->Stepping = true;
+                for (const std::pair<const std::array<int, 3>, std::uint8_t>& KeyRestPair : this->Active) {
+                    this->Pending.push_back(KeyRestPair.first);
+                }
+            }
+
+            // Step a chunk per thread at a time until the tick is done or the budget is spent.
+            while (!this->Pending.empty() && (GetElapsed() < this->BudgetMilliseconds)) {
+                const std::size_t First = this->Stepped.size();
+                const std::size_t BatchSize = std::min(this->Pending.size(), Jobs.GetThreadCount());
+                for (std::size_t Index = 0; Index < BatchSize; ++Index) {
+                    this->Stepped.push_back(ChunkStep{this->Pending.back(), Volume(), Region(), false});
+                    this->Pending.pop_back();
+                }
+                Jobs.ParallelFor(First, this->Stepped.size(), 1, [this, &Target](std::size_t FirstChunk, std::size_t LastChunk) -> void {
+                    for (std::size_t Index = FirstChunk; Index < LastChunk; ++Index) {
+                        StepChunk(Target, this->Tick, this->Stepped[Index]);
+                    }
+                });
+            }
+            if (!this->Pending.empty()) {
+                break;
+            }
+
+            this->Commit(Target, Changes);
+            if (GetElapsed() >= this->BudgetMilliseconds) {
+                break;
+            }
+        }
+        return Changes;
+    }
+
+    // Swap the changed chunks into the world, retire the chunks at rest and activate around the changes.
+    void Simulation::Commit(World& Target, std::vector<Region>& Changes) {
+        RAYMARCH_TRACE_SCOPE("Simulation::Commit");
+
+        const std::size_t FirstChange = Changes.size();
+        for (ChunkStep& Step : this->Stepped) {
+            if (Step.Changed.IsEmpty()) {
+                const auto Iterator = this->Active.find(Step.Key);
+                if ((Iterator != this->Active.end()) && (Step.Inert || (++Iterator->second >= RestTicks))) {
+                    this->Active.erase(Iterator);
+                }
+            }
+            else {
+                Target.GetChunk(Step.Key) = std::move(Step.Next);
+                Changes.push_back(Step.Changed);
+            }
+        }
+        for (std::size_t Index = FirstChange; Index < Changes.size(); ++Index) {
+            for (const std::array<int, 3>& Key : World::GetChunkKeys(Changes[Index].Expand(1))) {
+                if (Key[1] >= 0) {
+                    this->Active[Key] = 0;
+                }
+            }
+        }
+        this->Stepped.clear();
+        this->Stepping = false;
+        ++this->Tick;
+    }
+
+    // Compute the next state of a chunk from the current state of it and its neighbours.
+    void Simulation::StepChunk(const World& Source, std::uint64_t Tick, ChunkStep& Step) {
+        constexpr static const int Size = World::ChunkSize;
+        constexpr static const int PaddedSize = Size + 2;
+
+        // Nothing below the bedrock is simulated, and nothing happens where no chunk is stored.
+        const std::array<int, 3>& Key = Step.Key;
+        Step.Inert = true;
+        if (Key[1] < 0) {
+            return;
+        }
+        bool AnyStored = false;
+        for (int OffsetZ = -1; OffsetZ <= 1; ++OffsetZ) {
+            for (int OffsetY = -1; OffsetY <= 1; ++OffsetY) {
+                for (int OffsetX = -1; OffsetX <= 1; ++OffsetX) {
+                    AnyStored = AnyStored || (Source.FindChunk({{Key[0] + OffsetX, Key[1] + OffsetY, Key[2] + OffsetZ}}) != nullptr);
+                }
+            }
+        }
+        if (!AnyStored) {
+            return;
+        }
+
+        RAYMARCH_TRACE_SCOPE("Simulation::StepChunk");
+
+        // Copy the chunk with a border of one voxel, every rule only reads the voxels touching the voxel it updates or its flow partner.
+        const std::array<int, 3> Origin = {{Key[0] * Size, Key[1] * Size, Key[2] * Size}};
+        Volume Padded(PaddedSize, PaddedSize, PaddedSize);
+        Source.Extract({{Origin[0] - 1, Origin[1] - 1, Origin[2] - 1}}, Padded, Padded.GetRegion());
+
+        // Voxels below zero height are solid bedrock, so liquid can not fall out of the world.
+        if (Origin[1] == 0) {
+            Voxel Bedrock;
+            Bedrock.SetAlpha(0b111);
+            Bedrock.SetState(Voxel::StateType::Solid);
+            Bedrock.SetStrength(FireproofStrength);
+            Padded.Fill(Bedrock, Region({{0, 0, 0}}, {{PaddedSize, 1, PaddedSize}}));
+        }
+
+        // Chunks and borders without liquid, fire or heat are inert.
+        const Voxel* Data = Padded.data();
+        for (std::size_t Index = 0; Index < static_cast<std::size_t>(PaddedSize * PaddedSize * PaddedSize); ++Index) {
+            Step.Inert = Step.Inert && !IsLiquid(Data[Index]) && !IsFire(Data[Index]) && (Data[Index].GetTemperature() == 0);
+        }
+        if (Step.Inert) {
+            return;
+        }
+
+        auto At = [Data](int X, int Y, int Z) -> const Voxel& {
+            return Data[X + PaddedSize * (Y + PaddedSize * Z)];
+        };
+
+        // Liquid falling out of a voxel into the voxel below it.
+        auto GetFallOut = [&At](int X, int Y, int Z) -> int {
+            const Voxel& Value = At(X, Y, Z);
+            const Voxel& Below = At(X, Y - 1, Z);
+            if (!IsLiquid(Value) || !IsOpen(Below)) {
+                return 0;
+            }
+            return std::min(GetAmount(Value), LiquidCapacity - GetAmount(Below));
+        };
+
+        // Liquid falling into a voxel from the voxel above it.
+        auto GetFallIn = [&At, &GetFallOut](int X, int Y, int Z) -> int {
+            return IsOpen(At(X, Y, Z)) ? GetFallOut(X, Y + 1, Z) : 0;
+        };
+
+        // Liquid levelling from the lower voxel of a pair to the upper voxel, negative when it flows the other way.
+        // Only voxels that are not falling level out, and the receiver keeps room for what falls into it.
+        auto GetPairFlow = [&At, &GetFallOut, &GetFallIn](const std::array<int, 3>& Lower, const std::array<int, 3>& Upper) -> int {
+            const Voxel& LowerValue = At(Lower[0], Lower[1], Lower[2]);
+            const Voxel& UpperValue = At(Upper[0], Upper[1], Upper[2]);
+            if (!IsOpen(LowerValue) || !IsOpen(UpperValue)) {
+                return 0;
+            }
+            if ((GetFallOut(Lower[0], Lower[1], Lower[2]) > 0) || (GetFallOut(Upper[0], Upper[1], Upper[2]) > 0)) {
+                return 0;
+            }
+            const int Difference = GetAmount(LowerValue) - GetAmount(UpperValue);
+            if (Difference >= 2) {
+                return +std::min(Difference / 2, LiquidCapacity - GetAmount(UpperValue) - GetFallIn(Upper[0], Upper[1], Upper[2]));
+            }
+            if (Difference <= -2) {
+                return -std::min(-Difference / 2, LiquidCapacity - GetAmount(LowerValue) - GetFallIn(Lower[0], Lower[1], Lower[2]));
+            }
+            return 0;
+        };
+
+        // The lateral pairing alternates between X and Z, and between even and odd pairs, using world coordinates so chunks agree.
+        const int Axis = ((Tick / 2) % 2 == 0) ? 0 : 2;
+        const int Parity = static_cast<int>(Tick % 2);
+
+        constexpr static const std::array<std::array<int, 3>, 6> Neighbours = {{
+            {{+1, 0, 0}}, {{-1, 0, 0}}, {{0, +1, 0}}, {{0, -1, 0}}, {{0, 0, +1}}, {{0, 0, -1}}
+        }};
+
+        Volume Next(Size, Size, Size);
+        Region Changed;
+        for (int IndexZ = 1; IndexZ <= Size; ++IndexZ) {
+            for (int IndexY = 1; IndexY <= Size; ++IndexY) {
+                for (int IndexX = 1; IndexX <= Size; ++IndexX) {
+                    const Voxel& Old = At(IndexX, IndexY, IndexZ);
+                    Voxel New = Old;
+
+                    // Look at the touching voxels.
+                    bool NextToFire = false;
+                    bool NextToLiquid = false;
+                    int HeatSum = Old.GetTemperature();
+                    int HeatCount = 1;
+                    for (const std::array<int, 3>& Offset : Neighbours) {
+                        const Voxel& Neighbour = At(IndexX + Offset[0], IndexY + Offset[1], IndexZ + Offset[2]);
+                        NextToFire = NextToFire || IsFire(Neighbour);
+                        NextToLiquid = NextToLiquid || IsLiquid(Neighbour);
+                        if (Neighbour.GetAlpha() > 0) {
+                            HeatSum += Neighbour.GetTemperature();
+                            HeatCount += 1;
+                        }
+                    }
+
+                    // Heat moves one step towards the average of the touching voxels, or rises next to a fire.
+                    std::uint8_t Temperature = Old.GetTemperature();
+                    if (NextToFire) {
+                        Temperature = std::min(Temperature + 1, 0b111);
+                    }
+                    else if (2 * HeatSum > (2 * Temperature + 1) * HeatCount) {
+                        Temperature += 1;
+                    }
+                    else if (2 * HeatSum < (2 * Temperature - 1) * HeatCount) {
+                        Temperature -= 1;
+                    }
+
+                    if (IsFire(Old)) {
+                        // Fires burn their fuel and are put out by liquid.
+                        if (NextToLiquid || (Old.GetFillLevel() <= 1)) {
+                            New = Voxel();
+                        }
+                        else {
+                            New.SetFillLevel(Old.GetFillLevel() - 1);
+                        }
+                    }
+                    else if (IsOpen(Old)) {
+                        // Liquid falls, then levels with the pair partner.
+                        const int Coordinate = ((Axis == 0) ? IndexX : IndexZ) - 1 + Origin[Axis];
+                        const int Side = (((Coordinate - Parity) & 1) == 0) ? +1 : -1;
+                        const std::array<int, 3> Self = {{IndexX, IndexY, IndexZ}};
+                        std::array<int, 3> Partner = Self;
+                        Partner[Axis] += Side;
+                        const int FallIn = GetFallIn(IndexX, IndexY, IndexZ);
+                        const int Flow = (Side > 0) ? -GetPairFlow(Self, Partner) : GetPairFlow(Partner, Self);
+                        const int Amount = GetAmount(Old) - GetFallOut(IndexX, IndexY, IndexZ) + FallIn + Flow;
+                        if (Amount <= 0) {
+                            if (IsLiquid(Old)) {
+                                New = Voxel();
+                            }
+                        }
+                        else {
+                            if (!IsLiquid(Old)) {
+                                New = (FallIn > 0) ? At(IndexX, IndexY + 1, IndexZ) : At(Partner[0], Partner[1], Partner[2]);
+                            }
+                            New.SetFillLevel(static_cast<std::uint8_t>(Amount - 1));
+                            if (IsLiquid(Old)) {
+                                New.SetTemperature(Temperature);
+                            }
+                        }
+                    }
+                    else {
+                        // Solid voxels conduct heat, and flammable ones next to a fire ignite once hot enough.
+                        New.SetTemperature(Temperature);
+                        if (NextToFire && (Temperature >= IgnitionTemperature) && (Old.GetState() != Voxel::StateType::Plasma) && (Old.GetStrength() < FireproofStrength)) {
+                            New.SetState(Voxel::StateType::Plasma);
+                            New.SetFillLevel(0b111);
+                            New.SetTemperature(0b111);
+                            New.SetLight(0b1111);
+                            New.SetTint(0b110);
+                        }
+                    }
+
+                    Next(IndexX - 1, IndexY - 1, IndexZ - 1) = New;
+                    if (New.GetBits() != Old.GetBits()) {
+                        const int X = Origin[0] + IndexX - 1;
+                        const int Y = Origin[1] + IndexY - 1;
+                        const int Z = Origin[2] + IndexZ - 1;
+                        Changed = Changed.Union(Region({{X, Y, Z}}, {{X + 1, Y + 1, Z + 1}}));
+                    }
+                }
+            }
+        }
+
+        // Chunks that did not change keep their current voxels.
+        if (!Changed.IsEmpty()) {
+            Step.Next = std::move(Next);
+            Step.Changed = Changed;
+        }
+    }
+}
@@ -0,0 +1,154 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_SIMULATION_HPP
+#define RAYMARCH_SIMULATION_HPP
+
+#include "Region.hpp"
+#include "Volume.hpp"
+#include "World.hpp"
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  Simulation steps liquid flow, heat diffusion and fire spread on the chunks of a world.
+    /// @note   Each tick every active chunk computes its next state from the current state of the world into its own buffer,
+    ///         chunks are stepped in parallel, and the buffers are only swapped into the world once every active chunk has been stepped.
+    ///         A tick may be spread over several updates to stay within the time budget. Chunks that have not changed for a full
+    ///         cycle of flow directions are at rest and are not stepped again until a change nearby activates them.
+    ///
+    ///         Liquid voxels hold FillLevel plus one units of liquid, falling first and then levelling with one neighbour
+    ///         chosen by a pairing that alternates between ticks so every exchange is computed identically by both voxels.
+    ///         Burning voxels are plasma with fuel left in FillLevel, they heat their neighbours, ignite hot flammable neighbours,
+    ///         burn out when their fuel runs out and are put out by liquid. Heat diffuses between touching non-empty voxels.
+    class Simulation {
+    public:
+        /// @brief  The number of ticks stepped every second.
+        constexpr static const float TickRate = 20.0f;
+
+        /// @brief  The number of ticks in a cycle of the lateral flow pairings, a chunk at rest for this many ticks is retired.
+        constexpr static const std::uint8_t RestTicks = 4;
+
+        /// @brief  The amount of liquid a voxel can hold.
+        constexpr static const int LiquidCapacity = 8;
+
+        /// @brief  The temperature at which a flammable voxel next to a fire ignites.
+        constexpr static const std::uint8_t IgnitionTemperature = 4;
+
+        /// @brief  The strength of voxels that do not burn.
+        constexpr static const std::uint8_t FireproofStrength = 7;
+
+    private:
+        /// @brief  The result of stepping one chunk.
+        struct ChunkStep {
+            /// @brief  The chunk coordinate.
+            std::array<int, 3> Key;
+
+            /// @brief  The next state of the chunk, only allocated when it changed.
+            Volume Next;
+
+            /// @brief  The region of the chunk that changed, in world coordinates.
+            Region Changed;
+
+            /// @brief  Set when neither the chunk nor its border hold anything to simulate, so it is at rest for every tick.
+            bool Inert;
+        };
+
+    private:
+        /// @brief  The active chunks and the number of ticks each has been at rest.
+        std::unordered_map<std::array<int, 3>, std::uint8_t, World::ChunkKeyHash> Active;
+
+        /// @brief  The chunks of the current tick that have not been stepped yet.
+        std::vector<std::array<int, 3> > Pending;
+
+        /// @brief  The chunks of the current tick that have been stepped.
+        std::vector<ChunkStep> Stepped;
+
+        /// @brief  Set while a tick is being stepped.
+        bool Stepping;
+
+        /// @brief  The number of ticks stepped so far, selects the lateral flow pairing.
+        std::uint64_t Tick;
+
+        /// @brief  The time not yet simulated.
+        float Accumulator;
+
+        /// @brief  The time that may be spent stepping in each update.
+        float BudgetMilliseconds;
+
+    public:
+        /// @brief  Constructor that creates a simulation with nothing active.
+        /// @param  BudgetMilliseconds - The time that may be spent stepping in each update.
+        Simulation(float BudgetMilliseconds = 2.0f);
+
+    public:
+        /// @brief  Discard all activity and any tick in progress.
+        void Clear(void);
+
+        /// @brief  Activate the chunks around a region of the world that changed, a tick in progress is restarted.
+        /// @param  Changed - The region in world coordinates.
+        void Activate(const Region& Changed);
+
+        /// @brief  Get the number of active chunks.
+        /// @return The number of active chunks.
+        std::size_t GetActiveCount(void) const;
+
+        /// @brief  Get the number of ticks stepped so far.
+        /// @return The current tick.
+        std::uint64_t GetTick(void) const;
+
+        /// @brief  Get the time that may be spent stepping in each update.
+        /// @return The budget in milliseconds.
+        float GetBudget(void) const;
+
+        /// @brief  Set the time that may be spent stepping in each update.
+        /// @param  BudgetMilliseconds - The budget in milliseconds.
+        void SetBudget(float BudgetMilliseconds);
+
+    public:
+        /// @brief  Step the due ticks within the time budget.
+        /// @param  Target - The world to simulate.
+        /// @param  DeltaTime - The time since update was last called.
+        /// @return The regions of the world that changed, in world coordinates.
+        std::vector<Region> Update(World& Target, float DeltaTime);
+
+    private:
+        /// @brief  Compute the next state of one chunk.
+        /// @param  Source - The world at the start of the tick.
+        /// @param  Tick - The tick being stepped.
+        /// @param  Step - The chunk to step, receives the result.
+        static void StepChunk(const World& Source, std::uint64_t Tick, ChunkStep& Step);
+
+        /// @brief  Swap the stepped chunks into the world and finish the tick.
+        /// @param  Target - The world to update.
+        /// @param  Changes - Receives the regions that changed.
+        void Commit(World& Target, std::vector<Region>& Changes);
+    };
+}
+
+#endif // RAYMARCH_SIMULATION_HPP
@@ -0,0 +1,437 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "SparseVoxelOctree.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace Raymarch {
+    // The number of queries of a batch handled by each job.
+    constexpr static const std::size_t QueryGrain = 256;
+
+    // Write a little endian word.
+    static void WriteWord(std::uint32_t Value, std::uint8_t* Output) {
+        for (std::size_t Index = 0; Index < 4; ++Index) {
+            Output[Index] = static_cast<std::uint8_t>(Value >> (Index * 8));
+        }
+    }
+
+    // Read a little endian word.
+    static std::uint32_t ReadWord(const std::uint8_t* Data) {
+        std::uint32_t Value = 0;
+        for (std::size_t Index = 0; Index < 4; ++Index) {
+            Value |= static_cast<std::uint32_t>(Data[Index]) << (Index * 8);
+        }
+        return Value;
+    }
+
+    // A child of a node, either a leaf holding voxel bits or a node of the subtree being built.
+    struct OctreeChild {
+        bool IsNode;
+        std::uint32_t Node;
+        std::uint32_t Bits;
+    };
+
+    // Get the sign of a value as the shader does.
+    static float Sign(float Value) {
+        return (Value > 0.0f) ? 1.0f : ((Value < 0.0f) ? -1.0f : 0.0f);
+    }
+
+    // Test for ray intersection with a box, the same as the voxel shader.
+    static bool RayBoxIntersect(const std::array<float, 3>& RayOrigin, const std::array<float, 3>& RayDirection, const std::array<float, 3>& BoxMin, const std::array<float, 3>& BoxMax, float& IntersectionDepth) {
+        std::array<float, 3> MaximumVector;
+        std::array<float, 3> MinimumVector;
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            const float OriginToBoxMinimum = (BoxMin[Index] - RayOrigin[Index]) / RayDirection[Index];
+            const float OriginToBoxMaximum = (BoxMax[Index] - RayOrigin[Index]) / RayDirection[Index];
+            MaximumVector[Index] = std::max(OriginToBoxMaximum, OriginToBoxMinimum);
+            MinimumVector[Index] = std::min(OriginToBoxMaximum, OriginToBoxMinimum);
+        }
+
+        const float BackIntersectionDepth = std::min(MaximumVector[0], std::min(MaximumVector[1], MaximumVector[2]));
+
+        IntersectionDepth = std::max(std::max(MinimumVector[0], 0.0f), std::max(MinimumVector[1], MinimumVector[2]));
+
+        return BackIntersectionDepth > IntersectionDepth;
+    }
+
+    // Get a voxel of a volume.
+    static Voxel GetVoxel(const Volume& Source, int X, int Y, int Z) {
+        return Source(X, Y, Z);
+    }
+
+    // Decode a voxel of a packed volume.
+    static Voxel GetVoxel(const PaletteVolume& Source, int X, int Y, int Z) {
+        return Source.Get(static_cast<std::size_t>(X), static_cast<std::size_t>(Y), static_cast<std::size_t>(Z));
+    }
+
+    // Build a cube, its node is appended before the nodes below it and removed again when its children are equal leaves.
+    template <typename VolumeType>
+    static OctreeChild BuildCube(const VolumeType& Source, int X, int Y, int Z, int Side, std::vector<std::uint32_t>& Nodes) {
+        if ((X >= static_cast<int>(Source.GetSize()[0])) || (Y >= static_cast<int>(Source.GetSize()[1])) || (Z >= static_cast<int>(Source.GetSize()[2]))) {
+            return {false, 0, 0};
+        }
+        if (Side == 1) {
+            const Voxel Value = GetVoxel(Source, X, Y, Z);
+            return {false, 0, (Value.GetAlpha() > 0) ? Value.GetBits() : 0};
+        }
+
+        const std::size_t Node = Nodes.size() / SparseVoxelOctree::NodeWords;
+        Nodes.resize(Nodes.size() + SparseVoxelOctree::NodeWords, 0);
+        const int Half = Side / 2;
+        std::array<OctreeChild, 8> Children;
+        bool Uniform = true;
+        for (int Child = 0; Child < 8; ++Child) {
+            Children[Child] = BuildCube(Source, X + (Child & 1) * Half, Y + ((Child >> 1) & 1) * Half, Z + ((Child >> 2) & 1) * Half, Half, Nodes);
+            Uniform = Uniform && !Children[Child].IsNode && (Children[Child].Bits == Children[0].Bits);
+        }
+        if (Uniform) {
+            Nodes.resize(Node * SparseVoxelOctree::NodeWords);
+            return {false, 0, Children[0].Bits};
+        }
+        for (std::size_t Child = 0; Child < 8; ++Child) {
+            Nodes[Node * SparseVoxelOctree::NodeWords + Child * SparseVoxelOctree::ChildWords + 0] = Children[Child].IsNode ? Children[Child].Node : 0;
+            Nodes[Node * SparseVoxelOctree::NodeWords + Child * SparseVoxelOctree::ChildWords + 1] = Children[Child].Bits;
+        }
+        return {true, static_cast<std::uint32_t>(Node), 0};
+    }
+
+    // Build the nodes of a volume below a root cube of a depth, the subtrees of the root are built into their own nodes and appended after the root.
+    template <typename VolumeType>
+    static void BuildNodes(const VolumeType& Source, std::size_t Depth, std::vector<std::uint32_t>& Nodes) {
+        const int Half = 1 << (Depth - 1);
+
+        std::array<std::vector<std::uint32_t>, 8> Subtrees;
+        std::array<OctreeChild, 8> Children;
+        JobSystem::GetGlobal().ParallelFor(0, 8, 1, [&Source, Half, &Subtrees, &Children](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Child = First; Child < Last; ++Child) {
+                Children[Child] = BuildCube(Source, static_cast<int>(Child & 1) * Half, static_cast<int>((Child >> 1) & 1) * Half, static_cast<int>((Child >> 2) & 1) * Half, Half, Subtrees[Child]);
+            }
+        });
+
+        // Each subtree is relocated by the number of nodes before it, its first node is the child of the root.
+        Nodes.assign(SparseVoxelOctree::NodeWords, 0);
+        for (std::size_t Child = 0; Child < 8; ++Child) {
+            if (!Children[Child].IsNode) {
+                Nodes[Child * SparseVoxelOctree::ChildWords + 1] = Children[Child].Bits;
+                continue;
+            }
+            const std::uint32_t Offset = static_cast<std::uint32_t>(Nodes.size() / SparseVoxelOctree::NodeWords);
+            Nodes[Child * SparseVoxelOctree::ChildWords + 0] = Offset + Children[Child].Node;
+            const std::size_t First = Nodes.size();
+            Nodes.insert(Nodes.end(), Subtrees[Child].begin(), Subtrees[Child].end());
+            for (std::size_t Word = First; Word < Nodes.size(); Word += SparseVoxelOctree::ChildWords) {
+                if (Nodes[Word] != 0) {
+                    Nodes[Word] += Offset;
+                }
+            }
+        }
+    }
+
+    // Get the depth of the smallest power of two cube holding a volume, the root is always a node so the shader can start from it.
+    static std::size_t GetDepth(const std::array<std::size_t, 3>& Size) {
+        std::size_t Depth = 1;
+        while ((std::size_t(1) << Depth) < std::max(Size[0], std::max(Size[1], Size[2]))) {
+            ++Depth;
+        }
+        return Depth;
+    }
+
+    // Constructor for an empty octree.
+    SparseVoxelOctree::SparseVoxelOctree(void)
+        : Size{{0, 0, 0}}
+        , Depth(1)
+        , Nodes(NodeWords, 0) {
+    }
+
+    // Get the size.
+    const std::array<std::size_t, 3>& SparseVoxelOctree::GetSize(void) const {
+        return this->Size;
+    }
+
+    // Get the side of the root cube.
+    std::size_t SparseVoxelOctree::GetSide(void) const {
+        return std::size_t(1) << this->Depth;
+    }
+
+    // Get the number of nodes.
+    std::size_t SparseVoxelOctree::GetNodeCount(void) const {
+        return this->Nodes.size() / NodeWords;
+    }
+
+    // Get the nodes.
+    const std::uint32_t* SparseVoxelOctree::data(void) const {
+        return this->Nodes.data();
+    }
+
+    // Get the size of the nodes.
+    std::size_t SparseVoxelOctree::GetByteCount(void) const {
+        return this->Nodes.size() * sizeof(std::uint32_t);
+    }
+
+    // Get a voxel from its leaf.
+    Voxel SparseVoxelOctree::Get(int X, int Y, int Z) const {
+        if ((X < 0) || (Y < 0) || (Z < 0) || (X >= static_cast<int>(this->Size[0])) || (Y >= static_cast<int>(this->Size[1])) || (Z >= static_cast<int>(this->Size[2]))) {
+            return Voxel();
+        }
+        std::array<int, 3> Minimum;
+        int Side;
+        return Voxel::FromBits(this->FindLeaf({{X, Y, Z}}, Minimum, Side));
+    }
+
+    // Build the octree of a volume.
+    void SparseVoxelOctree::Build(const Volume& Source) {
+        RAYMARCH_TRACE_SCOPE("SparseVoxelOctree::Build");
+
+        this->Size = Source.GetSize();
+        this->Depth = GetDepth(this->Size);
+        BuildNodes(Source, this->Depth, this->Nodes);
+    }
+
+    // Build the octree of a packed volume.
+    void SparseVoxelOctree::Build(const PaletteVolume& Source) {
+        RAYMARCH_TRACE_SCOPE("SparseVoxelOctree::Build");
+
+        this->Size = Source.GetSize();
+        this->Depth = GetDepth(this->Size);
+        BuildNodes(Source, this->Depth, this->Nodes);
+    }
+
+    // Save the header, then the nodes.
+    bool SparseVoxelOctree::Save(const std::string& Path) const {
+        RAYMARCH_TRACE_SCOPE("SparseVoxelOctree::Save");
+
+        std::vector<std::uint8_t> Bytes(HeaderSize + this->Nodes.size() * 4);
+        WriteWord(Magic, &Bytes[0]);
+        WriteWord(Version, &Bytes[4]);
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            WriteWord(static_cast<std::uint32_t>(this->Size[Index]), &Bytes[8 + Index * 4]);
+        }
+        WriteWord(static_cast<std::uint32_t>(this->Depth), &Bytes[20]);
+        WriteWord(static_cast<std::uint32_t>(this->GetNodeCount()), &Bytes[24]);
+        for (std::size_t Word = 0; Word < this->Nodes.size(); ++Word) {
+            WriteWord(this->Nodes[Word], &Bytes[HeaderSize + Word * 4]);
+        }
+
+        std::ofstream Output(Path, std::ios::binary | std::ios::trunc);
+        return Output.write(reinterpret_cast<const char*>(Bytes.data()), static_cast<std::streamsize>(Bytes.size())) && Output.flush();
+    }
+
+    // Load and verify the header, then the nodes, every child pointer must point at a later node.
+    bool SparseVoxelOctree::Load(const std::string& Path) {
+        RAYMARCH_TRACE_SCOPE("SparseVoxelOctree::Load");
+
+        std::ifstream Input(Path, std::ios::binary);
+        if (!Input) {
+            return false;
+        }
+        Input.seekg(0, std::ios::end);
+        const std::uint64_t FileSize = static_cast<std::uint64_t>(Input.tellg());
+        Input.seekg(0, std::ios::beg);
+
+        // The node count is checked against the size of the file before the nodes are allocated.
+        std::array<std::uint8_t, HeaderSize> Header;
+        if ((FileSize < HeaderSize) || !Input.read(reinterpret_cast<char*>(Header.data()), HeaderSize)) {
+            return false;
+        }
+        const std::uint32_t Depth = ReadWord(&Header[20]);
+        const std::uint32_t NodeCount = ReadWord(&Header[24]);
+        if ((ReadWord(&Header[0]) != Magic) || (ReadWord(&Header[4]) != Version) || (Depth < 1) || (Depth > MaximumDepth) || (NodeCount < 1) ||
+            (FileSize != HeaderSize + static_cast<std::uint64_t>(NodeCount) * NodeWords * 4)) {
+            return false;
+        }
+
+        std::vector<std::uint8_t> Bytes(static_cast<std::size_t>(NodeCount) * NodeWords * 4);
+        if (!Input.read(reinterpret_cast<char*>(Bytes.data()), static_cast<std::streamsize>(Bytes.size()))) {
+            return false;
+        }
+        std::vector<std::uint32_t> Words(static_cast<std::size_t>(NodeCount) * NodeWords);
+        for (std::size_t Word = 0; Word < Words.size(); ++Word) {
+            Words[Word] = ReadWord(&Bytes[Word * 4]);
+            if ((Word % ChildWords == 0) && (Words[Word] != 0) && ((Words[Word] <= Word / NodeWords) || (Words[Word] >= NodeCount))) {
+                return false;
+            }
+        }
+
+        std::array<std::size_t, 3> Size;
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            Size[Index] = ReadWord(&Header[8 + Index * 4]);
+            if (Size[Index] > (std::size_t(1) << Depth)) {
+                return false;
+            }
+        }
+
+        this->Size = Size;
+        this->Depth = Depth;
+        this->Nodes.swap(Words);
+        return true;
+    }
+
+    // Cast a ray, empty leaves are crossed in one step and the voxels of other leaves one at a time so the hit matches the dense grid.
+    CollisionMap::RayHit SparseVoxelOctree::CastRay(const CollisionMap::RayQuery& Query) const {
+        CollisionMap::RayHit Result = {false, {{0, 0, 0}}, {{0, 0, 0}}, 0.0f, {{0.0f, 0.0f, 0.0f}}, 0};
+
+        const float Length = std::sqrt(Query.Direction[0] * Query.Direction[0] + Query.Direction[1] * Query.Direction[1] + Query.Direction[2] * Query.Direction[2]);
+        if (!(Length > 0.0f)) {
+            return Result;
+        }
+
+        // The direction in which to advance the ray position, offset to prevent the same artifacts as the shader.
+        const std::array<float, 3>& RayOrigin = Query.Origin;
+        std::array<float, 3> RayDirection;
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            RayDirection[Index] = Query.Direction[Index] / Length + 0.000001f;
+        }
+
+        // The ray march origin may be further forward than the ray origin if we can jump forward to the volume.
+        const std::array<float, 3> VolumeSize = {{static_cast<float>(this->Size[0]), static_cast<float>(this->Size[1]), static_cast<float>(this->Size[2])}};
+        std::array<float, 3> RayMarchOrigin = RayOrigin;
+        bool Inside = true;
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            Inside = Inside && (RayOrigin[Index] >= 0.0f) && (RayOrigin[Index] < VolumeSize[Index]);
+        }
+        if (!Inside) {
+            float IntersectionDepth;
+            if (!RayBoxIntersect(RayOrigin, RayDirection, {{0.0f, 0.0f, 0.0f}}, VolumeSize, IntersectionDepth)) {
+                return Result;
+            }
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                RayMarchOrigin[Index] = RayOrigin[Index] + RayDirection[Index] * IntersectionDepth + RayDirection[Index] * 0.0001f;
+            }
+        }
+
+        // Set up the ray marching parameters.
+        std::array<float, 3> RayPosition;
+        std::array<float, 3> RayStep;
+        std::array<float, 3> MaxTranslation;
+        std::array<float, 3> DeltaTranslation;
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            RayPosition[Index] = std::floor(RayMarchOrigin[Index]);
+            RayStep[Index] = Sign(RayDirection[Index]);
+            MaxTranslation[Index] = (((0.5f + RayPosition[Index]) + 0.5f * RayStep[Index]) - RayMarchOrigin[Index]) / RayDirection[Index];
+            DeltaTranslation[Index] = RayStep[Index] / RayDirection[Index];
+        }
+
+        // Ray marching loop, each iteration looks up one leaf.
+        for (int Iteration = 0; Iteration < CollisionMap::MaximumRaySteps; ++Iteration) {
+            Result.Steps = Iteration + 1;
+            const std::array<int, 3> Position = {{static_cast<int>(RayPosition[0]), static_cast<int>(RayPosition[1]), static_cast<int>(RayPosition[2])}};
+            std::array<int, 3> LeafMinimum;
+            int LeafSide;
+            if (this->FindLeaf(Position, LeafMinimum, LeafSide) != 0) {
+                // Calculate the intersection depth.
+                float IntersectionDepth;
+                if (!RayBoxIntersect(RayOrigin, RayDirection, RayPosition, {{RayPosition[0] + 1.0f, RayPosition[1] + 1.0f, RayPosition[2] + 1.0f}}, IntersectionDepth)) {
+                    return Result;
+                }
+
+                // Calculate the face from the direction of the intersection from the voxel centre.
+                std::array<float, 3> Direction;
+                for (std::size_t Index = 0; Index < 3; ++Index) {
+                    Result.Position[Index] = RayOrigin[Index] + RayDirection[Index] * IntersectionDepth;
+                    Direction[Index] = Result.Position[Index] - (RayPosition[Index] + 0.5f);
+                }
+                const std::array<float, 3> AbsoluteDirection = {{std::abs(Direction[0]), std::abs(Direction[1]), std::abs(Direction[2])}};
+                if ((AbsoluteDirection[1] > AbsoluteDirection[0]) && (AbsoluteDirection[1] > AbsoluteDirection[2])) {
+                    Result.Normal = {{0, static_cast<int>(Sign(Direction[1])), 0}};
+                }
+                else if (AbsoluteDirection[0] > AbsoluteDirection[2]) {
+                    Result.Normal = {{static_cast<int>(Sign(Direction[0])), 0, 0}};
+                }
+                else {
+                    Result.Normal = {{0, 0, static_cast<int>(Sign(Direction[2]))}};
+                }
+                Result.Hit = true;
+                Result.Voxel = Position;
+                Result.Distance = IntersectionDepth;
+                return Result;
+            }
+
+            // Skip the rest of the empty leaf in one step, crossing the face the ray leaves through and staying within the leaf along the other axes.
+            std::array<float, 3> LeafExits;
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                const float Minimum = static_cast<float>(LeafMinimum[Index]);
+                LeafExits[Index] = std::max((Minimum - RayOrigin[Index]) / RayDirection[Index], (Minimum + static_cast<float>(LeafSide) - RayOrigin[Index]) / RayDirection[Index]);
+            }
+            const float ExitDepth = std::min(LeafExits[0], std::min(LeafExits[1], LeafExits[2]));
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                const float Minimum = static_cast<float>(LeafMinimum[Index]);
+                const float ExitPosition = RayOrigin[Index] + RayDirection[Index] * ExitDepth;
+                if (LeafExits[Index] <= std::min(LeafExits[(Index + 1) % 3], LeafExits[(Index + 2) % 3])) {
+                    RayPosition[Index] = (RayStep[Index] > 0.0f) ? (Minimum + static_cast<float>(LeafSide)) : (Minimum - 1.0f);
+                }
+                else {
+                    RayPosition[Index] = std::min(std::max(std::floor(ExitPosition), Minimum), Minimum + static_cast<float>(LeafSide - 1));
+                }
+                MaxTranslation[Index] = (((0.5f + RayPosition[Index]) + 0.5f * RayStep[Index]) - ExitPosition) / RayDirection[Index];
+            }
+
+            // Test within bounds.
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                if ((RayPosition[Index] >= VolumeSize[Index]) || (RayPosition[Index] < 0.0f)) {
+                    return Result;
+                }
+            }
+        }
+        return Result;
+    }
+
+    // Cast a batch of rays.
+    void SparseVoxelOctree::CastRay(const std::vector<CollisionMap::RayQuery>& Queries, std::vector<CollisionMap::RayHit>& Results) const {
+        RAYMARCH_TRACE_SCOPE("SparseVoxelOctree::CastRay");
+
+        Results.resize(Queries.size());
+        JobSystem::GetGlobal().ParallelFor(0, Queries.size(), QueryGrain, [this, &Queries, &Results](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Index = First; Index < Last; ++Index) {
+                Results[Index] = this->CastRay(Queries[Index]);
+            }
+        });
+    }
+
+    // Descend from the root, halving the cube until a leaf.
+    std::uint32_t SparseVoxelOctree::FindLeaf(const std::array<int, 3>& Position, std::array<int, 3>& Minimum, int& Side) const {
+        std::size_t Node = 0;
+        Minimum = {{0, 0, 0}};
+        Side = 1 << this->Depth;
+        for (;;) {
+            Side /= 2;
+            std::size_t Child = 0;
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                if (Position[Index] >= Minimum[Index] + Side) {
+                    Minimum[Index] += Side;
+                    Child |= std::size_t(1) << Index;
+                }
+            }
+            const std::uint32_t* Entry = &this->Nodes[Node * NodeWords + Child * ChildWords];
+            if (Entry[0] == 0) {
+                return Entry[1];
+            }
+            Node = Entry[0];
+        }
+    }
+}
@@ -0,0 +1,147 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_SPARSEVOXELOCTREE_HPP
+#define RAYMARCH_SPARSEVOXELOCTREE_HPP
+
+#include "CollisionMap.hpp"
+#include "PaletteVolume.hpp"
+#include "Volume.hpp"
+#include "Voxel.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  SparseVoxelOctree stores a volume as an octree whose uniform cubes are single leaves, serialised for a buffer texture.
+    /// @note   The octree spans the smallest power of two cube holding the volume. Each node is eight children of two words, the first
+    ///         is zero for a leaf or else the index of the child node, the second holds the voxel bits of a leaf. Children are ordered
+    ///         by X in the first bit, Y in the second and Z in the third. Invisible voxels are stored as empty voxels so runs of air
+    ///         collapse, and the cube beyond the volume is empty. The root is node zero and every node is stored before its children.
+    class SparseVoxelOctree {
+    public:
+        /// @brief  The number of words of each child.
+        constexpr static const std::size_t ChildWords = 2;
+
+        /// @brief  The number of words of each node.
+        constexpr static const std::size_t NodeWords = 8 * ChildWords;
+
+        /// @brief  The deepest octree, its cube has a side of 2^MaximumDepth voxels.
+        constexpr static const std::size_t MaximumDepth = 16;
+
+        /// @brief  The identifier at the start of a saved octree, "RSVO" in little endian.
+        constexpr static const std::uint32_t Magic = 0x4F565352;
+
+        /// @brief  The version of the saved octree format.
+        constexpr static const std::uint32_t Version = 1;
+
+        /// @brief  The number of bytes of the header of a saved octree, before the nodes.
+        constexpr static const std::size_t HeaderSize = 28;
+
+    private:
+        /// @brief  The size of the volume.
+        std::array<std::size_t, 3> Size;
+
+        /// @brief  The number of levels of nodes below the root cube.
+        std::size_t Depth;
+
+        /// @brief  The nodes, the root first.
+        std::vector<std::uint32_t> Nodes;
+
+    public:
+        /// @brief  Constructor that creates an empty octree.
+        SparseVoxelOctree(void);
+
+    public:
+        /// @brief  Get the size of the volume.
+        /// @return The size of the volume.
+        const std::array<std::size_t, 3>& GetSize(void) const;
+
+        /// @brief  Get the side of the cube the octree spans.
+        /// @return The number of voxels along each axis of the root cube.
+        std::size_t GetSide(void) const;
+
+        /// @brief  Get the number of nodes.
+        /// @return The number of nodes, including the root.
+        std::size_t GetNodeCount(void) const;
+
+        /// @brief  Get the serialised nodes.
+        /// @return A pointer to the first word of the root.
+        const std::uint32_t* data(void) const;
+
+        /// @brief  Get the size of the serialised nodes.
+        /// @return The number of bytes of the nodes.
+        std::size_t GetByteCount(void) const;
+
+        /// @brief  Get a voxel.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return The voxel, or an empty voxel when it is invisible.
+        Voxel Get(int X, int Y, int Z) const;
+
+    public:
+        /// @brief  Build the octree of a volume, the eight subtrees below the root are built in parallel.
+        /// @param  Source - The volume.
+        void Build(const Volume& Source);
+
+        /// @brief  Build the octree of a packed volume, as published to the renderer, the eight subtrees below the root are built in parallel.
+        /// @param  Source - The packed volume.
+        void Build(const PaletteVolume& Source);
+
+        /// @brief  Save the octree to a file, the header and every node word in little endian.
+        /// @param  Path - The path of the file.
+        /// @return False if the file could not be written.
+        bool Save(const std::string& Path) const;
+
+        /// @brief  Load an octree saved to a file.
+        /// @param  Path - The path of the file.
+        /// @return False if the file could not be read or is not a valid octree, the octree is then unchanged.
+        bool Load(const std::string& Path);
+
+        /// @brief  Cast a ray through the octree as the octree variant of the voxel shader does, skipping each empty leaf in one step.
+        /// @param  Query - The ray in the coordinates of the volume.
+        /// @return The first visible voxel hit, with the number of leaves visited.
+        CollisionMap::RayHit CastRay(const CollisionMap::RayQuery& Query) const;
+
+        /// @brief  Cast a batch of rays in parallel.
+        /// @param  Queries - The rays in the coordinates of the volume.
+        /// @param  Results - The hit of each ray.
+        void CastRay(const std::vector<CollisionMap::RayQuery>& Queries, std::vector<CollisionMap::RayHit>& Results) const;
+
+    private:
+        /// @brief  Find the leaf holding a voxel.
+        /// @param  Position - The voxel, it must be inside the root cube.
+        /// @param  Minimum - The minimum corner of the leaf cube.
+        /// @param  Side - The side of the leaf cube.
+        /// @return The voxel bits of the leaf.
+        std::uint32_t FindLeaf(const std::array<int, 3>& Position, std::array<int, 3>& Minimum, int& Side) const;
+    };
+}
+
+#endif // RAYMARCH_SPARSEVOXELOCTREE_HPP
@@ -0,0 +1,518 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "TerrainGenerator.hpp"
+#include "ChunkCodec.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define RAYMARCH_TERRAINGENERATOR_AVX2 1
+#endif
+
+namespace Raymarch {
+    // The hash reduces its argument by whole turns with two parts of two pi, the high part has few enough bits that multiples of it are exact.
+    constexpr static const double InverseTwoPi = 0.15915494309189533577;
+    constexpr static const double TwoPiHigh = 6.28318548202514648438;
+    constexpr static const double TwoPiLow = -1.74845553146951715e-07;
+
+    // Taylor coefficients of sine in the square of the reduced argument, accurate to about 1e-11 over a whole turn.
+    constexpr static const std::size_t SineTermCount = 11;
+    constexpr static const double SineTerms[SineTermCount] = {
+        +1.0,
+        -1.0 / 6.0,
+        +1.0 / 120.0,
+        -1.0 / 5040.0,
+        +1.0 / 362880.0,
+        -1.0 / 39916800.0,
+        +1.0 / 6227020800.0,
+        -1.0 / 1307674368000.0,
+        +1.0 / 355687428096000.0,
+        -1.0 / 121645100408832000.0,
+        +1.0 / 51090942171709440000.0
+    };
+
+    // The multiplier of the shader hash.
+    constexpr static const float HashScale = 43758.5453f;
+
+    // Sine evaluated the same way by both kernels, so they give the same noise.
+    static double Sine(double Value) {
+        const double Turns = std::nearbyint(Value * InverseTwoPi);
+        const double Reduced = (Value - Turns * TwoPiHigh) - Turns * TwoPiLow;
+        const double Square = Reduced * Reduced;
+        double Result = SineTerms[SineTermCount - 1];
+        for (std::size_t Term = SineTermCount - 1; Term > 0; --Term) {
+            Result = Result * Square + SineTerms[Term - 1];
+        }
+        return Result * Reduced;
+    }
+
+    // The shader hash, the product is formed in single precision as in the shader.
+    static float Hash(float Seed) {
+        const float Product = static_cast<float>(Sine(static_cast<double>(Seed))) * HashScale;
+        return Product - std::floor(Product);
+    }
+
+    // The shader mix.
+    static float Mix(float Left, float Right, float Amount) {
+        return Left * (1.0f - Amount) + Right * Amount;
+    }
+
+    // The bytes of the voxels of a chunk.
+    constexpr static const std::size_t ChunkBytes = static_cast<std::size_t>(World::ChunkSize) * World::ChunkSize * World::ChunkSize * sizeof(Voxel);
+
+    // The bytes a cache entry uses besides its chunk.
+    constexpr static const std::size_t EntryOverhead = 64;
+
+    // The bytes a cached chunk uses.
+    static std::size_t GetEntryBytes(const std::shared_ptr<const Volume>& Chunk) {
+        return EntryOverhead + (Chunk ? ChunkBytes : 0);
+    }
+
+    // Constructor that starts the workers.
+    TerrainGenerator::TerrainGenerator(std::uint32_t Seed, std::size_t MemoryBudget, std::size_t CompressedBudget, std::size_t WorkerCount)
+        : Seed(Seed)
+        , MemoryBudget(MemoryBudget)
+        , CachedBytes(0)
+        , CompressedBudget(CompressedBudget)
+        , CompressedBytes(0)
+        , CompressedChunks(0)
+        , Stopping(false) {
+        for (std::size_t Index = 0; Index < std::max<std::size_t>(WorkerCount, 1); ++Index) {
+            this->Workers.emplace_back(&TerrainGenerator::RunWorker, this);
+        }
+    }
+
+    // Destructor that stops the workers.
+    TerrainGenerator::~TerrainGenerator(void) {
+        {
+            std::lock_guard<std::mutex> Lock(this->Mutex);
+            this->Stopping = true;
+        }
+        this->Condition.notify_all();
+        for (std::thread& Worker : this->Workers) {
+            Worker.join();
+        }
+    }
+
+    // Noise at a single point.
+    float TerrainGenerator::Noise(float X, float Y, float Z) {
+        float Result;
+        NoiseScalar(&X, &Y, &Z, &Result, 1);
+        return Result;
+    }
+
+    // Noise at a span of points.
+    void TerrainGenerator::Noise(const float* X, const float* Y, const float* Z, float* Result, std::size_t Count) {
+        if (IsVectorised()) {
+            NoiseAVX2(X, Y, Z, Result, Count);
+        }
+        else {
+            NoiseScalar(X, Y, Z, Result, Count);
+        }
+    }
+
+    // The AVX2 kernel is used when the processor supports it.
+    bool TerrainGenerator::IsVectorised(void) {
+        #ifdef RAYMARCH_TERRAINGENERATOR_AVX2
+            static const bool Vectorised = __builtin_cpu_supports("avx2");
+            return Vectorised;
+        #else
+            return false;
+        #endif
+    }
+
+    // Get the seed.
+    std::uint32_t TerrainGenerator::GetSeed(void) const {
+        return this->Seed;
+    }
+
+    // Get the memory budget.
+    std::size_t TerrainGenerator::GetMemoryBudget(void) const {
+        return this->MemoryBudget;
+    }
+
+    // Get the cached bytes.
+    std::size_t TerrainGenerator::GetCachedBytes(void) const {
+        std::lock_guard<std::mutex> Lock(this->Mutex);
+        return this->CachedBytes;
+    }
+
+    // Get the cached chunk count.
+    std::size_t TerrainGenerator::GetCachedCount(void) const {
+        std::lock_guard<std::mutex> Lock(this->Mutex);
+        return this->Recent.size();
+    }
+
+    // Get the compressed bytes.
+    std::size_t TerrainGenerator::GetCompressedBytes(void) const {
+        std::lock_guard<std::mutex> Lock(this->Mutex);
+        return this->CompressedBytes;
+    }
+
+    // Get the compressed chunk count.
+    std::size_t TerrainGenerator::GetCompressedCount(void) const {
+        std::lock_guard<std::mutex> Lock(this->Mutex);
+        return this->CompressedRecent.size();
+    }
+
+    // Get the compression ratio of the chunks holding voxels, empty chunks store nothing and would inflate it.
+    double TerrainGenerator::GetCompressionRatio(void) const {
+        std::lock_guard<std::mutex> Lock(this->Mutex);
+        const std::size_t EmptyBytes = (this->CompressedRecent.size() - this->CompressedChunks) * EntryOverhead;
+        const std::size_t Bytes = this->CompressedBytes - EmptyBytes;
+        return (Bytes == 0) ? 0.0 : static_cast<double>(this->CompressedChunks * ChunkBytes) / static_cast<double>(Bytes);
+    }
+
+    // Get the pending chunk count.
+    std::size_t TerrainGenerator::GetPendingCount(void) const {
+        std::lock_guard<std::mutex> Lock(this->Mutex);
+        return this->Requests.size() + this->Generating.size();
+    }
+
+    // Generate a chunk: flat ground with low hills, and caves through the hills.
+    std::shared_ptr<const Volume> TerrainGenerator::Generate(const std::array<int, 3>& Key) const {
+        RAYMARCH_TRACE_SCOPE("TerrainGenerator::Generate");
+
+        constexpr static const int Size = World::ChunkSize;
+        const Region Bounds = World::GetChunkRegion(Key);
+        if ((Bounds.Maximum[1] <= 0) || (Bounds.Minimum[1] >= HillHeight)) {
+            return nullptr;
+        }
+
+        // The seed moves the terrain through the noise, the offsets are kept small as the hash loses precision for large arguments.
+        const float SeedX = static_cast<float>(this->Seed % 997u) * 7.0f;
+        const float SeedY = static_cast<float>((this->Seed / 997u) % 991u) * 7.0f;
+        const float SeedZ = static_cast<float>((this->Seed / 997u / 991u) % 983u) * 7.0f;
+
+        // The height of every column, the ground varies slowly and hills rise where the broader noise is high.
+        std::vector<float> X(Size * Size * 2);
+        std::vector<float> Y(Size * Size * 2);
+        std::vector<float> Z(Size * Size * 2);
+        std::vector<float> Values(Size * Size * 2);
+        for (int IndexZ = 0; IndexZ < Size; ++IndexZ) {
+            for (int IndexX = 0; IndexX < Size; ++IndexX) {
+                const std::size_t Column = static_cast<std::size_t>(IndexZ * Size + IndexX);
+                const float WorldX = static_cast<float>(Bounds.Minimum[0] + IndexX) + 0.5f;
+                const float WorldZ = static_cast<float>(Bounds.Minimum[2] + IndexZ) + 0.5f;
+                X[Column] = WorldX / 16.0f + SeedX;
+                Y[Column] = SeedY;
+                Z[Column] = WorldZ / 16.0f + SeedZ;
+                X[Size * Size + Column] = WorldX / 48.0f + SeedX;
+                Y[Size * Size + Column] = SeedY + 7.0f;
+                Z[Size * Size + Column] = WorldZ / 48.0f + SeedZ;
+            }
+        }
+        Noise(X.data(), Y.data(), Z.data(), Values.data(), Values.size());
+
+        std::vector<int> Heights(Size * Size);
+        int HighestColumn = 0;
+        for (std::size_t Column = 0; Column < Heights.size(); ++Column) {
+            int Height = GroundHeight - 2 + std::min(static_cast<int>(Values[Column] * 3.0f), 2);
+            const float Hill = Values[Size * Size + Column];
+            if (Hill > 0.6f) {
+                Height = std::max(Height, GroundHeight + static_cast<int>((Hill - 0.6f) / 0.4f * static_cast<float>(HillHeight - GroundHeight)));
+            }
+            Heights[Column] = std::min(Height, HillHeight);
+            HighestColumn = std::max(HighestColumn, Heights[Column]);
+        }
+
+        // Caves are carved through the hills above the ground, the noise is evaluated for every voxel of the chunk that hills can reach.
+        const int CaveMinimum = std::max(Bounds.Minimum[1], GroundHeight);
+        const int CaveMaximum = std::min(Bounds.Maximum[1], HighestColumn);
+        const int CaveLayers = std::max(CaveMaximum - CaveMinimum, 0);
+        std::vector<float> Caves(static_cast<std::size_t>(CaveLayers) * Size * Size);
+        if (CaveLayers > 0) {
+            X.resize(Caves.size());
+            Y.resize(Caves.size());
+            Z.resize(Caves.size());
+            std::size_t Index = 0;
+            for (int IndexZ = 0; IndexZ < Size; ++IndexZ) {
+                for (int Layer = 0; Layer < CaveLayers; ++Layer) {
+                    for (int IndexX = 0; IndexX < Size; ++IndexX) {
+                        X[Index] = static_cast<float>(Bounds.Minimum[0] + IndexX) / 10.0f + SeedX;
+                        Y[Index] = static_cast<float>(CaveMinimum + Layer) / 10.0f + SeedY;
+                        Z[Index] = static_cast<float>(Bounds.Minimum[2] + IndexZ) / 10.0f + SeedZ;
+                        ++Index;
+                    }
+                }
+            }
+            Noise(X.data(), Y.data(), Z.data(), Caves.data(), Caves.size());
+        }
+
+        // Fill the columns, grass on the ground, snow on the high hills, dirt under the surface and stone below it.
+        const Voxel Grass = Voxel(60, 170, 50, 255);
+        const Voxel Snow = Voxel(235, 235, 235, 255);
+        const Voxel Dirt = Voxel(130, 95, 60, 255);
+        const Voxel Stone = Voxel(120, 120, 120, 255);
+        std::shared_ptr<Volume> Result = std::make_shared<Volume>(Size, Size, Size);
+        bool Empty = true;
+        for (int IndexZ = 0; IndexZ < Size; ++IndexZ) {
+            for (int IndexX = 0; IndexX < Size; ++IndexX) {
+                const int Height = Heights[static_cast<std::size_t>(IndexZ * Size + IndexX)];
+                const int Top = std::min(Height, Bounds.Maximum[1]);
+                for (int WorldY = std::max(Bounds.Minimum[1], 0); WorldY < Top; ++WorldY) {
+                    if ((WorldY >= CaveMinimum) && (WorldY < Height - 1)) {
+                        const std::size_t Index = (static_cast<std::size_t>(IndexZ) * static_cast<std::size_t>(CaveLayers) + static_cast<std::size_t>(WorldY - CaveMinimum)) * Size + static_cast<std::size_t>(IndexX);
+                        if (Caves[Index] > 0.72f) {
+                            continue;
+                        }
+                    }
+                    const int Depth = Height - 1 - WorldY;
+                    Voxel Value = Stone;
+                    if (Depth == 0) {
+                        Value = (Height > GroundHeight + 12) ? Snow : Grass;
+                    }
+                    else if (Depth < 3) {
+                        Value = Dirt;
+                    }
+                    (*Result)(static_cast<std::size_t>(IndexX), static_cast<std::size_t>(WorldY - Bounds.Minimum[1]), static_cast<std::size_t>(IndexZ)) = Value;
+                    Empty = false;
+                }
+            }
+        }
+        if (Empty) {
+            return nullptr;
+        }
+        return Result;
+    }
+
+    // Replace the waiting requests.
+    void TerrainGenerator::Request(const std::vector<std::array<int, 3> >& Keys) {
+        {
+            std::lock_guard<std::mutex> Lock(this->Mutex);
+            this->Requests.clear();
+            for (const std::array<int, 3>& Key : Keys) {
+                if ((this->Cached.count(Key) == 0) && (this->Generating.count(Key) == 0)) {
+                    this->Requests.push_back(Key);
+                }
+            }
+        }
+        this->Condition.notify_all();
+    }
+
+    // Get a cached chunk.
+    bool TerrainGenerator::Acquire(const std::array<int, 3>& Key, std::shared_ptr<const Volume>& Chunk) {
+        std::lock_guard<std::mutex> Lock(this->Mutex);
+        const std::unordered_map<std::array<int, 3>, std::list<CacheEntry>::iterator, World::ChunkKeyHash>::iterator Found = this->Cached.find(Key);
+        if (Found == this->Cached.end()) {
+            return false;
+        }
+        this->Recent.splice(this->Recent.begin(), this->Recent, Found->second);
+        Chunk = Found->second->Chunk;
+        return true;
+    }
+
+    // Noise one point at a time.
+    void TerrainGenerator::NoiseScalar(const float* X, const float* Y, const float* Z, float* Result, std::size_t Count) {
+        for (std::size_t Index = 0; Index < Count; ++Index) {
+            const float FloorX = std::floor(X[Index]);
+            const float FloorY = std::floor(Y[Index]);
+            const float FloorZ = std::floor(Z[Index]);
+            float FractX = X[Index] - FloorX;
+            float FractY = Y[Index] - FloorY;
+            float FractZ = Z[Index] - FloorZ;
+            FractX = FractX * FractX * (3.0f - 2.0f * FractX);
+            FractY = FractY * FractY * (3.0f - 2.0f * FractY);
+            FractZ = FractZ * FractZ * (3.0f - 2.0f * FractZ);
+
+            const float BaseSeed = FloorX + FloorY * 57.0f + 113.0f * FloorZ;
+
+            Result[Index] = Mix(Mix(Mix(Hash(BaseSeed + 0.0f), Hash(BaseSeed + 1.0f), FractX),
+                                    Mix(Hash(BaseSeed + 57.0f), Hash(BaseSeed + 58.0f), FractX), FractY),
+                                Mix(Mix(Hash(BaseSeed + 113.0f), Hash(BaseSeed + 114.0f), FractX),
+                                    Mix(Hash(BaseSeed + 170.0f), Hash(BaseSeed + 171.0f), FractX), FractY), FractZ);
+        }
+    }
+
+    #ifdef RAYMARCH_TERRAINGENERATOR_AVX2
+        // Sine of four arguments, the same steps as the scalar sine.
+        __attribute__((target("avx2")))
+        static __m256d SineAVX2(__m256d Value) {
+            const __m256d Turns = _mm256_round_pd(_mm256_mul_pd(Value, _mm256_set1_pd(InverseTwoPi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            const __m256d Reduced = _mm256_sub_pd(_mm256_sub_pd(Value, _mm256_mul_pd(Turns, _mm256_set1_pd(TwoPiHigh))), _mm256_mul_pd(Turns, _mm256_set1_pd(TwoPiLow)));
+            const __m256d Square = _mm256_mul_pd(Reduced, Reduced);
+            __m256d Result = _mm256_set1_pd(SineTerms[SineTermCount - 1]);
+            for (std::size_t Term = SineTermCount - 1; Term > 0; --Term) {
+                Result = _mm256_add_pd(_mm256_mul_pd(Result, Square), _mm256_set1_pd(SineTerms[Term - 1]));
+            }
+            return _mm256_mul_pd(Result, Reduced);
+        }
+
+        // Hash of eight seeds, the sines are taken in double precision four at a time.
+        __attribute__((target("avx2")))
+        static __m256 HashAVX2(__m256 Seed) {
+            const __m128 Low = _mm256_cvtpd_ps(SineAVX2(_mm256_cvtps_pd(_mm256_castps256_ps128(Seed))));
+            const __m128 High = _mm256_cvtpd_ps(SineAVX2(_mm256_cvtps_pd(_mm256_extractf128_ps(Seed, 1))));
+            const __m256 Product = _mm256_mul_ps(_mm256_insertf128_ps(_mm256_castps128_ps256(Low), High, 1), _mm256_set1_ps(HashScale));
+            return _mm256_sub_ps(Product, _mm256_floor_ps(Product));
+        }
+
+        // Hash of the corner of eight cells at an offset from their base seeds.
+        __attribute__((target("avx2")))
+        static __m256 CornerAVX2(__m256 BaseSeed, float Offset) {
+            return HashAVX2(_mm256_add_ps(BaseSeed, _mm256_set1_ps(Offset)));
+        }
+
+        // Mix of eight pairs.
+        __attribute__((target("avx2")))
+        static __m256 MixAVX2(__m256 Left, __m256 Right, __m256 Amount) {
+            return _mm256_add_ps(_mm256_mul_ps(Left, _mm256_sub_ps(_mm256_set1_ps(1.0f), Amount)), _mm256_mul_ps(Right, Amount));
+        }
+
+        // Noise eight points at a time, the remaining points are evaluated one at a time.
+        __attribute__((target("avx2")))
+        void TerrainGenerator::NoiseAVX2(const float* X, const float* Y, const float* Z, float* Result, std::size_t Count) {
+            const __m256 Three = _mm256_set1_ps(3.0f);
+            const __m256 Two = _mm256_set1_ps(2.0f);
+
+            std::size_t Index = 0;
+            for (; Index + 8 <= Count; Index += 8) {
+                const __m256 SeedX = _mm256_loadu_ps(X + Index);
+                const __m256 SeedY = _mm256_loadu_ps(Y + Index);
+                const __m256 SeedZ = _mm256_loadu_ps(Z + Index);
+                const __m256 FloorX = _mm256_floor_ps(SeedX);
+                const __m256 FloorY = _mm256_floor_ps(SeedY);
+                const __m256 FloorZ = _mm256_floor_ps(SeedZ);
+                __m256 FractX = _mm256_sub_ps(SeedX, FloorX);
+                __m256 FractY = _mm256_sub_ps(SeedY, FloorY);
+                __m256 FractZ = _mm256_sub_ps(SeedZ, FloorZ);
+                FractX = _mm256_mul_ps(_mm256_mul_ps(FractX, FractX), _mm256_sub_ps(Three, _mm256_mul_ps(Two, FractX)));
+                FractY = _mm256_mul_ps(_mm256_mul_ps(FractY, FractY), _mm256_sub_ps(Three, _mm256_mul_ps(Two, FractY)));
+                FractZ = _mm256_mul_ps(_mm256_mul_ps(FractZ, FractZ), _mm256_sub_ps(Three, _mm256_mul_ps(Two, FractZ)));
+
+                const __m256 BaseSeed = _mm256_add_ps(_mm256_add_ps(FloorX, _mm256_mul_ps(FloorY, _mm256_set1_ps(57.0f))), _mm256_mul_ps(_mm256_set1_ps(113.0f), FloorZ));
+                const __m256 Near = MixAVX2(MixAVX2(CornerAVX2(BaseSeed, 0.0f), CornerAVX2(BaseSeed, 1.0f), FractX), MixAVX2(CornerAVX2(BaseSeed, 57.0f), CornerAVX2(BaseSeed, 58.0f), FractX), FractY);
+                const __m256 Far = MixAVX2(MixAVX2(CornerAVX2(BaseSeed, 113.0f), CornerAVX2(BaseSeed, 114.0f), FractX), MixAVX2(CornerAVX2(BaseSeed, 170.0f), CornerAVX2(BaseSeed, 171.0f), FractX), FractY);
+                _mm256_storeu_ps(Result + Index, MixAVX2(Near, Far, FractZ));
+            }
+            NoiseScalar(X + Index, Y + Index, Z + Index, Result + Index, Count - Index);
+        }
+    #else
+        // Without AVX2 every point is evaluated one at a time.
+        void TerrainGenerator::NoiseAVX2(const float* X, const float* Y, const float* Z, float* Result, std::size_t Count) {
+            NoiseScalar(X, Y, Z, Result, Count);
+        }
+    #endif
+
+    // Cache a chunk.
+    void TerrainGenerator::Insert(const std::array<int, 3>& Key, const std::shared_ptr<const Volume>& Chunk, std::vector<CacheEntry>& Evicted) {
+        this->Recent.push_front({Key, Chunk});
+        this->Cached[Key] = this->Recent.begin();
+        this->CachedBytes += GetEntryBytes(Chunk);
+        while ((this->CachedBytes > this->MemoryBudget) && (this->Recent.size() > 1)) {
+            this->CachedBytes -= GetEntryBytes(this->Recent.back().Chunk);
+            this->Cached.erase(this->Recent.back().Key);
+            this->Generating.insert(this->Recent.back().Key);
+            Evicted.push_back(std::move(this->Recent.back()));
+            this->Recent.pop_back();
+        }
+    }
+
+    // Generate or decompress requested chunks until stopped.
+    void TerrainGenerator::RunWorker(void) {
+        Trace::SetThreadName("Terrain");
+
+        while (true) {
+            std::array<int, 3> Key;
+            CompressedEntry Packed;
+            bool Unpack = false;
+            {
+                std::unique_lock<std::mutex> Lock(this->Mutex);
+                this->Condition.wait(Lock, [this]() -> bool { return this->Stopping || !this->Requests.empty(); });
+                if (this->Stopping) {
+                    return;
+                }
+                Key = this->Requests.front();
+                this->Requests.pop_front();
+                if ((this->Cached.count(Key) != 0) || (this->Generating.count(Key) != 0)) {
+                    continue;
+                }
+                this->Generating.insert(Key);
+
+                // A chunk in the compressed tier leaves it to be decompressed.
+                const std::unordered_map<std::array<int, 3>, std::list<CompressedEntry>::iterator, World::ChunkKeyHash>::iterator Found = this->Compressed.find(Key);
+                if (Found != this->Compressed.end()) {
+                    Packed = std::move(*Found->second);
+                    this->CompressedBytes -= EntryOverhead + Packed.Data.size();
+                    this->CompressedChunks -= Packed.Data.empty() ? 0 : 1;
+                    this->CompressedRecent.erase(Found->second);
+                    this->Compressed.erase(Found);
+                    Unpack = true;
+                }
+            }
+
+            // Generation and decompression run without the lock so requests and acquires never wait for them.
+            std::shared_ptr<const Volume> Chunk;
+            if (Unpack && Packed.Data.empty()) {
+                Chunk = nullptr;
+            }
+            else if (Unpack) {
+                std::shared_ptr<Volume> Unpacked = std::make_shared<Volume>();
+                constexpr static const std::size_t Size = static_cast<std::size_t>(World::ChunkSize);
+                Chunk = ChunkCodec::Decompress(Packed.Data.data(), Packed.Data.size(), {{Size, Size, Size}}, *Unpacked) ? Unpacked : this->Generate(Key);
+            }
+            else {
+                Chunk = this->Generate(Key);
+            }
+
+            // Cache the chunk, the chunks it evicts stay marked as being generated while they are compressed.
+            std::vector<CacheEntry> Evicted;
+            {
+                std::lock_guard<std::mutex> Lock(this->Mutex);
+                this->Generating.erase(Key);
+                this->Insert(Key, Chunk, Evicted);
+            }
+            if (Evicted.empty()) {
+                continue;
+            }
+
+            // Compress the evicted chunks into the second tier, dropping the least recently compressed chunks over its budget.
+            std::vector<CompressedEntry> Compressions(Evicted.size());
+            for (std::size_t Index = 0; Index < Evicted.size(); ++Index) {
+                Compressions[Index].Key = Evicted[Index].Key;
+                if (Evicted[Index].Chunk) {
+                    ChunkCodec::Compress(*Evicted[Index].Chunk, Compressions[Index].Data);
+                }
+            }
+            std::lock_guard<std::mutex> Lock(this->Mutex);
+            for (CompressedEntry& Compression : Compressions) {
+                this->Generating.erase(Compression.Key);
+                this->CompressedBytes += EntryOverhead + Compression.Data.size();
+                this->CompressedChunks += Compression.Data.empty() ? 0 : 1;
+                this->CompressedRecent.push_front(std::move(Compression));
+                this->Compressed[this->CompressedRecent.front().Key] = this->CompressedRecent.begin();
+            }
+            while ((this->CompressedBytes > this->CompressedBudget) && !this->CompressedRecent.empty()) {
+                this->CompressedBytes -= EntryOverhead + this->CompressedRecent.back().Data.size();
+                this->CompressedChunks -= this->CompressedRecent.back().Data.empty() ? 0 : 1;
+                this->Compressed.erase(this->CompressedRecent.back().Key);
+                this->CompressedRecent.pop_back();
+            }
+        }
+    }
+}
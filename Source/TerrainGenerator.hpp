@@ -0,0 +1,241 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_TERRAINGENERATOR_HPP
+#define RAYMARCH_TERRAINGENERATOR_HPP
+
+#include "Volume.hpp"
+#include "World.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  TerrainGenerator generates an endless procedural terrain as world chunks on its own background threads.
+    /// @note   Chunks are generated from a seed with the value noise of the voxel shader and kept in a cache limited by memory,
+    ///         the least recently used chunks are evicted first. Evicted chunks are compressed into a second, much denser tier with
+    ///         its own budget, a requested chunk found there is decompressed by a worker instead of being generated again.
+    ///         Requesting and acquiring chunks never waits for generation or decompression.
+    class TerrainGenerator {
+    public:
+        /// @brief  The height of the flat ground, the player walks on top of it.
+        constexpr static const int GroundHeight = 4;
+
+        /// @brief  The highest voxel a hill can reach.
+        constexpr static const int HillHeight = 28;
+
+    private:
+        /// @brief  A generated chunk in the cache.
+        struct CacheEntry {
+            /// @brief  The chunk coordinate.
+            std::array<int, 3> Key;
+
+            /// @brief  The generated chunk, null when the chunk is empty.
+            std::shared_ptr<const Volume> Chunk;
+        };
+
+        /// @brief  A compressed chunk in the second tier.
+        struct CompressedEntry {
+            /// @brief  The chunk coordinate.
+            std::array<int, 3> Key;
+
+            /// @brief  The chunk compressed with the chunk codec, empty when the chunk is empty.
+            std::vector<std::uint8_t> Data;
+        };
+
+    private:
+        /// @brief  The seed of the terrain.
+        std::uint32_t Seed;
+
+        /// @brief  The largest number of bytes the cached chunks may use.
+        std::size_t MemoryBudget;
+
+        /// @brief  Guards the requests and the cache.
+        mutable std::mutex Mutex;
+
+        /// @brief  Signals new requests and stopping to the workers.
+        std::condition_variable Condition;
+
+        /// @brief  The chunks waiting to be generated, the front is generated first.
+        std::deque<std::array<int, 3> > Requests;
+
+        /// @brief  The chunks being generated.
+        std::unordered_set<std::array<int, 3>, World::ChunkKeyHash> Generating;
+
+        /// @brief  The cached chunks, the most recently used first.
+        std::list<CacheEntry> Recent;
+
+        /// @brief  The cached chunks by chunk coordinate.
+        std::unordered_map<std::array<int, 3>, std::list<CacheEntry>::iterator, World::ChunkKeyHash> Cached;
+
+        /// @brief  The number of bytes the cached chunks use.
+        std::size_t CachedBytes;
+
+        /// @brief  The largest number of bytes the compressed chunks may use.
+        std::size_t CompressedBudget;
+
+        /// @brief  The compressed chunks, the most recently compressed first.
+        std::list<CompressedEntry> CompressedRecent;
+
+        /// @brief  The compressed chunks by chunk coordinate.
+        std::unordered_map<std::array<int, 3>, std::list<CompressedEntry>::iterator, World::ChunkKeyHash> Compressed;
+
+        /// @brief  The number of bytes the compressed chunks use.
+        std::size_t CompressedBytes;
+
+        /// @brief  The number of chunks in the compressed tier that hold voxels, used for the compression ratio.
+        std::size_t CompressedChunks;
+
+        /// @brief  Set when the workers should exit.
+        bool Stopping;
+
+        /// @brief  The worker threads generating chunks.
+        std::vector<std::thread> Workers;
+
+    public:
+        /// @brief  Constructor that starts the workers.
+        /// @param  Seed - The seed of the terrain.
+        /// @param  MemoryBudget - The largest number of bytes the cached chunks may use.
+        /// @param  CompressedBudget - The largest number of bytes the compressed chunks may use.
+        /// @param  WorkerCount - The number of worker threads, at least one is started.
+        TerrainGenerator(std::uint32_t Seed, std::size_t MemoryBudget, std::size_t CompressedBudget, std::size_t WorkerCount);
+
+        /// @brief  Destructor that stops and joins the workers, chunks being generated are finished first.
+        ~TerrainGenerator(void);
+
+        /// @brief  Deleted copy constructor.
+        TerrainGenerator(const TerrainGenerator&) = delete;
+
+        /// @brief  Deleted copy assignment.
+        TerrainGenerator& operator=(const TerrainGenerator&) = delete;
+
+    public:
+        /// @brief  The value noise of the voxel shader.
+        /// @param  X - The X coordinate.
+        /// @param  Y - The Y coordinate.
+        /// @param  Z - The Z coordinate.
+        /// @return The noise, in the range 0 to 1.
+        static float Noise(float X, float Y, float Z);
+
+        /// @brief  The value noise of the voxel shader for a span of points, eight at a time with AVX2 when the processor supports it.
+        /// @param  X - The X coordinates.
+        /// @param  Y - The Y coordinates.
+        /// @param  Z - The Z coordinates.
+        /// @param  Result - Receives the noise of each point.
+        /// @param  Count - The number of points.
+        static void Noise(const float* X, const float* Y, const float* Z, float* Result, std::size_t Count);
+
+        /// @brief  Test if the vectorised noise kernel is used on this processor.
+        /// @return True if the noise is evaluated with AVX2.
+        static bool IsVectorised(void);
+
+    public:
+        /// @brief  Get the seed of the terrain.
+        /// @return The seed.
+        std::uint32_t GetSeed(void) const;
+
+        /// @brief  Get the largest number of bytes the cached chunks may use.
+        /// @return The memory budget.
+        std::size_t GetMemoryBudget(void) const;
+
+        /// @brief  Get the number of bytes the cached chunks use.
+        /// @return The cached bytes.
+        std::size_t GetCachedBytes(void) const;
+
+        /// @brief  Get the number of cached chunks, including empty chunks.
+        /// @return The cached chunk count.
+        std::size_t GetCachedCount(void) const;
+
+        /// @brief  Get the number of bytes the compressed chunks use.
+        /// @return The compressed bytes.
+        std::size_t GetCompressedBytes(void) const;
+
+        /// @brief  Get the number of compressed chunks, including empty chunks.
+        /// @return The compressed chunk count.
+        std::size_t GetCompressedCount(void) const;
+
+        /// @brief  Get how many times smaller the compressed chunks holding voxels are than their voxels.
+        /// @return The compression ratio, zero when no such chunk is compressed.
+        double GetCompressionRatio(void) const;
+
+        /// @brief  Get the number of chunks waiting to be generated or being generated.
+        /// @return The pending chunk count.
+        std::size_t GetPendingCount(void) const;
+
+        /// @brief  Generate a chunk on the calling thread, bypassing the cache.
+        /// @param  Key - The chunk coordinate.
+        /// @return The generated chunk, null when the chunk is empty.
+        std::shared_ptr<const Volume> Generate(const std::array<int, 3>& Key) const;
+
+        /// @brief  Replace the chunks waiting to be generated.
+        /// @param  Keys - The chunks to generate or decompress, most important first, cached chunks and chunks being generated are skipped.
+        void Request(const std::vector<std::array<int, 3> >& Keys);
+
+        /// @brief  Get a chunk from the cache, marking it as recently used.
+        /// @param  Key - The chunk coordinate.
+        /// @param  Chunk - Receives the generated chunk, null when the chunk is empty.
+        /// @return False if the chunk has not been generated.
+        bool Acquire(const std::array<int, 3>& Key, std::shared_ptr<const Volume>& Chunk);
+
+    private:
+        /// @brief  The value noise of the voxel shader for a span of points, one at a time.
+        /// @param  X - The X coordinates.
+        /// @param  Y - The Y coordinates.
+        /// @param  Z - The Z coordinates.
+        /// @param  Result - Receives the noise of each point.
+        /// @param  Count - The number of points.
+        static void NoiseScalar(const float* X, const float* Y, const float* Z, float* Result, std::size_t Count);
+
+        /// @brief  The value noise of the voxel shader for a span of points, eight at a time with AVX2.
+        /// @param  X - The X coordinates.
+        /// @param  Y - The Y coordinates.
+        /// @param  Z - The Z coordinates.
+        /// @param  Result - Receives the noise of each point.
+        /// @param  Count - The number of points.
+        static void NoiseAVX2(const float* X, const float* Y, const float* Z, float* Result, std::size_t Count);
+
+        /// @brief  Cache a chunk, evicting the least recently used chunks over the budget.
+        /// @param  Key - The chunk coordinate.
+        /// @param  Chunk - The chunk, null when it is empty.
+        /// @param  Evicted - Receives the evicted chunks, which are marked as being generated until they are compressed.
+        /// @note   The mutex must be held.
+        void Insert(const std::array<int, 3>& Key, const std::shared_ptr<const Volume>& Chunk, std::vector<CacheEntry>& Evicted);
+
+        /// @brief  The worker thread loop.
+        void RunWorker(void);
+    };
+}
+
+#endif // RAYMARCH_TERRAINGENERATOR_HPP
@@ -0,0 +1,167 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "TileRenderer.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Raymarch {
+    // Normalise a vector.
+    static std::array<float, 3> Normalise(const std::array<float, 3>& Vector) {
+        const float Length = std::sqrt(Vector[0] * Vector[0] + Vector[1] * Vector[1] + Vector[2] * Vector[2]);
+        return {{Vector[0] / Length, Vector[1] / Length, Vector[2] / Length}};
+    }
+
+    // The cross product of two vectors.
+    static std::array<float, 3> Cross(const std::array<float, 3>& Left, const std::array<float, 3>& Right) {
+        return {{Left[1] * Right[2] - Left[2] * Right[1], Left[2] * Right[0] - Left[0] * Right[2], Left[0] * Right[1] - Left[1] * Right[0]}};
+    }
+
+    // Copy the camera, the camera and light of the game state are already in the coordinates of the scene.
+    TileRenderer::Camera TileRenderer::GetCamera(const GameState& State, const std::array<std::size_t, 2>& ImageSize) {
+        return {ImageSize, State.GetCameraPosition(), State.GetCameraTarget(), State.GetNearClip(), State.GetFieldOfView(), State.GetFogDistance(), State.GetFogColour(), State.GetLightPosition()};
+    }
+
+    // Render each row of the tile as a job.
+    void TileRenderer::Render(const SparseVoxelOctree& Octree, const Camera& View, const Tile& Target, std::vector<std::uint8_t>& Pixels) {
+        RAYMARCH_TRACE_SCOPE("TileRenderer::Render");
+
+        Pixels.resize(Target.Size[0] * Target.Size[1] * 4);
+        JobSystem::GetGlobal().ParallelFor(0, Target.Size[1], 1, [&Octree, &View, &Target, &Pixels](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Row = First; Row < Last; ++Row) {
+                for (std::size_t Column = 0; Column < Target.Size[0]; ++Column) {
+                    const std::array<float, 3> Colour = Shade(Octree, View, Target.Position[0] + Column, Target.Position[1] + Row);
+                    std::uint8_t* Pixel = &Pixels[(Row * Target.Size[0] + Column) * 4];
+                    for (std::size_t Channel = 0; Channel < 3; ++Channel) {
+                        Pixel[Channel] = static_cast<std::uint8_t>(std::round(std::min(1.0f, std::max(0.0f, Colour[Channel])) * 255.0f));
+                    }
+                    Pixel[3] = 255;
+                }
+            }
+        });
+    }
+
+    // Decode the fields of a voxel into a colour, the same as the voxel shader.
+    std::array<float, 4> TileRenderer::DecodeVoxel(Voxel Value) {
+        const float Saturation = static_cast<float>(Value.GetSaturation()) / 3.0f;
+        const float Alpha = static_cast<float>(Value.GetAlpha()) / 7.0f;
+        const std::uint8_t TintValue = Value.GetTint();
+        const std::uint8_t HueValue = Value.GetHue();
+        const float Light = static_cast<float>(Value.GetLight()) / 15.0f;
+
+        std::array<float, 3> Colour;
+        if (HueValue < 4) {
+            Colour = {{static_cast<float>(HueValue) / 3.0f * Light, static_cast<float>(HueValue) / 3.0f * Light, static_cast<float>(HueValue) / 3.0f * Light}};
+        }
+        else {
+            const float Hue = static_cast<float>(HueValue - 4) / 11.0f;
+            const std::array<float, 3> Offsets = {{0.0f, 4.0f, 2.0f}};
+            for (std::size_t Channel = 0; Channel < 3; ++Channel) {
+                const float RGB = std::min(1.0f, std::max(0.0f, std::abs(std::fmod(Hue * 6.0f + Offsets[Channel], 6.0f) - 3.0f) - 1.0f));
+                Colour[Channel] = Light + Saturation * (RGB - 0.5f) * (1.0f - std::abs(2.0f * Light - 1.0f));
+            }
+        }
+
+        // Tint the colour towards the colour of nearby light sources.
+        if (TintValue != 0) {
+            for (std::size_t Channel = 0; Channel < 3; ++Channel) {
+                const float Tint = static_cast<float>((TintValue >> (2 - Channel)) & 0x1);
+                Colour[Channel] = 0.5f * (Colour[Channel] + Tint * Light);
+            }
+        }
+
+        return {{Colour[0], Colour[1], Colour[2], Alpha}};
+    }
+
+    // Cast the ray through a pixel, blending each translucent voxel it hits and continuing from where it leaves the voxel.
+    std::array<float, 3> TileRenderer::Shade(const SparseVoxelOctree& Octree, const Camera& View, std::size_t X, std::size_t Y) {
+        // Calculate direction vectors from camera and target.
+        const std::array<float, 3> ForwardVector = Normalise({{View.Target[0] - View.Position[0], View.Target[1] - View.Position[1], View.Target[2] - View.Position[2]}});
+        const std::array<float, 3> RightVector = Normalise(Cross({{0.0f, 1.0f, 0.0f}}, ForwardVector));
+        const std::array<float, 3> UpVector = Normalise(Cross(ForwardVector, RightVector));
+
+        // The position of the pixel centre on the viewport.
+        const std::array<float, 2> ViewportPosition = {{(static_cast<float>(X) + 0.5f) / static_cast<float>(View.ImageSize[0]), (static_cast<float>(Y) + 0.5f) / static_cast<float>(View.ImageSize[1])}};
+        const float ViewportWidth = 2.0f * View.NearClip * std::tan(View.FieldOfView * 0.5f * static_cast<float>(M_PI) / 180.0f);
+        const std::array<float, 2> ViewportSize = {{ViewportWidth, ViewportWidth * static_cast<float>(View.ImageSize[1]) / static_cast<float>(View.ImageSize[0])}};
+
+        // The point on the viewport, from the lower left point of the viewport, and the direction from the camera through it.
+        CollisionMap::RayQuery Query;
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            const float ViewportOrigin = (View.Position[Index] + (ForwardVector[Index] * View.NearClip)) - (0.5f * ViewportSize[0] * RightVector[Index]) - (0.5f * ViewportSize[1] * UpVector[Index]);
+            Query.Origin[Index] = ViewportOrigin + (ViewportPosition[0] * ViewportSize[0] * RightVector[Index]) + (ViewportPosition[1] * ViewportSize[1] * UpVector[Index]);
+            Query.Direction[Index] = Query.Origin[Index] - View.Position[Index];
+        }
+        const std::array<float, 3> Direction = Normalise(Query.Direction);
+
+        // Initially the colour is the fog colour, voxels are blended over it front to back.
+        std::array<float, 3> Colour = View.FogColour;
+        float Alpha = 0.0f;
+        for (int Layer = 0; (Layer < MaximumLayers) && (Alpha < 1.0f); ++Layer) {
+            const CollisionMap::RayHit Hit = Octree.CastRay(Query);
+            if (!Hit.Hit) {
+                break;
+            }
+            const Voxel Value = Octree.Get(Hit.Voxel[0], Hit.Voxel[1], Hit.Voxel[2]);
+            const std::array<float, 4> VoxelColour = DecodeVoxel(Value);
+
+            // Point lighting, and local lighting from propagated light above the ambient level, emitters are fully lit.
+            const std::array<float, 3> LightDirection = Normalise({{View.LightPosition[0] - Hit.Position[0], View.LightPosition[1] - Hit.Position[1], View.LightPosition[2] - Hit.Position[2]}});
+            float PointLight = std::min(1.0f, std::max(0.0f, static_cast<float>(Hit.Normal[0]) * LightDirection[0] + static_cast<float>(Hit.Normal[1]) * LightDirection[1] + static_cast<float>(Hit.Normal[2]) * LightDirection[2]));
+            const float LocalLight = (Value.GetState() == Voxel::StateType::Plasma) ? 1.0f : std::max(0.0f, static_cast<float>(Value.GetLight()) - 8.0f) / 7.0f;
+            PointLight = std::max(PointLight, LocalLight);
+
+            // Fog with the distance from the camera.
+            const float Distance = std::sqrt(
+                (Hit.Position[0] - View.Position[0]) * (Hit.Position[0] - View.Position[0]) +
+                (Hit.Position[1] - View.Position[1]) * (Hit.Position[1] - View.Position[1]) +
+                (Hit.Position[2] - View.Position[2]) * (Hit.Position[2] - View.Position[2]));
+            const float Fog = std::min(1.0f, Distance / View.FogDistance);
+
+            // Blend the lit voxel behind the colours so far.
+            const float Weight = (1.0f - Alpha) * VoxelColour[3];
+            for (std::size_t Channel = 0; Channel < 3; ++Channel) {
+                const float Lit = VoxelColour[Channel] * PointLight * (1.0f - Fog) + View.FogColour[Channel] * Fog;
+                Colour[Channel] = Colour[Channel] * (1.0f - Weight) + Lit * Weight;
+            }
+            Alpha = std::min(1.0f, Alpha + VoxelColour[3]);
+
+            // Continue from just beyond the face the ray leaves the voxel through.
+            float ExitDepth = INFINITY;
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                const float Step = Direction[Index] + 0.000001f;
+                const float Minimum = (static_cast<float>(Hit.Voxel[Index]) - Query.Origin[Index]) / Step;
+                const float Maximum = (static_cast<float>(Hit.Voxel[Index] + 1) - Query.Origin[Index]) / Step;
+                ExitDepth = std::min(ExitDepth, std::max(Minimum, Maximum));
+            }
+            for (std::size_t Index = 0; Index < 3; ++Index) {
+                Query.Origin[Index] += Direction[Index] * (ExitDepth + 0.001f);
+            }
+        }
+        return Colour;
+    }
+}
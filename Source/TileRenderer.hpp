@@ -0,0 +1,118 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_TILERENDERER_HPP
+#define RAYMARCH_TILERENDERER_HPP
+
+#include "GameState.hpp"
+#include "SparseVoxelOctree.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  TileRenderer raymarches rectangles of an image on the CPU from an octree of the scene, for offline renders.
+    /// @note   Rays are built with the camera math of the voxel shader and shaded with its colour decoding, point light, emitters and fog,
+    ///         passing through translucent voxels. Baked occlusion, shadows, colour noise and the cascades beyond the scene are left out.
+    class TileRenderer {
+    private:
+        /// @brief  Deleted destructor.
+        ~TileRenderer(void) = delete;
+        /// @brief  Deleted constructor.
+        TileRenderer(void) = delete;
+
+    public:
+        /// @brief  The largest number of translucent voxels a ray is blended through.
+        constexpr static const int MaximumLayers = 8;
+
+        /// @brief  The camera and lighting of an image, in the coordinates of the scene.
+        struct Camera {
+            /// @brief  The size of the whole image in pixels.
+            std::array<std::size_t, 2> ImageSize;
+
+            /// @brief  The position of the camera.
+            std::array<float, 3> Position;
+
+            /// @brief  The point the camera looks at, it must not be directly above or below the camera.
+            std::array<float, 3> Target;
+
+            /// @brief  The near clip distance.
+            float NearClip;
+
+            /// @brief  The horizontal field of view in degrees.
+            float FieldOfView;
+
+            /// @brief  The maximum render distance before fog.
+            float FogDistance;
+
+            /// @brief  The fog colour.
+            std::array<float, 3> FogColour;
+
+            /// @brief  The position of the global light.
+            std::array<float, 3> LightPosition;
+        };
+
+        /// @brief  A rectangle of an image.
+        struct Tile {
+            /// @brief  The lower left pixel of the tile.
+            std::array<std::size_t, 2> Position;
+
+            /// @brief  The size of the tile in pixels.
+            std::array<std::size_t, 2> Size;
+        };
+
+    public:
+        /// @brief  Get the camera of a game state.
+        /// @param  State - The state of the game.
+        /// @param  ImageSize - The size of the image in pixels.
+        /// @return The camera.
+        static Camera GetCamera(const GameState& State, const std::array<std::size_t, 2>& ImageSize);
+
+        /// @brief  Render a tile, the rows are rendered in parallel.
+        /// @param  Octree - The octree of the scene.
+        /// @param  View - The camera.
+        /// @param  Target - The tile, it must lie within the image.
+        /// @param  Pixels - Receives four bytes of red, green, blue and alpha per pixel, rows from the bottom of the tile.
+        static void Render(const SparseVoxelOctree& Octree, const Camera& View, const Tile& Target, std::vector<std::uint8_t>& Pixels);
+
+    private:
+        /// @brief  Decode the colour of a voxel as the voxel shader does.
+        /// @param  Value - The voxel.
+        /// @return The red, green, blue and alpha of the voxel.
+        static std::array<float, 4> DecodeVoxel(Voxel Value);
+
+        /// @brief  Shade the ray through a pixel.
+        /// @param  Octree - The octree of the scene.
+        /// @param  View - The camera.
+        /// @param  X - The X coordinate of the pixel.
+        /// @param  Y - The Y coordinate of the pixel.
+        /// @return The red, green and blue of the pixel.
+        static std::array<float, 3> Shade(const SparseVoxelOctree& Octree, const Camera& View, std::size_t X, std::size_t Y);
+    };
+}
+
+#endif // RAYMARCH_TILERENDERER_HPP
@@ -0,0 +1,179 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "Trace.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+namespace Raymarch {
+    // A single complete event.
+    struct TraceEvent {
+        const char* Name;
+        std::uint64_t Begin;
+        std::uint64_t End;
+    };
+
+    // The events recorded by a single thread.
+    struct Trace::ThreadBuffer {
+        // Limit the events kept per thread so a forgotten trace cannot exhaust memory.
+        constexpr static const std::size_t MaximumEvents = 1 << 20;
+
+        // Guards the events against a concurrent write, uncontended except while writing.
+        std::mutex Mutex;
+        std::size_t ThreadIndex;
+        std::string ThreadName;
+        std::vector<TraceEvent> Events;
+        std::size_t DroppedEvents;
+    };
+
+    // Tracing starts disabled.
+    std::atomic<bool> Trace::Enabled(false);
+
+    // Guards the thread buffer list.
+    std::mutex Trace::ThreadBuffersMutex;
+
+    // Start recording.
+    void Trace::Enable(void) {
+        // Ensure the epoch is set before the first event.
+        Trace::GetTime();
+        Trace::Enabled.store(true, std::memory_order_relaxed);
+    }
+
+    // Stop recording.
+    void Trace::Disable(void) {
+        Trace::Enabled.store(false, std::memory_order_relaxed);
+    }
+
+    // Get whether recording.
+    bool Trace::IsEnabled(void) {
+        return Trace::Enabled.load(std::memory_order_relaxed);
+    }
+
+    // Name the calling thread.
+    void Trace::SetThreadName(const std::string& Name) {
+        ThreadBuffer& Buffer = Trace::GetThreadBuffer();
+        std::lock_guard<std::mutex> Lock(Buffer.Mutex);
+        Buffer.ThreadName = Name;
+    }
+
+    // Get the nanoseconds since the first call, offset by one so that zero can mean "not recording".
+    std::uint64_t Trace::GetTime(void) {
+        static const std::chrono::steady_clock::time_point Epoch = std::chrono::steady_clock::now();
+        return 1 + static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Epoch).count());
+    }
+
+    // Get all thread buffers, constructed on first use to avoid static initialisation order issues.
+    std::vector<std::unique_ptr<Trace::ThreadBuffer> >& Trace::GetThreadBuffers(void) {
+        static std::vector<std::unique_ptr<ThreadBuffer> > Buffers;
+        return Buffers;
+    }
+
+    // Get the buffer of the calling thread.
+    Trace::ThreadBuffer& Trace::GetThreadBuffer(void) {
+        thread_local ThreadBuffer* Buffer = nullptr;
+        if (Buffer == nullptr) {
+            std::lock_guard<std::mutex> Lock(Trace::ThreadBuffersMutex);
+            std::vector<std::unique_ptr<ThreadBuffer> >& Buffers = Trace::GetThreadBuffers();
+            Buffers.emplace_back(new ThreadBuffer());
+            Buffer = Buffers.back().get();
+            Buffer->ThreadIndex = Buffers.size();
+            Buffer->ThreadName = "Thread " + std::to_string(Buffer->ThreadIndex);
+            Buffer->DroppedEvents = 0;
+        }
+        return *Buffer;
+    }
+
+    // Record an event for the calling thread.
+    void Trace::Record(const char* Name, std::uint64_t Begin, std::uint64_t End) {
+        ThreadBuffer& Buffer = Trace::GetThreadBuffer();
+        std::lock_guard<std::mutex> Lock(Buffer.Mutex);
+        if (Buffer.Events.size() >= ThreadBuffer::MaximumEvents) {
+            ++Buffer.DroppedEvents;
+            return;
+        }
+        Buffer.Events.push_back(TraceEvent{Name, Begin, End});
+    }
+
+    // Write all events in the Chrome trace event format.
+    bool Trace::Write(const std::string& Path) {
+        std::ofstream File(Path, std::ios::out | std::ios::trunc);
+        if (!File.is_open()) {
+            return false;
+        }
+
+        // Helper function to escape names into JSON strings.
+        auto Escape = [](const std::string& Value) -> std::string {
+            std::string Result;
+            Result.reserve(Value.size());
+            for (char Character : Value) {
+                if (Character == '"' || Character == '\\') {
+                    Result.push_back('\\');
+                    Result.push_back(Character);
+                }
+                else if (static_cast<unsigned char>(Character) < 0x20) {
+                    Result.push_back(' ');
+                }
+                else {
+                    Result.push_back(Character);
+                }
+            }
+            return Result;
+        };
+
+        // Helper function to format nanoseconds as the microseconds the format expects.
+        auto Microseconds = [](std::uint64_t Nanoseconds) -> std::string {
+            char Buffer[32];
+            std::snprintf(Buffer, sizeof(Buffer), "%llu.%03llu", static_cast<unsigned long long>(Nanoseconds / 1000), static_cast<unsigned long long>(Nanoseconds % 1000));
+            return Buffer;
+        };
+
+        File << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool First = true;
+
+        std::lock_guard<std::mutex> BuffersLock(Trace::ThreadBuffersMutex);
+        for (const std::unique_ptr<ThreadBuffer>& Buffer : Trace::GetThreadBuffers()) {
+            std::lock_guard<std::mutex> Lock(Buffer->Mutex);
+
+            // Thread name metadata.
+            File << (First ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << Buffer->ThreadIndex << ",\"args\":{\"name\":\"" << Escape(Buffer->ThreadName) << "\"}}";
+            First = false;
+
+            // Complete events.
+            for (const TraceEvent& Event : Buffer->Events) {
+                File << ",\n{\"name\":\"" << Escape(Event.Name) << "\",\"cat\":\"Raymarch\",\"ph\":\"X\",\"pid\":1,\"tid\":" << Buffer->ThreadIndex
+                     << ",\"ts\":" << Microseconds(Event.Begin) << ",\"dur\":" << Microseconds(Event.End - Event.Begin) << "}";
+            }
+
+            // Note any events that did not fit in the buffer.
+            if (Buffer->DroppedEvents > 0) {
+                File << ",\n{\"name\":\"Dropped " << Buffer->DroppedEvents << " events\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":" << Buffer->ThreadIndex << ",\"ts\":" << Microseconds(Buffer->Events.empty() ? 0 : Buffer->Events.back().End) << "}";
+            }
+        }
+
+        File << "\n]}\n";
+        return File.good();
+    }
+}
@@ -0,0 +1,145 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_TRACE_HPP
+#define RAYMARCH_TRACE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  Trace records timed scopes into per-thread buffers and writes them out as Chrome trace JSON.
+    /// @note   The output can be loaded in chrome://tracing or https://ui.perfetto.dev.
+    class Trace {
+    public:
+        /// @brief  Scope records a complete trace event spanning its lifetime.
+        class Scope {
+        private:
+            /// @brief  The name of the event, this must outlive the trace (use string literals).
+            const char* Name;
+
+            /// @brief  The start time of the event in nanoseconds, zero if tracing was disabled on construction.
+            std::uint64_t Begin;
+
+        public:
+            /// @brief  Constructor that starts timing the event if tracing is enabled.
+            /// @param  Name - The name of the event, this must outlive the trace (use string literals).
+            Scope(const char* Name);
+
+            /// @brief  Destructor that records the event if tracing was enabled on construction.
+            ~Scope(void);
+
+            /// @brief  Deleted copy constructor.
+            Scope(const Scope&) = delete;
+
+            /// @brief  Deleted copy assignment.
+            Scope& operator=(const Scope&) = delete;
+        };
+
+    private:
+        /// @brief  The per-thread event buffer, defined in the source file.
+        struct ThreadBuffer;
+
+    private:
+        /// @brief  Whether scopes are currently being recorded.
+        static std::atomic<bool> Enabled;
+
+        /// @brief  Guards the list of thread buffers.
+        static std::mutex ThreadBuffersMutex;
+
+    private:
+        /// @brief  Deleted destructor.
+        ~Trace(void) = delete;
+        /// @brief  Deleted constructor.
+        Trace(void) = delete;
+
+    public:
+        /// @brief  Start recording trace events.
+        static void Enable(void);
+
+        /// @brief  Stop recording trace events, recorded events are kept until written.
+        static void Disable(void);
+
+        /// @brief  Get whether trace events are being recorded.
+        /// @return True if trace events are being recorded.
+        static bool IsEnabled(void);
+
+        /// @brief  Name the calling thread in the trace output.
+        /// @param  Name - The name of the thread.
+        static void SetThreadName(const std::string& Name);
+
+        /// @brief  Write all recorded events as Chrome trace JSON.
+        /// @param  Path - The path of the file to write.
+        /// @return True if the file was written successfully.
+        static bool Write(const std::string& Path);
+
+    private:
+        /// @brief  Get the time since the trace epoch.
+        /// @return The time in nanoseconds, never zero.
+        static std::uint64_t GetTime(void);
+
+        /// @brief  Get every thread buffer created so far, buffers live until exit so events outlive their threads.
+        /// @return The list of thread buffers, guarded by ThreadBuffersMutex.
+        static std::vector<std::unique_ptr<ThreadBuffer> >& GetThreadBuffers(void);
+
+        /// @brief  Get the event buffer of the calling thread, creating it if required.
+        /// @return The event buffer of the calling thread.
+        static ThreadBuffer& GetThreadBuffer(void);
+
+        /// @brief  Record a complete event into the buffer of the calling thread.
+        /// @param  Name - The name of the event.
+        /// @param  Begin - The start time of the event in nanoseconds.
+        /// @param  End - The end time of the event in nanoseconds.
+        static void Record(const char* Name, std::uint64_t Begin, std::uint64_t End);
+    };
+
+    // Inlined so a disabled scope costs a single relaxed load and branch.
+    inline Trace::Scope::Scope(const char* Name)
+        : Name(Name)
+        , Begin(Trace::Enabled.load(std::memory_order_relaxed) ? Trace::GetTime() : 0) {
+    }
+
+    // Inlined so a disabled scope costs a single branch.
+    inline Trace::Scope::~Scope(void) {
+        if (this->Begin != 0) {
+            Trace::Record(this->Name, this->Begin, Trace::GetTime());
+        }
+    }
+}
+
+// Define RAYMARCH_DISABLE_TRACE to compile all trace scopes out entirely.
+#ifdef RAYMARCH_DISABLE_TRACE
+    #define RAYMARCH_TRACE_SCOPE(Name) static_cast<void>(0)
+#else
+    #define RAYMARCH_TRACE_CONCATENATE_DETAIL(Left, Right) Left##Right
+    #define RAYMARCH_TRACE_CONCATENATE(Left, Right) RAYMARCH_TRACE_CONCATENATE_DETAIL(Left, Right)
+    #define RAYMARCH_TRACE_SCOPE(Name) const ::Raymarch::Trace::Scope RAYMARCH_TRACE_CONCATENATE(TraceScope, __LINE__)(Name)
+#endif
+
+#endif // RAYMARCH_TRACE_HPP
@@ -24,9 +24,74 @@ THE SOFTWARE
 
 #include "Volume.hpp"
 
+#include <algorithm>
 #include <cassert>
 
+// Bulk operations on packed voxels are compiled for AVX2 as well as the baseline, the best is picked when the program loads.
+#if defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__))
+    #define RAYMARCH_VECTORISE __attribute__((target_clones("avx2", "default")))
+#else
+    #define RAYMARCH_VECTORISE
+#endif
+
 namespace Raymarch {
+    // Count the voxels with matching masked bits.
+    RAYMARCH_VECTORISE
+    static std::size_t CountMatching(const Voxel* Voxels, std::size_t Count, std::uint32_t Mask, std::uint32_t Value) {
+        std::size_t Result = 0;
+        for (std::size_t Index = 0; Index < Count; ++Index) {
+            Result += ((Voxels[Index].GetBits() & Mask) == Value) ? 1 : 0;
+        }
+        return Result;
+    }
+
+    // Pack one occupancy bit per voxel, whole words first and the remaining voxels into the last word.
+    RAYMARCH_VECTORISE
+    static void PackOccupancy(const Voxel* Voxels, std::size_t Count, std::uint64_t* Words) {
+        const std::size_t WholeWords = Count / 64;
+        for (std::size_t Word = 0; Word < WholeWords; ++Word) {
+            std::uint64_t Bits = 0;
+            for (std::size_t Bit = 0; Bit < 64; ++Bit) {
+                Bits |= static_cast<std::uint64_t>((Voxels[Word * 64 + Bit].GetBits() & Voxel::AlphaMask) != 0) << Bit;
+            }
+            Words[Word] = Bits;
+        }
+        if (Count % 64 != 0) {
+            std::uint64_t Bits = 0;
+            for (std::size_t Bit = 0; Bit < Count % 64; ++Bit) {
+                Bits |= static_cast<std::uint64_t>((Voxels[WholeWords * 64 + Bit].GetBits() & Voxel::AlphaMask) != 0) << Bit;
+            }
+            Words[WholeWords] = Bits;
+        }
+    }
+
+    // Count hues into four interleaved histograms so consecutive voxels do not wait on the same counter.
+    RAYMARCH_VECTORISE
+    static void CountHues(const Voxel* Voxels, std::size_t Count, std::array<std::size_t, 16>& Histogram) {
+        std::size_t Partial[4][16] = {};
+        std::size_t Index = 0;
+        for (; Index + 4 <= Count; Index += 4) {
+            ++Partial[0][(Voxels[Index + 0].GetBits() & Voxel::HueMask) >> Voxel::HueShift];
+            ++Partial[1][(Voxels[Index + 1].GetBits() & Voxel::HueMask) >> Voxel::HueShift];
+            ++Partial[2][(Voxels[Index + 2].GetBits() & Voxel::HueMask) >> Voxel::HueShift];
+            ++Partial[3][(Voxels[Index + 3].GetBits() & Voxel::HueMask) >> Voxel::HueShift];
+        }
+        for (; Index < Count; ++Index) {
+            ++Partial[0][(Voxels[Index].GetBits() & Voxel::HueMask) >> Voxel::HueShift];
+        }
+        for (std::size_t Hue = 0; Hue < 16; ++Hue) {
+            Histogram[Hue] = Partial[0][Hue] + Partial[1][Hue] + Partial[2][Hue] + Partial[3][Hue];
+        }
+    }
+
+    // Replace the masked bits of a span of voxels.
+    RAYMARCH_VECTORISE
+    static void ReplaceBits(Voxel* Voxels, std::size_t Count, std::uint32_t Mask, std::uint32_t Value) {
+        for (std::size_t Index = 0; Index < Count; ++Index) {
+            Voxels[Index] = Voxel::FromBits((Voxels[Index].GetBits() & ~Mask) | Value);
+        }
+    }
+
     // Construct and allocate a volume of a given size.
     Volume::Volume(const std::array<std::size_t, 3>& Size)
         : Size(Size)
@@ -59,6 +124,11 @@ namespace Raymarch {
         return this->Size[2];
     }
 
+    // Get the region covered by the volume.
+    Region Volume::GetRegion(void) const {
+        return Region({{0, 0, 0}}, {{static_cast<int>(this->Size[0]), static_cast<int>(this->Size[1]), static_cast<int>(this->Size[2])}});
+    }
+
     // Get a voxel from within the volume.
     Voxel& Volume::operator()(std::size_t X, std::size_t Y, std::size_t Z) {
         assert(X < this->Size[0]);
@@ -69,7 +139,12 @@ namespace Raymarch {
 
     // Get a voxel from within the volume.
     const Voxel& Volume::operator()(std::size_t X, std::size_t Y, std::size_t Z) const {
-        return const_cast<const decltype(this)>(this)->operator()(X, Y, Z);
+        return const_cast<Volume*>(this)->operator()(X, Y, Z);
+    }
+
+    // Get the volume data.
+    Voxel* Volume::data(void) {
+        return this->Data.data();
     }
 
     // Get the volume data.
@@ -87,19 +162,68 @@ namespace Raymarch {
         std::fill(this->Data.begin(), this->Data.end(), Value);
     }
 
+    // Fill a region of the volume with voxels of the given type.
+    void Volume::Fill(Voxel Value, const Region& Target) {
+        const Region Clipped = Target.Intersection(this->GetRegion());
+        for (int IndexZ = Clipped.Minimum[2]; IndexZ < Clipped.Maximum[2]; ++IndexZ) {
+            for (int IndexY = Clipped.Minimum[1]; IndexY < Clipped.Maximum[1]; ++IndexY) {
+                Voxel* Row = &this->operator()(0, IndexY, IndexZ);
+                std::fill(Row + Clipped.Minimum[0], Row + Clipped.Maximum[0], Value);
+            }
+        }
+    }
+
     // Copy a source volume into this volume.
-    void Volume::Insert(int X, int Y, int Z, Volume Source) {
-        for (std::size_t IndexX = 0; IndexX < Source.Size[0]; ++IndexX) {
-            if (X + static_cast<int>(IndexX) < 0) continue;
-            if (X + IndexX >= this->Size[0]) break;
-            for (std::size_t IndexY = 0; IndexY < Source.Size[1]; ++IndexY) {
-                if (Y + static_cast<int>(IndexY) < 0) continue;
-                if (Y + IndexY >= this->Size[1]) break;
-                for (std::size_t IndexZ = 0; IndexZ < Source.Size[2]; ++IndexZ) {
-                    if (Z + static_cast<int>(IndexZ) < 0) continue;
-                    if (Z + IndexZ >= this->Size[2]) break;
-                    this->operator()(X + IndexX, Y + IndexY, Z + IndexZ) = Source(IndexX, IndexY, IndexZ);
-                }
+    void Volume::Insert(int X, int Y, int Z, const Volume& Source) {
+        this->Insert(X, Y, Z, Source, this->GetRegion());
+    }
+
+    // Copy the part of a source volume that lands within the clip region into this volume.
+    void Volume::Insert(int X, int Y, int Z, const Volume& Source, const Region& Clip) {
+        // The region of this volume that the source covers and may be written.
+        const Region Target = Source.GetRegion().Translate({{X, Y, Z}}).Intersection(Clip).Intersection(this->GetRegion());
+
+        // Copy whole rows, X is contiguous in both volumes.
+        for (int IndexZ = Target.Minimum[2]; IndexZ < Target.Maximum[2]; ++IndexZ) {
+            for (int IndexY = Target.Minimum[1]; IndexY < Target.Maximum[1]; ++IndexY) {
+                const Voxel* SourceRow = &Source(Target.Minimum[0] - X, IndexY - Y, IndexZ - Z);
+                Voxel* TargetRow = &this->operator()(Target.Minimum[0], IndexY, IndexZ);
+                std::copy(SourceRow, SourceRow + (Target.Maximum[0] - Target.Minimum[0]), TargetRow);
+            }
+        }
+    }
+
+    // Count the voxels matching a mask.
+    std::size_t Volume::Count(std::uint32_t Mask, std::uint32_t Value) const {
+        return CountMatching(this->Data.data(), this->Data.size(), Mask, Value);
+    }
+
+    // Count the voxels with every alpha bit set.
+    std::size_t Volume::CountSolid(void) const {
+        return this->Count(Voxel::AlphaMask, Voxel::AlphaMask);
+    }
+
+    // Get the occupancy bit mask.
+    std::vector<std::uint64_t> Volume::GetOccupancyMask(void) const {
+        std::vector<std::uint64_t> Words((this->Data.size() + 63) / 64, 0);
+        PackOccupancy(this->Data.data(), this->Data.size(), Words.data());
+        return Words;
+    }
+
+    // Get the hue histogram.
+    std::array<std::size_t, 16> Volume::GetHueHistogram(void) const {
+        std::array<std::size_t, 16> Histogram;
+        CountHues(this->Data.data(), this->Data.size(), Histogram);
+        return Histogram;
+    }
+
+    // Set the light field of every voxel in a region, a row at a time.
+    void Volume::SetLight(std::uint8_t Light, const Region& Target) {
+        const Region Clipped = Target.Intersection(this->GetRegion());
+        const std::uint32_t Value = (static_cast<std::uint32_t>(Light) << Voxel::LightShift) & Voxel::LightMask;
+        for (int IndexZ = Clipped.Minimum[2]; IndexZ < Clipped.Maximum[2]; ++IndexZ) {
+            for (int IndexY = Clipped.Minimum[1]; IndexY < Clipped.Maximum[1]; ++IndexY) {
+                ReplaceBits(&this->operator()(Clipped.Minimum[0], IndexY, IndexZ), static_cast<std::size_t>(Clipped.Maximum[0] - Clipped.Minimum[0]), Voxel::LightMask, Value);
             }
         }
     }
@@ -26,6 +26,7 @@ THE SOFTWARE
 #ifndef RAYMARCH_VOLUME_HPP
 #define RAYMARCH_VOLUME_HPP
 
+#include "Region.hpp"
 #include "Voxel.hpp"
 
 #include <array>
@@ -73,6 +74,10 @@ namespace Raymarch {
         /// @return The depth of the volume.
         std::size_t GetSizeZ(void) const;
 
+        /// @brief  Get the region covered by the volume.
+        /// @return The region from the origin to the size of the volume.
+        Region GetRegion(void) const;
+
     public:
         /// @brief  Get a voxel within this volume.
         /// @param  X - The X coordinate within this volume to get.
@@ -89,9 +94,14 @@ namespace Raymarch {
         const Voxel& operator()(std::size_t X, std::size_t Y, std::size_t Z) const;
 
     public:
+        /// @brief  Get a pointer to the data in this volume.
+        /// @return A pointer to the data in the volume.
+        Voxel* data(void);
+
         /// @brief  Get a pointer to the data in this volume.
         /// @return A const pointer to the data in the volume.
         const Voxel* data(void) const;
+
     public:
         /// @brief  Clear the volume, set all voxels to empty.
         void Clear(void);
@@ -100,12 +110,49 @@ namespace Raymarch {
         /// @param  Value - The voxel type used to fill the volume.
         void Fill(Voxel Value);
 
+        /// @brief  Fill part of the volume, set all voxels within a region to a given type.
+        /// @param  Value - The voxel type used to fill the region.
+        /// @param  Target - The region to fill, clipped to the volume.
+        void Fill(Voxel Value, const Region& Target);
+
         /// @brief  Combine this volume with another source.
         /// @param  X - The X location to position the source volume within this volume.
         /// @param  Y - The Y location to position the source volume within this volume.
         /// @param  Z - The Z location to position the source volume within this volume.
         /// @param  Source - The source volume to write into this volume.
-        void Insert(int X, int Y, int Z, Volume Source);
+        void Insert(int X, int Y, int Z, const Volume& Source);
+
+        /// @brief  Combine part of this volume with another source, voxels outside of the clip region are untouched.
+        /// @param  X - The X location to position the source volume within this volume.
+        /// @param  Y - The Y location to position the source volume within this volume.
+        /// @param  Z - The Z location to position the source volume within this volume.
+        /// @param  Source - The source volume to write into this volume.
+        /// @param  Clip - The region of this volume that may be written.
+        void Insert(int X, int Y, int Z, const Volume& Source, const Region& Clip);
+
+    public:
+        /// @brief  Count the voxels whose packed bits match a value under a mask.
+        /// @param  Mask - The bits to compare, built from the field masks of Voxel.
+        /// @param  Value - The expected value of the masked bits.
+        /// @return The number of matching voxels.
+        std::size_t Count(std::uint32_t Mask, std::uint32_t Value) const;
+
+        /// @brief  Count the solid, fully opaque, voxels.
+        /// @return The number of voxels with the maximum alpha.
+        std::size_t CountSolid(void) const;
+
+        /// @brief  Get a mask of the voxels that are not empty.
+        /// @return One bit per voxel in volume order, set when its alpha is above zero, 64 voxels per word.
+        std::vector<std::uint64_t> GetOccupancyMask(void) const;
+
+        /// @brief  Count the voxels of each hue.
+        /// @return The number of voxels with each of the 16 hue values.
+        std::array<std::size_t, 16> GetHueHistogram(void) const;
+
+        /// @brief  Set the light level of every voxel within a region.
+        /// @param  Light - The light level.
+        /// @param  Target - The region to light, clipped to the volume.
+        void SetLight(std::uint8_t Light, const Region& Target);
 	};
 }
 
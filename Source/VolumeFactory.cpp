@@ -23,6 +23,9 @@ THE SOFTWARE
 */
 
 #include "VolumeFactory.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+#include "VoxelConverter.hpp"
 
 #include <cassert>
 #include <random>
@@ -30,11 +33,18 @@ THE SOFTWARE
 namespace Raymarch {
     // Create a solid cuboid volume all set to the same voxel type.
     Volume VolumeFactory::CreateSolid(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ, Voxel Value) {
+        RAYMARCH_TRACE_SCOPE("VolumeFactory::CreateSolid");
+
         // Allocate the volume.
         Raymarch::Volume Solid = Raymarch::Volume(SizeX, SizeY, SizeZ);
 
-        // Fill the volume with the voxel type.
-        Solid.Fill(Value);
+        // Fill the volume with the voxel type, in parallel slabs along Z.
+        JobSystem::GetGlobal().ParallelFor(0, SizeZ, 1, [&Solid, &Value](std::size_t FirstZ, std::size_t LastZ) -> void {
+            Region Slab = Solid.GetRegion();
+            Slab.Minimum[2] = static_cast<int>(FirstZ);
+            Slab.Maximum[2] = static_cast<int>(LastZ);
+            Solid.Fill(Value, Slab);
+        });
 
         // Return.
         return Solid;
@@ -42,6 +52,8 @@ namespace Raymarch {
 
     // Create a solid ellipsoid volume all set to the same voxel type.
     Volume VolumeFactory::CreateEllipsoid(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ, Voxel Value) {
+        RAYMARCH_TRACE_SCOPE("VolumeFactory::CreateEllipsoid");
+
         // Allocate the volume.
         Raymarch::Volume Ellipsoid = Raymarch::Volume(SizeX, SizeY, SizeZ);
 
@@ -53,21 +65,23 @@ namespace Raymarch {
         // Helper function to square values.
         auto Square = [](double Value) -> double { return Value * Value; };
 
-        // Loop over all voxels of the volume and fill them if they are within the ellipsoid.
-        for (std::size_t IndexX = 0; IndexX < SizeX; ++IndexX) {
-            const double PartialX = Square((static_cast<double>(IndexX) - RadiusX) / RadiusX);
-            for (std::size_t IndexY = 0; IndexY < SizeY; ++IndexY) {
-                const double PartialY = Square((static_cast<double>(IndexY) - RadiusY) / RadiusY);
-                for (std::size_t IndexZ = 0; IndexZ < SizeZ; ++IndexZ) {
-                    const double PartialZ = Square((static_cast<double>(IndexZ) - RadiusZ) / RadiusZ);
-
-                    // Evaluate the ellipsoid equation.
-                    if (PartialX + PartialY + PartialZ < 1.0) {
-                        Ellipsoid(IndexX, IndexY, IndexZ) = Value;
+        // Loop over all voxels of the volume in parallel slabs along Z and fill them if they are within the ellipsoid.
+        JobSystem::GetGlobal().ParallelFor(0, SizeZ, 1, [&](std::size_t FirstZ, std::size_t LastZ) -> void {
+            for (std::size_t IndexZ = FirstZ; IndexZ < LastZ; ++IndexZ) {
+                const double PartialZ = Square((static_cast<double>(IndexZ) - RadiusZ) / RadiusZ);
+                for (std::size_t IndexY = 0; IndexY < SizeY; ++IndexY) {
+                    const double PartialY = Square((static_cast<double>(IndexY) - RadiusY) / RadiusY);
+                    for (std::size_t IndexX = 0; IndexX < SizeX; ++IndexX) {
+                        const double PartialX = Square((static_cast<double>(IndexX) - RadiusX) / RadiusX);
+
+                        // Evaluate the ellipsoid equation.
+                        if (PartialX + PartialY + PartialZ < 1.0) {
+                            Ellipsoid(IndexX, IndexY, IndexZ) = Value;
+                        }
                     }
                 }
             }
-        }
+        });
 
         // Return.
         return Ellipsoid;
@@ -75,27 +89,34 @@ namespace Raymarch {
 
     // Create a sponge cubeoid by randomly setting positions in the cuboid.
     Volume VolumeFactory::CreateRandomSponge(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ, double Density, Voxel Value) {
+        RAYMARCH_TRACE_SCOPE("VolumeFactory::CreateRandomSponge");
+
         assert(Density >= 0 && Density <= 1);
 
         // Allocate the volume.
         Raymarch::Volume Sponge = Raymarch::Volume(SizeX, SizeY, SizeZ);
 
-        // Create a random generator.
-        std::default_random_engine RandomGenerator;
-        RandomGenerator.seed(std::random_device()());
-        std::uniform_real_distribution<double> RandomDistribution(0, 1);
-
-        // Loop over all voxels of the volume and fill them randomly.
-        for (std::size_t IndexX = 0; IndexX < SizeX; ++IndexX) {
-            for (std::size_t IndexY = 0; IndexY < SizeY; ++IndexY) {
-                for (std::size_t IndexZ = 0; IndexZ < SizeZ; ++IndexZ) {
-                    // Evalueate the random function.
-                    if (RandomDistribution(RandomGenerator) < Density) {
-                        Sponge(IndexX, IndexY, IndexZ) = Value;
+        // Seed once, each Z layer then derives its own generator so that layers can be filled independently.
+        const std::random_device::result_type Seed = std::random_device()();
+
+        // Loop over all voxels of the volume in parallel slabs along Z and fill them randomly.
+        JobSystem::GetGlobal().ParallelFor(0, SizeZ, 1, [&](std::size_t FirstZ, std::size_t LastZ) -> void {
+            for (std::size_t IndexZ = FirstZ; IndexZ < LastZ; ++IndexZ) {
+                // Create a random generator for this layer.
+                std::seed_seq LayerSeed{static_cast<std::size_t>(Seed), IndexZ};
+                std::default_random_engine RandomGenerator(LayerSeed);
+                std::uniform_real_distribution<double> RandomDistribution(0, 1);
+
+                for (std::size_t IndexY = 0; IndexY < SizeY; ++IndexY) {
+                    for (std::size_t IndexX = 0; IndexX < SizeX; ++IndexX) {
+                        // Evalueate the random function.
+                        if (RandomDistribution(RandomGenerator) < Density) {
+                            Sponge(IndexX, IndexY, IndexZ) = Value;
+                        }
                     }
                 }
             }
-        }
+        });
 
         // Return.
         return Sponge;
@@ -103,6 +124,8 @@ namespace Raymarch {
 
     // Create a column volumn.
     Volume VolumeFactory::CreateColumn(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ, double Radius, Voxel Value) {
+        RAYMARCH_TRACE_SCOPE("VolumeFactory::CreateColumn");
+
         assert(Radius > 0 && Radius < 1.0);
 
         // Allocate the volume.
@@ -115,26 +138,45 @@ namespace Raymarch {
         // Helper function to square values.
         auto Square = [](double Value)->double { return Value * Value; };
 
-        // Loop over all voxels of the volume and fill ones that are within the column.
-        for (std::size_t IndexX = 0; IndexX < SizeX; ++IndexX) {
-            const double PartialX = Square((static_cast<double>(IndexX) - RadiusX) / RadiusX);
-            for (std::size_t IndexY = 0; IndexY < SizeY; ++IndexY) {
-                for (std::size_t IndexZ = 0; IndexZ < SizeZ; ++IndexZ) {
-                    // Fill the top and bottom layers completely.
-                    if (IndexY == 0 || IndexY == SizeY-1) {
-                        Column(IndexX, IndexY, IndexZ) = Value;
-                        continue;
-                    }
-                    const double PartialZ = Square((static_cast<double>(IndexZ) - RadiusZ) / RadiusZ);
-                    // Evaluate the X and Z circle for inclusion in the column.
-                    if (PartialX + PartialZ < Radius) {
-                        Column(IndexX, IndexY, IndexZ) = Value;
+        // Loop over all voxels of the volume in parallel slabs along Z and fill ones that are within the column.
+        JobSystem::GetGlobal().ParallelFor(0, SizeZ, 1, [&](std::size_t FirstZ, std::size_t LastZ) -> void {
+            for (std::size_t IndexZ = FirstZ; IndexZ < LastZ; ++IndexZ) {
+                const double PartialZ = Square((static_cast<double>(IndexZ) - RadiusZ) / RadiusZ);
+                for (std::size_t IndexY = 0; IndexY < SizeY; ++IndexY) {
+                    for (std::size_t IndexX = 0; IndexX < SizeX; ++IndexX) {
+                        // Fill the top and bottom layers completely.
+                        if (IndexY == 0 || IndexY == SizeY-1) {
+                            Column(IndexX, IndexY, IndexZ) = Value;
+                            continue;
+                        }
+                        const double PartialX = Square((static_cast<double>(IndexX) - RadiusX) / RadiusX);
+                        // Evaluate the X and Z circle for inclusion in the column.
+                        if (PartialX + PartialZ < Radius) {
+                            Column(IndexX, IndexY, IndexZ) = Value;
+                        }
                     }
                 }
             }
-        }
+        });
 
         // Return.
         return Column;
     }
+
+    // Create a volume from RGBA colours, converting Z slabs in parallel.
+    Volume VolumeFactory::CreateFromRGBA(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ, const std::uint8_t* RGBA) {
+        RAYMARCH_TRACE_SCOPE("VolumeFactory::CreateFromRGBA");
+
+        // Allocate the volume.
+        Raymarch::Volume Converted = Raymarch::Volume(SizeX, SizeY, SizeZ);
+
+        // Each layer is a contiguous span of colours and voxels.
+        const std::size_t LayerSize = SizeX * SizeY;
+        JobSystem::GetGlobal().ParallelFor(0, SizeZ, 1, [&Converted, RGBA, LayerSize](std::size_t FirstZ, std::size_t LastZ) -> void {
+            VoxelConverter::Convert(RGBA + FirstZ * LayerSize * 4, Converted.data() + FirstZ * LayerSize, (LastZ - FirstZ) * LayerSize);
+        });
+
+        // Return.
+        return Converted;
+    }
 }
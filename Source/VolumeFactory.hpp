@@ -28,6 +28,8 @@ THE SOFTWARE
 
 #include "Volume.hpp"
 
+#include <cstdint>
+
 namespace Raymarch {
     /// @brief  VolumeFactory provides a number of factory functions to create volumes.
     class VolumeFactory {
@@ -67,6 +69,13 @@ namespace Raymarch {
         /// @param  Radius - The radius of the column radius between 0.0 and 1.0.
         /// @param  Value - The voxel value.
         static Volume CreateColumn(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ, double Radius, Voxel Value);
+
+        /// @brief  Create a volume from RGBA colours, such as an imported image or coloured model.
+        /// @param  SizeX - Width of the volume.
+        /// @param  SizeY - Height of the volume.
+        /// @param  SizeZ - Depth of the volume.
+        /// @param  RGBA - The colours of every voxel in volume order, four bytes each in red, green, blue, alpha order.
+        static Volume CreateFromRGBA(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ, const std::uint8_t* RGBA);
     };
 }
 
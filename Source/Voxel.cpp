@@ -29,33 +29,17 @@ THE SOFTWARE
 
 namespace Raymarch {
     // Constructor for empty voxels.
-    Voxel::Voxel(void) {
-        this->Saturation = 0;
-        this->Alpha = 0;
-        this->Tint = 0;
-        this->Hue = 0;
-        this->Light = 0;
-        this->State = 0;
-        this->Temperature = 0;
-        this->Direction = 0;
-        this->Density = 0;
-        this->Strength = 0;
-        this->FillLevel = 0;
+    Voxel::Voxel(void)
+        : Bits(0) {
     }
 
     // Constructor for solid voxels created from an RGBA colour.
-    Voxel::Voxel(std::uint8_t R, std::uint8_t G, std::uint8_t B, std::uint8_t A) {
-        this->Saturation = 3;
-        this->Alpha = A >> 5;
-        this->Tint = 0;
-        this->Hue = RGB2Hue(R, G, B);
-        this->Light = 0b1000;
-        this->State = 0;
-        this->Temperature = 0;
-        this->Direction = 0;
-        this->Density = 0;
-        this->Strength = 0;
-        this->FillLevel = 0;
+    Voxel::Voxel(std::uint8_t R, std::uint8_t G, std::uint8_t B, std::uint8_t A)
+        : Bits(0) {
+        this->SetSaturation(3);
+        this->SetAlpha(A >> 5);
+        this->SetHue(RGB2Hue(R, G, B));
+        this->SetLight(0b1000);
     }
 
     // Helper function to convert an RGB colour to a hue.
@@ -29,33 +29,73 @@ THE SOFTWARE
 #include <cstdint>
 
 namespace Raymarch {
+    /// @brief  Voxel is a 32 bit word with fields at fixed bit positions, so raw words can be processed in bulk and decoded by the shaders.
     class Voxel {
     public:
-        /// @brief  Unused (2 bits)
-        std::uint8_t Saturation : 2;
+        /// @brief  Values of the material state.
+        enum StateType : std::uint8_t {
+            Gas, Liquid, Solid, Plasma
+        };
+
+    public:
+        /// @brief  Saturation, unused (2 bits)
+        constexpr static const std::uint32_t SaturationShift = 0;
+        constexpr static const std::uint32_t SaturationWidth = 2;
+        constexpr static const std::uint32_t SaturationMask = ((1u << SaturationWidth) - 1u) << SaturationShift;
+
         /// @brief  Transparancy (3 bits)
-        std::uint8_t Alpha : 3;
+        constexpr static const std::uint32_t AlphaShift = 2;
+        constexpr static const std::uint32_t AlphaWidth = 3;
+        constexpr static const std::uint32_t AlphaMask = ((1u << AlphaWidth) - 1u) << AlphaShift;
+
         /// @brief  Tint from nearby light sources as RGB (3 bits)
-        std::uint8_t Tint : 3;
+        constexpr static const std::uint32_t TintShift = 5;
+        constexpr static const std::uint32_t TintWidth = 3;
+        constexpr static const std::uint32_t TintMask = ((1u << TintWidth) - 1u) << TintShift;
 
         /// @brief  Colour: 11 hues + white + light grey + dark grey + black (4 bits)
-        std::uint8_t Hue : 4;
+        constexpr static const std::uint32_t HueShift = 8;
+        constexpr static const std::uint32_t HueWidth = 4;
+        constexpr static const std::uint32_t HueMask = ((1u << HueWidth) - 1u) << HueShift;
+
         /// @brief  Light level, sum total from nearby sources (4 bits)
-        std::uint8_t Light : 4;
+        constexpr static const std::uint32_t LightShift = 12;
+        constexpr static const std::uint32_t LightWidth = 4;
+        constexpr static const std::uint32_t LightMask = ((1u << LightWidth) - 1u) << LightShift;
 
         /// @brief  Material state: Gas / Liquid / Solid / Plasma (2 bits)
-        std::uint8_t State : 2;
+        constexpr static const std::uint32_t StateShift = 16;
+        constexpr static const std::uint32_t StateWidth = 2;
+        constexpr static const std::uint32_t StateMask = ((1u << StateWidth) - 1u) << StateShift;
+
         /// @brief  Temperature (3 bits)
-        std::uint8_t Temperature : 3;
+        constexpr static const std::uint32_t TemperatureShift = 18;
+        constexpr static const std::uint32_t TemperatureWidth = 3;
+        constexpr static const std::uint32_t TemperatureMask = ((1u << TemperatureWidth) - 1u) << TemperatureShift;
+
         /// @brief  Direction: Outwards, N, W, E, S, Up, Down, Inwards (3 bits)
-        std::uint8_t Direction : 3;
+        constexpr static const std::uint32_t DirectionShift = 21;
+        constexpr static const std::uint32_t DirectionWidth = 3;
+        constexpr static const std::uint32_t DirectionMask = ((1u << DirectionWidth) - 1u) << DirectionShift;
 
         /// @brief  Density (2 bits)
-        std::uint8_t Density : 2;
+        constexpr static const std::uint32_t DensityShift = 24;
+        constexpr static const std::uint32_t DensityWidth = 2;
+        constexpr static const std::uint32_t DensityMask = ((1u << DensityWidth) - 1u) << DensityShift;
+
         /// @brief  Strength (3 bits)
-        std::uint8_t Strength : 3;
+        constexpr static const std::uint32_t StrengthShift = 26;
+        constexpr static const std::uint32_t StrengthWidth = 3;
+        constexpr static const std::uint32_t StrengthMask = ((1u << StrengthWidth) - 1u) << StrengthShift;
+
         /// @brief  Fill level, amount of material in the voxel (3 bits)
-        std::uint8_t FillLevel : 3;
+        constexpr static const std::uint32_t FillLevelShift = 29;
+        constexpr static const std::uint32_t FillLevelWidth = 3;
+        constexpr static const std::uint32_t FillLevelMask = ((1u << FillLevelWidth) - 1u) << FillLevelShift;
+
+    private:
+        /// @brief  The packed fields.
+        std::uint32_t Bits;
 
     public:
         /// @brief  Constructor that creates empty voxels.
@@ -68,6 +108,148 @@ namespace Raymarch {
         /// @param  A - Value for the alpha channel.
         Voxel(std::uint8_t R, std::uint8_t G, std::uint8_t B, std::uint8_t A = 255u);
 
+    public:
+        /// @brief  Create a voxel from its packed word.
+        /// @param  Bits - The packed fields.
+        /// @return The voxel.
+        static Voxel FromBits(std::uint32_t Bits) {
+            Voxel Result;
+            Result.Bits = Bits;
+            return Result;
+        }
+
+        /// @brief  Get the packed word.
+        /// @return The packed fields.
+        std::uint32_t GetBits(void) const {
+            return this->Bits;
+        }
+
+    public:
+        /// @brief  Get the field: Saturation, unused.
+        std::uint8_t GetSaturation(void) const {
+            return this->GetField<SaturationShift, SaturationWidth>();
+        }
+
+        /// @brief  Set the field: Saturation, unused.
+        void SetSaturation(std::uint8_t Value) {
+            this->SetField<SaturationShift, SaturationWidth>(Value);
+        }
+
+        /// @brief  Get the field: Transparancy.
+        std::uint8_t GetAlpha(void) const {
+            return this->GetField<AlphaShift, AlphaWidth>();
+        }
+
+        /// @brief  Set the field: Transparancy.
+        void SetAlpha(std::uint8_t Value) {
+            this->SetField<AlphaShift, AlphaWidth>(Value);
+        }
+
+        /// @brief  Get the field: Tint from nearby light sources as RGB.
+        std::uint8_t GetTint(void) const {
+            return this->GetField<TintShift, TintWidth>();
+        }
+
+        /// @brief  Set the field: Tint from nearby light sources as RGB.
+        void SetTint(std::uint8_t Value) {
+            this->SetField<TintShift, TintWidth>(Value);
+        }
+
+        /// @brief  Get the field: Colour: 11 hues + white + light grey + dark grey + black.
+        std::uint8_t GetHue(void) const {
+            return this->GetField<HueShift, HueWidth>();
+        }
+
+        /// @brief  Set the field: Colour: 11 hues + white + light grey + dark grey + black.
+        void SetHue(std::uint8_t Value) {
+            this->SetField<HueShift, HueWidth>(Value);
+        }
+
+        /// @brief  Get the field: Light level, sum total from nearby sources.
+        std::uint8_t GetLight(void) const {
+            return this->GetField<LightShift, LightWidth>();
+        }
+
+        /// @brief  Set the field: Light level, sum total from nearby sources.
+        void SetLight(std::uint8_t Value) {
+            this->SetField<LightShift, LightWidth>(Value);
+        }
+
+        /// @brief  Get the field: Material state: Gas / Liquid / Solid / Plasma.
+        std::uint8_t GetState(void) const {
+            return this->GetField<StateShift, StateWidth>();
+        }
+
+        /// @brief  Set the field: Material state: Gas / Liquid / Solid / Plasma.
+        void SetState(std::uint8_t Value) {
+            this->SetField<StateShift, StateWidth>(Value);
+        }
+
+        /// @brief  Get the field: Temperature.
+        std::uint8_t GetTemperature(void) const {
+            return this->GetField<TemperatureShift, TemperatureWidth>();
+        }
+
+        /// @brief  Set the field: Temperature.
+        void SetTemperature(std::uint8_t Value) {
+            this->SetField<TemperatureShift, TemperatureWidth>(Value);
+        }
+
+        /// @brief  Get the field: Direction: Outwards, N, W, E, S, Up, Down, Inwards.
+        std::uint8_t GetDirection(void) const {
+            return this->GetField<DirectionShift, DirectionWidth>();
+        }
+
+        /// @brief  Set the field: Direction: Outwards, N, W, E, S, Up, Down, Inwards.
+        void SetDirection(std::uint8_t Value) {
+            this->SetField<DirectionShift, DirectionWidth>(Value);
+        }
+
+        /// @brief  Get the field: Density.
+        std::uint8_t GetDensity(void) const {
+            return this->GetField<DensityShift, DensityWidth>();
+        }
+
+        /// @brief  Set the field: Density.
+        void SetDensity(std::uint8_t Value) {
+            this->SetField<DensityShift, DensityWidth>(Value);
+        }
+
+        /// @brief  Get the field: Strength.
+        std::uint8_t GetStrength(void) const {
+            return this->GetField<StrengthShift, StrengthWidth>();
+        }
+
+        /// @brief  Set the field: Strength.
+        void SetStrength(std::uint8_t Value) {
+            this->SetField<StrengthShift, StrengthWidth>(Value);
+        }
+
+        /// @brief  Get the field: Fill level, amount of material in the voxel.
+        std::uint8_t GetFillLevel(void) const {
+            return this->GetField<FillLevelShift, FillLevelWidth>();
+        }
+
+        /// @brief  Set the field: Fill level, amount of material in the voxel.
+        void SetFillLevel(std::uint8_t Value) {
+            this->SetField<FillLevelShift, FillLevelWidth>(Value);
+        }
+
+    private:
+        /// @brief  Extract a field from the packed word.
+        /// @return The value of the field.
+        template <std::uint32_t Shift, std::uint32_t Width>
+        std::uint8_t GetField(void) const {
+            return static_cast<std::uint8_t>((this->Bits >> Shift) & ((1u << Width) - 1u));
+        }
+
+        /// @brief  Replace a field in the packed word, extra bits of the value are discarded.
+        /// @param  Value - The new value of the field.
+        template <std::uint32_t Shift, std::uint32_t Width>
+        void SetField(std::uint8_t Value) {
+            this->Bits = (this->Bits & ~(((1u << Width) - 1u) << Shift)) | ((static_cast<std::uint32_t>(Value) & ((1u << Width) - 1u)) << Shift);
+        }
+
     private:
         /// @brief  Function to convert RGB colour to a 4 bit Hue.
         /// @param  R - Value for the red channel.
@@ -75,7 +257,12 @@ namespace Raymarch {
         /// @param  B - Value for the blue channel.
         /// @return Hue as a 4 bit value.
         std::uint8_t RGB2Hue(std::uint8_t R, std::uint8_t G, std::uint8_t B);
+
+        /// @brief  The bulk converter builds its hue table from RGB2Hue.
+        friend class VoxelConverter;
     };
+
+    static_assert(sizeof(Voxel) == sizeof(std::uint32_t), "Voxels must be a single packed 32 bit word.");
 }
 
 #endif // RAYMARCH_VOXEL_HPP
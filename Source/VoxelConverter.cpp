@@ -0,0 +1,186 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "VoxelConverter.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define RAYMARCH_VOXELCONVERTER_AVX2 1
+#endif
+
+namespace Raymarch {
+    // Table offsets of the channel holding the maximum, blue takes priority over green over red as in RGB2Hue.
+    constexpr static const std::size_t RedCase = 0;
+    constexpr static const std::size_t GreenCase = 1;
+    constexpr static const std::size_t BlueCase = 2;
+
+    // Build the hue table by converting a colour for every reachable entry.
+    const std::vector<std::uint8_t>& VoxelConverter::GetHueTable(void) {
+        static const std::vector<std::uint8_t> Table = []() -> std::vector<std::uint8_t> {
+            RAYMARCH_TRACE_SCOPE("VoxelConverter::GetHueTable");
+
+            // Three bytes of padding let the AVX2 kernel gather four bytes at the last entry.
+            std::vector<std::uint8_t> Result(HueTableCaseSize * 3 + 3, 0);
+            Voxel Converter;
+            for (int Difference = 1; Difference < 256; ++Difference) {
+                for (int Numerator = -Difference; Numerator <= Difference; ++Numerator) {
+                    // Colours with the maximum at 255 and the other two channels differing by the numerator.
+                    const int Maximum = 255;
+                    const int Minimum = Maximum - Difference;
+                    const int High = (Numerator >= 0) ? (Minimum + Numerator) : Minimum;
+                    const int Low = (Numerator >= 0) ? Minimum : (Minimum - Numerator);
+                    const std::size_t Entry = static_cast<std::size_t>(Difference * Difference - 1 + Numerator + Difference);
+                    Result[RedCase * HueTableCaseSize + Entry] = Converter.RGB2Hue(Maximum, High, Low);
+                    Result[GreenCase * HueTableCaseSize + Entry] = Converter.RGB2Hue(Low, Maximum, High);
+                    Result[BlueCase * HueTableCaseSize + Entry] = Converter.RGB2Hue(High, Low, Maximum);
+                }
+            }
+            return Result;
+        }();
+        return Table;
+    }
+
+    // The AVX2 kernel is used when the processor supports it.
+    bool VoxelConverter::IsVectorised(void) {
+        #ifdef RAYMARCH_VOXELCONVERTER_AVX2
+            static const bool Vectorised = __builtin_cpu_supports("avx2");
+            return Vectorised;
+        #else
+            return false;
+        #endif
+    }
+
+    // Convert a span of colours.
+    void VoxelConverter::Convert(const std::uint8_t* RGBA, Voxel* Output, std::size_t Count) {
+        RAYMARCH_TRACE_SCOPE("VoxelConverter::Convert");
+
+        const std::uint8_t* Table = GetHueTable().data();
+        if (IsVectorised()) {
+            ConvertAVX2(RGBA, Output, Count, Table);
+        }
+        else {
+            ConvertScalar(RGBA, Output, Count, Table);
+        }
+    }
+
+    // Convert one colour at a time through the table.
+    void VoxelConverter::ConvertScalar(const std::uint8_t* RGBA, Voxel* Output, std::size_t Count, const std::uint8_t* Table) {
+        for (std::size_t Index = 0; Index < Count; ++Index) {
+            const int R = RGBA[Index * 4 + 0];
+            const int G = RGBA[Index * 4 + 1];
+            const int B = RGBA[Index * 4 + 2];
+            const int A = RGBA[Index * 4 + 3];
+            const int Maximum = std::max(R, std::max(G, B));
+            const int Difference = Maximum - std::min(R, std::min(G, B));
+
+            std::uint8_t Hue;
+            if (Difference == 0) {
+                Hue = static_cast<std::uint8_t>(Maximum / 85);
+            }
+            else {
+                std::size_t Case;
+                int Numerator;
+                if (Maximum == B) {
+                    Case = BlueCase;
+                    Numerator = R - G;
+                }
+                else if (Maximum == G) {
+                    Case = GreenCase;
+                    Numerator = B - R;
+                }
+                else {
+                    Case = RedCase;
+                    Numerator = G - B;
+                }
+                Hue = Table[Case * HueTableCaseSize + static_cast<std::size_t>(Difference * Difference - 1 + Numerator + Difference)];
+            }
+
+            Voxel Value;
+            Value.SetSaturation(3);
+            Value.SetAlpha(static_cast<std::uint8_t>(A >> 5));
+            Value.SetHue(Hue);
+            Value.SetLight(0b1000);
+            Output[Index] = Value;
+        }
+    }
+
+    #ifdef RAYMARCH_VOXELCONVERTER_AVX2
+        // Convert eight colours at a time, the hues are gathered from the table and the remaining colours are converted one at a time.
+        __attribute__((target("avx2")))
+        void VoxelConverter::ConvertAVX2(const std::uint8_t* RGBA, Voxel* Output, std::size_t Count, const std::uint8_t* Table) {
+            const __m256i ByteMask = _mm256_set1_epi32(0xFF);
+            const __m256i GreenOffset = _mm256_set1_epi32(static_cast<int>(GreenCase * HueTableCaseSize));
+            const __m256i BlueOffset = _mm256_set1_epi32(static_cast<int>(BlueCase * HueTableCaseSize));
+            const __m256i One = _mm256_set1_epi32(1);
+            const __m256i Constant = _mm256_set1_epi32(static_cast<int>((3u << Voxel::SaturationShift) | (0b1000u << Voxel::LightShift)));
+            const __m256i GreyThreshold1 = _mm256_set1_epi32(84);
+            const __m256i GreyThreshold2 = _mm256_set1_epi32(169);
+            const __m256i GreyThreshold3 = _mm256_set1_epi32(254);
+
+            std::size_t Index = 0;
+            for (; Index + 8 <= Count; Index += 8) {
+                const __m256i Pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(RGBA + Index * 4));
+                const __m256i R = _mm256_and_si256(Pixels, ByteMask);
+                const __m256i G = _mm256_and_si256(_mm256_srli_epi32(Pixels, 8), ByteMask);
+                const __m256i B = _mm256_and_si256(_mm256_srli_epi32(Pixels, 16), ByteMask);
+                const __m256i A = _mm256_srli_epi32(Pixels, 24);
+
+                const __m256i Maximum = _mm256_max_epi32(R, _mm256_max_epi32(G, B));
+                const __m256i Difference = _mm256_sub_epi32(Maximum, _mm256_min_epi32(R, _mm256_min_epi32(G, B)));
+
+                // Select the numerator and table case of the maximum channel, blue over green over red.
+                const __m256i IsBlue = _mm256_cmpeq_epi32(Maximum, B);
+                const __m256i IsGreen = _mm256_cmpeq_epi32(Maximum, G);
+                __m256i Numerator = _mm256_sub_epi32(G, B);
+                __m256i Offset = _mm256_setzero_si256();
+                Numerator = _mm256_blendv_epi8(Numerator, _mm256_sub_epi32(B, R), IsGreen);
+                Offset = _mm256_blendv_epi8(Offset, GreenOffset, IsGreen);
+                Numerator = _mm256_blendv_epi8(Numerator, _mm256_sub_epi32(R, G), IsBlue);
+                Offset = _mm256_blendv_epi8(Offset, BlueOffset, IsBlue);
+
+                // Greys have no table entry, their index is clamped to the first entry and their hue is the maximum divided by 85.
+                const __m256i IsGrey = _mm256_cmpeq_epi32(Difference, _mm256_setzero_si256());
+                __m256i Entry = _mm256_add_epi32(_mm256_sub_epi32(_mm256_mullo_epi32(Difference, Difference), One), _mm256_add_epi32(Numerator, Difference));
+                Entry = _mm256_andnot_si256(IsGrey, _mm256_add_epi32(Entry, Offset));
+                const __m256i TableHue = _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int*>(Table), Entry, 1), ByteMask);
+                const __m256i GreyHue = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_sub_epi32(_mm256_setzero_si256(), _mm256_cmpgt_epi32(Maximum, GreyThreshold1)), _mm256_cmpgt_epi32(Maximum, GreyThreshold2)), _mm256_cmpgt_epi32(Maximum, GreyThreshold3));
+                const __m256i Hue = _mm256_blendv_epi8(TableHue, GreyHue, IsGrey);
+
+                // Pack the voxels.
+                __m256i Voxels = _mm256_or_si256(Constant, _mm256_slli_epi32(_mm256_srli_epi32(A, 5), Voxel::AlphaShift));
+                Voxels = _mm256_or_si256(Voxels, _mm256_slli_epi32(Hue, Voxel::HueShift));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(Output + Index), Voxels);
+            }
+            ConvertScalar(RGBA + Index * 4, Output + Index, Count - Index, Table);
+        }
+    #else
+        // Without AVX2 every colour is converted one at a time.
+        void VoxelConverter::ConvertAVX2(const std::uint8_t* RGBA, Voxel* Output, std::size_t Count, const std::uint8_t* Table) {
+            ConvertScalar(RGBA, Output, Count, Table);
+        }
+    #endif
+}
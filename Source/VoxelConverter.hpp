@@ -0,0 +1,83 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_VOXELCONVERTER_HPP
+#define RAYMARCH_VOXELCONVERTER_HPP
+
+#include "Voxel.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  VoxelConverter converts spans of RGBA colours to voxels, giving exactly the same voxels as the RGBA voxel constructor.
+    /// @note   Hues are read from a table built with the voxel hue conversion, indexed by the channel holding the maximum,
+    ///         the difference between the maximum and minimum channels, and the difference between the other two channels.
+    ///         An AVX2 kernel converts eight colours at a time when the processor supports it.
+    class VoxelConverter {
+    private:
+        /// @brief  Deleted destructor.
+        ~VoxelConverter(void) = delete;
+        /// @brief  Deleted constructor.
+        VoxelConverter(void) = delete;
+
+    public:
+        /// @brief  The number of table entries for each maximum channel, the entries for a difference D start at D * D - 1.
+        constexpr static const std::size_t HueTableCaseSize = 65535;
+
+    public:
+        /// @brief  Convert a span of colours to voxels.
+        /// @param  RGBA - The colours, four bytes each in red, green, blue, alpha order.
+        /// @param  Output - The voxels to write, at least Count voxels.
+        /// @param  Count - The number of colours to convert.
+        static void Convert(const std::uint8_t* RGBA, Voxel* Output, std::size_t Count);
+
+        /// @brief  Test if the vectorised kernel is used on this processor.
+        /// @return True if colours are converted with AVX2.
+        static bool IsVectorised(void);
+
+    private:
+        /// @brief  Get the hue table, built on first use.
+        /// @return The hue table, padded so that four bytes can be read at any entry.
+        static const std::vector<std::uint8_t>& GetHueTable(void);
+
+        /// @brief  Convert a span of colours one at a time.
+        /// @param  RGBA - The colours.
+        /// @param  Output - The voxels to write.
+        /// @param  Count - The number of colours to convert.
+        /// @param  Table - The hue table.
+        static void ConvertScalar(const std::uint8_t* RGBA, Voxel* Output, std::size_t Count, const std::uint8_t* Table);
+
+        /// @brief  Convert a span of colours eight at a time with AVX2.
+        /// @param  RGBA - The colours.
+        /// @param  Output - The voxels to write.
+        /// @param  Count - The number of colours to convert.
+        /// @param  Table - The hue table.
+        static void ConvertAVX2(const std::uint8_t* RGBA, Voxel* Output, std::size_t Count, const std::uint8_t* Table);
+    };
+}
+
+#endif // RAYMARCH_VOXELCONVERTER_HPP
@@ -0,0 +1,192 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "World.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+
+#include <functional>
+
+namespace Raymarch {
+    // Divide rounding towards negative infinity, so negative coordinates map to the chunk below zero.
+    static int FloorDivide(int Value, int Divisor) {
+        return (Value >= 0) ? (Value / Divisor) : -((-Value + Divisor - 1) / Divisor);
+    }
+
+    // Combine the three coordinates.
+    std::size_t World::ChunkKeyHash::operator()(const std::array<int, 3>& Key) const {
+        std::size_t Result = std::hash<int>()(Key[0]);
+        Result = Result * 73856093u ^ std::hash<int>()(Key[1]);
+        Result = Result * 19349663u ^ std::hash<int>()(Key[2]);
+        return Result;
+    }
+
+    // Constructor for an empty world.
+    World::World(void) {
+    }
+
+    // Get the chunk of a voxel.
+    std::array<int, 3> World::GetChunkKey(int X, int Y, int Z) {
+        return {{FloorDivide(X, ChunkSize), FloorDivide(Y, ChunkSize), FloorDivide(Z, ChunkSize)}};
+    }
+
+    // Get the world region of a chunk.
+    Region World::GetChunkRegion(const std::array<int, 3>& Key) {
+        return Region({{Key[0] * ChunkSize, Key[1] * ChunkSize, Key[2] * ChunkSize}}, {{(Key[0] + 1) * ChunkSize, (Key[1] + 1) * ChunkSize, (Key[2] + 1) * ChunkSize}});
+    }
+
+    // Get the chunks overlapping a region.
+    std::vector<std::array<int, 3> > World::GetChunkKeys(const Region& Target) {
+        std::vector<std::array<int, 3> > Result;
+        if (Target.IsEmpty()) {
+            return Result;
+        }
+        const std::array<int, 3> First = GetChunkKey(Target.Minimum[0], Target.Minimum[1], Target.Minimum[2]);
+        const std::array<int, 3> Last = GetChunkKey(Target.Maximum[0] - 1, Target.Maximum[1] - 1, Target.Maximum[2] - 1);
+        for (int KeyZ = First[2]; KeyZ <= Last[2]; ++KeyZ) {
+            for (int KeyY = First[1]; KeyY <= Last[1]; ++KeyY) {
+                for (int KeyX = First[0]; KeyX <= Last[0]; ++KeyX) {
+                    Result.push_back({{KeyX, KeyY, KeyZ}});
+                }
+            }
+        }
+        return Result;
+    }
+
+    // Remove every chunk.
+    void World::Clear(void) {
+        this->Chunks.clear();
+    }
+
+    // Get the number of chunks.
+    std::size_t World::GetChunkCount(void) const {
+        return this->Chunks.size();
+    }
+
+    // Get the stored chunk coordinates.
+    std::vector<std::array<int, 3> > World::GetChunkKeys(void) const {
+        std::vector<std::array<int, 3> > Result;
+        Result.reserve(this->Chunks.size());
+        for (const std::pair<const std::array<int, 3>, Volume>& KeyChunkPair : this->Chunks) {
+            Result.push_back(KeyChunkPair.first);
+        }
+        return Result;
+    }
+
+    // Find a chunk.
+    Volume* World::FindChunk(const std::array<int, 3>& Key) {
+        const auto Iterator = this->Chunks.find(Key);
+        return (Iterator != this->Chunks.end()) ? &Iterator->second : nullptr;
+    }
+
+    // Find a chunk.
+    const Volume* World::FindChunk(const std::array<int, 3>& Key) const {
+        const auto Iterator = this->Chunks.find(Key);
+        return (Iterator != this->Chunks.end()) ? &Iterator->second : nullptr;
+    }
+
+    // Get or store a chunk.
+    Volume& World::GetChunk(const std::array<int, 3>& Key) {
+        auto Iterator = this->Chunks.find(Key);
+        if (Iterator == this->Chunks.end()) {
+            Iterator = this->Chunks.emplace(Key, Volume(ChunkSize, ChunkSize, ChunkSize)).first;
+        }
+        return Iterator->second;
+    }
+
+    // Remove a chunk.
+    void World::RemoveChunk(const std::array<int, 3>& Key) {
+        this->Chunks.erase(Key);
+    }
+
+    // Merge a chunk under the stored voxels.
+    bool World::MergeChunk(const std::array<int, 3>& Key, const Volume& Source) {
+        auto Iterator = this->Chunks.find(Key);
+        if (Iterator == this->Chunks.end()) {
+            this->Chunks.emplace(Key, Source);
+            return false;
+        }
+        Voxel* Target = Iterator->second.data();
+        const Voxel* Fill = Source.data();
+        const std::size_t Count = static_cast<std::size_t>(ChunkSize) * ChunkSize * ChunkSize;
+        for (std::size_t Index = 0; Index < Count; ++Index) {
+            if (Target[Index].GetBits() == 0) {
+                Target[Index] = Fill[Index];
+            }
+        }
+        return true;
+    }
+
+    // Get a voxel.
+    Voxel World::Get(int X, int Y, int Z) const {
+        const std::array<int, 3> Key = GetChunkKey(X, Y, Z);
+        const Volume* Chunk = this->FindChunk(Key);
+        if (!Chunk) {
+            return Voxel();
+        }
+        return (*Chunk)(X - Key[0] * ChunkSize, Y - Key[1] * ChunkSize, Z - Key[2] * ChunkSize);
+    }
+
+    // Set a voxel.
+    void World::Set(int X, int Y, int Z, const Voxel& Value) {
+        const std::array<int, 3> Key = GetChunkKey(X, Y, Z);
+        this->GetChunk(Key)(X - Key[0] * ChunkSize, Y - Key[1] * ChunkSize, Z - Key[2] * ChunkSize) = Value;
+    }
+
+    // Write a model into the chunks it covers.
+    Region World::Insert(const std::array<int, 3>& Position, const Volume& Model) {
+        RAYMARCH_TRACE_SCOPE("World::Insert");
+
+        const Region Target = Model.GetRegion().Translate(Position);
+
+        // Chunks are stored serially, then written in parallel as each chunk is only written by one job.
+        const std::vector<std::array<int, 3> > Keys = GetChunkKeys(Target);
+        std::vector<Volume*> Chunks;
+        Chunks.reserve(Keys.size());
+        for (const std::array<int, 3>& Key : Keys) {
+            Chunks.push_back(&this->GetChunk(Key));
+        }
+        JobSystem::GetGlobal().ParallelFor(0, Keys.size(), 1, [&Keys, &Chunks, &Position, &Model](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Index = First; Index < Last; ++Index) {
+                const std::array<int, 3>& Key = Keys[Index];
+                Chunks[Index]->Insert(Position[0] - Key[0] * ChunkSize, Position[1] - Key[1] * ChunkSize, Position[2] - Key[2] * ChunkSize, Model);
+            }
+        });
+        return Target;
+    }
+
+    // Copy the chunks overlapping the clip region into the target.
+    void World::Extract(const std::array<int, 3>& Offset, Volume& Target, const Region& Clip) const {
+        const Region TargetClip = Clip.Intersection(Target.GetRegion());
+        for (const std::array<int, 3>& Key : GetChunkKeys(TargetClip.Translate(Offset))) {
+            const Volume* Chunk = this->FindChunk(Key);
+            if (Chunk) {
+                Target.Insert(Key[0] * ChunkSize - Offset[0], Key[1] * ChunkSize - Offset[1], Key[2] * ChunkSize - Offset[2], *Chunk, TargetClip);
+            }
+            else {
+                Target.Fill(Voxel(), GetChunkRegion(Key).Translate({{-Offset[0], -Offset[1], -Offset[2]}}).Intersection(TargetClip));
+            }
+        }
+    }
+}
@@ -0,0 +1,149 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_WORLD_HPP
+#define RAYMARCH_WORLD_HPP
+
+#include "Region.hpp"
+#include "Volume.hpp"
+
+#include <array>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  World holds the persistent voxels of the map as cubic chunks keyed by chunk coordinate.
+    /// @note   Chunks that have never been written are not stored and read as empty voxels.
+    class World {
+    public:
+        /// @brief  The edge length of the cubic chunks.
+        constexpr static const int ChunkSize = 32;
+
+        /// @brief  Hash of a chunk coordinate.
+        struct ChunkKeyHash {
+            /// @brief  Hash a chunk coordinate.
+            /// @param  Key - The chunk coordinate.
+            /// @return The hash of the chunk coordinate.
+            std::size_t operator()(const std::array<int, 3>& Key) const;
+        };
+
+    private:
+        /// @brief  The stored chunks.
+        std::unordered_map<std::array<int, 3>, Volume, ChunkKeyHash> Chunks;
+
+    public:
+        /// @brief  Constructor that creates an empty world.
+        World(void);
+
+    public:
+        /// @brief  Get the coordinate of the chunk containing a voxel.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return The chunk coordinate.
+        static std::array<int, 3> GetChunkKey(int X, int Y, int Z);
+
+        /// @brief  Get the voxels covered by a chunk.
+        /// @param  Key - The chunk coordinate.
+        /// @return The region of the chunk in world coordinates.
+        static Region GetChunkRegion(const std::array<int, 3>& Key);
+
+        /// @brief  Get the coordinates of every chunk that overlaps a region.
+        /// @param  Target - The region in world coordinates.
+        /// @return The chunk coordinates, stored or not.
+        static std::vector<std::array<int, 3> > GetChunkKeys(const Region& Target);
+
+    public:
+        /// @brief  Remove every chunk.
+        void Clear(void);
+
+        /// @brief  Get the number of stored chunks.
+        /// @return The number of chunks.
+        std::size_t GetChunkCount(void) const;
+
+        /// @brief  Get the coordinates of every stored chunk.
+        /// @return The chunk coordinates.
+        std::vector<std::array<int, 3> > GetChunkKeys(void) const;
+
+        /// @brief  Find a stored chunk.
+        /// @param  Key - The chunk coordinate.
+        /// @return The chunk, or null when it is not stored.
+        Volume* FindChunk(const std::array<int, 3>& Key);
+
+        /// @brief  Find a stored chunk.
+        /// @param  Key - The chunk coordinate.
+        /// @return The chunk, or null when it is not stored.
+        const Volume* FindChunk(const std::array<int, 3>& Key) const;
+
+        /// @brief  Get a chunk, storing an empty chunk if it is not stored.
+        /// @param  Key - The chunk coordinate.
+        /// @return The chunk.
+        /// @note   Not safe to call while other threads access the world.
+        Volume& GetChunk(const std::array<int, 3>& Key);
+
+        /// @brief  Remove a stored chunk, its voxels read as empty again.
+        /// @param  Key - The chunk coordinate.
+        /// @note   Not safe to call while other threads access the world.
+        void RemoveChunk(const std::array<int, 3>& Key);
+
+        /// @brief  Fill the empty voxels of a chunk from another chunk, storing the chunk if needed.
+        /// @param  Key - The chunk coordinate.
+        /// @param  Source - A chunk sized volume, its voxels never overwrite voxels already in the world.
+        /// @return True if the chunk was already stored.
+        /// @note   Not safe to call while other threads access the world.
+        bool MergeChunk(const std::array<int, 3>& Key, const Volume& Source);
+
+    public:
+        /// @brief  Get a voxel.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return The voxel, empty when its chunk is not stored.
+        Voxel Get(int X, int Y, int Z) const;
+
+        /// @brief  Set a voxel, storing its chunk if needed.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @param  Value - The new voxel.
+        void Set(int X, int Y, int Z, const Voxel& Value);
+
+        /// @brief  Write a volume into the world, overwriting every voxel it covers.
+        /// @param  Position - The world position of the origin of the model.
+        /// @param  Model - The volume to write.
+        /// @return The region of the world that was written.
+        Region Insert(const std::array<int, 3>& Position, const Volume& Model);
+
+        /// @brief  Copy part of the world into a volume.
+        /// @param  Offset - The world position of the origin of the target.
+        /// @param  Target - The volume to write.
+        /// @param  Clip - The region of the target to write.
+        /// @note   Safe to call from several threads with disjoint clip regions.
+        void Extract(const std::array<int, 3>& Offset, Volume& Target, const Region& Clip) const;
+    };
+}
+
+#endif // RAYMARCH_WORLD_HPP
@@ -0,0 +1,268 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "WorldFile.hpp"
+#include "ChunkCodec.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+
+#include <cstdio>
+
+namespace Raymarch {
+    // Append a little endian number.
+    template <typename Type>
+    static void WriteNumber(Type Value, std::vector<std::uint8_t>& Output) {
+        for (std::size_t Index = 0; Index < sizeof(Type); ++Index) {
+            Output.push_back(static_cast<std::uint8_t>(static_cast<std::uint64_t>(Value) >> (Index * 8)));
+        }
+    }
+
+    // Read a little endian number, the caller checks there are enough bytes.
+    template <typename Type>
+    static Type ReadNumber(const std::uint8_t* Data) {
+        std::uint64_t Value = 0;
+        for (std::size_t Index = 0; Index < sizeof(Type); ++Index) {
+            Value |= static_cast<std::uint64_t>(Data[Index]) << (Index * 8);
+        }
+        return static_cast<Type>(Value);
+    }
+
+    // Constructor for a file that is not open.
+    WorldFile::WorldFile(void) {
+    }
+
+    // The reflected CRC-32 polynomial, with the table built on first use.
+    std::uint32_t WorldFile::GetChecksum(const std::uint8_t* Data, std::size_t Size) {
+        static const std::array<std::uint32_t, 256> Table = []() -> std::array<std::uint32_t, 256> {
+            std::array<std::uint32_t, 256> Result;
+            for (std::uint32_t Index = 0; Index < 256; ++Index) {
+                std::uint32_t Value = Index;
+                for (int Bit = 0; Bit < 8; ++Bit) {
+                    Value = (Value & 1) ? (0xEDB88320u ^ (Value >> 1)) : (Value >> 1);
+                }
+                Result[Index] = Value;
+            }
+            return Result;
+        }();
+
+        std::uint32_t Checksum = 0xFFFFFFFFu;
+        for (std::size_t Index = 0; Index < Size; ++Index) {
+            Checksum = Table[(Checksum ^ Data[Index]) & 0xFF] ^ (Checksum >> 8);
+        }
+        return Checksum ^ 0xFFFFFFFFu;
+    }
+
+    // Compress the chunks, then write the header, index and chunks.
+    bool WorldFile::Save(const std::string& Path, const std::vector<std::pair<std::array<int, 3>, Volume> >& Chunks) {
+        RAYMARCH_TRACE_SCOPE("WorldFile::Save");
+
+        // Compress and checksum every chunk in parallel, the chunks are independent.
+        std::vector<std::vector<std::uint8_t> > Payloads(Chunks.size());
+        std::vector<IndexEntry> Entries(Chunks.size());
+        JobSystem::GetGlobal().ParallelFor(0, Chunks.size(), 1, [&Chunks, &Payloads, &Entries](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Index = First; Index < Last; ++Index) {
+                ChunkCodec::Compress(Chunks[Index].second, Payloads[Index]);
+                Entries[Index].Key = Chunks[Index].first;
+                Entries[Index].Size = static_cast<std::uint32_t>(Payloads[Index].size());
+                Entries[Index].Checksum = GetChecksum(Payloads[Index].data(), Payloads[Index].size());
+            }
+        });
+
+        // Lay the payloads out after the header and index.
+        std::uint64_t Offset = HeaderSize + (IndexEntrySize * Entries.size());
+        std::vector<std::uint8_t> Index;
+        Index.reserve(IndexEntrySize * Entries.size());
+        for (IndexEntry& Entry : Entries) {
+            Entry.Offset = Offset;
+            Offset += Entry.Size;
+            for (int Axis = 0; Axis < 3; ++Axis) {
+                WriteNumber(static_cast<std::int32_t>(Entry.Key[Axis]), Index);
+            }
+            WriteNumber(Entry.Offset, Index);
+            WriteNumber(Entry.Size, Index);
+            WriteNumber(Entry.Checksum, Index);
+        }
+
+        std::vector<std::uint8_t> Header;
+        Header.reserve(HeaderSize);
+        WriteNumber(Magic, Header);
+        WriteNumber(Version, Header);
+        WriteNumber(static_cast<std::uint32_t>(World::ChunkSize), Header);
+        WriteNumber(static_cast<std::uint32_t>(Entries.size()), Header);
+        WriteNumber(GetChecksum(Index.data(), Index.size()), Header);
+        WriteNumber(GetChecksum(Header.data(), Header.size()), Header);
+
+        // Write to a temporary file so an interrupted save never replaces a good file, the rename replaces the old file atomically.
+        const std::string Temporary = Path + ".tmp";
+        {
+            std::ofstream Output(Temporary, std::ios::binary | std::ios::trunc);
+            if (!Output) {
+                return false;
+            }
+            Output.write(reinterpret_cast<const char*>(Header.data()), static_cast<std::streamsize>(Header.size()));
+            Output.write(reinterpret_cast<const char*>(Index.data()), static_cast<std::streamsize>(Index.size()));
+            for (const std::vector<std::uint8_t>& Payload : Payloads) {
+                Output.write(reinterpret_cast<const char*>(Payload.data()), static_cast<std::streamsize>(Payload.size()));
+            }
+            Output.flush();
+            if (!Output) {
+                Output.close();
+                std::remove(Temporary.c_str());
+                return false;
+            }
+        }
+        if (std::rename(Temporary.c_str(), Path.c_str()) != 0) {
+            std::remove(Temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // Verify the header and index, the chunks are read on demand.
+    bool WorldFile::Open(const std::string& Path) {
+        RAYMARCH_TRACE_SCOPE("WorldFile::Open");
+
+        std::lock_guard<std::mutex> Lock(this->Mutex);
+        this->Index.clear();
+        this->Lookup.clear();
+        if (this->File.is_open()) {
+            this->File.close();
+        }
+        this->File.clear();
+
+        this->File.open(Path, std::ios::binary);
+        if (!this->File) {
+            return false;
+        }
+        this->File.seekg(0, std::ios::end);
+        const std::uint64_t FileSize = static_cast<std::uint64_t>(this->File.tellg());
+        this->File.seekg(0, std::ios::beg);
+
+        // Read and verify the header.
+        std::array<std::uint8_t, HeaderSize> Header;
+        if ((FileSize < HeaderSize) || !this->File.read(reinterpret_cast<char*>(Header.data()), HeaderSize)) {
+            this->File.close();
+            return false;
+        }
+        const std::uint32_t Count = ReadNumber<std::uint32_t>(&Header[12]);
+        const std::uint32_t IndexChecksum = ReadNumber<std::uint32_t>(&Header[16]);
+        if ((ReadNumber<std::uint32_t>(&Header[0]) != Magic) || (ReadNumber<std::uint32_t>(&Header[4]) != Version) ||
+            (ReadNumber<std::uint32_t>(&Header[8]) != static_cast<std::uint32_t>(World::ChunkSize)) ||
+            (ReadNumber<std::uint32_t>(&Header[20]) != GetChecksum(Header.data(), 20)) ||
+            (FileSize < HeaderSize + (static_cast<std::uint64_t>(Count) * IndexEntrySize))) {
+            this->File.close();
+            return false;
+        }
+
+        // Read and verify the index, every chunk must lie inside the file.
+        std::vector<std::uint8_t> Bytes(static_cast<std::size_t>(Count) * IndexEntrySize);
+        if (!this->File.read(reinterpret_cast<char*>(Bytes.data()), static_cast<std::streamsize>(Bytes.size())) ||
+            (GetChecksum(Bytes.data(), Bytes.size()) != IndexChecksum)) {
+            this->File.close();
+            return false;
+        }
+        std::vector<IndexEntry> Entries(Count);
+        std::unordered_map<std::array<int, 3>, std::size_t, World::ChunkKeyHash> Positions;
+        for (std::size_t Entry = 0; Entry < Count; ++Entry) {
+            const std::uint8_t* Data = &Bytes[Entry * IndexEntrySize];
+            for (int Axis = 0; Axis < 3; ++Axis) {
+                Entries[Entry].Key[Axis] = static_cast<int>(ReadNumber<std::int32_t>(&Data[Axis * 4]));
+            }
+            Entries[Entry].Offset = ReadNumber<std::uint64_t>(&Data[12]);
+            Entries[Entry].Size = ReadNumber<std::uint32_t>(&Data[20]);
+            Entries[Entry].Checksum = ReadNumber<std::uint32_t>(&Data[24]);
+            if ((Entries[Entry].Offset > FileSize) || (Entries[Entry].Size > FileSize - Entries[Entry].Offset) ||
+                !Positions.emplace(Entries[Entry].Key, Entry).second) {
+                this->File.close();
+                return false;
+            }
+        }
+
+        this->Index = std::move(Entries);
+        this->Lookup = std::move(Positions);
+        return true;
+    }
+
+    // Get the index.
+    const std::vector<WorldFile::IndexEntry>& WorldFile::GetIndex(void) const {
+        return this->Index;
+    }
+
+    // Read, verify and decompress a chunk.
+    bool WorldFile::ReadChunk(const std::array<int, 3>& Key, Volume& Chunk) {
+        RAYMARCH_TRACE_SCOPE("WorldFile::ReadChunk");
+
+        // Only the seek and read are serialised, verifying and decompressing run concurrently.
+        std::vector<std::uint8_t> Payload;
+        IndexEntry Entry;
+        {
+            std::lock_guard<std::mutex> Lock(this->Mutex);
+            const auto Position = this->Lookup.find(Key);
+            if (Position == this->Lookup.end()) {
+                return false;
+            }
+            Entry = this->Index[Position->second];
+            Payload.resize(Entry.Size);
+            this->File.clear();
+            this->File.seekg(static_cast<std::streamoff>(Entry.Offset), std::ios::beg);
+            if (!this->File.read(reinterpret_cast<char*>(Payload.data()), static_cast<std::streamsize>(Payload.size()))) {
+                return false;
+            }
+        }
+
+        if (GetChecksum(Payload.data(), Payload.size()) != Entry.Checksum) {
+            return false;
+        }
+        Volume Result;
+        constexpr static const std::size_t Size = static_cast<std::size_t>(World::ChunkSize);
+        if (!ChunkCodec::Decompress(Payload.data(), Payload.size(), {{Size, Size, Size}}, Result)) {
+            return false;
+        }
+        Chunk = std::move(Result);
+        return true;
+    }
+
+    // Read every chunk into a world.
+    bool WorldFile::Load(World& Target) {
+        RAYMARCH_TRACE_SCOPE("WorldFile::Load");
+
+        // Read every chunk in parallel, then store them once they are all known to be good.
+        std::vector<Volume> Chunks(this->Index.size());
+        std::vector<std::uint8_t> Valid(this->Index.size(), 0);
+        JobSystem::GetGlobal().ParallelFor(0, this->Index.size(), 1, [this, &Chunks, &Valid](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Entry = First; Entry < Last; ++Entry) {
+                Valid[Entry] = this->ReadChunk(this->Index[Entry].Key, Chunks[Entry]) ? 1 : 0;
+            }
+        });
+        for (std::uint8_t Result : Valid) {
+            if (Result == 0) {
+                return false;
+            }
+        }
+        for (std::size_t Entry = 0; Entry < this->Index.size(); ++Entry) {
+            Target.GetChunk(this->Index[Entry].Key) = std::move(Chunks[Entry]);
+        }
+        return true;
+    }
+}
@@ -0,0 +1,135 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_WORLDFILE_HPP
+#define RAYMARCH_WORLDFILE_HPP
+
+#include "Volume.hpp"
+#include "World.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Raymarch {
+    /// @brief  WorldFile saves the chunks of a world to a file and reads them back in any order.
+    /// @note   The file is a header, an index with an entry per chunk, then the chunks compressed with the chunk codec.
+    ///         The header holds a checksum of itself and of the index, and every index entry holds the offset, size and checksum
+    ///         of its chunk, so a chunk can be read and verified without reading any other chunk. Numbers are little endian.
+    class WorldFile {
+    public:
+        /// @brief  The first four bytes of a world file, "RMWD".
+        constexpr static const std::uint32_t Magic = 0x44574D52;
+
+        /// @brief  The version of the format.
+        constexpr static const std::uint32_t Version = 1;
+
+        /// @brief  The number of bytes in the header.
+        constexpr static const std::size_t HeaderSize = 24;
+
+        /// @brief  The number of bytes in an index entry.
+        constexpr static const std::size_t IndexEntrySize = 28;
+
+        /// @brief  The location of a chunk in the file.
+        struct IndexEntry {
+            /// @brief  The chunk coordinate.
+            std::array<int, 3> Key;
+
+            /// @brief  The offset of the compressed chunk from the start of the file.
+            std::uint64_t Offset;
+
+            /// @brief  The number of compressed bytes.
+            std::uint32_t Size;
+
+            /// @brief  The checksum of the compressed bytes.
+            std::uint32_t Checksum;
+        };
+
+    private:
+        /// @brief  The open file.
+        std::ifstream File;
+
+        /// @brief  Guards reading the file.
+        std::mutex Mutex;
+
+        /// @brief  The index of the open file.
+        std::vector<IndexEntry> Index;
+
+        /// @brief  The index entry of each chunk coordinate.
+        std::unordered_map<std::array<int, 3>, std::size_t, World::ChunkKeyHash> Lookup;
+
+    public:
+        /// @brief  Constructor that creates a world file with nothing open.
+        WorldFile(void);
+
+        /// @brief  Deleted copy constructor.
+        WorldFile(const WorldFile&) = delete;
+
+        /// @brief  Deleted copy assignment.
+        WorldFile& operator=(const WorldFile&) = delete;
+
+    public:
+        /// @brief  Calculate the checksum used by the format, the CRC-32 of the bytes.
+        /// @param  Data - The bytes.
+        /// @param  Size - The number of bytes.
+        /// @return The checksum.
+        static std::uint32_t GetChecksum(const std::uint8_t* Data, std::size_t Size);
+
+        /// @brief  Save chunks to a file, the chunks are compressed in parallel and the file is replaced only once it is complete.
+        /// @param  Path - The path of the file.
+        /// @param  Chunks - The chunk coordinates and chunks to save.
+        /// @return False if the file could not be written.
+        static bool Save(const std::string& Path, const std::vector<std::pair<std::array<int, 3>, Volume> >& Chunks);
+
+    public:
+        /// @brief  Open a file, reading and verifying only its header and index.
+        /// @param  Path - The path of the file.
+        /// @return False if the file could not be read or is not a valid world file.
+        bool Open(const std::string& Path);
+
+        /// @brief  Get the index of the open file.
+        /// @return The index entries, empty when nothing is open.
+        const std::vector<IndexEntry>& GetIndex(void) const;
+
+        /// @brief  Read and verify a chunk of the open file, safe to call from several threads.
+        /// @param  Key - The chunk coordinate.
+        /// @param  Chunk - Receives the chunk.
+        /// @return False if the file has no such chunk or it could not be read, verified or decompressed.
+        bool ReadChunk(const std::array<int, 3>& Key, Volume& Chunk);
+
+        /// @brief  Read every chunk of the open file into a world, decompressing in parallel.
+        /// @param  Target - The world to write the chunks into.
+        /// @return False if any chunk could not be read, the target is then unchanged.
+        bool Load(World& Target);
+    };
+}
+
+#endif // RAYMARCH_WORLDFILE_HPP